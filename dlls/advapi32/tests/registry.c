@@ -4132,6 +4132,264 @@ static void test_EnumDynamicTimeZoneInformation(void)
     RegCloseKey(key);
 }
 
+/* binary registry hive format written by the wineserver when WINEREGHIVE is set */
+struct hive_header
+{
+    char          magic[8];
+    unsigned int  version;
+    unsigned int  arch;
+    LONGLONG      generation;
+    unsigned int  root;
+    unsigned int  size;
+};
+
+struct hive_key
+{
+    unsigned int  size;
+    unsigned int  flags;
+    LONGLONG      modif;
+    unsigned int  namelen;
+    unsigned int  classlen;
+    unsigned int  nb_subkeys;
+    unsigned int  nb_values;
+};
+
+struct hive_value
+{
+    unsigned int  type;
+    unsigned int  len;
+    unsigned int  namelen;
+    unsigned int  offset;
+};
+
+#define HIVE_KEY_DELETED 0x80000000
+
+static const WCHAR *get_hive_key_name( const struct hive_key *rec )
+{
+    return (const WCHAR *)((const char *)(rec + 1) + rec->nb_subkeys * sizeof(unsigned int) +
+                           rec->nb_values * sizeof(struct hive_value));
+}
+
+static BOOL hive_name_equal( const struct hive_key *rec, const char *name )
+{
+    WCHAR nameW[MAX_PATH];
+    int len = MultiByteToWideChar( CP_ACP, 0, name, -1, nameW, MAX_PATH ) - 1;
+
+    return CompareStringW( LOCALE_NEUTRAL, NORM_IGNORECASE, get_hive_key_name( rec ),
+                           rec->namelen / sizeof(WCHAR), nameW, len ) == CSTR_EQUAL;
+}
+
+/* read a file from the wine prefix, return NULL if it doesn't exist */
+static char *read_prefix_file( const char *name, DWORD *size )
+{
+    WCHAR * (CDECL *pwine_get_dos_file_name)( const char * );
+    char path[MAX_PATH];
+    WCHAR *dos_name;
+    HANDLE file;
+    char *data;
+    DWORD len;
+
+    pwine_get_dos_file_name = (void *)GetProcAddress( GetModuleHandleA("kernel32.dll"), "wine_get_dos_file_name" );
+    if (!pwine_get_dos_file_name) return NULL;
+    if (!GetEnvironmentVariableA( "WINEPREFIX", path, MAX_PATH - 32 ))
+    {
+        if (!GetEnvironmentVariableA( "HOME", path, MAX_PATH - 32 )) return NULL;
+        strcat( path, "/.wine" );
+    }
+    strcat( path, "/" );
+    strcat( path, name );
+    if (!(dos_name = pwine_get_dos_file_name( path ))) return NULL;
+    file = CreateFileW( dos_name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        NULL, OPEN_EXISTING, 0, 0 );
+    HeapFree( GetProcessHeap(), 0, dos_name );
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    *size = GetFileSize( file, NULL );
+    data = HeapAlloc( GetProcessHeap(), 0, *size + 1 );
+    if (!ReadFile( file, data, *size, &len, NULL ) || len != *size)
+    {
+        HeapFree( GetProcessHeap(), 0, data );
+        data = NULL;
+    }
+    CloseHandle( file );
+    return data;
+}
+
+/* check a key record and its subkeys, return the number of keys or 0 if the hive is corrupted */
+static unsigned int check_hive_key( const char *hive, unsigned int offset, unsigned int end )
+{
+    const struct hive_key *rec = (const struct hive_key *)(hive + offset);
+    const unsigned int *subkeys = (const unsigned int *)(rec + 1);
+    const struct hive_value *values;
+    unsigned int i, count = 1, size;
+
+    if ((offset & 7) || offset < sizeof(struct hive_header) || offset >= end) return 0;
+    if (rec->size < sizeof(*rec) || (rec->size & 7) || rec->size > end - offset) return 0;
+    size = sizeof(*rec) + rec->nb_subkeys * sizeof(unsigned int) + rec->nb_values * sizeof(*values);
+    if (size + rec->namelen + rec->classlen > rec->size) return 0;
+
+    values = (const struct hive_value *)(subkeys + rec->nb_subkeys);
+    for (i = 0; i < rec->nb_values; i++)
+        if (values[i].offset > rec->size || values[i].namelen + values[i].len > rec->size - values[i].offset)
+            return 0;
+
+    /* subkeys are stored before their parent */
+    for (i = 0; i < rec->nb_subkeys; i++)
+    {
+        unsigned int ret = check_hive_key( hive, subkeys[i], offset );
+        if (!ret) return 0;
+        count += ret;
+    }
+    return count;
+}
+
+/* find the last journal record of a key, NULL if there is none */
+static const struct hive_key *find_journal_key( const char *journal, DWORD size, const char *path )
+{
+    const struct hive_key *rec, *ret = NULL;
+    DWORD pos;
+
+    for (pos = sizeof(struct hive_header); pos + sizeof(*rec) <= size; pos += rec->size)
+    {
+        rec = (const struct hive_key *)(journal + pos);
+        if (rec->size < sizeof(*rec) || rec->size > size - pos) break;
+        if (hive_name_equal( rec, path )) ret = rec;
+    }
+    return ret;
+}
+
+/* check that the key counts match what can be enumerated */
+static void check_key_tree( HKEY hkey, const char *path, int depth )
+{
+    DWORD ret, subkeys, values, i, len;
+    char name[MAX_PATH];
+    HKEY subkey;
+
+    ret = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL );
+    ok( !ret, "%s: RegQueryInfoKey failed %u\n", path, ret );
+    for (i = 0; ; i++)
+    {
+        len = sizeof(name);
+        if ((ret = RegEnumValueA( hkey, i, name, &len, NULL, NULL, NULL, NULL )) == ERROR_NO_MORE_ITEMS) break;
+        if (ret != ERROR_MORE_DATA) ok( !ret, "%s: RegEnumValue %u failed %u\n", path, i, ret );
+    }
+    ok( i == values, "%s: enumerated %u values, expected %u\n", path, i, values );
+    for (i = 0; !(ret = RegEnumKeyA( hkey, i, name, sizeof(name) )); i++)
+    {
+        if (!depth || RegOpenKeyExA( hkey, name, 0, KEY_READ, &subkey )) continue;
+        check_key_tree( subkey, name, depth - 1 );
+        RegCloseKey( subkey );
+    }
+    ok( ret == ERROR_NO_MORE_ITEMS, "%s: RegEnumKey failed %u\n", path, ret );
+    ok( i == subkeys, "%s: enumerated %u subkeys, expected %u\n", path, i, subkeys );
+}
+
+static void test_registry_hive(void)
+{
+    static const char journal_path[] = "Software\\Wine\\Test\\HiveJournal";
+    static const char subkey_path[] = "Software\\Wine\\Test\\HiveJournal\\subkey";
+    const struct hive_header *header;
+    const struct hive_value *value;
+    const struct hive_key *rec;
+    HKEY hkey, subkey;
+    char *hive, *journal;
+    DWORD ret, size, dword;
+    unsigned int i, count;
+    BOOL found = FALSE;
+
+    if (!(hive = read_prefix_file( "user.hive", &size )))
+    {
+        skip( "the registry isn't saved in the hive format\n" );
+        return;
+    }
+
+    header = (const struct hive_header *)hive;
+    ok( size >= sizeof(*header), "hive too small: %u bytes\n", size );
+    ok( !memcmp( header->magic, "WINEHIVE", 8 ), "wrong magic %s\n", debugstr_an( header->magic, 8 ) );
+    ok( header->version == 1, "wrong version %u\n", header->version );
+    ok( header->size == size, "wrong size %u / %u\n", header->size, size );
+    count = check_hive_key( hive, header->root, header->size );
+    ok( count > 1, "corrupted hive\n" );
+    if (count)
+    {
+        const unsigned int *subkeys;
+
+        rec = (const struct hive_key *)(hive + header->root);
+        ok( rec->size == header->size - header->root, "root key isn't the last record\n" );
+        subkeys = (const unsigned int *)(rec + 1);
+        for (i = 0; i < rec->nb_subkeys; i++)
+            if (hive_name_equal( (const struct hive_key *)(hive + subkeys[i]), "Software" )) found = TRUE;
+        ok( found, "Software key not found in the hive\n" );
+    }
+    HeapFree( GetProcessHeap(), 0, hive );
+
+    /* keys are only loaded from the hive when accessed */
+    if (!RegOpenKeyExA( HKEY_CURRENT_USER, "Software", 0, KEY_READ, &hkey ))
+    {
+        check_key_tree( hkey, "HKCU\\Software", 3 );
+        RegCloseKey( hkey );
+    }
+    if (!RegOpenKeyExA( HKEY_LOCAL_MACHINE, "Software", 0, KEY_READ, &hkey ))
+    {
+        check_key_tree( hkey, "HKLM\\Software", 2 );
+        RegCloseKey( hkey );
+    }
+
+    /* flushing a key appends its changes to the journal */
+    ret = RegCreateKeyA( hkey_main, "HiveJournal", &hkey );
+    ok( !ret, "RegCreateKey failed %u\n", ret );
+    ret = RegCreateKeyA( hkey, "subkey", &subkey );
+    ok( !ret, "RegCreateKey failed %u\n", ret );
+    RegCloseKey( subkey );
+    dword = 1;
+    RegSetValueExA( hkey, "value", 0, REG_DWORD, (BYTE *)&dword, sizeof(dword) );
+    ret = RegFlushKey( hkey );
+    ok( !ret, "RegFlushKey failed %u\n", ret );
+
+    /* the first flush may write a complete hive instead */
+    dword = 2;
+    RegSetValueExA( hkey, "value", 0, REG_DWORD, (BYTE *)&dword, sizeof(dword) );
+    ret = RegDeleteKeyA( hkey, "subkey" );
+    ok( !ret, "RegDeleteKey failed %u\n", ret );
+    ret = RegFlushKey( hkey );
+    ok( !ret, "RegFlushKey failed %u\n", ret );
+
+    journal = read_prefix_file( "user.journal", &size );
+    ok( journal != NULL, "journal not found\n" );
+    if (journal)
+    {
+        header = (const struct hive_header *)journal;
+        ok( size >= sizeof(*header), "journal too small: %u bytes\n", size );
+        ok( !memcmp( header->magic, "WINEJRNL", 8 ), "wrong magic %s\n", debugstr_an( header->magic, 8 ) );
+        ok( header->version == 1, "wrong version %u\n", header->version );
+
+        /* replaying the journal must give the current state of the keys */
+        rec = find_journal_key( journal, size, journal_path );
+        ok( rec != NULL, "no journal record for %s\n", journal_path );
+        if (rec)
+        {
+            ok( !(rec->flags & HIVE_KEY_DELETED), "key marked as deleted\n" );
+            ok( !rec->nb_subkeys, "journal record with %u subkeys\n", rec->nb_subkeys );
+            ok( rec->nb_values == 1, "wrong number of values %u\n", rec->nb_values );
+            value = (const struct hive_value *)(rec + 1);
+            if (rec->nb_values == 1)
+            {
+                ok( value->type == REG_DWORD, "wrong type %u\n", value->type );
+                ok( value->len == sizeof(DWORD), "wrong len %u\n", value->len );
+                ok( value->namelen == 5 * sizeof(WCHAR), "wrong name len %u\n", value->namelen );
+                ok( *(const DWORD *)((const char *)rec + value->offset + value->namelen) == 2,
+                    "wrong value %u\n", *(const DWORD *)((const char *)rec + value->offset + value->namelen) );
+            }
+        }
+        rec = find_journal_key( journal, size, subkey_path );
+        ok( rec != NULL, "no journal record for %s\n", subkey_path );
+        if (rec) ok( rec->flags & HIVE_KEY_DELETED, "key not marked as deleted\n" );
+        HeapFree( GetProcessHeap(), 0, journal );
+    }
+
+    RegDeleteKeyA( hkey, "" );
+    RegCloseKey( hkey );
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -4170,6 +4428,7 @@ START_TEST(registry)
     test_RegQueryValueExPerformanceData();
     test_RegLoadMUIString();
     test_EnumDynamicTimeZoneInformation();
+    test_registry_hive();
 
     /* cleanup */
     delete_key( hkey_main );
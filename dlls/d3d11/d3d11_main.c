@@ -129,6 +129,7 @@ HRESULT WINAPI D3D11CoreCreateDevice(IDXGIFactory *factory, IDXGIAdapter *adapte
         ERR("Failed to query ID3D11Device interface, returning E_FAIL.\n");
         return E_FAIL;
     }
+    impl_from_ID3D11Device2((ID3D11Device2 *)*device)->create_flags = flags;
 
     return S_OK;
 }
@@ -525,6 +525,49 @@ struct d3d11_immediate_context
     struct wined3d_private_store private_store;
 };
 
+/* ID3D11DeviceContext - deferred context */
+struct d3d11_deferred_context
+{
+    ID3D11DeviceContext1 ID3D11DeviceContext1_iface;
+    LONG refcount;
+
+    struct wined3d_private_store private_store;
+    struct d3d_device *device;
+    const struct wined3d_adapter *wined3d_adapter;
+
+    /* The calls recorded since the last FinishCommandList(), and the objects
+     * they reference. */
+    BYTE *data;
+    SIZE_T data_size, data_capacity;
+    IUnknown **objects;
+    SIZE_T object_count, objects_capacity;
+    struct list maps;
+    /* A call couldn't be recorded, FinishCommandList() fails. */
+    BOOL out_of_memory;
+};
+
+HRESULT d3d11_deferred_context_create(struct d3d_device *device, UINT flags,
+        struct d3d11_deferred_context **context) DECLSPEC_HIDDEN;
+
+/* ID3D11CommandList */
+struct d3d11_command_list
+{
+    ID3D11CommandList ID3D11CommandList_iface;
+    LONG refcount;
+
+    struct wined3d_private_store private_store;
+    ID3D11Device2 *device;
+
+    BYTE *data;
+    SIZE_T data_size;
+    IUnknown **objects;
+    SIZE_T object_count;
+};
+
+struct d3d11_command_list *unsafe_impl_from_ID3D11CommandList(ID3D11CommandList *iface) DECLSPEC_HIDDEN;
+void d3d11_command_list_execute(struct d3d11_command_list *list, ID3D11DeviceContext1 *context,
+        BOOL restore_state) DECLSPEC_HIDDEN;
+
 /* ID3D11Device, ID3D10Device1 */
 struct d3d_device
 {
@@ -537,6 +580,7 @@ struct d3d_device
     LONG refcount;
 
     D3D_FEATURE_LEVEL feature_level;
+    UINT create_flags;
 
     struct d3d11_immediate_context immediate_context;
 
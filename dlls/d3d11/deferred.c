@@ -0,0 +1,3168 @@
+/*
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ *
+ */
+
+#include "d3d11_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d11);
+
+/* Deferred contexts record the calls made on them into a buffer owned by the
+ * context, without taking the wined3d lock, so that several threads can
+ * record command lists in parallel. ExecuteCommandList() replays the calls on
+ * the immediate context, which queues them to the wined3d command stream in
+ * one go. */
+
+enum d3d11_deferred_call_id
+{
+    /* Calls only changing the context state. */
+    D3D11_DEFERRED_CALL_SET_SHADER,
+    D3D11_DEFERRED_CALL_SET_CONSTANT_BUFFERS,
+    D3D11_DEFERRED_CALL_SET_SHADER_RESOURCES,
+    D3D11_DEFERRED_CALL_SET_SAMPLERS,
+    D3D11_DEFERRED_CALL_SET_CS_UAVS,
+    D3D11_DEFERRED_CALL_SET_INPUT_LAYOUT,
+    D3D11_DEFERRED_CALL_SET_VERTEX_BUFFERS,
+    D3D11_DEFERRED_CALL_SET_INDEX_BUFFER,
+    D3D11_DEFERRED_CALL_SET_PRIMITIVE_TOPOLOGY,
+    D3D11_DEFERRED_CALL_SET_RENDER_TARGETS,
+    D3D11_DEFERRED_CALL_SET_BLEND_STATE,
+    D3D11_DEFERRED_CALL_SET_DEPTH_STENCIL_STATE,
+    D3D11_DEFERRED_CALL_SET_RASTERIZER_STATE,
+    D3D11_DEFERRED_CALL_SET_VIEWPORTS,
+    D3D11_DEFERRED_CALL_SET_SCISSOR_RECTS,
+    D3D11_DEFERRED_CALL_SET_STREAM_OUTPUT,
+    D3D11_DEFERRED_CALL_SET_PREDICATION,
+    D3D11_DEFERRED_CALL_CLEAR_STATE,
+
+    D3D11_DEFERRED_CALL_EXECUTE_COMMAND_LIST,
+    D3D11_DEFERRED_CALL_DRAW,
+    D3D11_DEFERRED_CALL_DRAW_INDEXED,
+    D3D11_DEFERRED_CALL_DRAW_INSTANCED,
+    D3D11_DEFERRED_CALL_DRAW_INDEXED_INSTANCED,
+    D3D11_DEFERRED_CALL_DRAW_AUTO,
+    D3D11_DEFERRED_CALL_DRAW_INSTANCED_INDIRECT,
+    D3D11_DEFERRED_CALL_DRAW_INDEXED_INSTANCED_INDIRECT,
+    D3D11_DEFERRED_CALL_DISPATCH,
+    D3D11_DEFERRED_CALL_DISPATCH_INDIRECT,
+    D3D11_DEFERRED_CALL_CLEAR_RENDER_TARGET_VIEW,
+    D3D11_DEFERRED_CALL_CLEAR_UAV_UINT,
+    D3D11_DEFERRED_CALL_CLEAR_UAV_FLOAT,
+    D3D11_DEFERRED_CALL_CLEAR_DEPTH_STENCIL_VIEW,
+    D3D11_DEFERRED_CALL_COPY_SUBRESOURCE_REGION,
+    D3D11_DEFERRED_CALL_COPY_RESOURCE,
+    D3D11_DEFERRED_CALL_COPY_STRUCTURE_COUNT,
+    D3D11_DEFERRED_CALL_RESOLVE_SUBRESOURCE,
+    D3D11_DEFERRED_CALL_UPDATE_SUBRESOURCE,
+    D3D11_DEFERRED_CALL_UPDATE_MAPPED,
+    D3D11_DEFERRED_CALL_GENERATE_MIPS,
+    D3D11_DEFERRED_CALL_SET_RESOURCE_MIN_LOD,
+    D3D11_DEFERRED_CALL_BEGIN,
+    D3D11_DEFERRED_CALL_END,
+};
+
+struct d3d11_deferred_call
+{
+    enum d3d11_deferred_call_id id;
+    unsigned int size;
+};
+
+/* Calls taking at most one object and one integer: shaders (the value is the
+ * shader type), the input layout, rasterizer and depth stencil states (the
+ * stencil reference value), the primitive topology, predication, indirect
+ * draws and dispatches (the buffer offset), mipmap generation, queries and
+ * nested command lists (whether the state is restored). */
+struct d3d11_deferred_object_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *object;
+    UINT value;
+};
+
+/* Calls binding objects to consecutive slots. Any per-slot values, i.e.
+ * strides and offsets for vertex buffers, initial counts for unordered
+ * access views and offsets for stream output buffers, follow the objects. */
+struct d3d11_deferred_bind_call
+{
+    struct d3d11_deferred_call call;
+    enum wined3d_shader_type type;
+    UINT start_slot, count;
+    BOOL has_values;
+    IUnknown *objects[1];
+};
+
+struct d3d11_deferred_index_buffer_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *buffer;
+    DXGI_FORMAT format;
+    UINT offset;
+};
+
+/* The render target views are followed by the unordered access views, and
+ * their initial counts if any. */
+struct d3d11_deferred_render_targets_call
+{
+    struct d3d11_deferred_call call;
+    UINT rtv_count;
+    IUnknown *dsv;
+    UINT uav_start_slot, uav_count;
+    BOOL set_uavs, has_initial_counts;
+    IUnknown *views[1];
+};
+
+struct d3d11_deferred_blend_state_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *state;
+    BOOL has_blend_factor;
+    float blend_factor[4];
+    UINT sample_mask;
+};
+
+struct d3d11_deferred_viewports_call
+{
+    struct d3d11_deferred_call call;
+    UINT count;
+    D3D11_VIEWPORT viewports[1];
+};
+
+struct d3d11_deferred_scissor_rects_call
+{
+    struct d3d11_deferred_call call;
+    UINT count;
+    D3D11_RECT rects[1];
+};
+
+struct d3d11_deferred_draw_call
+{
+    struct d3d11_deferred_call call;
+    UINT count;
+    UINT instance_count;
+    UINT start_location;
+    INT base_vertex_location;
+    UINT start_instance_location;
+};
+
+struct d3d11_deferred_dispatch_call
+{
+    struct d3d11_deferred_call call;
+    UINT x, y, z;
+};
+
+struct d3d11_deferred_clear_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *view;
+    float color[4];
+    UINT values[4];
+    UINT flags;
+    float depth;
+    UINT8 stencil;
+};
+
+/* Copies, resolves and structure count copies. The latter store the buffer
+ * offset in dst_x. */
+struct d3d11_deferred_copy_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *dst, *src;
+    UINT dst_idx, dst_x, dst_y, dst_z;
+    UINT src_idx;
+    BOOL has_box;
+    D3D11_BOX box;
+    DXGI_FORMAT format;
+    UINT flags;
+};
+
+struct d3d11_deferred_update_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *resource;
+    UINT subresource_idx;
+    BOOL has_box;
+    D3D11_BOX box;
+    UINT row_pitch, depth_pitch;
+    UINT flags;
+    D3D11_MAP map_type;
+    SIZE_T data_size;
+    BYTE data[1];
+};
+
+struct d3d11_deferred_min_lod_call
+{
+    struct d3d11_deferred_call call;
+    IUnknown *resource;
+    float min_lod;
+};
+
+/* Contents of a dynamic buffer mapped on a deferred context. They are kept
+ * until the command list is finished, since D3D11_MAP_WRITE_NO_OVERWRITE
+ * maps only update part of the buffer. The data is write watched, so that
+ * only the pages written since the previous map are recorded. */
+struct d3d11_deferred_map
+{
+    struct list entry;
+    ID3D11Resource *resource;
+    UINT subresource_idx;
+    D3D11_MAP map_type;
+    SIZE_T size;
+    void *data;
+    void **dirty_pages;
+    ULONG_PTR page_count;
+};
+
+static BOOL d3d11_array_reserve(void **elements, SIZE_T *capacity, SIZE_T count, SIZE_T size)
+{
+    SIZE_T max_capacity, new_capacity;
+    void *new_elements;
+
+    if (count <= *capacity)
+        return TRUE;
+
+    max_capacity = ~(SIZE_T)0 / size;
+    if (count > max_capacity)
+        return FALSE;
+
+    new_capacity = max(*capacity, 64);
+    while (new_capacity < count && new_capacity <= max_capacity / 2)
+        new_capacity *= 2;
+    if (new_capacity < count)
+        new_capacity = count;
+
+    if (!(new_elements = heap_realloc(*elements, new_capacity * size)))
+        return FALSE;
+
+    *elements = new_elements;
+    *capacity = new_capacity;
+    return TRUE;
+}
+
+/* ID3D11CommandList methods */
+
+static inline struct d3d11_command_list *impl_from_ID3D11CommandList(ID3D11CommandList *iface)
+{
+    return CONTAINING_RECORD(iface, struct d3d11_command_list, ID3D11CommandList_iface);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_command_list_QueryInterface(ID3D11CommandList *iface,
+        REFIID iid, void **out)
+{
+    TRACE("iface %p, iid %s, out %p.\n", iface, debugstr_guid(iid), out);
+
+    if (IsEqualGUID(iid, &IID_ID3D11CommandList)
+            || IsEqualGUID(iid, &IID_ID3D11DeviceChild)
+            || IsEqualGUID(iid, &IID_IUnknown))
+    {
+        ID3D11CommandList_AddRef(iface);
+        *out = iface;
+        return S_OK;
+    }
+
+    WARN("%s not implemented, returning E_NOINTERFACE.\n", debugstr_guid(iid));
+
+    *out = NULL;
+    return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE d3d11_command_list_AddRef(ID3D11CommandList *iface)
+{
+    struct d3d11_command_list *list = impl_from_ID3D11CommandList(iface);
+    ULONG refcount = InterlockedIncrement(&list->refcount);
+
+    TRACE("%p increasing refcount to %u.\n", list, refcount);
+
+    return refcount;
+}
+
+static ULONG STDMETHODCALLTYPE d3d11_command_list_Release(ID3D11CommandList *iface)
+{
+    struct d3d11_command_list *list = impl_from_ID3D11CommandList(iface);
+    ULONG refcount = InterlockedDecrement(&list->refcount);
+    SIZE_T i;
+
+    TRACE("%p decreasing refcount to %u.\n", list, refcount);
+
+    if (!refcount)
+    {
+        ID3D11Device2 *device = list->device;
+
+        for (i = 0; i < list->object_count; ++i)
+            IUnknown_Release(list->objects[i]);
+        heap_free(list->objects);
+        heap_free(list->data);
+
+        wined3d_mutex_lock();
+        wined3d_private_store_cleanup(&list->private_store);
+        wined3d_mutex_unlock();
+        heap_free(list);
+
+        ID3D11Device2_Release(device);
+    }
+
+    return refcount;
+}
+
+static void STDMETHODCALLTYPE d3d11_command_list_GetDevice(ID3D11CommandList *iface, ID3D11Device **device)
+{
+    struct d3d11_command_list *list = impl_from_ID3D11CommandList(iface);
+
+    TRACE("iface %p, device %p.\n", iface, device);
+
+    *device = (ID3D11Device *)list->device;
+    ID3D11Device_AddRef(*device);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_command_list_GetPrivateData(ID3D11CommandList *iface,
+        REFGUID guid, UINT *data_size, void *data)
+{
+    struct d3d11_command_list *list = impl_from_ID3D11CommandList(iface);
+
+    TRACE("iface %p, guid %s, data_size %p, data %p.\n", iface, debugstr_guid(guid), data_size, data);
+
+    return d3d_get_private_data(&list->private_store, guid, data_size, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_command_list_SetPrivateData(ID3D11CommandList *iface,
+        REFGUID guid, UINT data_size, const void *data)
+{
+    struct d3d11_command_list *list = impl_from_ID3D11CommandList(iface);
+
+    TRACE("iface %p, guid %s, data_size %u, data %p.\n", iface, debugstr_guid(guid), data_size, data);
+
+    return d3d_set_private_data(&list->private_store, guid, data_size, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_command_list_SetPrivateDataInterface(ID3D11CommandList *iface,
+        REFGUID guid, const IUnknown *data)
+{
+    struct d3d11_command_list *list = impl_from_ID3D11CommandList(iface);
+
+    TRACE("iface %p, guid %s, data %p.\n", iface, debugstr_guid(guid), data);
+
+    return d3d_set_private_data_interface(&list->private_store, guid, data);
+}
+
+static UINT STDMETHODCALLTYPE d3d11_command_list_GetContextFlags(ID3D11CommandList *iface)
+{
+    TRACE("iface %p.\n", iface);
+
+    return 0;
+}
+
+static const struct ID3D11CommandListVtbl d3d11_command_list_vtbl =
+{
+    /* IUnknown methods */
+    d3d11_command_list_QueryInterface,
+    d3d11_command_list_AddRef,
+    d3d11_command_list_Release,
+    /* ID3D11DeviceChild methods */
+    d3d11_command_list_GetDevice,
+    d3d11_command_list_GetPrivateData,
+    d3d11_command_list_SetPrivateData,
+    d3d11_command_list_SetPrivateDataInterface,
+    /* ID3D11CommandList methods */
+    d3d11_command_list_GetContextFlags,
+};
+
+struct d3d11_command_list *unsafe_impl_from_ID3D11CommandList(ID3D11CommandList *iface)
+{
+    if (!iface)
+        return NULL;
+    assert(iface->lpVtbl == &d3d11_command_list_vtbl);
+    return impl_from_ID3D11CommandList(iface);
+}
+
+static void d3d11_replay_shader(ID3D11DeviceContext1 *context, const struct d3d11_deferred_object_call *call)
+{
+    switch (call->value)
+    {
+        case WINED3D_SHADER_TYPE_VERTEX:
+            ID3D11DeviceContext1_VSSetShader(context, (ID3D11VertexShader *)call->object, NULL, 0);
+            break;
+        case WINED3D_SHADER_TYPE_HULL:
+            ID3D11DeviceContext1_HSSetShader(context, (ID3D11HullShader *)call->object, NULL, 0);
+            break;
+        case WINED3D_SHADER_TYPE_DOMAIN:
+            ID3D11DeviceContext1_DSSetShader(context, (ID3D11DomainShader *)call->object, NULL, 0);
+            break;
+        case WINED3D_SHADER_TYPE_GEOMETRY:
+            ID3D11DeviceContext1_GSSetShader(context, (ID3D11GeometryShader *)call->object, NULL, 0);
+            break;
+        case WINED3D_SHADER_TYPE_PIXEL:
+            ID3D11DeviceContext1_PSSetShader(context, (ID3D11PixelShader *)call->object, NULL, 0);
+            break;
+        case WINED3D_SHADER_TYPE_COMPUTE:
+            ID3D11DeviceContext1_CSSetShader(context, (ID3D11ComputeShader *)call->object, NULL, 0);
+            break;
+        default:
+            ERR("Invalid shader type %#x.\n", call->value);
+            break;
+    }
+}
+
+static void d3d11_replay_constant_buffers(ID3D11DeviceContext1 *context,
+        const struct d3d11_deferred_bind_call *call)
+{
+    ID3D11Buffer *const *buffers = (ID3D11Buffer *const *)call->objects;
+
+    switch (call->type)
+    {
+        case WINED3D_SHADER_TYPE_VERTEX:
+            ID3D11DeviceContext1_VSSetConstantBuffers(context, call->start_slot, call->count, buffers);
+            break;
+        case WINED3D_SHADER_TYPE_HULL:
+            ID3D11DeviceContext1_HSSetConstantBuffers(context, call->start_slot, call->count, buffers);
+            break;
+        case WINED3D_SHADER_TYPE_DOMAIN:
+            ID3D11DeviceContext1_DSSetConstantBuffers(context, call->start_slot, call->count, buffers);
+            break;
+        case WINED3D_SHADER_TYPE_GEOMETRY:
+            ID3D11DeviceContext1_GSSetConstantBuffers(context, call->start_slot, call->count, buffers);
+            break;
+        case WINED3D_SHADER_TYPE_PIXEL:
+            ID3D11DeviceContext1_PSSetConstantBuffers(context, call->start_slot, call->count, buffers);
+            break;
+        case WINED3D_SHADER_TYPE_COMPUTE:
+            ID3D11DeviceContext1_CSSetConstantBuffers(context, call->start_slot, call->count, buffers);
+            break;
+        default:
+            ERR("Invalid shader type %#x.\n", call->type);
+            break;
+    }
+}
+
+static void d3d11_replay_shader_resources(ID3D11DeviceContext1 *context,
+        const struct d3d11_deferred_bind_call *call)
+{
+    ID3D11ShaderResourceView *const *views = (ID3D11ShaderResourceView *const *)call->objects;
+
+    switch (call->type)
+    {
+        case WINED3D_SHADER_TYPE_VERTEX:
+            ID3D11DeviceContext1_VSSetShaderResources(context, call->start_slot, call->count, views);
+            break;
+        case WINED3D_SHADER_TYPE_HULL:
+            ID3D11DeviceContext1_HSSetShaderResources(context, call->start_slot, call->count, views);
+            break;
+        case WINED3D_SHADER_TYPE_DOMAIN:
+            ID3D11DeviceContext1_DSSetShaderResources(context, call->start_slot, call->count, views);
+            break;
+        case WINED3D_SHADER_TYPE_GEOMETRY:
+            ID3D11DeviceContext1_GSSetShaderResources(context, call->start_slot, call->count, views);
+            break;
+        case WINED3D_SHADER_TYPE_PIXEL:
+            ID3D11DeviceContext1_PSSetShaderResources(context, call->start_slot, call->count, views);
+            break;
+        case WINED3D_SHADER_TYPE_COMPUTE:
+            ID3D11DeviceContext1_CSSetShaderResources(context, call->start_slot, call->count, views);
+            break;
+        default:
+            ERR("Invalid shader type %#x.\n", call->type);
+            break;
+    }
+}
+
+static void d3d11_replay_samplers(ID3D11DeviceContext1 *context, const struct d3d11_deferred_bind_call *call)
+{
+    ID3D11SamplerState *const *samplers = (ID3D11SamplerState *const *)call->objects;
+
+    switch (call->type)
+    {
+        case WINED3D_SHADER_TYPE_VERTEX:
+            ID3D11DeviceContext1_VSSetSamplers(context, call->start_slot, call->count, samplers);
+            break;
+        case WINED3D_SHADER_TYPE_HULL:
+            ID3D11DeviceContext1_HSSetSamplers(context, call->start_slot, call->count, samplers);
+            break;
+        case WINED3D_SHADER_TYPE_DOMAIN:
+            ID3D11DeviceContext1_DSSetSamplers(context, call->start_slot, call->count, samplers);
+            break;
+        case WINED3D_SHADER_TYPE_GEOMETRY:
+            ID3D11DeviceContext1_GSSetSamplers(context, call->start_slot, call->count, samplers);
+            break;
+        case WINED3D_SHADER_TYPE_PIXEL:
+            ID3D11DeviceContext1_PSSetSamplers(context, call->start_slot, call->count, samplers);
+            break;
+        case WINED3D_SHADER_TYPE_COMPUTE:
+            ID3D11DeviceContext1_CSSetSamplers(context, call->start_slot, call->count, samplers);
+            break;
+        default:
+            ERR("Invalid shader type %#x.\n", call->type);
+            break;
+    }
+}
+
+static const UINT *d3d11_deferred_bind_call_values(const struct d3d11_deferred_bind_call *call)
+{
+    return call->has_values ? (const UINT *)&call->objects[call->count] : NULL;
+}
+
+static void d3d11_replay_update(ID3D11DeviceContext1 *context, const struct d3d11_deferred_update_call *call)
+{
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    HRESULT hr;
+
+    if (call->call.id == D3D11_DEFERRED_CALL_UPDATE_SUBRESOURCE)
+    {
+        ID3D11DeviceContext1_UpdateSubresource1(context, (ID3D11Resource *)call->resource,
+                call->subresource_idx, call->has_box ? &call->box : NULL, call->data,
+                call->row_pitch, call->depth_pitch, call->flags);
+        return;
+    }
+
+    if (FAILED(hr = ID3D11DeviceContext1_Map(context, (ID3D11Resource *)call->resource,
+            call->subresource_idx, call->map_type, 0, &map_desc)))
+    {
+        ERR("Failed to map resource %p, hr %#x.\n", call->resource, hr);
+        return;
+    }
+    memcpy((BYTE *)map_desc.pData + call->box.left, call->data, call->data_size);
+    ID3D11DeviceContext1_Unmap(context, (ID3D11Resource *)call->resource, call->subresource_idx);
+}
+
+static void d3d11_command_list_replay(const struct d3d11_command_list *list, ID3D11DeviceContext1 *context)
+{
+    const struct d3d11_deferred_call *call;
+    const BYTE *data = list->data;
+    SIZE_T offset;
+
+    for (offset = 0; offset < list->data_size; offset += call->size)
+    {
+        call = (const struct d3d11_deferred_call *)&data[offset];
+
+        switch (call->id)
+        {
+            case D3D11_DEFERRED_CALL_SET_SHADER:
+                d3d11_replay_shader(context, (const struct d3d11_deferred_object_call *)call);
+                break;
+
+            case D3D11_DEFERRED_CALL_SET_CONSTANT_BUFFERS:
+                d3d11_replay_constant_buffers(context, (const struct d3d11_deferred_bind_call *)call);
+                break;
+
+            case D3D11_DEFERRED_CALL_SET_SHADER_RESOURCES:
+                d3d11_replay_shader_resources(context, (const struct d3d11_deferred_bind_call *)call);
+                break;
+
+            case D3D11_DEFERRED_CALL_SET_SAMPLERS:
+                d3d11_replay_samplers(context, (const struct d3d11_deferred_bind_call *)call);
+                break;
+
+            case D3D11_DEFERRED_CALL_SET_CS_UAVS:
+            {
+                const struct d3d11_deferred_bind_call *c = (const struct d3d11_deferred_bind_call *)call;
+
+                ID3D11DeviceContext1_CSSetUnorderedAccessViews(context, c->start_slot, c->count,
+                        (ID3D11UnorderedAccessView *const *)c->objects, d3d11_deferred_bind_call_values(c));
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_INPUT_LAYOUT:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_IASetInputLayout(context, (ID3D11InputLayout *)c->object);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_VERTEX_BUFFERS:
+            {
+                const struct d3d11_deferred_bind_call *c = (const struct d3d11_deferred_bind_call *)call;
+                const UINT *values = d3d11_deferred_bind_call_values(c);
+
+                ID3D11DeviceContext1_IASetVertexBuffers(context, c->start_slot, c->count,
+                        (ID3D11Buffer *const *)c->objects, values, values + c->count);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_INDEX_BUFFER:
+            {
+                const struct d3d11_deferred_index_buffer_call *c
+                        = (const struct d3d11_deferred_index_buffer_call *)call;
+
+                ID3D11DeviceContext1_IASetIndexBuffer(context, (ID3D11Buffer *)c->buffer, c->format, c->offset);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_PRIMITIVE_TOPOLOGY:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_IASetPrimitiveTopology(context, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_RENDER_TARGETS:
+            {
+                const struct d3d11_deferred_render_targets_call *c
+                        = (const struct d3d11_deferred_render_targets_call *)call;
+                UINT rtv_count = c->rtv_count == D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL ? 0 : c->rtv_count;
+                UINT uav_count = c->uav_count == D3D11_KEEP_UNORDERED_ACCESS_VIEWS ? 0 : c->uav_count;
+
+                if (!c->set_uavs)
+                {
+                    ID3D11DeviceContext1_OMSetRenderTargets(context, c->rtv_count,
+                            (ID3D11RenderTargetView *const *)c->views, (ID3D11DepthStencilView *)c->dsv);
+                    break;
+                }
+
+                ID3D11DeviceContext1_OMSetRenderTargetsAndUnorderedAccessViews(context, c->rtv_count,
+                        (ID3D11RenderTargetView *const *)c->views, (ID3D11DepthStencilView *)c->dsv,
+                        c->uav_start_slot, c->uav_count, (ID3D11UnorderedAccessView *const *)&c->views[rtv_count],
+                        c->has_initial_counts ? (const UINT *)&c->views[rtv_count + uav_count] : NULL);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_BLEND_STATE:
+            {
+                const struct d3d11_deferred_blend_state_call *c
+                        = (const struct d3d11_deferred_blend_state_call *)call;
+
+                ID3D11DeviceContext1_OMSetBlendState(context, (ID3D11BlendState *)c->state,
+                        c->has_blend_factor ? c->blend_factor : NULL, c->sample_mask);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_DEPTH_STENCIL_STATE:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_OMSetDepthStencilState(context, (ID3D11DepthStencilState *)c->object, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_RASTERIZER_STATE:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_RSSetState(context, (ID3D11RasterizerState *)c->object);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_VIEWPORTS:
+            {
+                const struct d3d11_deferred_viewports_call *c = (const struct d3d11_deferred_viewports_call *)call;
+
+                ID3D11DeviceContext1_RSSetViewports(context, c->count, c->viewports);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_SCISSOR_RECTS:
+            {
+                const struct d3d11_deferred_scissor_rects_call *c
+                        = (const struct d3d11_deferred_scissor_rects_call *)call;
+
+                ID3D11DeviceContext1_RSSetScissorRects(context, c->count, c->rects);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_STREAM_OUTPUT:
+            {
+                const struct d3d11_deferred_bind_call *c = (const struct d3d11_deferred_bind_call *)call;
+
+                ID3D11DeviceContext1_SOSetTargets(context, c->count,
+                        (ID3D11Buffer *const *)c->objects, d3d11_deferred_bind_call_values(c));
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_PREDICATION:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_SetPredication(context, (ID3D11Predicate *)c->object, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_CLEAR_STATE:
+                ID3D11DeviceContext1_ClearState(context);
+                break;
+
+            case D3D11_DEFERRED_CALL_EXECUTE_COMMAND_LIST:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_ExecuteCommandList(context, (ID3D11CommandList *)c->object, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DRAW:
+            {
+                const struct d3d11_deferred_draw_call *c = (const struct d3d11_deferred_draw_call *)call;
+
+                ID3D11DeviceContext1_Draw(context, c->count, c->start_location);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DRAW_INDEXED:
+            {
+                const struct d3d11_deferred_draw_call *c = (const struct d3d11_deferred_draw_call *)call;
+
+                ID3D11DeviceContext1_DrawIndexed(context, c->count, c->start_location, c->base_vertex_location);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DRAW_INSTANCED:
+            {
+                const struct d3d11_deferred_draw_call *c = (const struct d3d11_deferred_draw_call *)call;
+
+                ID3D11DeviceContext1_DrawInstanced(context, c->count, c->instance_count,
+                        c->start_location, c->start_instance_location);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DRAW_INDEXED_INSTANCED:
+            {
+                const struct d3d11_deferred_draw_call *c = (const struct d3d11_deferred_draw_call *)call;
+
+                ID3D11DeviceContext1_DrawIndexedInstanced(context, c->count, c->instance_count,
+                        c->start_location, c->base_vertex_location, c->start_instance_location);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DRAW_AUTO:
+                ID3D11DeviceContext1_DrawAuto(context);
+                break;
+
+            case D3D11_DEFERRED_CALL_DRAW_INSTANCED_INDIRECT:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_DrawInstancedIndirect(context, (ID3D11Buffer *)c->object, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DRAW_INDEXED_INSTANCED_INDIRECT:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_DrawIndexedInstancedIndirect(context, (ID3D11Buffer *)c->object, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DISPATCH:
+            {
+                const struct d3d11_deferred_dispatch_call *c = (const struct d3d11_deferred_dispatch_call *)call;
+
+                ID3D11DeviceContext1_Dispatch(context, c->x, c->y, c->z);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_DISPATCH_INDIRECT:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_DispatchIndirect(context, (ID3D11Buffer *)c->object, c->value);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_CLEAR_RENDER_TARGET_VIEW:
+            {
+                const struct d3d11_deferred_clear_call *c = (const struct d3d11_deferred_clear_call *)call;
+
+                ID3D11DeviceContext1_ClearRenderTargetView(context, (ID3D11RenderTargetView *)c->view, c->color);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_CLEAR_UAV_UINT:
+            {
+                const struct d3d11_deferred_clear_call *c = (const struct d3d11_deferred_clear_call *)call;
+
+                ID3D11DeviceContext1_ClearUnorderedAccessViewUint(context,
+                        (ID3D11UnorderedAccessView *)c->view, c->values);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_CLEAR_UAV_FLOAT:
+            {
+                const struct d3d11_deferred_clear_call *c = (const struct d3d11_deferred_clear_call *)call;
+
+                ID3D11DeviceContext1_ClearUnorderedAccessViewFloat(context,
+                        (ID3D11UnorderedAccessView *)c->view, c->color);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_CLEAR_DEPTH_STENCIL_VIEW:
+            {
+                const struct d3d11_deferred_clear_call *c = (const struct d3d11_deferred_clear_call *)call;
+
+                ID3D11DeviceContext1_ClearDepthStencilView(context, (ID3D11DepthStencilView *)c->view,
+                        c->flags, c->depth, c->stencil);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_COPY_SUBRESOURCE_REGION:
+            {
+                const struct d3d11_deferred_copy_call *c = (const struct d3d11_deferred_copy_call *)call;
+
+                ID3D11DeviceContext1_CopySubresourceRegion1(context, (ID3D11Resource *)c->dst, c->dst_idx,
+                        c->dst_x, c->dst_y, c->dst_z, (ID3D11Resource *)c->src, c->src_idx,
+                        c->has_box ? &c->box : NULL, c->flags);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_COPY_RESOURCE:
+            {
+                const struct d3d11_deferred_copy_call *c = (const struct d3d11_deferred_copy_call *)call;
+
+                ID3D11DeviceContext1_CopyResource(context, (ID3D11Resource *)c->dst, (ID3D11Resource *)c->src);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_COPY_STRUCTURE_COUNT:
+            {
+                const struct d3d11_deferred_copy_call *c = (const struct d3d11_deferred_copy_call *)call;
+
+                ID3D11DeviceContext1_CopyStructureCount(context, (ID3D11Buffer *)c->dst, c->dst_x,
+                        (ID3D11UnorderedAccessView *)c->src);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_RESOLVE_SUBRESOURCE:
+            {
+                const struct d3d11_deferred_copy_call *c = (const struct d3d11_deferred_copy_call *)call;
+
+                ID3D11DeviceContext1_ResolveSubresource(context, (ID3D11Resource *)c->dst, c->dst_idx,
+                        (ID3D11Resource *)c->src, c->src_idx, c->format);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_UPDATE_SUBRESOURCE:
+            case D3D11_DEFERRED_CALL_UPDATE_MAPPED:
+                d3d11_replay_update(context, (const struct d3d11_deferred_update_call *)call);
+                break;
+
+            case D3D11_DEFERRED_CALL_GENERATE_MIPS:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_GenerateMips(context, (ID3D11ShaderResourceView *)c->object);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_SET_RESOURCE_MIN_LOD:
+            {
+                const struct d3d11_deferred_min_lod_call *c = (const struct d3d11_deferred_min_lod_call *)call;
+
+                ID3D11DeviceContext1_SetResourceMinLOD(context, (ID3D11Resource *)c->resource, c->min_lod);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_BEGIN:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_Begin(context, (ID3D11Asynchronous *)c->object);
+                break;
+            }
+
+            case D3D11_DEFERRED_CALL_END:
+            {
+                const struct d3d11_deferred_object_call *c = (const struct d3d11_deferred_object_call *)call;
+
+                ID3D11DeviceContext1_End(context, (ID3D11Asynchronous *)c->object);
+                break;
+            }
+
+            default:
+                ERR("Invalid call id %#x.\n", call->id);
+                return;
+        }
+    }
+}
+
+/* The pipeline state saved by ExecuteCommandList() when the application asks
+ * for it to be restored. */
+struct d3d11_stage_state
+{
+    ID3D11DeviceChild *shader;
+    ID3D11Buffer *constant_buffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+    ID3D11ShaderResourceView *views[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+    ID3D11SamplerState *samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+};
+
+struct d3d11_saved_state
+{
+    struct d3d11_stage_state vs, hs, ds, gs, ps, cs;
+    ID3D11UnorderedAccessView *cs_uavs[D3D11_PS_CS_UAV_REGISTER_COUNT];
+
+    ID3D11InputLayout *input_layout;
+    ID3D11Buffer *vertex_buffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+    UINT strides[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+    UINT offsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+    ID3D11Buffer *index_buffer;
+    DXGI_FORMAT index_format;
+    UINT index_offset;
+    D3D11_PRIMITIVE_TOPOLOGY topology;
+
+    ID3D11Buffer *so_buffers[D3D11_SO_BUFFER_SLOT_COUNT];
+
+    ID3D11RasterizerState *rasterizer_state;
+    UINT viewport_count;
+    D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+    UINT scissor_rect_count;
+    D3D11_RECT scissor_rects[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+
+    ID3D11RenderTargetView *rtvs[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+    ID3D11DepthStencilView *dsv;
+    ID3D11UnorderedAccessView *uavs[D3D11_PS_CS_UAV_REGISTER_COUNT];
+    ID3D11BlendState *blend_state;
+    float blend_factor[4];
+    UINT sample_mask;
+    ID3D11DepthStencilState *depth_stencil_state;
+    UINT stencil_ref;
+
+    ID3D11Predicate *predicate;
+    BOOL predicate_value;
+};
+
+static void d3d11_saved_state_capture(struct d3d11_saved_state *state, ID3D11DeviceContext1 *context)
+{
+    ID3D11DeviceContext1_VSGetShader(context, (ID3D11VertexShader **)&state->vs.shader, NULL, NULL);
+    ID3D11DeviceContext1_VSGetConstantBuffers(context, 0, ARRAY_SIZE(state->vs.constant_buffers),
+            state->vs.constant_buffers);
+    ID3D11DeviceContext1_VSGetShaderResources(context, 0, ARRAY_SIZE(state->vs.views), state->vs.views);
+    ID3D11DeviceContext1_VSGetSamplers(context, 0, ARRAY_SIZE(state->vs.samplers), state->vs.samplers);
+
+    ID3D11DeviceContext1_HSGetShader(context, (ID3D11HullShader **)&state->hs.shader, NULL, NULL);
+    ID3D11DeviceContext1_HSGetConstantBuffers(context, 0, ARRAY_SIZE(state->hs.constant_buffers),
+            state->hs.constant_buffers);
+    ID3D11DeviceContext1_HSGetShaderResources(context, 0, ARRAY_SIZE(state->hs.views), state->hs.views);
+    ID3D11DeviceContext1_HSGetSamplers(context, 0, ARRAY_SIZE(state->hs.samplers), state->hs.samplers);
+
+    ID3D11DeviceContext1_DSGetShader(context, (ID3D11DomainShader **)&state->ds.shader, NULL, NULL);
+    ID3D11DeviceContext1_DSGetConstantBuffers(context, 0, ARRAY_SIZE(state->ds.constant_buffers),
+            state->ds.constant_buffers);
+    ID3D11DeviceContext1_DSGetShaderResources(context, 0, ARRAY_SIZE(state->ds.views), state->ds.views);
+    ID3D11DeviceContext1_DSGetSamplers(context, 0, ARRAY_SIZE(state->ds.samplers), state->ds.samplers);
+
+    ID3D11DeviceContext1_GSGetShader(context, (ID3D11GeometryShader **)&state->gs.shader, NULL, NULL);
+    ID3D11DeviceContext1_GSGetConstantBuffers(context, 0, ARRAY_SIZE(state->gs.constant_buffers),
+            state->gs.constant_buffers);
+    ID3D11DeviceContext1_GSGetShaderResources(context, 0, ARRAY_SIZE(state->gs.views), state->gs.views);
+    ID3D11DeviceContext1_GSGetSamplers(context, 0, ARRAY_SIZE(state->gs.samplers), state->gs.samplers);
+
+    ID3D11DeviceContext1_PSGetShader(context, (ID3D11PixelShader **)&state->ps.shader, NULL, NULL);
+    ID3D11DeviceContext1_PSGetConstantBuffers(context, 0, ARRAY_SIZE(state->ps.constant_buffers),
+            state->ps.constant_buffers);
+    ID3D11DeviceContext1_PSGetShaderResources(context, 0, ARRAY_SIZE(state->ps.views), state->ps.views);
+    ID3D11DeviceContext1_PSGetSamplers(context, 0, ARRAY_SIZE(state->ps.samplers), state->ps.samplers);
+
+    ID3D11DeviceContext1_CSGetShader(context, (ID3D11ComputeShader **)&state->cs.shader, NULL, NULL);
+    ID3D11DeviceContext1_CSGetConstantBuffers(context, 0, ARRAY_SIZE(state->cs.constant_buffers),
+            state->cs.constant_buffers);
+    ID3D11DeviceContext1_CSGetShaderResources(context, 0, ARRAY_SIZE(state->cs.views), state->cs.views);
+    ID3D11DeviceContext1_CSGetSamplers(context, 0, ARRAY_SIZE(state->cs.samplers), state->cs.samplers);
+    ID3D11DeviceContext1_CSGetUnorderedAccessViews(context, 0, ARRAY_SIZE(state->cs_uavs), state->cs_uavs);
+
+    ID3D11DeviceContext1_IAGetInputLayout(context, &state->input_layout);
+    ID3D11DeviceContext1_IAGetVertexBuffers(context, 0, ARRAY_SIZE(state->vertex_buffers),
+            state->vertex_buffers, state->strides, state->offsets);
+    ID3D11DeviceContext1_IAGetIndexBuffer(context, &state->index_buffer, &state->index_format, &state->index_offset);
+    ID3D11DeviceContext1_IAGetPrimitiveTopology(context, &state->topology);
+
+    ID3D11DeviceContext1_SOGetTargets(context, ARRAY_SIZE(state->so_buffers), state->so_buffers);
+
+    ID3D11DeviceContext1_RSGetState(context, &state->rasterizer_state);
+    state->viewport_count = ARRAY_SIZE(state->viewports);
+    ID3D11DeviceContext1_RSGetViewports(context, &state->viewport_count, state->viewports);
+    state->scissor_rect_count = ARRAY_SIZE(state->scissor_rects);
+    ID3D11DeviceContext1_RSGetScissorRects(context, &state->scissor_rect_count, state->scissor_rects);
+
+    ID3D11DeviceContext1_OMGetRenderTargetsAndUnorderedAccessViews(context, ARRAY_SIZE(state->rtvs),
+            state->rtvs, &state->dsv, 0, ARRAY_SIZE(state->uavs), state->uavs);
+    ID3D11DeviceContext1_OMGetBlendState(context, &state->blend_state, state->blend_factor, &state->sample_mask);
+    ID3D11DeviceContext1_OMGetDepthStencilState(context, &state->depth_stencil_state, &state->stencil_ref);
+
+    ID3D11DeviceContext1_GetPredication(context, &state->predicate, &state->predicate_value);
+}
+
+static void d3d11_release_objects(void *objects, unsigned int count)
+{
+    IUnknown **object = objects;
+    unsigned int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (object[i])
+            IUnknown_Release(object[i]);
+    }
+}
+
+static void d3d11_stage_state_release(struct d3d11_stage_state *state)
+{
+    d3d11_release_objects(&state->shader, 1);
+    d3d11_release_objects(state->constant_buffers, ARRAY_SIZE(state->constant_buffers));
+    d3d11_release_objects(state->views, ARRAY_SIZE(state->views));
+    d3d11_release_objects(state->samplers, ARRAY_SIZE(state->samplers));
+}
+
+/* Stream output offsets can't be queried, the buffers are rebound with
+ * offset 0. */
+static void d3d11_saved_state_apply(struct d3d11_saved_state *state, ID3D11DeviceContext1 *context)
+{
+    ID3D11DeviceContext1_VSSetShader(context, (ID3D11VertexShader *)state->vs.shader, NULL, 0);
+    ID3D11DeviceContext1_VSSetConstantBuffers(context, 0, ARRAY_SIZE(state->vs.constant_buffers),
+            state->vs.constant_buffers);
+    ID3D11DeviceContext1_VSSetShaderResources(context, 0, ARRAY_SIZE(state->vs.views), state->vs.views);
+    ID3D11DeviceContext1_VSSetSamplers(context, 0, ARRAY_SIZE(state->vs.samplers), state->vs.samplers);
+
+    ID3D11DeviceContext1_HSSetShader(context, (ID3D11HullShader *)state->hs.shader, NULL, 0);
+    ID3D11DeviceContext1_HSSetConstantBuffers(context, 0, ARRAY_SIZE(state->hs.constant_buffers),
+            state->hs.constant_buffers);
+    ID3D11DeviceContext1_HSSetShaderResources(context, 0, ARRAY_SIZE(state->hs.views), state->hs.views);
+    ID3D11DeviceContext1_HSSetSamplers(context, 0, ARRAY_SIZE(state->hs.samplers), state->hs.samplers);
+
+    ID3D11DeviceContext1_DSSetShader(context, (ID3D11DomainShader *)state->ds.shader, NULL, 0);
+    ID3D11DeviceContext1_DSSetConstantBuffers(context, 0, ARRAY_SIZE(state->ds.constant_buffers),
+            state->ds.constant_buffers);
+    ID3D11DeviceContext1_DSSetShaderResources(context, 0, ARRAY_SIZE(state->ds.views), state->ds.views);
+    ID3D11DeviceContext1_DSSetSamplers(context, 0, ARRAY_SIZE(state->ds.samplers), state->ds.samplers);
+
+    ID3D11DeviceContext1_GSSetShader(context, (ID3D11GeometryShader *)state->gs.shader, NULL, 0);
+    ID3D11DeviceContext1_GSSetConstantBuffers(context, 0, ARRAY_SIZE(state->gs.constant_buffers),
+            state->gs.constant_buffers);
+    ID3D11DeviceContext1_GSSetShaderResources(context, 0, ARRAY_SIZE(state->gs.views), state->gs.views);
+    ID3D11DeviceContext1_GSSetSamplers(context, 0, ARRAY_SIZE(state->gs.samplers), state->gs.samplers);
+
+    ID3D11DeviceContext1_PSSetShader(context, (ID3D11PixelShader *)state->ps.shader, NULL, 0);
+    ID3D11DeviceContext1_PSSetConstantBuffers(context, 0, ARRAY_SIZE(state->ps.constant_buffers),
+            state->ps.constant_buffers);
+    ID3D11DeviceContext1_PSSetShaderResources(context, 0, ARRAY_SIZE(state->ps.views), state->ps.views);
+    ID3D11DeviceContext1_PSSetSamplers(context, 0, ARRAY_SIZE(state->ps.samplers), state->ps.samplers);
+
+    ID3D11DeviceContext1_CSSetShader(context, (ID3D11ComputeShader *)state->cs.shader, NULL, 0);
+    ID3D11DeviceContext1_CSSetConstantBuffers(context, 0, ARRAY_SIZE(state->cs.constant_buffers),
+            state->cs.constant_buffers);
+    ID3D11DeviceContext1_CSSetShaderResources(context, 0, ARRAY_SIZE(state->cs.views), state->cs.views);
+    ID3D11DeviceContext1_CSSetSamplers(context, 0, ARRAY_SIZE(state->cs.samplers), state->cs.samplers);
+    ID3D11DeviceContext1_CSSetUnorderedAccessViews(context, 0, ARRAY_SIZE(state->cs_uavs), state->cs_uavs, NULL);
+
+    ID3D11DeviceContext1_IASetInputLayout(context, state->input_layout);
+    ID3D11DeviceContext1_IASetVertexBuffers(context, 0, ARRAY_SIZE(state->vertex_buffers),
+            state->vertex_buffers, state->strides, state->offsets);
+    ID3D11DeviceContext1_IASetIndexBuffer(context, state->index_buffer, state->index_format, state->index_offset);
+    ID3D11DeviceContext1_IASetPrimitiveTopology(context, state->topology);
+
+    ID3D11DeviceContext1_SOSetTargets(context, ARRAY_SIZE(state->so_buffers), state->so_buffers, NULL);
+
+    ID3D11DeviceContext1_RSSetState(context, state->rasterizer_state);
+    ID3D11DeviceContext1_RSSetViewports(context, state->viewport_count, state->viewports);
+    ID3D11DeviceContext1_RSSetScissorRects(context, state->scissor_rect_count, state->scissor_rects);
+
+    ID3D11DeviceContext1_OMSetRenderTargetsAndUnorderedAccessViews(context, ARRAY_SIZE(state->rtvs),
+            state->rtvs, state->dsv, 0, ARRAY_SIZE(state->uavs), state->uavs, NULL);
+    ID3D11DeviceContext1_OMSetBlendState(context, state->blend_state, state->blend_factor, state->sample_mask);
+    ID3D11DeviceContext1_OMSetDepthStencilState(context, state->depth_stencil_state, state->stencil_ref);
+
+    ID3D11DeviceContext1_SetPredication(context, state->predicate, state->predicate_value);
+
+    d3d11_stage_state_release(&state->vs);
+    d3d11_stage_state_release(&state->hs);
+    d3d11_stage_state_release(&state->ds);
+    d3d11_stage_state_release(&state->gs);
+    d3d11_stage_state_release(&state->ps);
+    d3d11_stage_state_release(&state->cs);
+    d3d11_release_objects(state->cs_uavs, ARRAY_SIZE(state->cs_uavs));
+    d3d11_release_objects(&state->input_layout, 1);
+    d3d11_release_objects(state->vertex_buffers, ARRAY_SIZE(state->vertex_buffers));
+    d3d11_release_objects(&state->index_buffer, 1);
+    d3d11_release_objects(state->so_buffers, ARRAY_SIZE(state->so_buffers));
+    d3d11_release_objects(&state->rasterizer_state, 1);
+    d3d11_release_objects(state->rtvs, ARRAY_SIZE(state->rtvs));
+    d3d11_release_objects(&state->dsv, 1);
+    d3d11_release_objects(state->uavs, ARRAY_SIZE(state->uavs));
+    d3d11_release_objects(&state->blend_state, 1);
+    d3d11_release_objects(&state->depth_stencil_state, 1);
+    d3d11_release_objects(&state->predicate, 1);
+}
+
+/* Called with the wined3d lock held. Command lists don't inherit any state,
+ * and the context state is reset after the command list has been executed
+ * unless it is explicitly restored. */
+void d3d11_command_list_execute(struct d3d11_command_list *list, ID3D11DeviceContext1 *context,
+        BOOL restore_state)
+{
+    struct d3d11_saved_state *state = NULL;
+
+    if (restore_state)
+    {
+        if (!(state = heap_alloc_zero(sizeof(*state))))
+            ERR("Failed to allocate state, the context state will not be restored.\n");
+        else
+            d3d11_saved_state_capture(state, context);
+    }
+
+    ID3D11DeviceContext1_ClearState(context);
+    d3d11_command_list_replay(list, context);
+    ID3D11DeviceContext1_ClearState(context);
+
+    if (state)
+    {
+        d3d11_saved_state_apply(state, context);
+        heap_free(state);
+    }
+}
+
+static HRESULT d3d11_command_list_create(struct d3d11_deferred_context *context, struct d3d11_command_list **list)
+{
+    struct d3d11_command_list *object;
+
+    if (!(object = heap_alloc_zero(sizeof(*object))))
+        return E_OUTOFMEMORY;
+
+    object->ID3D11CommandList_iface.lpVtbl = &d3d11_command_list_vtbl;
+    object->refcount = 1;
+
+    wined3d_mutex_lock();
+    wined3d_private_store_init(&object->private_store);
+    wined3d_mutex_unlock();
+
+    /* The command list takes over the recorded calls. */
+    object->data = context->data;
+    object->data_size = context->data_size;
+    object->objects = context->objects;
+    object->object_count = context->object_count;
+    context->data = NULL;
+    context->data_size = context->data_capacity = 0;
+    context->objects = NULL;
+    context->object_count = context->objects_capacity = 0;
+
+    ID3D11Device2_AddRef(object->device = &context->device->ID3D11Device2_iface);
+
+    TRACE("Created command list %p.\n", object);
+    *list = object;
+
+    return S_OK;
+}
+
+/* ID3D11DeviceContext - deferred context methods */
+
+static inline struct d3d11_deferred_context *impl_from_deferred_ID3D11DeviceContext1(ID3D11DeviceContext1 *iface)
+{
+    return CONTAINING_RECORD(iface, struct d3d11_deferred_context, ID3D11DeviceContext1_iface);
+}
+
+static void *d3d11_deferred_context_record(struct d3d11_deferred_context *context,
+        enum d3d11_deferred_call_id id, SIZE_T size)
+{
+    struct d3d11_deferred_call *call;
+
+    size = (size + 7) & ~(SIZE_T)7;
+    if (!d3d11_array_reserve((void **)&context->data, &context->data_capacity, context->data_size + size, 1))
+    {
+        ERR("Failed to record call %#x.\n", id);
+        context->out_of_memory = TRUE;
+        return NULL;
+    }
+
+    call = (struct d3d11_deferred_call *)&context->data[context->data_size];
+    memset(call, 0, size);
+    call->id = id;
+    call->size = size;
+    context->data_size += size;
+
+    return call;
+}
+
+/* Keeps the object alive until the command list is released. */
+static IUnknown *d3d11_deferred_context_reference(struct d3d11_deferred_context *context, void *object)
+{
+    if (!object)
+        return NULL;
+
+    if (!d3d11_array_reserve((void **)&context->objects, &context->objects_capacity,
+            context->object_count + 1, sizeof(*context->objects)))
+    {
+        ERR("Failed to reference object %p.\n", object);
+        context->out_of_memory = TRUE;
+        return object;
+    }
+
+    IUnknown_AddRef((IUnknown *)object);
+    context->objects[context->object_count++] = object;
+
+    return object;
+}
+
+static void d3d11_deferred_context_record_object(struct d3d11_deferred_context *context,
+        enum d3d11_deferred_call_id id, void *object, UINT value)
+{
+    struct d3d11_deferred_object_call *call;
+
+    if (!(call = d3d11_deferred_context_record(context, id, sizeof(*call))))
+        return;
+    call->object = d3d11_deferred_context_reference(context, object);
+    call->value = value;
+}
+
+static void d3d11_deferred_context_record_bind(struct d3d11_deferred_context *context,
+        enum d3d11_deferred_call_id id, enum wined3d_shader_type type, UINT start_slot, UINT count,
+        const void *objects, const UINT *values, const UINT *values2)
+{
+    IUnknown *const *src = objects;
+    struct d3d11_deferred_bind_call *call;
+    unsigned int value_count, i;
+    UINT *dst_values;
+
+    value_count = (values ? count : 0) + (values2 ? count : 0);
+    if (!(call = d3d11_deferred_context_record(context, id,
+            FIELD_OFFSET(struct d3d11_deferred_bind_call, objects[count]) + value_count * sizeof(UINT))))
+        return;
+
+    call->type = type;
+    call->start_slot = start_slot;
+    call->count = count;
+    call->has_values = !!value_count;
+    for (i = 0; i < count; ++i)
+        call->objects[i] = d3d11_deferred_context_reference(context, src[i]);
+
+    dst_values = (UINT *)&call->objects[count];
+    if (values)
+        memcpy(dst_values, values, count * sizeof(*values));
+    if (values2)
+        memcpy(dst_values + count, values2, count * sizeof(*values2));
+}
+
+static void d3d11_deferred_context_set_shader(ID3D11DeviceContext1 *iface, enum wined3d_shader_type type,
+        void *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    if (class_instances)
+        FIXME("Dynamic linking is not implemented yet.\n");
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_SET_SHADER, shader, type);
+}
+
+static void d3d11_deferred_context_set_constant_buffers(ID3D11DeviceContext1 *iface,
+        enum wined3d_shader_type type, UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    d3d11_deferred_context_record_bind(context, D3D11_DEFERRED_CALL_SET_CONSTANT_BUFFERS,
+            type, start_slot, buffer_count, buffers, NULL, NULL);
+}
+
+static void d3d11_deferred_context_set_shader_resources(ID3D11DeviceContext1 *iface,
+        enum wined3d_shader_type type, UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    d3d11_deferred_context_record_bind(context, D3D11_DEFERRED_CALL_SET_SHADER_RESOURCES,
+            type, start_slot, view_count, views, NULL, NULL);
+}
+
+static void d3d11_deferred_context_set_samplers(ID3D11DeviceContext1 *iface,
+        enum wined3d_shader_type type, UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    d3d11_deferred_context_record_bind(context, D3D11_DEFERRED_CALL_SET_SAMPLERS,
+            type, start_slot, sampler_count, samplers, NULL, NULL);
+}
+
+static void d3d11_deferred_context_record_draw(ID3D11DeviceContext1 *iface, enum d3d11_deferred_call_id id,
+        UINT count, UINT instance_count, UINT start_location, INT base_vertex_location, UINT start_instance_location)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_draw_call *call;
+
+    if (!(call = d3d11_deferred_context_record(context, id, sizeof(*call))))
+        return;
+    call->count = count;
+    call->instance_count = instance_count;
+    call->start_location = start_location;
+    call->base_vertex_location = base_vertex_location;
+    call->start_instance_location = start_instance_location;
+}
+
+static void d3d11_deferred_context_record_clear(ID3D11DeviceContext1 *iface, enum d3d11_deferred_call_id id,
+        void *view, const float color[4], const UINT values[4], UINT flags, float depth, UINT8 stencil)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_clear_call *call;
+
+    if (!(call = d3d11_deferred_context_record(context, id, sizeof(*call))))
+        return;
+    call->view = d3d11_deferred_context_reference(context, view);
+    if (color)
+        memcpy(call->color, color, sizeof(call->color));
+    if (values)
+        memcpy(call->values, values, sizeof(call->values));
+    call->flags = flags;
+    call->depth = depth;
+    call->stencil = stencil;
+}
+
+static struct d3d11_deferred_copy_call *d3d11_deferred_context_record_copy(ID3D11DeviceContext1 *iface,
+        enum d3d11_deferred_call_id id, void *dst, UINT dst_idx, void *src, UINT src_idx)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_copy_call *call;
+
+    if (!(call = d3d11_deferred_context_record(context, id, sizeof(*call))))
+        return NULL;
+    call->dst = d3d11_deferred_context_reference(context, dst);
+    call->dst_idx = dst_idx;
+    call->src = d3d11_deferred_context_reference(context, src);
+    call->src_idx = src_idx;
+
+    return call;
+}
+
+static BOOL is_block_compressed(enum wined3d_format_id format_id)
+{
+    return (format_id >= WINED3DFMT_BC1_TYPELESS && format_id <= WINED3DFMT_BC5_SNORM)
+            || (format_id >= WINED3DFMT_BC6H_TYPELESS && format_id <= WINED3DFMT_BC7_UNORM_SRGB);
+}
+
+/* The amount of data UpdateSubresource() reads from the application. */
+static SIZE_T d3d11_deferred_context_get_update_size(struct d3d11_deferred_context *context,
+        ID3D11Resource *resource, UINT subresource_idx, const D3D11_BOX *box, UINT row_pitch, UINT depth_pitch)
+{
+    struct wined3d_resource *wined3d_resource = wined3d_resource_from_d3d11_resource(resource);
+    struct wined3d_sub_resource_desc sub_resource_desc;
+    struct wined3d_resource_desc resource_desc;
+    unsigned int width, height, depth, row_count;
+
+    wined3d_resource_get_desc(wined3d_resource, &resource_desc);
+    if (resource_desc.resource_type == WINED3D_RTYPE_BUFFER)
+        return box ? box->right - box->left : resource_desc.size;
+
+    if (FAILED(wined3d_texture_get_sub_resource_desc(wined3d_texture_from_resource(wined3d_resource),
+            subresource_idx, &sub_resource_desc)))
+        return 0;
+
+    width = box ? box->right - box->left : sub_resource_desc.width;
+    height = box ? box->bottom - box->top : sub_resource_desc.height;
+    depth = box ? box->back - box->front : sub_resource_desc.depth;
+    if (!width || !height || !depth)
+        return 0;
+
+    row_count = is_block_compressed(sub_resource_desc.format) ? (height + 3) / 4 : height;
+    return (depth - 1) * (SIZE_T)depth_pitch + (row_count - 1) * (SIZE_T)row_pitch
+            + wined3d_calculate_format_pitch(context->wined3d_adapter, sub_resource_desc.format, width);
+}
+
+static struct d3d11_deferred_map *d3d11_deferred_context_find_map(struct d3d11_deferred_context *context,
+        ID3D11Resource *resource, UINT subresource_idx)
+{
+    struct d3d11_deferred_map *map;
+
+    LIST_FOR_EACH_ENTRY(map, &context->maps, struct d3d11_deferred_map, entry)
+    {
+        if (map->resource == resource && map->subresource_idx == subresource_idx)
+            return map;
+    }
+
+    return NULL;
+}
+
+static void d3d11_deferred_context_free_maps(struct d3d11_deferred_context *context)
+{
+    struct d3d11_deferred_map *map, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE(map, next, &context->maps, struct d3d11_deferred_map, entry)
+    {
+        list_remove(&map->entry);
+        ID3D11Resource_Release(map->resource);
+        VirtualFree(map->data, 0, MEM_RELEASE);
+        heap_free(map->dirty_pages);
+        heap_free(map);
+    }
+}
+
+static void d3d11_deferred_context_free_calls(struct d3d11_deferred_context *context)
+{
+    SIZE_T i;
+
+    for (i = 0; i < context->object_count; ++i)
+        IUnknown_Release(context->objects[i]);
+    heap_free(context->objects);
+    heap_free(context->data);
+    context->data = NULL;
+    context->data_size = context->data_capacity = 0;
+    context->objects = NULL;
+    context->object_count = context->objects_capacity = 0;
+}
+
+/* FinishCommandList() with "restore" set keeps the state of the context, so
+ * the next command list starts by setting it again. */
+static void d3d11_deferred_context_restore_state(struct d3d11_deferred_context *context,
+        const struct d3d11_command_list *list)
+{
+    const struct d3d11_deferred_call *call;
+    SIZE_T offset, i;
+
+    for (offset = 0; offset < list->data_size; offset += call->size)
+    {
+        call = (const struct d3d11_deferred_call *)&list->data[offset];
+
+        if (call->id == D3D11_DEFERRED_CALL_CLEAR_STATE
+                || (call->id == D3D11_DEFERRED_CALL_EXECUTE_COMMAND_LIST
+                && !((const struct d3d11_deferred_object_call *)call)->value))
+        {
+            context->data_size = 0;
+            continue;
+        }
+
+        if (call->id >= D3D11_DEFERRED_CALL_CLEAR_STATE)
+            continue;
+
+        if (!d3d11_array_reserve((void **)&context->data, &context->data_capacity,
+                context->data_size + call->size, 1))
+        {
+            ERR("Failed to restore the context state.\n");
+            context->out_of_memory = TRUE;
+            return;
+        }
+        memcpy(&context->data[context->data_size], call, call->size);
+        context->data_size += call->size;
+    }
+
+    /* The copied calls may reference any of the command list objects. */
+    for (i = 0; i < list->object_count; ++i)
+        d3d11_deferred_context_reference(context, list->objects[i]);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_QueryInterface(ID3D11DeviceContext1 *iface,
+        REFIID iid, void **out)
+{
+    TRACE("iface %p, iid %s, out %p.\n", iface, debugstr_guid(iid), out);
+
+    if (IsEqualGUID(iid, &IID_ID3D11DeviceContext1)
+            || IsEqualGUID(iid, &IID_ID3D11DeviceContext)
+            || IsEqualGUID(iid, &IID_ID3D11DeviceChild)
+            || IsEqualGUID(iid, &IID_IUnknown))
+    {
+        ID3D11DeviceContext1_AddRef(iface);
+        *out = iface;
+        return S_OK;
+    }
+
+    WARN("%s not implemented, returning E_NOINTERFACE.\n", debugstr_guid(iid));
+
+    *out = NULL;
+    return E_NOINTERFACE;
+}
+
+static ULONG STDMETHODCALLTYPE d3d11_deferred_context_AddRef(ID3D11DeviceContext1 *iface)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    ULONG refcount = InterlockedIncrement(&context->refcount);
+
+    TRACE("%p increasing refcount to %u.\n", context, refcount);
+
+    return refcount;
+}
+
+static ULONG STDMETHODCALLTYPE d3d11_deferred_context_Release(ID3D11DeviceContext1 *iface)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    ULONG refcount = InterlockedDecrement(&context->refcount);
+
+    TRACE("%p decreasing refcount to %u.\n", context, refcount);
+
+    if (!refcount)
+    {
+        struct d3d_device *device = context->device;
+
+        d3d11_deferred_context_free_maps(context);
+        d3d11_deferred_context_free_calls(context);
+
+        wined3d_mutex_lock();
+        wined3d_private_store_cleanup(&context->private_store);
+        wined3d_mutex_unlock();
+        heap_free(context);
+
+        ID3D11Device2_Release(&device->ID3D11Device2_iface);
+    }
+
+    return refcount;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GetDevice(ID3D11DeviceContext1 *iface, ID3D11Device **device)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, device %p.\n", iface, device);
+
+    *device = (ID3D11Device *)&context->device->ID3D11Device2_iface;
+    ID3D11Device_AddRef(*device);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_GetPrivateData(ID3D11DeviceContext1 *iface,
+        REFGUID guid, UINT *data_size, void *data)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, guid %s, data_size %p, data %p.\n", iface, debugstr_guid(guid), data_size, data);
+
+    return d3d_get_private_data(&context->private_store, guid, data_size, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_SetPrivateData(ID3D11DeviceContext1 *iface,
+        REFGUID guid, UINT data_size, const void *data)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, guid %s, data_size %u, data %p.\n", iface, debugstr_guid(guid), data_size, data);
+
+    return d3d_set_private_data(&context->private_store, guid, data_size, data);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_SetPrivateDataInterface(ID3D11DeviceContext1 *iface,
+        REFGUID guid, const IUnknown *data)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, guid %s, data %p.\n", iface, debugstr_guid(guid), data);
+
+    return d3d_set_private_data_interface(&context->private_store, guid, data);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSSetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n", iface, start_slot, buffer_count, buffers);
+
+    d3d11_deferred_context_set_constant_buffers(iface, WINED3D_SHADER_TYPE_VERTEX,
+            start_slot, buffer_count, buffers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSSetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
+
+    d3d11_deferred_context_set_shader_resources(iface, WINED3D_SHADER_TYPE_PIXEL, start_slot, view_count, views);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSSetShader(ID3D11DeviceContext1 *iface,
+        ID3D11PixelShader *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    TRACE("iface %p, shader %p, class_instances %p, class_instance_count %u.\n",
+            iface, shader, class_instances, class_instance_count);
+
+    d3d11_deferred_context_set_shader(iface, WINED3D_SHADER_TYPE_PIXEL,
+            shader, class_instances, class_instance_count);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSSetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
+            iface, start_slot, sampler_count, samplers);
+
+    d3d11_deferred_context_set_samplers(iface, WINED3D_SHADER_TYPE_PIXEL, start_slot, sampler_count, samplers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSSetShader(ID3D11DeviceContext1 *iface,
+        ID3D11VertexShader *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    TRACE("iface %p, shader %p, class_instances %p, class_instance_count %u.\n",
+            iface, shader, class_instances, class_instance_count);
+
+    d3d11_deferred_context_set_shader(iface, WINED3D_SHADER_TYPE_VERTEX,
+            shader, class_instances, class_instance_count);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DrawIndexed(ID3D11DeviceContext1 *iface,
+        UINT index_count, UINT start_index_location, INT base_vertex_location)
+{
+    TRACE("iface %p, index_count %u, start_index_location %u, base_vertex_location %d.\n",
+            iface, index_count, start_index_location, base_vertex_location);
+
+    d3d11_deferred_context_record_draw(iface, D3D11_DEFERRED_CALL_DRAW_INDEXED,
+            index_count, 0, start_index_location, base_vertex_location, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_Draw(ID3D11DeviceContext1 *iface,
+        UINT vertex_count, UINT start_vertex_location)
+{
+    TRACE("iface %p, vertex_count %u, start_vertex_location %u.\n",
+            iface, vertex_count, start_vertex_location);
+
+    d3d11_deferred_context_record_draw(iface, D3D11_DEFERRED_CALL_DRAW, vertex_count, 0, start_vertex_location, 0, 0);
+}
+
+/* Only dynamic buffers can be mapped on deferred contexts. The data is
+ * uploaded when the command list is executed. */
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_Map(ID3D11DeviceContext1 *iface, ID3D11Resource *resource,
+        UINT subresource_idx, D3D11_MAP map_type, UINT map_flags, D3D11_MAPPED_SUBRESOURCE *mapped_subresource)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    D3D11_RESOURCE_DIMENSION dimension;
+    struct d3d11_deferred_map *map;
+    D3D11_BUFFER_DESC desc;
+
+    TRACE("iface %p, resource %p, subresource_idx %u, map_type %u, map_flags %#x, mapped_subresource %p.\n",
+            iface, resource, subresource_idx, map_type, map_flags, mapped_subresource);
+
+    if (map_flags)
+        FIXME("Ignoring map_flags %#x.\n", map_flags);
+
+    if (map_type != D3D11_MAP_WRITE_DISCARD && map_type != D3D11_MAP_WRITE_NO_OVERWRITE)
+    {
+        WARN("Invalid map type %#x.\n", map_type);
+        return E_INVALIDARG;
+    }
+
+    ID3D11Resource_GetType(resource, &dimension);
+    if (dimension != D3D11_RESOURCE_DIMENSION_BUFFER)
+    {
+        FIXME("Mapping textures on deferred contexts is not implemented.\n");
+        return E_NOTIMPL;
+    }
+
+    if (!(map = d3d11_deferred_context_find_map(context, resource, subresource_idx)))
+    {
+        if (map_type != D3D11_MAP_WRITE_DISCARD)
+        {
+            WARN("Resource %p must be discarded first.\n", resource);
+            return E_INVALIDARG;
+        }
+
+        ID3D11Buffer_GetDesc((ID3D11Buffer *)resource, &desc);
+        if (!(map = heap_alloc_zero(sizeof(*map))))
+            return E_OUTOFMEMORY;
+        if (!(map->data = VirtualAlloc(NULL, desc.ByteWidth, MEM_RESERVE | MEM_COMMIT | MEM_WRITE_WATCH,
+                PAGE_READWRITE)))
+        {
+            heap_free(map);
+            return E_OUTOFMEMORY;
+        }
+        map->page_count = (desc.ByteWidth + 0xfff) / 0x1000;
+        if (!(map->dirty_pages = heap_calloc(map->page_count, sizeof(*map->dirty_pages))))
+        {
+            VirtualFree(map->data, 0, MEM_RELEASE);
+            heap_free(map);
+            return E_OUTOFMEMORY;
+        }
+        ID3D11Resource_AddRef(map->resource = resource);
+        map->subresource_idx = subresource_idx;
+        map->size = desc.ByteWidth;
+        list_add_head(&context->maps, &map->entry);
+    }
+
+    map->map_type = map_type;
+    mapped_subresource->pData = map->data;
+    mapped_subresource->RowPitch = map->size;
+    mapped_subresource->DepthPitch = map->size;
+
+    return S_OK;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_Unmap(ID3D11DeviceContext1 *iface, ID3D11Resource *resource,
+        UINT subresource_idx)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_update_call *call;
+    struct d3d11_deferred_map *map;
+    SIZE_T start = 0, end;
+    ULONG_PTR count;
+    ULONG page_size;
+
+    TRACE("iface %p, resource %p, subresource_idx %u.\n", iface, resource, subresource_idx);
+
+    if (!(map = d3d11_deferred_context_find_map(context, resource, subresource_idx)))
+    {
+        WARN("Resource %p is not mapped.\n", resource);
+        return;
+    }
+
+    /* only record the range written since the previous map */
+    end = map->size;
+    count = map->page_count;
+    if (!GetWriteWatch(WRITE_WATCH_FLAG_RESET, map->data, map->size, map->dirty_pages, &count, &page_size))
+    {
+        if (count)
+        {
+            start = (BYTE *)map->dirty_pages[0] - (BYTE *)map->data;
+            end = min((BYTE *)map->dirty_pages[count - 1] + page_size - (BYTE *)map->data, map->size);
+        }
+        else
+        {
+            end = 0;
+        }
+    }
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_UPDATE_MAPPED,
+            FIELD_OFFSET(struct d3d11_deferred_update_call, data[end - start]))))
+        return;
+    call->resource = d3d11_deferred_context_reference(context, resource);
+    call->subresource_idx = subresource_idx;
+    call->has_box = TRUE;
+    call->box.left = start;
+    call->box.right = end;
+    call->map_type = map->map_type;
+    call->data_size = end - start;
+    memcpy(call->data, (BYTE *)map->data + start, end - start);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSSetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
+            iface, start_slot, buffer_count, buffers);
+
+    d3d11_deferred_context_set_constant_buffers(iface, WINED3D_SHADER_TYPE_PIXEL,
+            start_slot, buffer_count, buffers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IASetInputLayout(ID3D11DeviceContext1 *iface,
+        ID3D11InputLayout *input_layout)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, input_layout %p.\n", iface, input_layout);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_SET_INPUT_LAYOUT, input_layout, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IASetVertexBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers, const UINT *strides, const UINT *offsets)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p, strides %p, offsets %p.\n",
+            iface, start_slot, buffer_count, buffers, strides, offsets);
+
+    d3d11_deferred_context_record_bind(context, D3D11_DEFERRED_CALL_SET_VERTEX_BUFFERS,
+            0, start_slot, buffer_count, buffers, strides, offsets);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IASetIndexBuffer(ID3D11DeviceContext1 *iface,
+        ID3D11Buffer *buffer, DXGI_FORMAT format, UINT offset)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_index_buffer_call *call;
+
+    TRACE("iface %p, buffer %p, format %s, offset %u.\n", iface, buffer, debug_dxgi_format(format), offset);
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_SET_INDEX_BUFFER, sizeof(*call))))
+        return;
+    call->buffer = d3d11_deferred_context_reference(context, buffer);
+    call->format = format;
+    call->offset = offset;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DrawIndexedInstanced(ID3D11DeviceContext1 *iface,
+        UINT instance_index_count, UINT instance_count, UINT start_index_location, INT base_vertex_location,
+        UINT start_instance_location)
+{
+    TRACE("iface %p, instance_index_count %u, instance_count %u, start_index_location %u, "
+            "base_vertex_location %d, start_instance_location %u.\n",
+            iface, instance_index_count, instance_count, start_index_location,
+            base_vertex_location, start_instance_location);
+
+    d3d11_deferred_context_record_draw(iface, D3D11_DEFERRED_CALL_DRAW_INDEXED_INSTANCED, instance_index_count,
+            instance_count, start_index_location, base_vertex_location, start_instance_location);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DrawInstanced(ID3D11DeviceContext1 *iface,
+        UINT instance_vertex_count, UINT instance_count, UINT start_vertex_location, UINT start_instance_location)
+{
+    TRACE("iface %p, instance_vertex_count %u, instance_count %u, start_vertex_location %u, "
+            "start_instance_location %u.\n",
+            iface, instance_vertex_count, instance_count, start_vertex_location,
+            start_instance_location);
+
+    d3d11_deferred_context_record_draw(iface, D3D11_DEFERRED_CALL_DRAW_INSTANCED, instance_vertex_count,
+            instance_count, start_vertex_location, 0, start_instance_location);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSSetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
+            iface, start_slot, buffer_count, buffers);
+
+    d3d11_deferred_context_set_constant_buffers(iface, WINED3D_SHADER_TYPE_GEOMETRY,
+            start_slot, buffer_count, buffers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSSetShader(ID3D11DeviceContext1 *iface,
+        ID3D11GeometryShader *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    TRACE("iface %p, shader %p, class_instances %p, class_instance_count %u.\n",
+            iface, shader, class_instances, class_instance_count);
+
+    d3d11_deferred_context_set_shader(iface, WINED3D_SHADER_TYPE_GEOMETRY,
+            shader, class_instances, class_instance_count);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IASetPrimitiveTopology(ID3D11DeviceContext1 *iface,
+        D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, topology %#x.\n", iface, topology);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_SET_PRIMITIVE_TOPOLOGY, NULL, topology);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSSetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
+
+    d3d11_deferred_context_set_shader_resources(iface, WINED3D_SHADER_TYPE_VERTEX, start_slot, view_count, views);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSSetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
+            iface, start_slot, sampler_count, samplers);
+
+    d3d11_deferred_context_set_samplers(iface, WINED3D_SHADER_TYPE_VERTEX, start_slot, sampler_count, samplers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_Begin(ID3D11DeviceContext1 *iface,
+        ID3D11Asynchronous *asynchronous)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, asynchronous %p.\n", iface, asynchronous);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_BEGIN, asynchronous, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_End(ID3D11DeviceContext1 *iface,
+        ID3D11Asynchronous *asynchronous)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, asynchronous %p.\n", iface, asynchronous);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_END, asynchronous, 0);
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_GetData(ID3D11DeviceContext1 *iface,
+        ID3D11Asynchronous *asynchronous, void *data, UINT data_size, UINT data_flags)
+{
+    TRACE("iface %p, asynchronous %p, data %p, data_size %u, data_flags %#x.\n",
+            iface, asynchronous, data, data_size, data_flags);
+
+    WARN("Cannot retrieve query data on a deferred context.\n");
+
+    return DXGI_ERROR_INVALID_CALL;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_SetPredication(ID3D11DeviceContext1 *iface,
+        ID3D11Predicate *predicate, BOOL value)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, predicate %p, value %#x.\n", iface, predicate, value);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_SET_PREDICATION, predicate, value);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSSetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
+
+    d3d11_deferred_context_set_shader_resources(iface, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, view_count, views);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSSetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
+            iface, start_slot, sampler_count, samplers);
+
+    d3d11_deferred_context_set_samplers(iface, WINED3D_SHADER_TYPE_GEOMETRY, start_slot, sampler_count, samplers);
+}
+
+static void d3d11_deferred_context_set_render_targets(struct d3d11_deferred_context *context,
+        BOOL set_uavs, UINT rtv_count, ID3D11RenderTargetView *const *rtvs, ID3D11DepthStencilView *dsv,
+        UINT uav_start_slot, UINT uav_count, ID3D11UnorderedAccessView *const *uavs, const UINT *initial_counts)
+{
+    UINT rtv_object_count = rtv_count == D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL ? 0 : rtv_count;
+    UINT uav_object_count = set_uavs && uav_count != D3D11_KEEP_UNORDERED_ACCESS_VIEWS ? uav_count : 0;
+    struct d3d11_deferred_render_targets_call *call;
+    SIZE_T size;
+    UINT i;
+
+    if (rtv_object_count && !rtvs)
+        rtv_object_count = 0;
+    if (uav_object_count && !uavs)
+        uav_object_count = 0;
+
+    size = FIELD_OFFSET(struct d3d11_deferred_render_targets_call, views[rtv_object_count + uav_object_count]);
+    if (initial_counts)
+        size += uav_object_count * sizeof(*initial_counts);
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_SET_RENDER_TARGETS, size)))
+        return;
+
+    call->rtv_count = rtv_count == D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL ? rtv_count : rtv_object_count;
+    call->dsv = d3d11_deferred_context_reference(context, dsv);
+    call->uav_start_slot = uav_start_slot;
+    call->uav_count = uav_count == D3D11_KEEP_UNORDERED_ACCESS_VIEWS ? uav_count : uav_object_count;
+    call->set_uavs = set_uavs;
+    call->has_initial_counts = initial_counts && uav_object_count;
+    for (i = 0; i < rtv_object_count; ++i)
+        call->views[i] = d3d11_deferred_context_reference(context, rtvs[i]);
+    for (i = 0; i < uav_object_count; ++i)
+        call->views[rtv_object_count + i] = d3d11_deferred_context_reference(context, uavs[i]);
+    if (call->has_initial_counts)
+        memcpy(&call->views[rtv_object_count + uav_object_count], initial_counts,
+                uav_object_count * sizeof(*initial_counts));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMSetRenderTargets(ID3D11DeviceContext1 *iface,
+        UINT render_target_view_count, ID3D11RenderTargetView *const *render_target_views,
+        ID3D11DepthStencilView *depth_stencil_view)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, render_target_view_count %u, render_target_views %p, depth_stencil_view %p.\n",
+            iface, render_target_view_count, render_target_views, depth_stencil_view);
+
+    d3d11_deferred_context_set_render_targets(context, FALSE, render_target_view_count, render_target_views,
+            depth_stencil_view, 0, 0, NULL, NULL);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMSetRenderTargetsAndUnorderedAccessViews(
+        ID3D11DeviceContext1 *iface, UINT render_target_view_count,
+        ID3D11RenderTargetView *const *render_target_views, ID3D11DepthStencilView *depth_stencil_view,
+        UINT unordered_access_view_start_slot, UINT unordered_access_view_count,
+        ID3D11UnorderedAccessView *const *unordered_access_views, const UINT *initial_counts)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, render_target_view_count %u, render_target_views %p, depth_stencil_view %p, "
+            "unordered_access_view_start_slot %u, unordered_access_view_count %u, unordered_access_views %p, "
+            "initial_counts %p.\n",
+            iface, render_target_view_count, render_target_views, depth_stencil_view,
+            unordered_access_view_start_slot, unordered_access_view_count, unordered_access_views,
+            initial_counts);
+
+    d3d11_deferred_context_set_render_targets(context, TRUE, render_target_view_count, render_target_views,
+            depth_stencil_view, unordered_access_view_start_slot, unordered_access_view_count,
+            unordered_access_views, initial_counts);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMSetBlendState(ID3D11DeviceContext1 *iface,
+        ID3D11BlendState *blend_state, const float blend_factor[4], UINT sample_mask)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_blend_state_call *call;
+
+    TRACE("iface %p, blend_state %p, blend_factor %s, sample_mask 0x%08x.\n",
+            iface, blend_state, debug_float4(blend_factor), sample_mask);
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_SET_BLEND_STATE, sizeof(*call))))
+        return;
+    call->state = d3d11_deferred_context_reference(context, blend_state);
+    if ((call->has_blend_factor = !!blend_factor))
+        memcpy(call->blend_factor, blend_factor, sizeof(call->blend_factor));
+    call->sample_mask = sample_mask;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMSetDepthStencilState(ID3D11DeviceContext1 *iface,
+        ID3D11DepthStencilState *depth_stencil_state, UINT stencil_ref)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, depth_stencil_state %p, stencil_ref %u.\n",
+            iface, depth_stencil_state, stencil_ref);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_SET_DEPTH_STENCIL_STATE,
+            depth_stencil_state, stencil_ref);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_SOSetTargets(ID3D11DeviceContext1 *iface, UINT buffer_count,
+        ID3D11Buffer *const *buffers, const UINT *offsets)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, buffer_count %u, buffers %p, offsets %p.\n", iface, buffer_count, buffers, offsets);
+
+    d3d11_deferred_context_record_bind(context, D3D11_DEFERRED_CALL_SET_STREAM_OUTPUT,
+            0, 0, min(buffer_count, D3D11_SO_BUFFER_SLOT_COUNT), buffers, offsets, NULL);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DrawAuto(ID3D11DeviceContext1 *iface)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p.\n", iface);
+
+    d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_DRAW_AUTO, sizeof(struct d3d11_deferred_call));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DrawIndexedInstancedIndirect(ID3D11DeviceContext1 *iface,
+        ID3D11Buffer *buffer, UINT offset)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, buffer %p, offset %u.\n", iface, buffer, offset);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_DRAW_INDEXED_INSTANCED_INDIRECT,
+            buffer, offset);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DrawInstancedIndirect(ID3D11DeviceContext1 *iface,
+        ID3D11Buffer *buffer, UINT offset)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, buffer %p, offset %u.\n", iface, buffer, offset);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_DRAW_INSTANCED_INDIRECT, buffer, offset);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_Dispatch(ID3D11DeviceContext1 *iface,
+        UINT thread_group_count_x, UINT thread_group_count_y, UINT thread_group_count_z)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_dispatch_call *call;
+
+    TRACE("iface %p, thread_group_count_x %u, thread_group_count_y %u, thread_group_count_z %u.\n",
+            iface, thread_group_count_x, thread_group_count_y, thread_group_count_z);
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_DISPATCH, sizeof(*call))))
+        return;
+    call->x = thread_group_count_x;
+    call->y = thread_group_count_y;
+    call->z = thread_group_count_z;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DispatchIndirect(ID3D11DeviceContext1 *iface,
+        ID3D11Buffer *buffer, UINT offset)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, buffer %p, offset %u.\n", iface, buffer, offset);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_DISPATCH_INDIRECT, buffer, offset);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_RSSetState(ID3D11DeviceContext1 *iface,
+        ID3D11RasterizerState *rasterizer_state)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, rasterizer_state %p.\n", iface, rasterizer_state);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_SET_RASTERIZER_STATE, rasterizer_state, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_RSSetViewports(ID3D11DeviceContext1 *iface,
+        UINT viewport_count, const D3D11_VIEWPORT *viewports)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_viewports_call *call;
+
+    TRACE("iface %p, viewport_count %u, viewports %p.\n", iface, viewport_count, viewports);
+
+    if (viewport_count > D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE)
+        return;
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_SET_VIEWPORTS,
+            FIELD_OFFSET(struct d3d11_deferred_viewports_call, viewports[viewport_count]))))
+        return;
+    call->count = viewport_count;
+    memcpy(call->viewports, viewports, viewport_count * sizeof(*viewports));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_RSSetScissorRects(ID3D11DeviceContext1 *iface,
+        UINT rect_count, const D3D11_RECT *rects)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_scissor_rects_call *call;
+
+    TRACE("iface %p, rect_count %u, rects %p.\n", iface, rect_count, rects);
+
+    if (rect_count > D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE)
+        return;
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_SET_SCISSOR_RECTS,
+            FIELD_OFFSET(struct d3d11_deferred_scissor_rects_call, rects[rect_count]))))
+        return;
+    call->count = rect_count;
+    memcpy(call->rects, rects, rect_count * sizeof(*rects));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CopySubresourceRegion1(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *dst_resource, UINT dst_subresource_idx, UINT dst_x, UINT dst_y, UINT dst_z,
+        ID3D11Resource *src_resource, UINT src_subresource_idx, const D3D11_BOX *src_box, UINT flags)
+{
+    struct d3d11_deferred_copy_call *call;
+
+    TRACE("iface %p, dst_resource %p, dst_subresource_idx %u, dst_x %u, dst_y %u, dst_z %u, "
+            "src_resource %p, src_subresource_idx %u, src_box %p, flags %#x.\n",
+            iface, dst_resource, dst_subresource_idx, dst_x, dst_y, dst_z,
+            src_resource, src_subresource_idx, src_box, flags);
+
+    if (!(call = d3d11_deferred_context_record_copy(iface, D3D11_DEFERRED_CALL_COPY_SUBRESOURCE_REGION,
+            dst_resource, dst_subresource_idx, src_resource, src_subresource_idx)))
+        return;
+    call->dst_x = dst_x;
+    call->dst_y = dst_y;
+    call->dst_z = dst_z;
+    if ((call->has_box = !!src_box))
+        call->box = *src_box;
+    call->flags = flags;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CopySubresourceRegion(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *dst_resource, UINT dst_subresource_idx, UINT dst_x, UINT dst_y, UINT dst_z,
+        ID3D11Resource *src_resource, UINT src_subresource_idx, const D3D11_BOX *src_box)
+{
+    TRACE("iface %p, dst_resource %p, dst_subresource_idx %u, dst_x %u, dst_y %u, dst_z %u, "
+            "src_resource %p, src_subresource_idx %u, src_box %p.\n",
+            iface, dst_resource, dst_subresource_idx, dst_x, dst_y, dst_z,
+            src_resource, src_subresource_idx, src_box);
+
+    d3d11_deferred_context_CopySubresourceRegion1(iface, dst_resource, dst_subresource_idx,
+            dst_x, dst_y, dst_z, src_resource, src_subresource_idx, src_box, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CopyResource(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *dst_resource, ID3D11Resource *src_resource)
+{
+    TRACE("iface %p, dst_resource %p, src_resource %p.\n", iface, dst_resource, src_resource);
+
+    d3d11_deferred_context_record_copy(iface, D3D11_DEFERRED_CALL_COPY_RESOURCE, dst_resource, 0, src_resource, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_UpdateSubresource1(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *resource, UINT subresource_idx, const D3D11_BOX *box, const void *data,
+        UINT row_pitch, UINT depth_pitch, UINT flags)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_update_call *call;
+    SIZE_T data_size;
+
+    TRACE("iface %p, resource %p, subresource_idx %u, box %p, data %p, row_pitch %u, depth_pitch %u, flags %#x.\n",
+            iface, resource, subresource_idx, box, data, row_pitch, depth_pitch, flags);
+
+    data_size = d3d11_deferred_context_get_update_size(context, resource, subresource_idx,
+            box, row_pitch, depth_pitch);
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_UPDATE_SUBRESOURCE,
+            FIELD_OFFSET(struct d3d11_deferred_update_call, data[data_size]))))
+        return;
+    call->resource = d3d11_deferred_context_reference(context, resource);
+    call->subresource_idx = subresource_idx;
+    if ((call->has_box = !!box))
+        call->box = *box;
+    call->row_pitch = row_pitch;
+    call->depth_pitch = depth_pitch;
+    call->flags = flags;
+    call->data_size = data_size;
+    memcpy(call->data, data, data_size);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_UpdateSubresource(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *resource, UINT subresource_idx, const D3D11_BOX *box,
+        const void *data, UINT row_pitch, UINT depth_pitch)
+{
+    TRACE("iface %p, resource %p, subresource_idx %u, box %p, data %p, row_pitch %u, depth_pitch %u.\n",
+            iface, resource, subresource_idx, box, data, row_pitch, depth_pitch);
+
+    d3d11_deferred_context_UpdateSubresource1(iface, resource, subresource_idx, box,
+            data, row_pitch, depth_pitch, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CopyStructureCount(ID3D11DeviceContext1 *iface,
+        ID3D11Buffer *dst_buffer, UINT dst_offset, ID3D11UnorderedAccessView *src_view)
+{
+    struct d3d11_deferred_copy_call *call;
+
+    TRACE("iface %p, dst_buffer %p, dst_offset %u, src_view %p.\n",
+            iface, dst_buffer, dst_offset, src_view);
+
+    if ((call = d3d11_deferred_context_record_copy(iface, D3D11_DEFERRED_CALL_COPY_STRUCTURE_COUNT,
+            dst_buffer, 0, src_view, 0)))
+        call->dst_x = dst_offset;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ClearRenderTargetView(ID3D11DeviceContext1 *iface,
+        ID3D11RenderTargetView *render_target_view, const float color_rgba[4])
+{
+    TRACE("iface %p, render_target_view %p, color_rgba %s.\n",
+            iface, render_target_view, debug_float4(color_rgba));
+
+    d3d11_deferred_context_record_clear(iface, D3D11_DEFERRED_CALL_CLEAR_RENDER_TARGET_VIEW,
+            render_target_view, color_rgba, NULL, 0, 0.0f, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ClearUnorderedAccessViewUint(ID3D11DeviceContext1 *iface,
+        ID3D11UnorderedAccessView *unordered_access_view, const UINT values[4])
+{
+    TRACE("iface %p, unordered_access_view %p, values {%u, %u, %u, %u}.\n",
+            iface, unordered_access_view, values[0], values[1], values[2], values[3]);
+
+    d3d11_deferred_context_record_clear(iface, D3D11_DEFERRED_CALL_CLEAR_UAV_UINT,
+            unordered_access_view, NULL, values, 0, 0.0f, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ClearUnorderedAccessViewFloat(ID3D11DeviceContext1 *iface,
+        ID3D11UnorderedAccessView *unordered_access_view, const float values[4])
+{
+    TRACE("iface %p, unordered_access_view %p, values %s.\n",
+            iface, unordered_access_view, debug_float4(values));
+
+    d3d11_deferred_context_record_clear(iface, D3D11_DEFERRED_CALL_CLEAR_UAV_FLOAT,
+            unordered_access_view, values, NULL, 0, 0.0f, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ClearDepthStencilView(ID3D11DeviceContext1 *iface,
+        ID3D11DepthStencilView *depth_stencil_view, UINT flags, FLOAT depth, UINT8 stencil)
+{
+    TRACE("iface %p, depth_stencil_view %p, flags %#x, depth %.8e, stencil %u.\n",
+            iface, depth_stencil_view, flags, depth, stencil);
+
+    d3d11_deferred_context_record_clear(iface, D3D11_DEFERRED_CALL_CLEAR_DEPTH_STENCIL_VIEW,
+            depth_stencil_view, NULL, NULL, flags, depth, stencil);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GenerateMips(ID3D11DeviceContext1 *iface,
+        ID3D11ShaderResourceView *view)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, view %p.\n", iface, view);
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_GENERATE_MIPS, view, 0);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_SetResourceMinLOD(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *resource, FLOAT min_lod)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_deferred_min_lod_call *call;
+
+    TRACE("iface %p, resource %p, min_lod %f.\n", iface, resource, min_lod);
+
+    if (!(call = d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_SET_RESOURCE_MIN_LOD, sizeof(*call))))
+        return;
+    call->resource = d3d11_deferred_context_reference(context, resource);
+    call->min_lod = min_lod;
+}
+
+static FLOAT STDMETHODCALLTYPE d3d11_deferred_context_GetResourceMinLOD(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *resource)
+{
+    FIXME("iface %p, resource %p stub!\n", iface, resource);
+
+    return 0.0f;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ResolveSubresource(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *dst_resource, UINT dst_subresource_idx,
+        ID3D11Resource *src_resource, UINT src_subresource_idx,
+        DXGI_FORMAT format)
+{
+    struct d3d11_deferred_copy_call *call;
+
+    TRACE("iface %p, dst_resource %p, dst_subresource_idx %u, src_resource %p, src_subresource_idx %u, "
+            "format %s.\n",
+            iface, dst_resource, dst_subresource_idx, src_resource, src_subresource_idx,
+            debug_dxgi_format(format));
+
+    if ((call = d3d11_deferred_context_record_copy(iface, D3D11_DEFERRED_CALL_RESOLVE_SUBRESOURCE,
+            dst_resource, dst_subresource_idx, src_resource, src_subresource_idx)))
+        call->format = format;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ExecuteCommandList(ID3D11DeviceContext1 *iface,
+        ID3D11CommandList *command_list, BOOL restore_state)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, command_list %p, restore_state %#x.\n", iface, command_list, restore_state);
+
+    if (!command_list)
+    {
+        WARN("Invalid command list.\n");
+        return;
+    }
+
+    d3d11_deferred_context_record_object(context, D3D11_DEFERRED_CALL_EXECUTE_COMMAND_LIST,
+            command_list, restore_state);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSSetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
+
+    d3d11_deferred_context_set_shader_resources(iface, WINED3D_SHADER_TYPE_HULL, start_slot, view_count, views);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSSetShader(ID3D11DeviceContext1 *iface,
+        ID3D11HullShader *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    TRACE("iface %p, shader %p, class_instances %p, class_instance_count %u.\n",
+            iface, shader, class_instances, class_instance_count);
+
+    d3d11_deferred_context_set_shader(iface, WINED3D_SHADER_TYPE_HULL,
+            shader, class_instances, class_instance_count);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSSetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
+            iface, start_slot, sampler_count, samplers);
+
+    d3d11_deferred_context_set_samplers(iface, WINED3D_SHADER_TYPE_HULL, start_slot, sampler_count, samplers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSSetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
+            iface, start_slot, buffer_count, buffers);
+
+    d3d11_deferred_context_set_constant_buffers(iface, WINED3D_SHADER_TYPE_HULL,
+            start_slot, buffer_count, buffers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSSetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
+
+    d3d11_deferred_context_set_shader_resources(iface, WINED3D_SHADER_TYPE_DOMAIN, start_slot, view_count, views);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSSetShader(ID3D11DeviceContext1 *iface,
+        ID3D11DomainShader *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    TRACE("iface %p, shader %p, class_instances %p, class_instance_count %u.\n",
+            iface, shader, class_instances, class_instance_count);
+
+    d3d11_deferred_context_set_shader(iface, WINED3D_SHADER_TYPE_DOMAIN,
+            shader, class_instances, class_instance_count);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSSetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
+            iface, start_slot, sampler_count, samplers);
+
+    d3d11_deferred_context_set_samplers(iface, WINED3D_SHADER_TYPE_DOMAIN, start_slot, sampler_count, samplers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSSetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
+            iface, start_slot, buffer_count, buffers);
+
+    d3d11_deferred_context_set_constant_buffers(iface, WINED3D_SHADER_TYPE_DOMAIN,
+            start_slot, buffer_count, buffers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSSetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView *const *views)
+{
+    TRACE("iface %p, start_slot %u, view_count %u, views %p.\n", iface, start_slot, view_count, views);
+
+    d3d11_deferred_context_set_shader_resources(iface, WINED3D_SHADER_TYPE_COMPUTE, start_slot, view_count, views);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSSetUnorderedAccessViews(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11UnorderedAccessView *const *views, const UINT *initial_counts)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p, start_slot %u, view_count %u, views %p, initial_counts %p.\n",
+            iface, start_slot, view_count, views, initial_counts);
+
+    d3d11_deferred_context_record_bind(context, D3D11_DEFERRED_CALL_SET_CS_UAVS,
+            WINED3D_SHADER_TYPE_COMPUTE, start_slot, view_count, views, initial_counts, NULL);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSSetShader(ID3D11DeviceContext1 *iface,
+        ID3D11ComputeShader *shader, ID3D11ClassInstance *const *class_instances, UINT class_instance_count)
+{
+    TRACE("iface %p, shader %p, class_instances %p, class_instance_count %u.\n",
+            iface, shader, class_instances, class_instance_count);
+
+    d3d11_deferred_context_set_shader(iface, WINED3D_SHADER_TYPE_COMPUTE,
+            shader, class_instances, class_instance_count);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSSetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState *const *samplers)
+{
+    TRACE("iface %p, start_slot %u, sampler_count %u, samplers %p.\n",
+            iface, start_slot, sampler_count, samplers);
+
+    d3d11_deferred_context_set_samplers(iface, WINED3D_SHADER_TYPE_COMPUTE, start_slot, sampler_count, samplers);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSSetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer *const *buffers)
+{
+    TRACE("iface %p, start_slot %u, buffer_count %u, buffers %p.\n",
+            iface, start_slot, buffer_count, buffers);
+
+    d3d11_deferred_context_set_constant_buffers(iface, WINED3D_SHADER_TYPE_COMPUTE,
+            start_slot, buffer_count, buffers);
+}
+
+/* The state of deferred contexts isn't tracked, so it can't be queried. */
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSGetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p stub!\n",
+            iface, start_slot, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSGetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSGetShader(ID3D11DeviceContext1 *iface,
+        ID3D11PixelShader **shader, ID3D11ClassInstance **class_instances, UINT *class_instance_count)
+{
+    FIXME("iface %p, shader %p, class_instances %p, class_instance_count %p stub!\n",
+            iface, shader, class_instances, class_instance_count);
+
+    *shader = NULL;
+    if (class_instance_count)
+        *class_instance_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSGetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState **samplers)
+{
+    FIXME("iface %p, start_slot %u, sampler_count %u, samplers %p stub!\n",
+            iface, start_slot, sampler_count, samplers);
+
+    memset(samplers, 0, sampler_count * sizeof(*samplers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSGetShader(ID3D11DeviceContext1 *iface,
+        ID3D11VertexShader **shader, ID3D11ClassInstance **class_instances, UINT *class_instance_count)
+{
+    FIXME("iface %p, shader %p, class_instances %p, class_instance_count %p stub!\n",
+            iface, shader, class_instances, class_instance_count);
+
+    *shader = NULL;
+    if (class_instance_count)
+        *class_instance_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSGetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p stub!\n",
+            iface, start_slot, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IAGetInputLayout(ID3D11DeviceContext1 *iface,
+        ID3D11InputLayout **input_layout)
+{
+    FIXME("iface %p, input_layout %p stub!\n", iface, input_layout);
+
+    *input_layout = NULL;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IAGetVertexBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *strides, UINT *offsets)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, strides %p, offsets %p stub!\n",
+            iface, start_slot, buffer_count, buffers, strides, offsets);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+    memset(strides, 0, buffer_count * sizeof(*strides));
+    memset(offsets, 0, buffer_count * sizeof(*offsets));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IAGetIndexBuffer(ID3D11DeviceContext1 *iface,
+        ID3D11Buffer **buffer, DXGI_FORMAT *format, UINT *offset)
+{
+    FIXME("iface %p, buffer %p, format %p, offset %p stub!\n", iface, buffer, format, offset);
+
+    *buffer = NULL;
+    *format = DXGI_FORMAT_UNKNOWN;
+    *offset = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSGetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p stub!\n",
+            iface, start_slot, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSGetShader(ID3D11DeviceContext1 *iface,
+        ID3D11GeometryShader **shader, ID3D11ClassInstance **class_instances, UINT *class_instance_count)
+{
+    FIXME("iface %p, shader %p, class_instances %p, class_instance_count %p stub!\n",
+            iface, shader, class_instances, class_instance_count);
+
+    *shader = NULL;
+    if (class_instance_count)
+        *class_instance_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_IAGetPrimitiveTopology(ID3D11DeviceContext1 *iface,
+        D3D11_PRIMITIVE_TOPOLOGY *topology)
+{
+    FIXME("iface %p, topology %p stub!\n", iface, topology);
+
+    *topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSGetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSGetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState **samplers)
+{
+    FIXME("iface %p, start_slot %u, sampler_count %u, samplers %p stub!\n",
+            iface, start_slot, sampler_count, samplers);
+
+    memset(samplers, 0, sampler_count * sizeof(*samplers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GetPredication(ID3D11DeviceContext1 *iface,
+        ID3D11Predicate **predicate, BOOL *value)
+{
+    FIXME("iface %p, predicate %p, value %p stub!\n", iface, predicate, value);
+
+    *predicate = NULL;
+    if (value)
+        *value = FALSE;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSGetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSGetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState **samplers)
+{
+    FIXME("iface %p, start_slot %u, sampler_count %u, samplers %p stub!\n",
+            iface, start_slot, sampler_count, samplers);
+
+    memset(samplers, 0, sampler_count * sizeof(*samplers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMGetRenderTargets(ID3D11DeviceContext1 *iface,
+        UINT render_target_view_count, ID3D11RenderTargetView **render_target_views,
+        ID3D11DepthStencilView **depth_stencil_view)
+{
+    FIXME("iface %p, render_target_view_count %u, render_target_views %p, depth_stencil_view %p stub!\n",
+            iface, render_target_view_count, render_target_views, depth_stencil_view);
+
+    if (render_target_views)
+        memset(render_target_views, 0, render_target_view_count * sizeof(*render_target_views));
+    if (depth_stencil_view)
+        *depth_stencil_view = NULL;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMGetRenderTargetsAndUnorderedAccessViews(
+        ID3D11DeviceContext1 *iface,
+        UINT render_target_view_count, ID3D11RenderTargetView **render_target_views,
+        ID3D11DepthStencilView **depth_stencil_view,
+        UINT unordered_access_view_start_slot, UINT unordered_access_view_count,
+        ID3D11UnorderedAccessView **unordered_access_views)
+{
+    FIXME("iface %p, render_target_view_count %u, render_target_views %p, depth_stencil_view %p, "
+            "unordered_access_view_start_slot %u, unordered_access_view_count %u, "
+            "unordered_access_views %p stub!\n",
+            iface, render_target_view_count, render_target_views, depth_stencil_view,
+            unordered_access_view_start_slot, unordered_access_view_count, unordered_access_views);
+
+    d3d11_deferred_context_OMGetRenderTargets(iface, render_target_view_count,
+            render_target_views, depth_stencil_view);
+    if (unordered_access_views)
+        memset(unordered_access_views, 0, unordered_access_view_count * sizeof(*unordered_access_views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMGetBlendState(ID3D11DeviceContext1 *iface,
+        ID3D11BlendState **blend_state, FLOAT blend_factor[4], UINT *sample_mask)
+{
+    FIXME("iface %p, blend_state %p, blend_factor %p, sample_mask %p stub!\n",
+            iface, blend_state, blend_factor, sample_mask);
+
+    if (blend_state)
+        *blend_state = NULL;
+    if (blend_factor)
+        blend_factor[0] = blend_factor[1] = blend_factor[2] = blend_factor[3] = 1.0f;
+    if (sample_mask)
+        *sample_mask = D3D11_DEFAULT_SAMPLE_MASK;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_OMGetDepthStencilState(ID3D11DeviceContext1 *iface,
+        ID3D11DepthStencilState **depth_stencil_state, UINT *stencil_ref)
+{
+    FIXME("iface %p, depth_stencil_state %p, stencil_ref %p stub!\n",
+            iface, depth_stencil_state, stencil_ref);
+
+    if (depth_stencil_state)
+        *depth_stencil_state = NULL;
+    if (stencil_ref)
+        *stencil_ref = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_SOGetTargets(ID3D11DeviceContext1 *iface,
+        UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, buffer_count %u, buffers %p stub!\n", iface, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_RSGetState(ID3D11DeviceContext1 *iface,
+        ID3D11RasterizerState **rasterizer_state)
+{
+    FIXME("iface %p, rasterizer_state %p stub!\n", iface, rasterizer_state);
+
+    *rasterizer_state = NULL;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_RSGetViewports(ID3D11DeviceContext1 *iface,
+        UINT *viewport_count, D3D11_VIEWPORT *viewports)
+{
+    FIXME("iface %p, viewport_count %p, viewports %p stub!\n", iface, viewport_count, viewports);
+
+    if (viewports)
+        memset(viewports, 0, *viewport_count * sizeof(*viewports));
+    else
+        *viewport_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_RSGetScissorRects(ID3D11DeviceContext1 *iface,
+        UINT *rect_count, D3D11_RECT *rects)
+{
+    FIXME("iface %p, rect_count %p, rects %p stub!\n", iface, rect_count, rects);
+
+    if (rects)
+        memset(rects, 0, *rect_count * sizeof(*rects));
+    else
+        *rect_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSGetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSGetShader(ID3D11DeviceContext1 *iface,
+        ID3D11HullShader **shader, ID3D11ClassInstance **class_instances, UINT *class_instance_count)
+{
+    FIXME("iface %p, shader %p, class_instances %p, class_instance_count %p stub!\n",
+            iface, shader, class_instances, class_instance_count);
+
+    *shader = NULL;
+    if (class_instance_count)
+        *class_instance_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSGetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState **samplers)
+{
+    FIXME("iface %p, start_slot %u, sampler_count %u, samplers %p stub!\n",
+            iface, start_slot, sampler_count, samplers);
+
+    memset(samplers, 0, sampler_count * sizeof(*samplers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSGetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p stub!\n",
+            iface, start_slot, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSGetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSGetShader(ID3D11DeviceContext1 *iface,
+        ID3D11DomainShader **shader, ID3D11ClassInstance **class_instances, UINT *class_instance_count)
+{
+    FIXME("iface %p, shader %p, class_instances %p, class_instance_count %p stub!\n",
+            iface, shader, class_instances, class_instance_count);
+
+    *shader = NULL;
+    if (class_instance_count)
+        *class_instance_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSGetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState **samplers)
+{
+    FIXME("iface %p, start_slot %u, sampler_count %u, samplers %p stub!\n",
+            iface, start_slot, sampler_count, samplers);
+
+    memset(samplers, 0, sampler_count * sizeof(*samplers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSGetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p stub!\n",
+            iface, start_slot, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSGetShaderResources(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11ShaderResourceView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSGetUnorderedAccessViews(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT view_count, ID3D11UnorderedAccessView **views)
+{
+    FIXME("iface %p, start_slot %u, view_count %u, views %p stub!\n", iface, start_slot, view_count, views);
+
+    memset(views, 0, view_count * sizeof(*views));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSGetShader(ID3D11DeviceContext1 *iface,
+        ID3D11ComputeShader **shader, ID3D11ClassInstance **class_instances, UINT *class_instance_count)
+{
+    FIXME("iface %p, shader %p, class_instances %p, class_instance_count %p stub!\n",
+            iface, shader, class_instances, class_instance_count);
+
+    *shader = NULL;
+    if (class_instance_count)
+        *class_instance_count = 0;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSGetSamplers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT sampler_count, ID3D11SamplerState **samplers)
+{
+    FIXME("iface %p, start_slot %u, sampler_count %u, samplers %p stub!\n",
+            iface, start_slot, sampler_count, samplers);
+
+    memset(samplers, 0, sampler_count * sizeof(*samplers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSGetConstantBuffers(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p stub!\n",
+            iface, start_slot, buffer_count, buffers);
+
+    memset(buffers, 0, buffer_count * sizeof(*buffers));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ClearState(ID3D11DeviceContext1 *iface)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+
+    TRACE("iface %p.\n", iface);
+
+    d3d11_deferred_context_record(context, D3D11_DEFERRED_CALL_CLEAR_STATE, sizeof(struct d3d11_deferred_call));
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_Flush(ID3D11DeviceContext1 *iface)
+{
+    TRACE("iface %p.\n", iface);
+}
+
+static D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE d3d11_deferred_context_GetType(ID3D11DeviceContext1 *iface)
+{
+    TRACE("iface %p.\n", iface);
+
+    return D3D11_DEVICE_CONTEXT_DEFERRED;
+}
+
+static UINT STDMETHODCALLTYPE d3d11_deferred_context_GetContextFlags(ID3D11DeviceContext1 *iface)
+{
+    TRACE("iface %p.\n", iface);
+
+    return 0;
+}
+
+static HRESULT STDMETHODCALLTYPE d3d11_deferred_context_FinishCommandList(ID3D11DeviceContext1 *iface,
+        BOOL restore, ID3D11CommandList **command_list)
+{
+    struct d3d11_deferred_context *context = impl_from_deferred_ID3D11DeviceContext1(iface);
+    struct d3d11_command_list *object;
+    HRESULT hr;
+
+    TRACE("iface %p, restore %#x, command_list %p.\n", iface, restore, command_list);
+
+    /* The recorded calls are incomplete, throw them away. */
+    if (context->out_of_memory)
+    {
+        WARN("Ran out of memory while recording, discarding the command list.\n");
+        d3d11_deferred_context_free_calls(context);
+        d3d11_deferred_context_free_maps(context);
+        context->out_of_memory = FALSE;
+        *command_list = NULL;
+        return E_OUTOFMEMORY;
+    }
+
+    if (FAILED(hr = d3d11_command_list_create(context, &object)))
+    {
+        WARN("Failed to create command list, hr %#x.\n", hr);
+        *command_list = NULL;
+        return hr;
+    }
+
+    d3d11_deferred_context_free_maps(context);
+    if (restore)
+        d3d11_deferred_context_restore_state(context, object);
+
+    *command_list = &object->ID3D11CommandList_iface;
+
+    return S_OK;
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DiscardResource(ID3D11DeviceContext1 *iface,
+        ID3D11Resource *resource)
+{
+    FIXME("iface %p, resource %p stub!\n", iface, resource);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DiscardView(ID3D11DeviceContext1 *iface, ID3D11View *view)
+{
+    FIXME("iface %p, view %p stub!\n", iface, view);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSSetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer * const *buffers, const UINT *first_constant,
+        const UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSSetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer * const *buffers, const UINT *first_constant,
+        const UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSSetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer * const *buffers, const UINT *first_constant,
+        const UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSSetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer * const *buffers, const UINT *first_constant,
+        const UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSSetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer * const *buffers, const UINT *first_constant,
+        const UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSSetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer * const *buffers, const UINT *first_constant,
+        const UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_VSGetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *first_constant, UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_HSGetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *first_constant, UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DSGetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *first_constant, UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_GSGetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *first_constant, UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_PSGetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *first_constant, UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_CSGetConstantBuffers1(ID3D11DeviceContext1 *iface,
+        UINT start_slot, UINT buffer_count, ID3D11Buffer **buffers, UINT *first_constant, UINT *num_constants)
+{
+    FIXME("iface %p, start_slot %u, buffer_count %u, buffers %p, first_constant %p, num_constants %p stub!\n",
+            iface, start_slot, buffer_count, buffers, first_constant, num_constants);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_SwapDeviceContextState(ID3D11DeviceContext1 *iface,
+        ID3DDeviceContextState *state, ID3DDeviceContextState **prev_state)
+{
+    FIXME("iface %p, state %p, prev_state %p stub!\n", iface, state, prev_state);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_ClearView(ID3D11DeviceContext1 *iface, ID3D11View *view,
+        const FLOAT color[4], const D3D11_RECT *rect, UINT num_rects)
+{
+    FIXME("iface %p, view %p, color %p, rect %p, num_rects %u stub!\n", iface, view, color, rect, num_rects);
+}
+
+static void STDMETHODCALLTYPE d3d11_deferred_context_DiscardView1(ID3D11DeviceContext1 *iface, ID3D11View *view,
+        const D3D11_RECT *rects, UINT num_rects)
+{
+    FIXME("iface %p, view %p, rects %p, num_rects %u stub!\n", iface, view, rects, num_rects);
+}
+
+static const struct ID3D11DeviceContext1Vtbl d3d11_deferred_context_vtbl =
+{
+    /* IUnknown methods */
+    d3d11_deferred_context_QueryInterface,
+    d3d11_deferred_context_AddRef,
+    d3d11_deferred_context_Release,
+    /* ID3D11DeviceChild methods */
+    d3d11_deferred_context_GetDevice,
+    d3d11_deferred_context_GetPrivateData,
+    d3d11_deferred_context_SetPrivateData,
+    d3d11_deferred_context_SetPrivateDataInterface,
+    /* ID3D11DeviceContext methods */
+    d3d11_deferred_context_VSSetConstantBuffers,
+    d3d11_deferred_context_PSSetShaderResources,
+    d3d11_deferred_context_PSSetShader,
+    d3d11_deferred_context_PSSetSamplers,
+    d3d11_deferred_context_VSSetShader,
+    d3d11_deferred_context_DrawIndexed,
+    d3d11_deferred_context_Draw,
+    d3d11_deferred_context_Map,
+    d3d11_deferred_context_Unmap,
+    d3d11_deferred_context_PSSetConstantBuffers,
+    d3d11_deferred_context_IASetInputLayout,
+    d3d11_deferred_context_IASetVertexBuffers,
+    d3d11_deferred_context_IASetIndexBuffer,
+    d3d11_deferred_context_DrawIndexedInstanced,
+    d3d11_deferred_context_DrawInstanced,
+    d3d11_deferred_context_GSSetConstantBuffers,
+    d3d11_deferred_context_GSSetShader,
+    d3d11_deferred_context_IASetPrimitiveTopology,
+    d3d11_deferred_context_VSSetShaderResources,
+    d3d11_deferred_context_VSSetSamplers,
+    d3d11_deferred_context_Begin,
+    d3d11_deferred_context_End,
+    d3d11_deferred_context_GetData,
+    d3d11_deferred_context_SetPredication,
+    d3d11_deferred_context_GSSetShaderResources,
+    d3d11_deferred_context_GSSetSamplers,
+    d3d11_deferred_context_OMSetRenderTargets,
+    d3d11_deferred_context_OMSetRenderTargetsAndUnorderedAccessViews,
+    d3d11_deferred_context_OMSetBlendState,
+    d3d11_deferred_context_OMSetDepthStencilState,
+    d3d11_deferred_context_SOSetTargets,
+    d3d11_deferred_context_DrawAuto,
+    d3d11_deferred_context_DrawIndexedInstancedIndirect,
+    d3d11_deferred_context_DrawInstancedIndirect,
+    d3d11_deferred_context_Dispatch,
+    d3d11_deferred_context_DispatchIndirect,
+    d3d11_deferred_context_RSSetState,
+    d3d11_deferred_context_RSSetViewports,
+    d3d11_deferred_context_RSSetScissorRects,
+    d3d11_deferred_context_CopySubresourceRegion,
+    d3d11_deferred_context_CopyResource,
+    d3d11_deferred_context_UpdateSubresource,
+    d3d11_deferred_context_CopyStructureCount,
+    d3d11_deferred_context_ClearRenderTargetView,
+    d3d11_deferred_context_ClearUnorderedAccessViewUint,
+    d3d11_deferred_context_ClearUnorderedAccessViewFloat,
+    d3d11_deferred_context_ClearDepthStencilView,
+    d3d11_deferred_context_GenerateMips,
+    d3d11_deferred_context_SetResourceMinLOD,
+    d3d11_deferred_context_GetResourceMinLOD,
+    d3d11_deferred_context_ResolveSubresource,
+    d3d11_deferred_context_ExecuteCommandList,
+    d3d11_deferred_context_HSSetShaderResources,
+    d3d11_deferred_context_HSSetShader,
+    d3d11_deferred_context_HSSetSamplers,
+    d3d11_deferred_context_HSSetConstantBuffers,
+    d3d11_deferred_context_DSSetShaderResources,
+    d3d11_deferred_context_DSSetShader,
+    d3d11_deferred_context_DSSetSamplers,
+    d3d11_deferred_context_DSSetConstantBuffers,
+    d3d11_deferred_context_CSSetShaderResources,
+    d3d11_deferred_context_CSSetUnorderedAccessViews,
+    d3d11_deferred_context_CSSetShader,
+    d3d11_deferred_context_CSSetSamplers,
+    d3d11_deferred_context_CSSetConstantBuffers,
+    d3d11_deferred_context_VSGetConstantBuffers,
+    d3d11_deferred_context_PSGetShaderResources,
+    d3d11_deferred_context_PSGetShader,
+    d3d11_deferred_context_PSGetSamplers,
+    d3d11_deferred_context_VSGetShader,
+    d3d11_deferred_context_PSGetConstantBuffers,
+    d3d11_deferred_context_IAGetInputLayout,
+    d3d11_deferred_context_IAGetVertexBuffers,
+    d3d11_deferred_context_IAGetIndexBuffer,
+    d3d11_deferred_context_GSGetConstantBuffers,
+    d3d11_deferred_context_GSGetShader,
+    d3d11_deferred_context_IAGetPrimitiveTopology,
+    d3d11_deferred_context_VSGetShaderResources,
+    d3d11_deferred_context_VSGetSamplers,
+    d3d11_deferred_context_GetPredication,
+    d3d11_deferred_context_GSGetShaderResources,
+    d3d11_deferred_context_GSGetSamplers,
+    d3d11_deferred_context_OMGetRenderTargets,
+    d3d11_deferred_context_OMGetRenderTargetsAndUnorderedAccessViews,
+    d3d11_deferred_context_OMGetBlendState,
+    d3d11_deferred_context_OMGetDepthStencilState,
+    d3d11_deferred_context_SOGetTargets,
+    d3d11_deferred_context_RSGetState,
+    d3d11_deferred_context_RSGetViewports,
+    d3d11_deferred_context_RSGetScissorRects,
+    d3d11_deferred_context_HSGetShaderResources,
+    d3d11_deferred_context_HSGetShader,
+    d3d11_deferred_context_HSGetSamplers,
+    d3d11_deferred_context_HSGetConstantBuffers,
+    d3d11_deferred_context_DSGetShaderResources,
+    d3d11_deferred_context_DSGetShader,
+    d3d11_deferred_context_DSGetSamplers,
+    d3d11_deferred_context_DSGetConstantBuffers,
+    d3d11_deferred_context_CSGetShaderResources,
+    d3d11_deferred_context_CSGetUnorderedAccessViews,
+    d3d11_deferred_context_CSGetShader,
+    d3d11_deferred_context_CSGetSamplers,
+    d3d11_deferred_context_CSGetConstantBuffers,
+    d3d11_deferred_context_ClearState,
+    d3d11_deferred_context_Flush,
+    d3d11_deferred_context_GetType,
+    d3d11_deferred_context_GetContextFlags,
+    d3d11_deferred_context_FinishCommandList,
+    /* ID3D11DeviceContext1 methods */
+    d3d11_deferred_context_CopySubresourceRegion1,
+    d3d11_deferred_context_UpdateSubresource1,
+    d3d11_deferred_context_DiscardResource,
+    d3d11_deferred_context_DiscardView,
+    d3d11_deferred_context_VSSetConstantBuffers1,
+    d3d11_deferred_context_HSSetConstantBuffers1,
+    d3d11_deferred_context_DSSetConstantBuffers1,
+    d3d11_deferred_context_GSSetConstantBuffers1,
+    d3d11_deferred_context_PSSetConstantBuffers1,
+    d3d11_deferred_context_CSSetConstantBuffers1,
+    d3d11_deferred_context_VSGetConstantBuffers1,
+    d3d11_deferred_context_HSGetConstantBuffers1,
+    d3d11_deferred_context_DSGetConstantBuffers1,
+    d3d11_deferred_context_GSGetConstantBuffers1,
+    d3d11_deferred_context_PSGetConstantBuffers1,
+    d3d11_deferred_context_CSGetConstantBuffers1,
+    d3d11_deferred_context_SwapDeviceContextState,
+    d3d11_deferred_context_ClearView,
+    d3d11_deferred_context_DiscardView1,
+};
+
+HRESULT d3d11_deferred_context_create(struct d3d_device *device, UINT flags,
+        struct d3d11_deferred_context **context)
+{
+    struct wined3d_device_creation_parameters creation_parameters;
+    struct d3d11_deferred_context *object;
+
+    if (flags)
+    {
+        WARN("Invalid flags %#x.\n", flags);
+        return E_INVALIDARG;
+    }
+
+    if (device->create_flags & D3D11_CREATE_DEVICE_SINGLETHREADED)
+    {
+        WARN("Deferred contexts are not supported by single-threaded devices.\n");
+        return DXGI_ERROR_INVALID_CALL;
+    }
+
+    if (!(object = heap_alloc_zero(sizeof(*object))))
+        return E_OUTOFMEMORY;
+
+    object->ID3D11DeviceContext1_iface.lpVtbl = &d3d11_deferred_context_vtbl;
+    object->refcount = 1;
+    list_init(&object->maps);
+
+    wined3d_mutex_lock();
+    wined3d_private_store_init(&object->private_store);
+    wined3d_device_get_creation_parameters(device->wined3d_device, &creation_parameters);
+    object->wined3d_adapter = wined3d_get_adapter(wined3d_device_get_wined3d(device->wined3d_device),
+            creation_parameters.adapter_idx);
+    wined3d_mutex_unlock();
+
+    object->device = device;
+    ID3D11Device2_AddRef(&device->ID3D11Device2_iface);
+
+    TRACE("Created deferred context %p.\n", object);
+    *context = object;
+
+    return S_OK;
+}
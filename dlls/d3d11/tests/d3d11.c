@@ -2229,7 +2229,7 @@ static void test_create_deferred_context(void)
     }
 
     hr = ID3D11Device_CreateDeferredContext(device, 0, &context);
-    todo_wine ok(hr == DXGI_ERROR_INVALID_CALL, "Failed to create deferred context, hr %#x.\n", hr);
+    ok(hr == DXGI_ERROR_INVALID_CALL, "Failed to create deferred context, hr %#x.\n", hr);
 
     refcount = ID3D11Device_Release(device);
     ok(!refcount, "Device has %u references left.\n", refcount);
@@ -2242,7 +2242,7 @@ static void test_create_deferred_context(void)
 
     expected_refcount = get_refcount(device) + 1;
     hr = ID3D11Device_CreateDeferredContext(device, 0, &context);
-    todo_wine ok(hr == S_OK, "Failed to create deferred context, hr %#x.\n", hr);
+    ok(hr == S_OK, "Failed to create deferred context, hr %#x.\n", hr);
     if (FAILED(hr))
         goto done;
     refcount = get_refcount(device);
@@ -2263,6 +2263,124 @@ done:
     ok(!refcount, "Device has %u references left.\n", refcount);
 }
 
+static void test_deferred_context_command_list(void)
+{
+    static const struct vec4 green = {0.0f, 1.0f, 0.0f, 1.0f};
+    static const struct vec4 red = {1.0f, 0.0f, 0.0f, 1.0f};
+    static const float white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    static const float blue[] = {0.0f, 0.0f, 1.0f, 1.0f};
+
+    ID3D11DeviceContext *immediate, *deferred;
+    ID3D11CommandList *list1, *list2;
+    struct d3d11_test_context test_context;
+    D3D11_MAPPED_SUBRESOURCE map_desc;
+    ID3D11RenderTargetView *rtv;
+    D3D11_BUFFER_DESC buffer_desc;
+    unsigned int stride, offset;
+    D3D11_VIEWPORT viewport;
+    ID3D11Device *device;
+    ID3D11Buffer *cb;
+    ULONG refcount;
+    HRESULT hr;
+
+    if (!init_test_context(&test_context, NULL))
+        return;
+
+    device = test_context.device;
+    immediate = test_context.immediate_context;
+
+    hr = ID3D11Device_CreateDeferredContext(device, 0, &deferred);
+    if (FAILED(hr))
+    {
+        skip("Failed to create deferred context, hr %#x.\n", hr);
+        release_test_context(&test_context);
+        return;
+    }
+
+    ok(ID3D11DeviceContext_GetType(deferred) == D3D11_DEVICE_CONTEXT_DEFERRED, "Got unexpected context type.\n");
+
+    /* Creates the shaders, input layout and vertex buffer. */
+    draw_color_quad(&test_context, &red);
+    ID3D11DeviceContext_ClearRenderTargetView(immediate, test_context.backbuffer_rtv, white);
+
+    ID3D11DeviceContext_ClearRenderTargetView(deferred, test_context.backbuffer_rtv, blue);
+    check_texture_color(test_context.backbuffer, 0xffffffff, 0);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &list1);
+    ok(hr == S_OK, "Failed to finish command list, hr %#x.\n", hr);
+    check_texture_color(test_context.backbuffer, 0xffffffff, 0);
+
+    ID3D11DeviceContext_ExecuteCommandList(immediate, list1, FALSE);
+    check_texture_color(test_context.backbuffer, 0xffff0000, 0);
+    ID3D11DeviceContext_OMGetRenderTargets(immediate, 1, &rtv, NULL);
+    ok(!rtv, "Got unexpected render target view %p.\n", rtv);
+    ID3D11CommandList_Release(list1);
+
+    buffer_desc.ByteWidth = sizeof(green);
+    buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+    buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+    hr = ID3D11Device_CreateBuffer(device, &buffer_desc, NULL, &cb);
+    ok(hr == S_OK, "Failed to create buffer, hr %#x.\n", hr);
+
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)cb, 0, D3D11_MAP_WRITE, 0, &map_desc);
+    ok(hr == E_INVALIDARG, "Got unexpected hr %#x.\n", hr);
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)cb, 0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+    ok(hr == S_OK, "Failed to map buffer, hr %#x.\n", hr);
+    memcpy(map_desc.pData, &green, sizeof(green));
+    ID3D11DeviceContext_Unmap(deferred, (ID3D11Resource *)cb, 0);
+
+    viewport.TopLeftX = 0.0f;
+    viewport.TopLeftY = 0.0f;
+    viewport.Width = 640.0f;
+    viewport.Height = 480.0f;
+    viewport.MinDepth = 0.0f;
+    viewport.MaxDepth = 1.0f;
+    stride = sizeof(struct vec3);
+    offset = 0;
+    ID3D11DeviceContext_OMSetRenderTargets(deferred, 1, &test_context.backbuffer_rtv, NULL);
+    ID3D11DeviceContext_RSSetViewports(deferred, 1, &viewport);
+    ID3D11DeviceContext_IASetInputLayout(deferred, test_context.input_layout);
+    ID3D11DeviceContext_IASetPrimitiveTopology(deferred, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    ID3D11DeviceContext_IASetVertexBuffers(deferred, 0, 1, &test_context.vb, &stride, &offset);
+    ID3D11DeviceContext_VSSetShader(deferred, test_context.vs, NULL, 0);
+    ID3D11DeviceContext_PSSetShader(deferred, test_context.ps, NULL, 0);
+    ID3D11DeviceContext_PSSetConstantBuffers(deferred, 0, 1, &cb);
+    ID3D11DeviceContext_Draw(deferred, 4, 0);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, TRUE, &list1);
+    ok(hr == S_OK, "Failed to finish command list, hr %#x.\n", hr);
+
+    /* The second command list inherits the state of the first one. */
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)cb, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &map_desc);
+    ok(hr == E_INVALIDARG, "Got unexpected hr %#x.\n", hr);
+    hr = ID3D11DeviceContext_Map(deferred, (ID3D11Resource *)cb, 0, D3D11_MAP_WRITE_DISCARD, 0, &map_desc);
+    ok(hr == S_OK, "Failed to map buffer, hr %#x.\n", hr);
+    memcpy(map_desc.pData, &red, sizeof(red));
+    ID3D11DeviceContext_Unmap(deferred, (ID3D11Resource *)cb, 0);
+    ID3D11DeviceContext_Draw(deferred, 4, 0);
+    hr = ID3D11DeviceContext_FinishCommandList(deferred, FALSE, &list2);
+    ok(hr == S_OK, "Failed to finish command list, hr %#x.\n", hr);
+
+    ID3D11DeviceContext_ClearRenderTargetView(immediate, test_context.backbuffer_rtv, white);
+    ID3D11DeviceContext_OMSetRenderTargets(immediate, 1, &test_context.backbuffer_rtv, NULL);
+    ID3D11DeviceContext_ExecuteCommandList(immediate, list1, TRUE);
+    check_texture_color(test_context.backbuffer, 0xff00ff00, 1);
+    ID3D11DeviceContext_OMGetRenderTargets(immediate, 1, &rtv, NULL);
+    ok(rtv == test_context.backbuffer_rtv, "Got unexpected render target view %p.\n", rtv);
+    ID3D11RenderTargetView_Release(rtv);
+
+    ID3D11DeviceContext_ExecuteCommandList(immediate, list2, FALSE);
+    check_texture_color(test_context.backbuffer, 0xff0000ff, 1);
+
+    ID3D11CommandList_Release(list2);
+    ID3D11CommandList_Release(list1);
+    ID3D11Buffer_Release(cb);
+    refcount = ID3D11DeviceContext_Release(deferred);
+    ok(!refcount, "Got unexpected refcount %u.\n", refcount);
+    release_test_context(&test_context);
+}
+
 static void test_create_texture1d(void)
 {
     ULONG refcount, expected_refcount;
@@ -30088,6 +30206,7 @@ START_TEST(d3d11)
     queue_for_each_feature_level(test_device_interfaces);
     queue_test(test_get_immediate_context);
     queue_test(test_create_deferred_context);
+    queue_test(test_deferred_context_command_list);
     queue_test(test_create_texture1d);
     queue_test(test_texture1d_interfaces);
     queue_test(test_create_texture2d);
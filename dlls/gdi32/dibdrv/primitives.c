@@ -25,8 +25,33 @@
 
 #include "wine/debug.h"
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <emmintrin.h>
+#define HAVE_SSE2_PRIMITIVES
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(dib);
 
+#ifdef HAVE_SSE2_PRIMITIVES
+
+/* The SSE2 versions of the primitives are only used when the CPU supports
+ * them; they produce the same results as the plain C versions. */
+static inline BOOL use_sse2(void)
+{
+#ifdef __x86_64__
+    return TRUE;
+#else
+    static int supported = -1;
+
+    if (supported == -1) supported = IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE );
+    return supported;
+#endif
+}
+
+#endif
+
 /* Bayer matrices for dithering */
 
 static const BYTE bayer_4x4[4][4] =
@@ -264,10 +289,60 @@ static inline void memset_16( WORD *start, WORD val, DWORD size )
 #endif
 }
 
+#ifdef HAVE_SSE2_PRIMITIVES
+static SSE2_TARGET void do_rop_row_32_sse2( DWORD *ptr, int len, DWORD and, DWORD xor )
+{
+    __m128i and_mask = _mm_set1_epi32( and ), xor_mask = _mm_set1_epi32( xor );
+
+    for (; len >= 4; len -= 4, ptr += 4)
+    {
+        __m128i val = _mm_loadu_si128( (const __m128i *)ptr );
+        _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( val, and_mask ), xor_mask ));
+    }
+    while (len--) do_rop_32( ptr++, and, xor );
+}
+
+static SSE2_TARGET void do_rop_row_16_sse2( WORD *ptr, int len, WORD and, WORD xor )
+{
+    __m128i and_mask = _mm_set1_epi16( and ), xor_mask = _mm_set1_epi16( xor );
+
+    for (; len >= 8; len -= 8, ptr += 8)
+    {
+        __m128i val = _mm_loadu_si128( (const __m128i *)ptr );
+        _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( val, and_mask ), xor_mask ));
+    }
+    while (len--) do_rop_16( ptr++, and, xor );
+}
+#endif
+
+static inline void do_rop_row_32( DWORD *ptr, int len, DWORD and, DWORD xor )
+{
+#ifdef HAVE_SSE2_PRIMITIVES
+    if (use_sse2())
+    {
+        do_rop_row_32_sse2( ptr, len, and, xor );
+        return;
+    }
+#endif
+    while (len--) do_rop_32( ptr++, and, xor );
+}
+
+static inline void do_rop_row_16( WORD *ptr, int len, WORD and, WORD xor )
+{
+#ifdef HAVE_SSE2_PRIMITIVES
+    if (use_sse2())
+    {
+        do_rop_row_16_sse2( ptr, len, and, xor );
+        return;
+    }
+#endif
+    while (len--) do_rop_16( ptr++, and, xor );
+}
+
 static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
-    DWORD *ptr, *start;
-    int x, y, i;
+    DWORD *start;
+    int y, i;
 
     for(i = 0; i < num; i++, rc++)
     {
@@ -276,8 +351,7 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
-                for(x = rc->left, ptr = start; x < rc->right; x++)
-                    do_rop_32(ptr++, and, xor);
+                do_rop_row_32( start, rc->right - rc->left, and, xor );
         else
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 memset_32( start, xor, rc->right - rc->left );
@@ -417,8 +491,8 @@ static void solid_rects_24(const dib_info *dib, int num, const RECT *rc, DWORD a
 
 static void solid_rects_16(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
-    WORD *ptr, *start;
-    int x, y, i;
+    WORD *start;
+    int y, i;
 
     for(i = 0; i < num; i++, rc++)
     {
@@ -427,8 +501,7 @@ static void solid_rects_16(const dib_info *dib, int num, const RECT *rc, DWORD a
         start = get_pixel_ptr_16(dib, rc->left, rc->top);
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 2)
-                for(x = rc->left, ptr = start; x < rc->right; x++)
-                    do_rop_16(ptr++, and, xor);
+                do_rop_row_16( start, rc->right - rc->left, and, xor );
         else
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 2)
                 memset_16( start, xor, rc->right - rc->left );
@@ -2215,6 +2288,97 @@ static inline BOOL bit_fields_match(const dib_info *d1, const dib_info *d2)
            d1->blue_mask  == d2->blue_mask;
 }
 
+#ifdef HAVE_SSE2_PRIMITIVES
+static SSE2_TARGET void convert_row_888_to_8888_sse2( DWORD *dst, const DWORD *src, int len,
+                                                      int red_shift, int green_shift, int blue_shift )
+{
+    __m128i red = _mm_cvtsi32_si128( red_shift ), green = _mm_cvtsi32_si128( green_shift );
+    __m128i blue = _mm_cvtsi32_si128( blue_shift ), mask = _mm_set1_epi32( 0xff );
+    DWORD src_val;
+
+    for (; len >= 4; len -= 4, src += 4, dst += 4)
+    {
+        __m128i val = _mm_loadu_si128( (const __m128i *)src );
+        __m128i r = _mm_and_si128( _mm_srl_epi32( val, red ), mask );
+        __m128i g = _mm_and_si128( _mm_srl_epi32( val, green ), mask );
+        __m128i b = _mm_and_si128( _mm_srl_epi32( val, blue ), mask );
+        _mm_storeu_si128( (__m128i *)dst, _mm_or_si128( _mm_or_si128( _mm_slli_epi32( r, 16 ),
+                                                                      _mm_slli_epi32( g, 8 )), b ));
+    }
+    while (len--)
+    {
+        src_val = *src++;
+        *dst++ = (((src_val >> red_shift)   & 0xff) << 16) |
+                 (((src_val >> green_shift) & 0xff) <<  8) |
+                  ((src_val >> blue_shift)  & 0xff);
+    }
+}
+
+/* 5-bit components are expanded as (c << 3 | c >> 2), 6-bit ones as (c << 2 | c >> 4). */
+static SSE2_TARGET void convert_row_555_565_to_8888_sse2( DWORD *dst, const WORD *src, int len,
+                                                          int red_shift, int green_shift, int blue_shift,
+                                                          int green_len )
+{
+    __m128i red = _mm_cvtsi32_si128( red_shift ), green = _mm_cvtsi32_si128( green_shift );
+    __m128i blue = _mm_cvtsi32_si128( blue_shift ), zero = _mm_setzero_si128();
+    __m128i green_hi = _mm_cvtsi32_si128( green_len == 6 ? 10 : 11 );
+    __m128i green_lo = _mm_cvtsi32_si128( green_len == 6 ? 4 : 6 );
+    __m128i green_hi_mask = _mm_set1_epi32( green_len == 6 ? 0x00fc00 : 0x00f800 );
+    __m128i green_lo_mask = _mm_set1_epi32( green_len == 6 ? 0x000300 : 0x000700 );
+    DWORD src_val;
+
+    for (; len >= 4; len -= 4, src += 4, dst += 4)
+    {
+        __m128i val = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)src ), zero );
+        __m128i r = _mm_srl_epi32( val, red ), g = _mm_srl_epi32( val, green ), b = _mm_srl_epi32( val, blue );
+        __m128i res;
+
+        res = _mm_or_si128( _mm_and_si128( _mm_slli_epi32( r, 19 ), _mm_set1_epi32( 0xf80000 )),
+                            _mm_and_si128( _mm_slli_epi32( r, 14 ), _mm_set1_epi32( 0x070000 )));
+        res = _mm_or_si128( res, _mm_and_si128( _mm_sll_epi32( g, green_hi ), green_hi_mask ));
+        res = _mm_or_si128( res, _mm_and_si128( _mm_sll_epi32( g, green_lo ), green_lo_mask ));
+        res = _mm_or_si128( res, _mm_and_si128( _mm_slli_epi32( b, 3 ), _mm_set1_epi32( 0x0000f8 )));
+        res = _mm_or_si128( res, _mm_and_si128( _mm_srli_epi32( b, 2 ), _mm_set1_epi32( 0x000007 )));
+        _mm_storeu_si128( (__m128i *)dst, res );
+    }
+    while (len--)
+    {
+        src_val = *src++;
+        if (green_len == 6)
+            *dst++ = (((src_val >> red_shift)   << 19) & 0xf80000) |
+                     (((src_val >> red_shift)   << 14) & 0x070000) |
+                     (((src_val >> green_shift) << 10) & 0x00fc00) |
+                     (((src_val >> green_shift) <<  4) & 0x000300) |
+                     (((src_val >> blue_shift)  <<  3) & 0x0000f8) |
+                     (((src_val >> blue_shift)  >>  2) & 0x000007);
+        else
+            *dst++ = (((src_val >> red_shift)   << 19) & 0xf80000) |
+                     (((src_val >> red_shift)   << 14) & 0x070000) |
+                     (((src_val >> green_shift) << 11) & 0x00f800) |
+                     (((src_val >> green_shift) <<  6) & 0x000700) |
+                     (((src_val >> blue_shift)  <<  3) & 0x0000f8) |
+                     (((src_val >> blue_shift)  >>  2) & 0x000007);
+    }
+}
+#endif
+
+/* Converts four pixels at a time from three unaligned DWORD reads. */
+static inline void convert_row_24_to_8888( DWORD *dst, const BYTE *src, int len )
+{
+    DWORD val[3];
+
+    for (; len >= 4; len -= 4, src += 12, dst += 4)
+    {
+        memcpy( val, src, sizeof(val) );
+        dst[0] = val[0] & 0xffffff;
+        dst[1] = (val[0] >> 24) | ((val[1] & 0xffff) << 8);
+        dst[2] = (val[1] >> 16) | ((val[2] & 0xff) << 16);
+        dst[3] = val[2] >> 8;
+    }
+    for (; len > 0; len--, src += 3)
+        *dst++ = src[2] << 16 | src[1] << 8 | src[0];
+}
+
 static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_rect, BOOL dither)
 {
     DWORD *dst_start = get_pixel_ptr_32(dst, 0, 0), *dst_pixel, src_val;
@@ -2246,6 +2410,15 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
             {
                 dst_pixel = dst_start;
                 src_pixel = src_start;
+#ifdef HAVE_SSE2_PRIMITIVES
+                if (use_sse2())
+                {
+                    convert_row_888_to_8888_sse2( dst_pixel, src_pixel, src_rect->right - src_rect->left,
+                                                  src->red_shift, src->green_shift, src->blue_shift );
+                    dst_pixel += src_rect->right - src_rect->left;
+                }
+                else
+#endif
                 for(x = src_rect->left; x < src_rect->right; x++)
                 {
                     src_val = *src_pixel++;
@@ -2281,22 +2454,12 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
 
     case 24:
     {
-        BYTE *src_start = get_pixel_ptr_24(src, src_rect->left, src_rect->top), *src_pixel;
+        BYTE *src_start = get_pixel_ptr_24(src, src_rect->left, src_rect->top);
 
         for(y = src_rect->top; y < src_rect->bottom; y++)
         {
-            dst_pixel = dst_start;
-            src_pixel = src_start;
-            for(x = src_rect->left; x < src_rect->right; x++)
-            {
-                RGBQUAD rgb;
-                rgb.rgbBlue  = *src_pixel++;
-                rgb.rgbGreen = *src_pixel++;
-                rgb.rgbRed   = *src_pixel++;
-
-                *dst_pixel++ = ((rgb.rgbRed << 16) & 0xff0000) | ((rgb.rgbGreen << 8) & 0x00ff00) | (rgb.rgbBlue & 0x0000ff);
-            }
-            if(pad_size) memset(dst_pixel, 0, pad_size);
+            convert_row_24_to_8888( dst_start, src_start, src_rect->right - src_rect->left );
+            if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
             dst_start += dst->stride / 4;
             src_start += src->stride;
         }
@@ -2306,6 +2469,22 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
     case 16:
     {
         WORD *src_start = get_pixel_ptr_16(src, src_rect->left, src_rect->top), *src_pixel;
+#ifdef HAVE_SSE2_PRIMITIVES
+        if(use_sse2() && src->red_len == 5 && src->blue_len == 5 &&
+           (src->green_len == 5 || src->green_len == 6))
+        {
+            for(y = src_rect->top; y < src_rect->bottom; y++)
+            {
+                convert_row_555_565_to_8888_sse2( dst_start, src_start, src_rect->right - src_rect->left,
+                                                  src->red_shift, src->green_shift, src->blue_shift,
+                                                  src->green_len );
+                if(pad_size) memset(dst_start + (src_rect->right - src_rect->left), 0, pad_size);
+                dst_start += dst->stride / 4;
+                src_start += src->stride / 2;
+            }
+        }
+        else
+#endif
         if(src->funcs == &funcs_555)
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
@@ -4651,6 +4830,121 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+#ifdef HAVE_SSE2_PRIMITIVES
+
+/* (x + 127) / 255 for eight 16-bit values up to 255 * 255. */
+static inline SSE2_TARGET __m128i div255_epu16( __m128i x )
+{
+    x = _mm_add_epi16( x, _mm_set1_epi16( 128 ));
+    return _mm_srli_epi16( _mm_add_epi16( x, _mm_srli_epi16( x, 8 )), 8 );
+}
+
+static inline SSE2_TARGET __m128i broadcast_alpha_epi16( __m128i x )
+{
+    return _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, 0xff ), 0xff );
+}
+
+/* Packs back the (src + dst * (255 - alpha) / 255) sums of blend_argb(), which
+ * can exceed 255; like the C version, the ninth bit spills into the next component. */
+static inline SSE2_TARGET __m128i pack_argb_sums( __m128i lo, __m128i hi )
+{
+    __m128i mask = _mm_set1_epi16( 0xff );
+    __m128i val = _mm_packus_epi16( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ));
+    __m128i carry = _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ));
+    return _mm_or_si128( val, _mm_slli_epi32( carry, 8 ));
+}
+
+static inline SSE2_TARGET __m128i blend_argb_sse2( __m128i dst, __m128i src )
+{
+    __m128i zero = _mm_setzero_si128(), opaque = _mm_set1_epi16( 255 );
+    __m128i src_lo = _mm_unpacklo_epi8( src, zero ), src_hi = _mm_unpackhi_epi8( src, zero );
+    __m128i dst_lo = _mm_unpacklo_epi8( dst, zero ), dst_hi = _mm_unpackhi_epi8( dst, zero );
+
+    dst_lo = div255_epu16( _mm_mullo_epi16( dst_lo, _mm_sub_epi16( opaque, broadcast_alpha_epi16( src_lo ))));
+    dst_hi = div255_epu16( _mm_mullo_epi16( dst_hi, _mm_sub_epi16( opaque, broadcast_alpha_epi16( src_hi ))));
+    return pack_argb_sums( _mm_add_epi16( src_lo, dst_lo ), _mm_add_epi16( src_hi, dst_hi ));
+}
+
+static inline SSE2_TARGET __m128i blend_argb_alpha_sse2( __m128i dst, __m128i src, __m128i alpha )
+{
+    __m128i zero = _mm_setzero_si128(), opaque = _mm_set1_epi16( 255 );
+    __m128i src_lo = _mm_unpacklo_epi8( src, zero ), src_hi = _mm_unpackhi_epi8( src, zero );
+    __m128i dst_lo = _mm_unpacklo_epi8( dst, zero ), dst_hi = _mm_unpackhi_epi8( dst, zero );
+
+    src_lo = div255_epu16( _mm_mullo_epi16( src_lo, alpha ));
+    src_hi = div255_epu16( _mm_mullo_epi16( src_hi, alpha ));
+    dst_lo = div255_epu16( _mm_mullo_epi16( dst_lo, _mm_sub_epi16( opaque, broadcast_alpha_epi16( src_lo ))));
+    dst_hi = div255_epu16( _mm_mullo_epi16( dst_hi, _mm_sub_epi16( opaque, broadcast_alpha_epi16( src_hi ))));
+    return pack_argb_sums( _mm_add_epi16( src_lo, dst_lo ), _mm_add_epi16( src_hi, dst_hi ));
+}
+
+static inline SSE2_TARGET __m128i blend_argb_constant_alpha_sse2( __m128i dst, __m128i src, __m128i alpha )
+{
+    __m128i zero = _mm_setzero_si128(), inv_alpha = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+    __m128i lo, hi;
+
+    lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( src, zero ), alpha ),
+                        _mm_mullo_epi16( _mm_unpacklo_epi8( dst, zero ), inv_alpha ));
+    hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( src, zero ), alpha ),
+                        _mm_mullo_epi16( _mm_unpackhi_epi8( dst, zero ), inv_alpha ));
+    return _mm_packus_epi16( div255_epu16( lo ), div255_epu16( hi ));
+}
+
+static SSE2_TARGET void blend_rect_8888_sse2(const dib_info *dst, const RECT *rc,
+                                             const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
+{
+    DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
+    DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
+    __m128i alpha = _mm_set1_epi16( blend.SourceConstantAlpha );
+    __m128i alpha_mask = _mm_set1_epi32( 0xff000000 ), zero = _mm_setzero_si128();
+    int x, y, width = rc->right - rc->left;
+
+    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+    {
+        for (x = 0; x + 4 <= width; x += 4)
+        {
+            __m128i s = _mm_loadu_si128( (const __m128i *)(src_ptr + x) );
+            __m128i d = _mm_loadu_si128( (const __m128i *)(dst_ptr + x) );
+
+            if (blend.AlphaFormat & AC_SRC_ALPHA)
+            {
+                if (blend.SourceConstantAlpha == 255)
+                {
+                    /* fully transparent pixels leave the destination unchanged,
+                     * opaque ones replace it */
+                    if (_mm_movemask_epi8( _mm_cmpeq_epi32( s, zero )) == 0xffff) continue;
+                    if (_mm_movemask_epi8( _mm_cmpeq_epi32( _mm_and_si128( s, alpha_mask ),
+                                                            alpha_mask )) != 0xffff)
+                        s = blend_argb_sse2( d, s );
+                }
+                else s = blend_argb_alpha_sse2( d, s, alpha );
+            }
+            else
+            {
+                if (src->compression != BI_RGB) s = _mm_or_si128( s, alpha_mask );
+                s = blend_argb_constant_alpha_sse2( d, s, alpha );
+            }
+            _mm_storeu_si128( (__m128i *)(dst_ptr + x), s );
+        }
+        for (; x < width; x++)
+        {
+            if (blend.AlphaFormat & AC_SRC_ALPHA)
+            {
+                if (blend.SourceConstantAlpha == 255)
+                    dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+                else
+                    dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+            }
+            else if (src->compression == BI_RGB)
+                dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+            else
+                dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        }
+    }
+}
+
+#endif
+
 static void blend_rect_8888(const dib_info *dst, const RECT *rc,
                             const dib_info *src, const POINT *origin, BLENDFUNCTION blend)
 {
@@ -4658,6 +4952,14 @@ static void blend_rect_8888(const dib_info *dst, const RECT *rc,
     DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
     int x, y;
 
+#ifdef HAVE_SSE2_PRIMITIVES
+    if (use_sse2())
+    {
+        blend_rect_8888_sse2( dst, rc, src, origin, blend );
+        return;
+    }
+#endif
+
     if (blend.AlphaFormat & AC_SRC_ALPHA)
     {
 	if (blend.SourceConstantAlpha == 255)
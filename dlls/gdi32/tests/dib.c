@@ -3516,11 +3516,141 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static HBITMAP create_perf_dib( HDC hdc, int bpp, DWORD compression, const DWORD *masks, void **bits )
+{
+    char bmibuf[sizeof(BITMAPINFO) + 3 * sizeof(DWORD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    HBITMAP dib;
+
+    memset( bmi, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = 1024;
+    bmi->bmiHeader.biHeight = -768;
+    bmi->bmiHeader.biBitCount = bpp;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biCompression = compression;
+    if (masks) memcpy( bmi->bmiColors, masks, 3 * sizeof(DWORD) );
+
+    dib = CreateDIBSection( hdc, bmi, DIB_RGB_COLORS, bits, NULL, 0 );
+    ok( dib != NULL, "failed to create %u bpp dib\n", bpp );
+    return dib;
+}
+
+static void start_primitive_timer( LARGE_INTEGER *start )
+{
+    if (winetest_benchmark) QueryPerformanceCounter( start );
+}
+
+static void trace_primitive_rate( const char *name, const LARGE_INTEGER *start, const LARGE_INTEGER *freq,
+                                  unsigned int count )
+{
+    LARGE_INTEGER end;
+    double secs;
+
+    if (!winetest_benchmark) return;
+    QueryPerformanceCounter( &end );
+    secs = (double)(end.QuadPart - start->QuadPart) / freq->QuadPart;
+    if (secs > 0) trace( "%s: %.1f Mpixels/s\n", name, count * 1024.0 * 768.0 / secs / 1e6 );
+}
+
+/* the primitives are only timed with WINETEST_BENCHMARK set */
+static void test_large_primitives(void)
+{
+    static const DWORD masks_565[3] = {0xf800, 0x07e0, 0x001f};
+    BLENDFUNCTION blend = {AC_SRC_OVER, 0, 255, AC_SRC_ALPHA};
+    HBITMAP dst_dib, argb_dib, rgb24_dib, rgb565_dib;
+    HDC dst_dc, src_dc;
+    DWORD *dst_bits, *argb_bits, white;
+    BYTE *rgb24_bits;
+    WORD *rgb565_bits;
+    LARGE_INTEGER freq, start;
+    unsigned int i, count = winetest_benchmark ? 100 : 1;
+    HBRUSH brush;
+
+    if (winetest_benchmark) QueryPerformanceFrequency( &freq );
+    dst_dc = CreateCompatibleDC( NULL );
+    src_dc = CreateCompatibleDC( NULL );
+
+    dst_dib = create_perf_dib( dst_dc, 32, BI_RGB, NULL, (void **)&dst_bits );
+    argb_dib = create_perf_dib( dst_dc, 32, BI_RGB, NULL, (void **)&argb_bits );
+    rgb24_dib = create_perf_dib( dst_dc, 24, BI_RGB, NULL, (void **)&rgb24_bits );
+    rgb565_dib = create_perf_dib( dst_dc, 16, BI_BITFIELDS, masks_565, (void **)&rgb565_bits );
+    if (!dst_dib || !argb_dib || !rgb24_dib || !rgb565_dib) goto done;
+
+    for (i = 0; i < 1024 * 768; i++)
+    {
+        argb_bits[i] = (i & 3) ? 0x80402010 : (i & 4) ? 0 : 0xff112233;
+        rgb24_bits[3 * i] = 0x10;
+        rgb24_bits[3 * i + 1] = 0x20;
+        rgb24_bits[3 * i + 2] = 0x30;
+        rgb565_bits[i] = 0xffff;
+    }
+    SelectObject( dst_dc, dst_dib );
+
+    brush = CreateSolidBrush( RGB(0x10, 0x20, 0x30) );
+    SelectObject( dst_dc, brush );
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) PatBlt( dst_dc, 0, 0, 1024, 768, PATCOPY );
+    trace_primitive_rate( "solid_rects_32 (PATCOPY)", &start, &freq, count );
+    ok( dst_bits[0] == 0x102030, "got %08x\n", dst_bits[0] );
+    start_primitive_timer( &start );
+    for (i = 0; i < count * 2; i++) PatBlt( dst_dc, 0, 0, 1024, 768, PATINVERT );
+    trace_primitive_rate( "solid_rects_32 (PATINVERT)", &start, &freq, count * 2 );
+    ok( dst_bits[1023] == 0x102030, "got %08x\n", dst_bits[1023] );
+    SelectObject( dst_dc, GetStockObject( WHITE_BRUSH ) );
+    DeleteObject( brush );
+
+    SelectObject( src_dc, argb_dib );
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) BitBlt( dst_dc, 0, 0, 1024, 768, src_dc, 0, 0, SRCCOPY );
+    trace_primitive_rate( "copy_rect_32", &start, &freq, count );
+    ok( dst_bits[1] == 0x80402010, "got %08x\n", dst_bits[1] );
+
+    PatBlt( dst_dc, 0, 0, 1024, 768, WHITENESS );
+    white = dst_bits[4];
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) GdiAlphaBlend( dst_dc, 0, 0, 1024, 768, src_dc, 0, 0, 1024, 768, blend );
+    trace_primitive_rate( "blend_rect_8888 (per-pixel alpha)", &start, &freq, count );
+    ok( dst_bits[0] == 0xff112233, "got %08x\n", dst_bits[0] );
+    ok( dst_bits[4] == white, "got %08x, expected %08x\n", dst_bits[4], white );
+
+    blend.SourceConstantAlpha = 0x80;
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) GdiAlphaBlend( dst_dc, 0, 0, 1024, 768, src_dc, 0, 0, 1024, 768, blend );
+    trace_primitive_rate( "blend_rect_8888 (constant and per-pixel alpha)", &start, &freq, count );
+
+    blend.AlphaFormat = 0;
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) GdiAlphaBlend( dst_dc, 0, 0, 1024, 768, src_dc, 0, 0, 1024, 768, blend );
+    trace_primitive_rate( "blend_rect_8888 (constant alpha)", &start, &freq, count );
+
+    SelectObject( src_dc, rgb24_dib );
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) BitBlt( dst_dc, 0, 0, 1024, 768, src_dc, 0, 0, SRCCOPY );
+    trace_primitive_rate( "convert_to_8888 (24 bpp)", &start, &freq, count );
+    ok( dst_bits[5] == 0x302010, "got %08x\n", dst_bits[5] );
+
+    SelectObject( src_dc, rgb565_dib );
+    start_primitive_timer( &start );
+    for (i = 0; i < count; i++) BitBlt( dst_dc, 0, 0, 1024, 768, src_dc, 0, 0, SRCCOPY );
+    trace_primitive_rate( "convert_to_8888 (16 bpp)", &start, &freq, count );
+    ok( dst_bits[5] == 0xffffff, "got %08x\n", dst_bits[5] );
+
+done:
+    DeleteDC( src_dc );
+    DeleteDC( dst_dc );
+    if (dst_dib) DeleteObject( dst_dib );
+    if (argb_dib) DeleteObject( argb_dib );
+    if (rgb24_dib) DeleteObject( rgb24_dib );
+    if (rgb565_dib) DeleteObject( rgb565_dib );
+}
+
 START_TEST(dib)
 {
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
     test_simple_graphics();
+    test_large_primitives();
 
     CryptReleaseContext(crypt_prov, 0);
 }
@@ -94,6 +94,9 @@ static void dump_instr_arg(instr_arg_type_t type, instr_arg_t *arg)
     case ARG_BSTR:
         TRACE_(jscript_disas)("\t%s", debugstr_wn(arg->bstr, SysStringLen(arg->bstr)));
         break;
+    case ARG_CACHE:
+        TRACE_(jscript_disas)("\t%s", debugstr_wn(arg->cache->name, SysStringLen(arg->cache->name)));
+        break;
     case ARG_INT:
         TRACE_(jscript_disas)("\t%d", arg->uint);
         break;
@@ -295,8 +298,9 @@ static HRESULT push_instr_bstr(compiler_ctx_t *ctx, jsop_t op, const WCHAR *arg)
     return S_OK;
 }
 
-static HRESULT push_instr_bstr_uint(compiler_ctx_t *ctx, jsop_t op, const WCHAR *arg1, unsigned arg2)
+static HRESULT push_instr_cache_uint(compiler_ctx_t *ctx, jsop_t op, const WCHAR *arg1, unsigned arg2)
 {
+    prop_cache_t *cache;
     unsigned instr;
     WCHAR *str;
 
@@ -304,11 +308,16 @@ static HRESULT push_instr_bstr_uint(compiler_ctx_t *ctx, jsop_t op, const WCHAR
     if(!str)
         return E_OUTOFMEMORY;
 
+    cache = compiler_alloc(ctx->code, sizeof(*cache));
+    if(!cache)
+        return E_OUTOFMEMORY;
+    init_prop_cache(cache, str);
+
     instr = push_instr(ctx, op);
     if(!instr)
         return E_OUTOFMEMORY;
 
-    instr_ptr(ctx, instr)->u.arg[0].bstr = str;
+    instr_ptr(ctx, instr)->u.arg[0].cache = cache;
     instr_ptr(ctx, instr)->u.arg[1].uint = arg2;
     return S_OK;
 }
@@ -395,7 +404,7 @@ static HRESULT compile_member_expression(compiler_ctx_t *ctx, member_expression_
     if(FAILED(hres))
         return hres;
 
-    return push_instr_bstr(ctx, OP_member, expr->identifier);
+    return push_instr_cache_uint(ctx, OP_member, expr->identifier, 0);
 }
 
 #define LABEL_FLAG 0x80000000
@@ -455,7 +464,7 @@ static HRESULT emit_identifier_ref(compiler_ctx_t *ctx, const WCHAR *identifier,
     int local_ref;
     if(bind_local(ctx, identifier, &local_ref))
         return push_instr_int(ctx, OP_local_ref, local_ref);
-    return push_instr_bstr_uint(ctx, OP_identid, identifier, flags);
+    return push_instr_cache_uint(ctx, OP_identid, identifier, flags);
 }
 
 static HRESULT emit_identifier(compiler_ctx_t *ctx, const WCHAR *identifier)
@@ -463,7 +472,7 @@ static HRESULT emit_identifier(compiler_ctx_t *ctx, const WCHAR *identifier)
     int local_ref;
     if(bind_local(ctx, identifier, &local_ref))
         return push_instr_int(ctx, OP_local, local_ref);
-    return push_instr_bstr(ctx, OP_ident, identifier);
+    return push_instr_cache_uint(ctx, OP_ident, identifier, 0);
 }
 
 static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *expr, unsigned flags)
@@ -493,22 +502,12 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
     }
     case EXPR_MEMBER: {
         member_expression_t *member_expr = (member_expression_t*)expr;
-        jsstr_t *jsstr;
 
         hres = compile_expression(ctx, member_expr->expression, TRUE);
         if(FAILED(hres))
             return hres;
 
-        /* FIXME: Potential optimization */
-        jsstr = compiler_alloc_string(ctx, member_expr->identifier);
-        if(!jsstr)
-            return E_OUTOFMEMORY;
-
-        hres = push_instr_str(ctx, OP_str, jsstr);
-        if(FAILED(hres))
-            return hres;
-
-        hres = push_instr_uint(ctx, OP_memberid, flags);
+        hres = push_instr_cache_uint(ctx, OP_member_ref, member_expr->identifier, flags);
         break;
     }
     DEFAULT_UNREACHABLE;
@@ -1895,6 +1895,44 @@ HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *
     return DISP_E_UNKNOWNNAME;
 }
 
+void init_prop_cache(prop_cache_t *cache, BSTR name)
+{
+    cache->name = name;
+    cache->hash = string_hash(name);
+    cache->id = 0;
+}
+
+HRESULT jsdisp_get_id_cached(jsdisp_t *jsdisp, prop_cache_t *cache, DWORD flags, DISPID *id)
+{
+    dispex_prop_t *prop;
+    HRESULT hres;
+
+    if(cache->id > 0 && cache->id < jsdisp->prop_cnt) {
+        prop = jsdisp->props + cache->id;
+        if(prop->hash == cache->hash && prop->type != PROP_DELETED && !wcscmp(prop->name, cache->name)) {
+            *id = cache->id;
+            return S_OK;
+        }
+    }
+
+    if(flags & fdexNameEnsure)
+        hres = ensure_prop_name(jsdisp, cache->name, PROPF_ENUMERABLE | PROPF_CONFIGURABLE | PROPF_WRITABLE,
+                                &prop);
+    else
+        hres = find_prop_name_prot(jsdisp, cache->hash, cache->name, &prop);
+    if(FAILED(hres))
+        return hres;
+
+    if(prop && prop->type!=PROP_DELETED) {
+        *id = cache->id = prop_to_id(jsdisp, prop);
+        return S_OK;
+    }
+
+    TRACE("not found %s\n", debugstr_w(cache->name));
+    *id = DISPID_UNKNOWN;
+    return DISP_E_UNKNOWNNAME;
+}
+
 HRESULT jsdisp_call_value(jsdisp_t *jsfunc, IDispatch *jsthis, WORD flags, unsigned argc, jsval_t *argv, jsval_t *r)
 {
     HRESULT hres;
@@ -467,6 +467,20 @@ static HRESULT disp_get_id(script_ctx_t *ctx, IDispatch *disp, const WCHAR *name
     return hres;
 }
 
+static HRESULT disp_get_id_cached(script_ctx_t *ctx, IDispatch *disp, prop_cache_t *cache, DWORD flags, DISPID *id)
+{
+    jsdisp_t *jsdisp;
+    HRESULT hres;
+
+    jsdisp = iface_to_jsdisp(disp);
+    if(!jsdisp)
+        return disp_get_id(ctx, disp, cache->name, cache->name, flags, id);
+
+    hres = jsdisp_get_id_cached(jsdisp, cache, flags, id);
+    jsdisp_release(jsdisp);
+    return hres;
+}
+
 static HRESULT disp_cmp(IDispatch *disp1, IDispatch *disp2, BOOL *ret)
 {
     IObjectIdentity *identity;
@@ -630,8 +644,13 @@ local_ref_t *lookup_local(const function_code_t *function, const WCHAR *identifi
     return bsearch(identifier, function->locals, function->locals_cnt, sizeof(*function->locals), local_ref_cmp);
 }
 
+static inline HRESULT scope_get_id(jsdisp_t *jsdisp, BSTR identifier, prop_cache_t *cache, DWORD flags, DISPID *id)
+{
+    return cache ? jsdisp_get_id_cached(jsdisp, cache, flags, id) : jsdisp_get_id(jsdisp, identifier, flags, id);
+}
+
 /* ECMA-262 3rd Edition    10.1.4 */
-static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *ret)
+static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, prop_cache_t *cache, exprval_t *ret)
 {
     scope_chain_t *scope;
     named_item_t *item;
@@ -661,7 +680,7 @@ static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *re
                 }
             }
             if(scope->jsobj)
-                hres = jsdisp_get_id(scope->jsobj, identifier, fdexNameImplicit, &id);
+                hres = scope_get_id(scope->jsobj, identifier, cache, fdexNameImplicit, &id);
             else
                 hres = disp_get_id(ctx, scope->obj, identifier, identifier, fdexNameImplicit, &id);
             if(SUCCEEDED(hres)) {
@@ -672,7 +691,7 @@ static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *re
 
         item = ctx->call_ctx->bytecode->named_item;
         if(item) {
-            hres = jsdisp_get_id(item->script_obj, identifier, 0, &id);
+            hres = scope_get_id(item->script_obj, identifier, cache, 0, &id);
             if(SUCCEEDED(hres)) {
                 exprval_set_disp_ref(ret, to_disp(item->script_obj), id);
                 return S_OK;
@@ -687,7 +706,7 @@ static HRESULT identifier_eval(script_ctx_t *ctx, BSTR identifier, exprval_t *re
         }
     }
 
-    hres = jsdisp_get_id(ctx->global, identifier, 0, &id);
+    hres = scope_get_id(ctx->global, identifier, cache, 0, &id);
     if(SUCCEEDED(hres)) {
         exprval_set_disp_ref(ret, to_disp(ctx->global), id);
         return S_OK;
@@ -714,6 +733,12 @@ static inline BSTR get_op_bstr(script_ctx_t *ctx, int i)
     return frame->bytecode->instrs[frame->ip].u.arg[i].bstr;
 }
 
+static inline prop_cache_t *get_op_cache(script_ctx_t *ctx, int i)
+{
+    call_frame_t *frame = ctx->call_ctx;
+    return frame->bytecode->instrs[frame->ip].u.arg[i].cache;
+}
+
 static inline unsigned get_op_uint(script_ctx_t *ctx, int i)
 {
     call_frame_t *frame = ctx->call_ctx;
@@ -1094,7 +1119,7 @@ static HRESULT interp_array(script_ctx_t *ctx)
 /* ECMA-262 3rd Edition    11.2.1 */
 static HRESULT interp_member(script_ctx_t *ctx)
 {
-    const BSTR arg = get_op_bstr(ctx, 0);
+    prop_cache_t *cache = get_op_cache(ctx, 0);
     IDispatch *obj;
     jsval_t v;
     DISPID id;
@@ -1106,7 +1131,7 @@ static HRESULT interp_member(script_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    hres = disp_get_id(ctx, obj, arg, arg, 0, &id);
+    hres = disp_get_id_cached(ctx, obj, cache, 0, &id);
     if(SUCCEEDED(hres)) {
         hres = disp_propget(ctx, obj, id, &v);
     }else if(hres == DISP_E_UNKNOWNNAME) {
@@ -1120,6 +1145,28 @@ static HRESULT interp_member(script_ctx_t *ctx)
     return stack_push(ctx, v);
 }
 
+/* Pushes the reference to a member, takes ownership of obj. */
+static HRESULT push_member_ref(script_ctx_t *ctx, IDispatch *obj, DISPID id, unsigned flags, HRESULT hres)
+{
+    exprval_t ref;
+
+    if(SUCCEEDED(hres)) {
+        ref.type = EXPRVAL_IDREF;
+        ref.u.idref.disp = obj;
+        ref.u.idref.id = id;
+    }else {
+        IDispatch_Release(obj);
+        if(hres == DISP_E_UNKNOWNNAME && !(flags & fdexNameEnsure)) {
+            exprval_set_exception(&ref, JS_E_INVALID_PROPERTY);
+        }else {
+            ERR("failed %08x\n", hres);
+            return hres;
+        }
+    }
+
+    return stack_push_exprval(ctx, &ref);
+}
+
 /* ECMA-262 3rd Edition    11.2.1 */
 static HRESULT interp_memberid(script_ctx_t *ctx)
 {
@@ -1128,7 +1175,6 @@ static HRESULT interp_memberid(script_ctx_t *ctx)
     const WCHAR *name;
     jsstr_t *name_str;
     IDispatch *obj;
-    exprval_t ref;
     DISPID id;
     HRESULT hres;
 
@@ -1150,22 +1196,29 @@ static HRESULT interp_memberid(script_ctx_t *ctx)
 
     hres = disp_get_id(ctx, obj, name, NULL, arg, &id);
     jsstr_release(name_str);
-    if(SUCCEEDED(hres)) {
-        ref.type = EXPRVAL_IDREF;
-        ref.u.idref.disp = obj;
-        ref.u.idref.id = id;
-    }else {
-        IDispatch_Release(obj);
-        if(hres == DISP_E_UNKNOWNNAME && !(arg & fdexNameEnsure)) {
-            exprval_set_exception(&ref, JS_E_INVALID_PROPERTY);
-            hres = S_OK;
-        }else {
-            ERR("failed %08x\n", hres);
-            return hres;
-        }
-    }
+    return push_member_ref(ctx, obj, id, arg, hres);
+}
 
-    return stack_push_exprval(ctx, &ref);
+/* ECMA-262 3rd Edition    11.2.1 */
+static HRESULT interp_member_ref(script_ctx_t *ctx)
+{
+    prop_cache_t *cache = get_op_cache(ctx, 0);
+    const unsigned arg = get_op_uint(ctx, 1);
+    IDispatch *obj;
+    jsval_t objv;
+    DISPID id;
+    HRESULT hres;
+
+    TRACE("%s %x\n", debugstr_w(cache->name), arg);
+
+    objv = stack_pop(ctx);
+    hres = to_object(ctx, objv, &obj);
+    jsval_release(objv);
+    if(FAILED(hres))
+        return hres;
+
+    hres = disp_get_id_cached(ctx, obj, cache, arg, &id);
+    return push_member_ref(ctx, obj, id, arg, hres);
 }
 
 /* ECMA-262 3rd Edition    11.2.1 */
@@ -1266,12 +1319,12 @@ static HRESULT interp_this(script_ctx_t *ctx)
     return stack_push(ctx, jsval_disp(this_obj));
 }
 
-static HRESULT interp_identifier_ref(script_ctx_t *ctx, BSTR identifier, unsigned flags)
+static HRESULT interp_identifier_ref(script_ctx_t *ctx, BSTR identifier, prop_cache_t *cache, unsigned flags)
 {
     exprval_t exprval;
     HRESULT hres;
 
-    hres = identifier_eval(ctx, identifier, &exprval);
+    hres = identifier_eval(ctx, identifier, cache, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -1298,13 +1351,13 @@ static HRESULT interp_identifier_ref(script_ctx_t *ctx, BSTR identifier, unsigne
     return stack_push_exprval(ctx, &exprval);
 }
 
-static HRESULT identifier_value(script_ctx_t *ctx, BSTR identifier)
+static HRESULT identifier_value(script_ctx_t *ctx, BSTR identifier, prop_cache_t *cache)
 {
     exprval_t exprval;
     jsval_t v;
     HRESULT hres;
 
-    hres = identifier_eval(ctx, identifier, &exprval);
+    hres = identifier_eval(ctx, identifier, cache, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -1328,7 +1381,7 @@ static HRESULT interp_local_ref(script_ctx_t *ctx)
     TRACE("%d\n", arg);
 
     if(!frame->base_scope || !frame->base_scope->frame)
-        return interp_identifier_ref(ctx, local_name(frame, arg), flags);
+        return interp_identifier_ref(ctx, local_name(frame, arg), NULL, flags);
 
     ref.type = EXPRVAL_STACK_REF;
     ref.u.off = local_off(frame, arg);
@@ -1345,7 +1398,7 @@ static HRESULT interp_local(script_ctx_t *ctx)
     TRACE("%d: %s\n", arg, debugstr_w(local_name(frame, arg)));
 
     if(!frame->base_scope || !frame->base_scope->frame)
-        return identifier_value(ctx, local_name(frame, arg));
+        return identifier_value(ctx, local_name(frame, arg), NULL);
 
     hres = jsval_copy(ctx->stack[local_off(frame, arg)], &copy);
     if(FAILED(hres))
@@ -1357,22 +1410,22 @@ static HRESULT interp_local(script_ctx_t *ctx)
 /* ECMA-262 3rd Edition    10.1.4 */
 static HRESULT interp_ident(script_ctx_t *ctx)
 {
-    const BSTR arg = get_op_bstr(ctx, 0);
+    prop_cache_t *cache = get_op_cache(ctx, 0);
 
-    TRACE("%s\n", debugstr_w(arg));
+    TRACE("%s\n", debugstr_w(cache->name));
 
-    return identifier_value(ctx, arg);
+    return identifier_value(ctx, cache->name, cache);
 }
 
 /* ECMA-262 3rd Edition    10.1.4 */
 static HRESULT interp_identid(script_ctx_t *ctx)
 {
-    const BSTR arg = get_op_bstr(ctx, 0);
+    prop_cache_t *cache = get_op_cache(ctx, 0);
     const unsigned flags = get_op_uint(ctx, 1);
 
-    TRACE("%s %x\n", debugstr_w(arg), flags);
+    TRACE("%s %x\n", debugstr_w(cache->name), flags);
 
-    return interp_identifier_ref(ctx, arg, flags);
+    return interp_identifier_ref(ctx, cache->name, cache, flags);
 }
 
 /* ECMA-262 3rd Edition    7.8.1 */
@@ -1928,7 +1981,7 @@ static HRESULT interp_delete_ident(script_ctx_t *ctx)
 
     TRACE("%s\n", debugstr_w(arg));
 
-    hres = identifier_eval(ctx, arg, &exprval);
+    hres = identifier_eval(ctx, arg, NULL, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -2039,7 +2092,7 @@ static HRESULT interp_typeofident(script_ctx_t *ctx)
 
     TRACE("%s\n", debugstr_w(arg));
 
-    hres = identifier_eval(ctx, arg, &exprval);
+    hres = identifier_eval(ctx, arg, NULL, &exprval);
     if(FAILED(hres))
         return hres;
 
@@ -2904,7 +2957,7 @@ static HRESULT bind_event_target(script_ctx_t *ctx, function_code_t *func, jsdis
     jsval_t v;
     HRESULT hres;
 
-    hres = identifier_eval(ctx, func->event_target, &exprval);
+    hres = identifier_eval(ctx, func->event_target, NULL, &exprval);
     if(FAILED(hres))
         return hres;
 
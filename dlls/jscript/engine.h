@@ -43,8 +43,8 @@
     X(func,       1, ARG_UINT,   0)        \
     X(gt,         1, 0,0)                  \
     X(gteq,       1, 0,0)                  \
-    X(ident,      1, ARG_BSTR,   0)        \
-    X(identid,    1, ARG_BSTR,   ARG_INT)  \
+    X(ident,      1, ARG_CACHE,  0)        \
+    X(identid,    1, ARG_CACHE,  ARG_INT)  \
     X(in,         1, 0,0)                  \
     X(instanceof, 1, 0,0)                  \
     X(int,        1, ARG_INT,    0)        \
@@ -55,7 +55,8 @@
     X(lshift,     1, 0,0)                  \
     X(lt,         1, 0,0)                  \
     X(lteq,       1, 0,0)                  \
-    X(member,     1, ARG_BSTR,   0)        \
+    X(member,     1, ARG_CACHE,  0)        \
+    X(member_ref, 1, ARG_CACHE,  ARG_UINT) \
     X(memberid,   1, ARG_UINT,   0)        \
     X(minus,      1, 0,0)                  \
     X(mod,        1, 0,0)                  \
@@ -110,12 +111,14 @@ typedef union {
     LONG lng;
     jsstr_t *str;
     unsigned uint;
+    prop_cache_t *cache;
 } instr_arg_t;
 
 typedef enum {
     ARG_NONE = 0,
     ARG_ADDR,
     ARG_BSTR,
+    ARG_CACHE,
     ARG_DBL,
     ARG_FUNC,
     ARG_INT,
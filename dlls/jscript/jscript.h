@@ -253,6 +253,17 @@ struct jsdisp_t {
     const builtin_info_t *builtin_info;
 };
 
+/*
+ * Per-instruction cache of a property lookup. The cached DISPID is only used
+ * if the property at that position has the expected name, so it may be shared
+ * by all objects with the same property layout.
+ */
+typedef struct {
+    BSTR name;
+    unsigned hash;
+    DISPID id;
+} prop_cache_t;
+
 static inline IDispatch *to_disp(jsdisp_t *jsdisp)
 {
     return (IDispatch*)&jsdisp->IDispatchEx_iface;
@@ -307,6 +318,8 @@ HRESULT jsdisp_propput_idx(jsdisp_t*,DWORD,jsval_t) DECLSPEC_HIDDEN;
 HRESULT jsdisp_propget_name(jsdisp_t*,LPCWSTR,jsval_t*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_get_idx(jsdisp_t*,DWORD,jsval_t*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_get_id(jsdisp_t*,const WCHAR*,DWORD,DISPID*) DECLSPEC_HIDDEN;
+HRESULT jsdisp_get_id_cached(jsdisp_t*,prop_cache_t*,DWORD,DISPID*) DECLSPEC_HIDDEN;
+void init_prop_cache(prop_cache_t*,BSTR) DECLSPEC_HIDDEN;
 HRESULT disp_delete(IDispatch*,DISPID,BOOL*) DECLSPEC_HIDDEN;
 HRESULT disp_delete_name(script_ctx_t*,IDispatch*,jsstr_t*,BOOL*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_delete_idx(jsdisp_t*,DWORD) DECLSPEC_HIDDEN;
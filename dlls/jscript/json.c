@@ -447,10 +447,21 @@ static HRESULT maybe_to_primitive(script_ctx_t *ctx, jsval_t val, jsval_t *r)
 /* ECMA-262 5.1 Edition    15.12.3 (abstract operation Quote) */
 static HRESULT json_quote(stringify_ctx_t *ctx, const WCHAR *ptr, size_t len)
 {
+    const WCHAR *run;
+
     if(!ptr || !append_char(ctx, '"'))
         return E_OUTOFMEMORY;
 
-    while(len--) {
+    while(len) {
+        /* Copy characters that don't need escaping in one go. */
+        for(run = ptr; len && *ptr >= ' ' && *ptr != '"' && *ptr != '\\'; ptr++)
+            len--;
+        if(ptr != run && !append_string_len(ctx, run, ptr - run))
+            return E_OUTOFMEMORY;
+        if(!len)
+            break;
+        len--;
+
         switch(*ptr) {
         case '"':
         case '\\':
@@ -477,17 +488,13 @@ static HRESULT json_quote(stringify_ctx_t *ctx, const WCHAR *ptr, size_t len)
             if(!append_simple_quote(ctx, 't'))
                 return E_OUTOFMEMORY;
             break;
-        default:
-            if(*ptr < ' ') {
-                static const WCHAR formatW[] = {'\\','u','%','0','4','x',0};
-                WCHAR buf[7];
-                swprintf(buf, ARRAY_SIZE(buf), formatW, *ptr);
-                if(!append_string(ctx, buf))
-                    return E_OUTOFMEMORY;
-            }else {
-                if(!append_char(ctx, *ptr))
-                    return E_OUTOFMEMORY;
-            }
+        default: {
+            static const WCHAR formatW[] = {'\\','u','%','0','4','x',0};
+            WCHAR buf[7];
+            swprintf(buf, ARRAY_SIZE(buf), formatW, *ptr);
+            if(!append_string(ctx, buf))
+                return E_OUTOFMEMORY;
+        }
         }
         ptr++;
     }
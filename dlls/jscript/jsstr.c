@@ -30,34 +30,91 @@
 #define JSSTR_SHORT_STRING_LENGTH 8
 
 /*
- * This is the max rope depth. While faster to allocate, ropes may become slow at access.
+ * This is the max rope depth we are willing to walk on character access. Concatenation
+ * itself never flattens, so a loop appending to a string stays linear; a deeper rope is
+ * flattened the first time its characters are needed.
  */
 #define JSSTR_MAX_ROPE_DEPTH 100
 
 const char *debugstr_jsstr(jsstr_t *str)
 {
+    BOOL rope = FALSE;
+
+    while(jsstr_is_rope(str)) {
+        str = jsstr_as_rope(str)->left;
+        rope = TRUE;
+    }
+
+    if(rope)
+        return wine_dbg_sprintf("%s...", debugstr_jsstr(str));
     return jsstr_is_inline(str) ? debugstr_wn(jsstr_as_inline(str)->buf, jsstr_length(str))
-        : jsstr_is_heap(str) ? debugstr_wn(jsstr_as_heap(str)->buf, jsstr_length(str))
-        : wine_dbg_sprintf("%s...", debugstr_jsstr(jsstr_as_rope(str)->left));
+        : debugstr_wn(jsstr_as_heap(str)->buf, jsstr_length(str));
 }
 
-void jsstr_free(jsstr_t *str)
+/* Releases a child of a rope being freed, returns it if it's a rope that needs to be freed as well. */
+static jsstr_rope_t *release_rope_child(jsstr_t *str)
 {
+    if(--str->ref)
+        return NULL;
+
     switch(jsstr_tag(str)) {
     case JSSTR_HEAP:
         heap_free(jsstr_as_heap(str)->buf);
-        break;
-    case JSSTR_ROPE: {
-        jsstr_rope_t *rope = jsstr_as_rope(str);
-        jsstr_release(rope->left);
-        jsstr_release(rope->right);
+        /* fall through */
+    case JSSTR_INLINE:
+        heap_free(str);
+        return NULL;
+    case JSSTR_ROPE:
         break;
     }
+
+    return jsstr_as_rope(str);
+}
+
+void jsstr_free(jsstr_t *str)
+{
+    jsstr_rope_t *rope, *left, *right, *stack = NULL;
+
+    switch(jsstr_tag(str)) {
+    case JSSTR_HEAP:
+        heap_free(jsstr_as_heap(str)->buf);
+        /* fall through */
     case JSSTR_INLINE:
+        heap_free(str);
+        return;
+    case JSSTR_ROPE:
         break;
     }
 
-    heap_free(str);
+    /*
+     * Ropes built by appending in a loop may be arbitrarily deep, so free them without recursion.
+     * A rope with two children to free is reused as a stack entry holding the pending one.
+     */
+    rope = jsstr_as_rope(str);
+    while(rope) {
+        left = release_rope_child(rope->left);
+        right = release_rope_child(rope->right);
+
+        if(left && right) {
+            rope->left = &left->str;
+            rope->right = stack ? &stack->str : NULL;
+            stack = rope;
+            rope = right;
+            continue;
+        }
+
+        heap_free(rope);
+        if(left || right) {
+            rope = left ? left : right;
+        }else if(stack) {
+            rope = jsstr_as_rope(stack->left);
+            left = stack;
+            stack = stack->right ? jsstr_as_rope(stack->right) : NULL;
+            heap_free(left);
+        }else {
+            rope = NULL;
+        }
+    }
 }
 
 static inline void jsstr_init(jsstr_t *str, unsigned len, jsstr_tag_t tag)
@@ -95,23 +152,63 @@ jsstr_t *jsstr_alloc_len(const WCHAR *buf, unsigned len)
     return ret;
 }
 
+static inline BOOL jsstr_is_deep_rope(jsstr_t *str)
+{
+    return jsstr_is_rope(str) && jsstr_as_rope(str)->depth > JSSTR_MAX_ROPE_DEPTH;
+}
+
+/*
+ * Copies a range of the rope. We recurse only into the shorter part of the range and
+ * loop on the longer one, so the recursion depth is logarithmic in the string length.
+ */
 static void jsstr_rope_extract(jsstr_rope_t *str, unsigned off, unsigned len, WCHAR *buf)
 {
-    unsigned left_len = jsstr_length(str->left);
-
-    if(left_len <= off) {
-        jsstr_extract(str->right, off-left_len, len, buf);
-    }else if(left_len >= len+off) {
-        jsstr_extract(str->left, off, len, buf);
-    }else {
-        left_len -= off;
-        jsstr_extract(str->left, off, left_len, buf);
-        jsstr_extract(str->right, 0, len-left_len, buf+left_len);
+    unsigned left_len;
+    jsstr_t *next;
+
+    for(;;) {
+        left_len = jsstr_length(str->left);
+
+        if(left_len <= off) {
+            next = str->right;
+            off -= left_len;
+        }else if(left_len >= len+off) {
+            next = str->left;
+        }else {
+            left_len -= off;
+            if(left_len < len-left_len) {
+                jsstr_extract(str->left, off, left_len, buf);
+                next = str->right;
+                off = 0;
+                len -= left_len;
+                buf += left_len;
+            }else {
+                jsstr_extract(str->right, 0, len-left_len, buf+left_len);
+                next = str->left;
+                len = left_len;
+            }
+        }
+
+        switch(jsstr_tag(next)) {
+        case JSSTR_INLINE:
+            memcpy(buf, jsstr_as_inline(next)->buf+off, len*sizeof(WCHAR));
+            return;
+        case JSSTR_HEAP:
+            memcpy(buf, jsstr_as_heap(next)->buf+off, len*sizeof(WCHAR));
+            return;
+        case JSSTR_ROPE:
+            str = jsstr_as_rope(next);
+            break;
+        }
     }
 }
 
 void jsstr_extract(jsstr_t *str, unsigned off, unsigned len, WCHAR *buf)
 {
+    /* Walking a deep rope for each access would be slow, flatten it once instead. */
+    if(jsstr_is_deep_rope(str) && len < jsstr_length(str))
+        jsstr_rope_flatten(jsstr_as_rope(str));
+
     switch(jsstr_tag(str)) {
     case JSSTR_INLINE:
         memcpy(buf, jsstr_as_inline(str)->buf+off, len*sizeof(WCHAR));
@@ -152,11 +249,11 @@ static int jsstr_cmp_str(jsstr_t *jsstr, const WCHAR *str, unsigned len)
 
 #define TMP_BUF_SIZE 256
 
-static int ropes_cmp(jsstr_rope_t *left, jsstr_rope_t *right)
+static int ropes_cmp(jsstr_t *left, jsstr_t *right)
 {
     WCHAR left_buf[TMP_BUF_SIZE], right_buf[TMP_BUF_SIZE];
-    unsigned left_len = jsstr_length(&left->str);
-    unsigned right_len = jsstr_length(&right->str);
+    unsigned left_len = jsstr_length(left);
+    unsigned right_len = jsstr_length(right);
     unsigned cmp_off = 0, cmp_size;
     int ret;
 
@@ -166,8 +263,8 @@ static int ropes_cmp(jsstr_rope_t *left, jsstr_rope_t *right)
         if(cmp_size > TMP_BUF_SIZE)
             cmp_size = TMP_BUF_SIZE;
 
-        jsstr_rope_extract(left, cmp_off, cmp_size, left_buf);
-        jsstr_rope_extract(right, cmp_off, cmp_size, right_buf);
+        jsstr_extract(left, cmp_off, cmp_size, left_buf);
+        jsstr_extract(right, cmp_off, cmp_size, right_buf);
         ret = memcmp(left_buf, right_buf, cmp_size);
         if(ret)
             return ret;
@@ -192,6 +289,14 @@ int jsstr_cmp(jsstr_t *str1, jsstr_t *str2)
     const WCHAR *str;
     int ret;
 
+    /* jsstr_cmp_str walks ropes recursively, flatten the deep ones first. */
+    if(jsstr_is_deep_rope(str1))
+        jsstr_rope_flatten(jsstr_as_rope(str1));
+    if(jsstr_is_deep_rope(str2))
+        jsstr_rope_flatten(jsstr_as_rope(str2));
+    if(jsstr_is_deep_rope(str1) || jsstr_is_deep_rope(str2))
+        return ropes_cmp(str1, str2);
+
     str = jsstr_try_flat(str2);
     if(str) {
         ret = jsstr_cmp_str(str1, str, min(len1, len2));
@@ -204,7 +309,7 @@ int jsstr_cmp(jsstr_t *str1, jsstr_t *str2)
         return ret || len1 == len2 ? -ret : 1;
     }
 
-    return ropes_cmp(jsstr_as_rope(str1), jsstr_as_rope(str2));
+    return ropes_cmp(str1, str2);
 }
 
 jsstr_t *jsstr_concat(jsstr_t *str1, jsstr_t *str2)
@@ -225,25 +330,23 @@ jsstr_t *jsstr_concat(jsstr_t *str1, jsstr_t *str2)
         unsigned depth, depth2;
         jsstr_rope_t *rope;
 
+        if(len1+len2 > JSSTR_MAX_LENGTH)
+            return NULL;
+
         depth = jsstr_is_rope(str1) ? jsstr_as_rope(str1)->depth : 0;
         depth2 = jsstr_is_rope(str2) ? jsstr_as_rope(str2)->depth : 0;
         if(depth2 > depth)
             depth = depth2;
 
-        if(depth++ < JSSTR_MAX_ROPE_DEPTH) {
-            if(len1+len2 > JSSTR_MAX_LENGTH)
-                return NULL;
+        rope = heap_alloc(sizeof(*rope));
+        if(!rope)
+            return NULL;
 
-            rope = heap_alloc(sizeof(*rope));
-            if(!rope)
-                return NULL;
-
-            jsstr_init(&rope->str, len1+len2, JSSTR_ROPE);
-            rope->left = jsstr_addref(str1);
-            rope->right = jsstr_addref(str2);
-            rope->depth = depth;
-            return &rope->str;
-        }
+        jsstr_init(&rope->str, len1+len2, JSSTR_ROPE);
+        rope->left = jsstr_addref(str1);
+        rope->right = jsstr_addref(str2);
+        rope->depth = depth+1;
+        return &rope->str;
     }
 
     ret = jsstr_alloc_buf(len1+len2, &ptr);
@@ -266,8 +369,7 @@ const WCHAR *jsstr_rope_flatten(jsstr_rope_t *str)
     if(!buf)
         return NULL;
 
-    jsstr_flush(str->left, buf);
-    jsstr_flush(str->right, buf+jsstr_length(str->left));
+    jsstr_rope_extract(str, 0, jsstr_length(&str->str), buf);
     buf[jsstr_length(&str->str)] = 0;
 
     /* Trasform to heap string */
@@ -150,9 +150,7 @@ static inline unsigned jsstr_flush(jsstr_t *str, WCHAR *buf)
     }else if(jsstr_is_heap(str)) {
         memcpy(buf, jsstr_as_heap(str)->buf, len*sizeof(WCHAR));
     }else {
-        jsstr_rope_t *rope = jsstr_as_rope(str);
-        jsstr_flush(rope->left, buf);
-        jsstr_flush(rope->right, buf+jsstr_length(rope->left));
+        jsstr_extract(str, 0, len, buf);
     }
     return len;
 }
@@ -1899,6 +1899,7 @@ ok(isNaN(tmp), "Math.tan(-Infinity) is not NaN");
         [[1], "1"],
         [["test"], "\"test\""],
         [["test\"\\\b\f\n\r\t\u0002 !"], "\"test\\\"\\\\\\b\\f\\n\\r\\t\\u0002 !\""],
+        [["\"a\" \\b\\ c\u001f"], "\"\\\"a\\\" \\\\b\\\\ c\\u001f\""],
         [[NaN], "null"],
         [[Infinity], "null"],
         [[-Infinity], "null"],
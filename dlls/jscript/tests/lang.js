@@ -1866,6 +1866,73 @@ ok(tmp, "tmp = " + tmp);
     ok(x === undefined, "x = " + x);
 })();
 
+/* the same member expression evaluated on objects with different properties */
+(function() {
+    function getx(o) { return o.x; }
+    function setx(o, v) { o.x = v; }
+    function Constr() {}
+    var a = {x: 1}, b = {y: 2, x: 3}, c = {}, proto = {x: 4}, d, i;
+
+    for(i = 0; i < 3; i++) {
+        ok(getx(a) === 1, "getx(a) = " + getx(a));
+        ok(getx(b) === 3, "getx(b) = " + getx(b));
+        ok(getx(c) === undefined, "getx(c) = " + getx(c));
+    }
+
+    delete a.x;
+    ok(getx(a) === undefined, "getx(a) = " + getx(a) + " after delete");
+    setx(a, 5);
+    ok(getx(a) === 5, "getx(a) = " + getx(a));
+
+    Constr.prototype = proto;
+    d = new Constr();
+    ok(getx(d) === 4, "getx(d) = " + getx(d));
+    setx(d, 6);
+    ok(getx(d) === 6, "getx(d) = " + getx(d));
+    ok(proto.x === 4, "proto.x = " + proto.x);
+    delete d.x;
+    ok(getx(d) === 4, "getx(d) = " + getx(d) + " after delete");
+    delete proto.x;
+    ok(getx(d) === undefined, "getx(d) = " + getx(d) + " after prototype delete");
+})();
+
+/* the same identifier resolved in different scopes */
+var cacheTestVar = 1;
+(function() {
+    function get() { return cacheTestVar; }
+    function getWith(o) { with(o) { return cacheTestVar; } }
+    var i;
+
+    for(i = 0; i < 3; i++) {
+        ok(get() === i + 1, "get() = " + get());
+        cacheTestVar++;
+    }
+    ok(getWith({}) === 4, "getWith({}) = " + getWith({}));
+    ok(getWith({cacheTestVar: 10}) === 10, "getWith({cacheTestVar: 10}) = " + getWith({cacheTestVar: 10}));
+    ok(getWith({}) === 4, "getWith({}) = " + getWith({}));
+})();
+
+/* strings built by many concatenations */
+(function() {
+    var s = "", t = "", u, i;
+
+    for(i = 0; i < 5000; i++) {
+        s += "ab";
+        t = "ab" + t;
+    }
+    u = s;
+    s += "!";
+
+    ok(s.length === 10001, "s.length = " + s.length);
+    ok(u.length === 10000, "u.length = " + u.length);
+    ok(s.charAt(9999) === "b", "s.charAt(9999) = " + s.charAt(9999));
+    ok(s.substring(9998) === "ab!", "s.substring(9998) = " + s.substring(9998));
+    ok(t === u, "t !== u");
+    ok(s !== u, "s === u");
+    ok(s.indexOf("!") === 10000, "s.indexOf('!') = " + s.indexOf("!"));
+    ok(s.substr(0, 4) === "abab", "s.substr(0, 4) = " + s.substr(0, 4));
+})();
+
 var get, set;
 
 /* NoNewline rule parser tests */
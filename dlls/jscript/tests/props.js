@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* Property and identifier lookup benchmarks, each reporting operations per second.
+ * Only run from run.c when benchmarks are requested. */
+
+var iterations = 200000;
+var counter = 0;
+
+function report(name, ops, start) {
+    var ms = new Date().getTime() - start;
+    test.trace(name + ": " + (ms ? Math.round(ops * 1000 / ms) : "inf") + " ops/sec (" + ms + " ms)");
+}
+
+function bench_global_vars() {
+    var start = new Date().getTime(), i;
+
+    counter = 0;
+    for(i = 0; i < iterations; i++)
+        counter = counter + 1;
+    test.ok(counter === iterations, "counter = " + counter);
+    report("global get/put", iterations * 2, start);
+}
+
+function bench_member_get() {
+    var obj = {x: 1, y: 2, z: 3}, start = new Date().getTime(), sum = 0, i;
+
+    for(i = 0; i < iterations; i++)
+        sum += obj.x + obj.y + obj.z;
+    test.ok(sum === iterations * 6, "sum = " + sum);
+    report("member get", iterations * 3, start);
+}
+
+function bench_member_put() {
+    var obj = {x: 0}, start = new Date().getTime(), i;
+
+    for(i = 0; i < iterations; i++)
+        obj.x = i;
+    test.ok(obj.x === iterations - 1, "obj.x = " + obj.x);
+    report("member put", iterations, start);
+}
+
+function Point(x, y) {
+    this.x = x;
+    this.y = y;
+}
+
+Point.prototype.length2 = function() {
+    return this.x * this.x + this.y * this.y;
+}
+
+function bench_same_layout() {
+    var points = [], start, sum = 0, i;
+
+    for(i = 0; i < 100; i++)
+        points.push(new Point(i, 1));
+
+    start = new Date().getTime();
+    for(i = 0; i < iterations; i++)
+        sum += points[i % 100].x;
+    test.ok(sum === iterations * 99 / 2, "sum = " + sum);
+    report("member get, same layout", iterations, start);
+}
+
+function bench_method_call() {
+    var p = new Point(3, 4), start = new Date().getTime(), sum = 0, i;
+
+    for(i = 0; i < iterations; i++)
+        sum += p.length2();
+    test.ok(sum === iterations * 25, "sum = " + sum);
+    report("prototype method call", iterations, start);
+}
+
+function bench_builtin_call() {
+    var start = new Date().getTime(), sum = 0, i;
+
+    for(i = 0; i < iterations; i++)
+        sum += Math.abs(-1);
+    test.ok(sum === iterations, "sum = " + sum);
+    report("builtin method call", iterations, start);
+}
+
+bench_global_vars();
+bench_member_get();
+bench_member_put();
+bench_same_layout();
+bench_method_call();
+bench_builtin_call();
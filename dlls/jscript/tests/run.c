@@ -3494,6 +3494,8 @@ static void run_benchmarks(void)
     run_benchmark("dna.js");
     run_benchmark("base64.js");
     run_benchmark("validateinput.js");
+    run_benchmark("props.js");
+    run_benchmark("strings.js");
 }
 
 static BOOL check_jscript(void)
@@ -3538,7 +3540,7 @@ START_TEST(run)
             test_parse_proc();
         }
 
-        if(winetest_interactive)
+        if(winetest_interactive || winetest_benchmark)
             run_benchmarks();
     }
 
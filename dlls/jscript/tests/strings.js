@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/* String building benchmarks, each reporting operations per second.
+ * Only run from run.c when benchmarks are requested. */
+
+function report(name, ops, start) {
+    var ms = new Date().getTime() - start;
+    test.trace(name + ": " + (ms ? Math.round(ops * 1000 / ms) : "inf") + " ops/sec (" + ms + " ms)");
+}
+
+function bench_concat() {
+    var iterations = 1000000, start = new Date().getTime(), s = "", i;
+
+    for(i = 0; i < iterations; i++)
+        s += "x";
+    test.ok(s.length === iterations, "s.length = " + s.length);
+    test.ok(s.charAt(iterations - 1) === "x", "s.charAt(iterations - 1) = " + s.charAt(iterations - 1));
+    report("concatenation", iterations, start);
+}
+
+function bench_concat_parts() {
+    var iterations = 100000, start = new Date().getTime(), s = "", i;
+
+    for(i = 0; i < iterations; i++)
+        s += "<td>" + i + "</td>";
+    test.ok(s.indexOf("<td>99999</td>") !== -1, "missing last cell");
+    report("mixed concatenation", iterations, start);
+}
+
+function bench_join() {
+    var iterations = 100000, arr = [], start = new Date().getTime(), s, i;
+
+    for(i = 0; i < iterations; i++)
+        arr.push("item" + i);
+    s = arr.join(",");
+    test.ok(s.length === arr.join("").length + iterations - 1, "s.length = " + s.length);
+    report("array join", iterations, start);
+}
+
+function bench_json() {
+    var obj = {items: []}, start, s, i;
+
+    for(i = 0; i < 20000; i++)
+        obj.items.push({id: i, name: "item \"" + i + "\"", tags: ["a", "b"], valid: true});
+
+    start = new Date().getTime();
+    s = JSON.stringify(obj);
+    test.ok(s.length > 20000 * 40, "s.length = " + s.length);
+    test.ok(s.substring(0, 19) === "{\"items\":[{\"id\":0,\"", "s = " + s.substring(0, 19));
+    report("JSON.stringify", obj.items.length, start);
+}
+
+bench_concat();
+bench_concat_parts();
+bench_join();
+bench_json();
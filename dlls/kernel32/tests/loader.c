@@ -3918,6 +3918,85 @@ static void test_dll_file( const char *name )
 #undef OK_FIELD
 }
 
+static void test_export_lookup(void)
+{
+    static const char * const dlls[] =
+    {
+        "ntdll.dll", "kernel32.dll", "kernelbase.dll", "advapi32.dll", "user32.dll", "gdi32.dll",
+        "msvcrt.dll", "ole32.dll", "oleaut32.dll", "rpcrt4.dll", "shell32.dll", "shlwapi.dll",
+        "comctl32.dll", "comdlg32.dll", "ws2_32.dll", "crypt32.dll", "setupapi.dll", "wininet.dll",
+        "winmm.dll", "version.dll",
+    };
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *names;
+    const WORD *ordinals;
+    LARGE_INTEGER start, end, freq;
+    unsigned int i, j, count = 0, iter;
+    HMODULE modules[ARRAY_SIZE(dlls)];
+    void *proc, *ordinal_proc;
+    const char *name;
+    DWORD size;
+
+    if (winetest_benchmark)
+    {
+        QueryPerformanceFrequency( &freq );
+        QueryPerformanceCounter( &start );
+    }
+    for (i = 0; i < ARRAY_SIZE(dlls); i++)
+    {
+        modules[i] = LoadLibraryA( dlls[i] );
+        ok( modules[i] != NULL, "failed to load %s, error %u\n", dlls[i], GetLastError() );
+    }
+    if (winetest_benchmark)
+    {
+        QueryPerformanceCounter( &end );
+        trace( "loaded %u dlls in %.3f ms\n", (unsigned int)ARRAY_SIZE(dlls),
+               (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart );
+    }
+
+    /* check that every export name resolves to the same address as its ordinal */
+    for (i = 0; i < ARRAY_SIZE(dlls); i++)
+    {
+        if (!modules[i]) continue;
+        exports = pRtlImageDirectoryEntryToData( modules[i], TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+        if (!exports) continue;
+        names = (const DWORD *)((const char *)modules[i] + exports->AddressOfNames);
+        ordinals = (const WORD *)((const char *)modules[i] + exports->AddressOfNameOrdinals);
+        for (j = 0; j < exports->NumberOfNames; j++)
+        {
+            name = (const char *)modules[i] + names[j];
+            proc = GetProcAddress( modules[i], name );
+            ordinal_proc = GetProcAddress( modules[i], (LPSTR)(ULONG_PTR)(exports->Base + ordinals[j]) );
+            ok( proc == ordinal_proc, "%s.%s: got %p, ordinal %p\n", dlls[i], name, proc, ordinal_proc );
+        }
+        ok( !GetProcAddress( modules[i], "wine_nonexistent_export" ), "%s: found nonexistent export\n", dlls[i] );
+    }
+
+    if (winetest_benchmark)
+    {
+        QueryPerformanceCounter( &start );
+        for (iter = 0; iter < 20; iter++)
+        {
+            for (i = 0; i < ARRAY_SIZE(dlls); i++)
+            {
+                if (!modules[i]) continue;
+                exports = pRtlImageDirectoryEntryToData( modules[i], TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &size );
+                if (!exports) continue;
+                names = (const DWORD *)((const char *)modules[i] + exports->AddressOfNames);
+                for (j = 0; j < exports->NumberOfNames; j++, count++)
+                    GetProcAddress( modules[i], (const char *)modules[i] + names[j] );
+            }
+        }
+        QueryPerformanceCounter( &end );
+        if (count)
+            trace( "resolved %u exports in %.3f ms, %.1f ns per lookup\n", count,
+                   (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart,
+                   (end.QuadPart - start.QuadPart) * 1e9 / freq.QuadPart / count );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(dlls); i++) if (modules[i]) FreeLibrary( modules[i] );
+}
+
 static void test_LoadPackagedLibrary(void)
 {
     HMODULE h;
@@ -4010,6 +4089,7 @@ START_TEST(loader)
     test_dll_file( "kernel32.dll" );
     test_dll_file( "advapi32.dll" );
     test_dll_file( "user32.dll" );
+    test_export_lookup();
     /* loader test must be last, it can corrupt the internal loader state on Windows */
     test_Loader();
 }
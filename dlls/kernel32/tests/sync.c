@@ -1340,6 +1340,177 @@ static void test_WaitForMultipleObjects(void)
     todo_wine ok(status == STATUS_INVALID_HANDLE, "expected STATUS_INVALID_HANDLE, got %08x\n", status);
 }
 
+static DWORD WINAPI mixed_wait_thread(void *arg)
+{
+    HANDLE *handles = arg;
+    DWORD r;
+
+    r = WaitForMultipleObjects(2, handles, FALSE, 5000);
+    ok(r == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", r);
+    return 0;
+}
+
+static void test_mixed_waits(void)
+{
+    HANDLE handles[2], thread;
+    LONG prev;
+    DWORD r;
+
+    /* single object waits and multiple object waits on the same objects */
+    handles[0] = CreateSemaphoreA(NULL, 0, 2, NULL);
+    ok(handles[0] != NULL, "CreateSemaphore failed with error %u\n", GetLastError());
+    handles[1] = CreateEventA(NULL, TRUE, FALSE, NULL);
+    ok(handles[1] != NULL, "CreateEvent failed with error %u\n", GetLastError());
+
+    thread = CreateThread(NULL, 0, mixed_wait_thread, handles, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with error %u\n", GetLastError());
+    r = WaitForSingleObject(thread, 100);
+    ok(r == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", r);
+
+    r = WaitForSingleObject(handles[0], 0);
+    ok(r == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", r);
+    prev = 0xdeadbeef;
+    r = ReleaseSemaphore(handles[0], 1, &prev);
+    ok(r, "ReleaseSemaphore failed with error %u\n", GetLastError());
+    ok(prev == 0, "got previous count %d\n", prev);
+
+    /* the waiting thread consumes the count */
+    r = WaitForSingleObject(thread, 5000);
+    ok(r == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", r);
+    r = WaitForSingleObject(handles[0], 0);
+    ok(r == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", r);
+    CloseHandle(thread);
+
+    r = ReleaseSemaphore(handles[0], 2, &prev);
+    ok(r, "ReleaseSemaphore failed with error %u\n", GetLastError());
+    r = ReleaseSemaphore(handles[0], 1, &prev);
+    ok(!r, "ReleaseSemaphore succeeded\n");
+    ok(GetLastError() == ERROR_TOO_MANY_POSTS, "got error %u\n", GetLastError());
+    r = WaitForSingleObject(handles[0], 0);
+    ok(r == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", r);
+    r = WaitForMultipleObjects(2, handles, FALSE, 0);
+    ok(r == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", r);
+    r = WaitForSingleObject(handles[0], 0);
+    ok(r == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", r);
+
+    SetEvent(handles[1]);
+    r = WaitForSingleObject(handles[1], 0);
+    ok(r == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", r);
+    r = WaitForMultipleObjects(2, handles, FALSE, 0);
+    ok(r == WAIT_OBJECT_0 + 1, "WaitForMultipleObjects returned %u\n", r);
+
+    CloseHandle(handles[0]);
+    CloseHandle(handles[1]);
+}
+
+static LONG mutex_owners;
+
+static DWORD WINAPI mutex_contention_thread(void *arg)
+{
+    HANDLE *handles = arg;
+    DWORD r, i, count = handles[1] ? 2 : 1;
+    BOOL ret;
+
+    /* with the timer handle the wait can't be done on the shared memory */
+    for (i = 0; i < 500; i++)
+    {
+        r = WaitForMultipleObjects(count, handles, FALSE, 10000);
+        ok(r == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", r);
+        if (r != WAIT_OBJECT_0) break;
+        r = InterlockedIncrement(&mutex_owners);
+        ok(r == 1, "mutex has %u owners\n", r);
+        InterlockedDecrement(&mutex_owners);
+        ret = ReleaseMutex(handles[0]);
+        ok(ret, "ReleaseMutex failed with error %u\n", GetLastError());
+    }
+    return 0;
+}
+
+static void test_mutex_contention(void)
+{
+    HANDLE handles[2], single[2], threads[4], timer;
+    DWORD r, i;
+
+    timer = CreateWaitableTimerA(NULL, TRUE, NULL);
+    ok(timer != NULL, "CreateWaitableTimer failed with error %u\n", GetLastError());
+    handles[0] = CreateMutexA(NULL, FALSE, NULL);
+    ok(handles[0] != NULL, "CreateMutex failed with error %u\n", GetLastError());
+    handles[1] = timer;
+    single[0] = handles[0];
+    single[1] = NULL;
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        threads[i] = CreateThread(NULL, 0, mutex_contention_thread, (i & 1) ? handles : single, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with error %u\n", GetLastError());
+    }
+    r = WaitForMultipleObjects(ARRAY_SIZE(threads), threads, TRUE, 60000);
+    ok(r == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", r);
+    for (i = 0; i < ARRAY_SIZE(threads); i++) CloseHandle(threads[i]);
+
+    r = WaitForSingleObject(handles[0], 0);
+    ok(r == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", r);
+    ReleaseMutex(handles[0]);
+    CloseHandle(handles[0]);
+    CloseHandle(timer);
+}
+
+static DWORD WINAPI pulse_wait_thread(void *arg)
+{
+    return WaitForSingleObject(arg, 5000);
+}
+
+static void test_pulse_event(BOOL manual)
+{
+    HANDLE event, threads[2];
+    DWORD r, code, i, released = 0;
+
+    event = CreateEventA(NULL, manual, FALSE, NULL);
+    ok(event != NULL, "CreateEvent failed with error %u\n", GetLastError());
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        threads[i] = CreateThread(NULL, 0, pulse_wait_thread, event, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed with error %u\n", GetLastError());
+    }
+    r = WaitForMultipleObjects(ARRAY_SIZE(threads), threads, FALSE, 200);
+    ok(r == WAIT_TIMEOUT, "WaitForMultipleObjects returned %u\n", r);
+
+    PulseEvent(event);
+    r = WaitForSingleObject(event, 0);
+    ok(r == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", r);
+
+    /* a manual-reset event releases all waiters, an auto-reset one a single waiter */
+    Sleep(200);
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        if (WaitForSingleObject(threads[i], 0)) continue;
+        GetExitCodeThread(threads[i], &code);
+        ok(code == WAIT_OBJECT_0, "thread %u returned %u\n", i, code);
+        released++;
+    }
+    ok(released == (manual ? 2 : 1), "%u threads released\n", released);
+
+    if (!manual)
+    {
+        PulseEvent(event);
+        r = WaitForMultipleObjects(ARRAY_SIZE(threads), threads, TRUE, 5000);
+        ok(r == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", r);
+        for (i = 0; i < ARRAY_SIZE(threads); i++)
+        {
+            GetExitCodeThread(threads[i], &code);
+            ok(code == WAIT_OBJECT_0, "thread %u returned %u\n", i, code);
+        }
+    }
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        WaitForSingleObject(threads[i], 5000);
+        CloseHandle(threads[i]);
+    }
+    CloseHandle(event);
+}
+
 static BOOL g_initcallback_ret, g_initcallback_called;
 static void *g_initctxt;
 
@@ -2754,6 +2925,10 @@ START_TEST(sync)
     test_timer_queue();
     test_WaitForSingleObject();
     test_WaitForMultipleObjects();
+    test_mixed_waits();
+    test_mutex_contention();
+    test_pulse_event(TRUE);
+    test_pulse_event(FALSE);
     test_initonce();
     test_condvars_base(&aligned_cv);
     test_condvars_base(&unaligned_cv.cv);
@@ -4208,6 +4208,76 @@ static void test_shared_memory_ro(BOOL is_child, DWORD child_access)
     CloseHandle(mapping);
 }
 
+static void test_large_pages(void)
+{
+    SIZE_T large_page = GetLargePageMinimum();
+    MEMORY_BASIC_INFORMATION info;
+    DWORD old_prot;
+    char *ptr;
+    BOOL ret;
+
+    if (!large_page)
+    {
+        skip("large pages not supported\n");
+        return;
+    }
+    ok(!(large_page & (large_page - 1)), "large page size %#lx is not a power of 2\n", large_page);
+
+    SetLastError(0xdeadbeef);
+    ptr = VirtualAlloc(NULL, large_page, MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!ptr, "VirtualAlloc succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER || GetLastError() == ERROR_PRIVILEGE_NOT_HELD,
+       "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ptr = VirtualAlloc(NULL, large_page, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!ptr)
+    {
+        ok(GetLastError() == ERROR_PRIVILEGE_NOT_HELD || GetLastError() == ERROR_NO_SYSTEM_RESOURCES,
+           "got error %u\n", GetLastError());
+        skip("cannot allocate large pages\n");
+        return;
+    }
+    ok(!((ULONG_PTR)ptr & (large_page - 1)), "ptr %p is not aligned to %#lx\n", ptr, large_page);
+    ptr[0] = 1;
+    ptr[large_page - 1] = 2;
+    ok(VirtualQuery(ptr, &info, sizeof(info)) == sizeof(info), "VirtualQuery failed\n");
+    ok(info.RegionSize == large_page, "got region size %#lx\n", info.RegionSize);
+    ok(info.State == MEM_COMMIT, "got state %#x\n", info.State);
+    ok(info.Protect == PAGE_READWRITE, "got protect %#x\n", info.Protect);
+
+    /* large pages can't be split */
+    SetLastError(0xdeadbeef);
+    ret = VirtualProtect(ptr, si.dwPageSize, PAGE_READONLY, &old_prot);
+    ok(!ret, "VirtualProtect succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = VirtualFree(ptr + si.dwPageSize, si.dwPageSize, MEM_DECOMMIT);
+    ok(!ret, "VirtualFree succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+    ok(VirtualQuery(ptr, &info, sizeof(info)) == sizeof(info), "VirtualQuery failed\n");
+    ok(info.RegionSize == large_page, "got region size %#lx\n", info.RegionSize);
+    ok(info.State == MEM_COMMIT, "got state %#x\n", info.State);
+    ok(info.Protect == PAGE_READWRITE, "got protect %#x\n", info.Protect);
+    ok(ptr[0] == 1 && ptr[large_page - 1] == 2, "data was modified\n");
+
+    ret = VirtualProtect(ptr, large_page, PAGE_READONLY, &old_prot);
+    ok(ret, "VirtualProtect failed %u\n", GetLastError());
+    ok(old_prot == PAGE_READWRITE, "got old protect %#x\n", old_prot);
+    ok(VirtualQuery(ptr, &info, sizeof(info)) == sizeof(info), "VirtualQuery failed\n");
+    ok(info.RegionSize == large_page, "got region size %#lx\n", info.RegionSize);
+    ok(info.Protect == PAGE_READONLY, "got protect %#x\n", info.Protect);
+    ok(VirtualFree(ptr, 0, MEM_RELEASE), "VirtualFree failed %u\n", GetLastError());
+
+    if (large_page / 2 >= si.dwPageSize)
+    {
+        SetLastError(0xdeadbeef);
+        ptr = VirtualAlloc(NULL, large_page / 2, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        ok(!ptr, "VirtualAlloc succeeded\n");
+        ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+    }
+}
+
 START_TEST(virtual)
 {
     int argc;
@@ -4284,6 +4354,7 @@ START_TEST(virtual)
     test_IsBadWritePtr();
     test_IsBadCodePtr();
     test_write_watch();
+    test_large_pages();
 #if defined(__i386__) || defined(__x86_64__)
     test_stack_commit();
 #endif
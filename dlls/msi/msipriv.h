@@ -131,6 +131,7 @@ typedef struct tagMSIQUERY
     UINT row;
     MSIDATABASE *db;
     struct list mem;
+    WCHAR *text; /* only kept for the msiperf channel */
 } MSIQUERY;
 
 /* maybe we can use a Variant instead of doing it ourselves? */
@@ -348,6 +349,16 @@ typedef struct tagMSIVIEWOPS
      * drop - drops the table from the database
      */
     UINT (*drop)( struct tagMSIVIEW *view );
+
+    /*
+     * find_matching_rows - iterates through the rows where a column has a value
+     *
+     *  The value is compared with what fetch_int returns for the column, i.e.
+     *  a string ID for string columns. The handle keeps track of the position
+     *  in the iteration, it must be NULL on the first call. Rows are returned
+     *  in ascending order, until ERROR_NO_MORE_ITEMS is returned.
+     */
+    UINT (*find_matching_rows)( struct tagMSIVIEW *view, UINT col, UINT val, UINT *row, MSIITERHANDLE *handle );
 } MSIVIEWOPS;
 
 struct tagMSIVIEW
@@ -40,6 +40,7 @@
 #include "initguid.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(msi);
+WINE_DECLARE_DEBUG_CHANNEL(msiperf);
 
 static void MSI_CloseView( MSIOBJECTHDR *arg )
 {
@@ -54,6 +55,7 @@ static void MSI_CloseView( MSIOBJECTHDR *arg )
     {
         msi_free( ptr );
     }
+    msi_free( query->text );
 }
 
 UINT VIEW_find_column( MSIVIEW *table, LPCWSTR name, LPCWSTR table_name, UINT *n )
@@ -125,6 +127,7 @@ UINT MSI_DatabaseOpenViewW(MSIDATABASE *db,
     msiobj_addref( &db->hdr );
     query->db = db;
     list_init( &query->mem );
+    if (TRACE_ON(msiperf)) query->text = strdupW( szQuery );
 
     r = MSI_ParseSQL( db, szQuery, &query->view, &query->mem );
     if( r == ERROR_SUCCESS )
@@ -498,7 +501,9 @@ UINT WINAPI MsiViewClose(MSIHANDLE hView)
 
 UINT MSI_ViewExecute(MSIQUERY *query, MSIRECORD *rec )
 {
+    LARGE_INTEGER start, end, freq;
     MSIVIEW *view;
+    UINT r, rows = 0;
 
     TRACE("%p %p\n", query, rec);
 
@@ -509,7 +514,18 @@ UINT MSI_ViewExecute(MSIQUERY *query, MSIRECORD *rec )
         return ERROR_FUNCTION_FAILED;
     query->row = 0;
 
-    return view->ops->execute( view, rec );
+    if (!TRACE_ON(msiperf))
+        return view->ops->execute( view, rec );
+
+    QueryPerformanceCounter( &start );
+    r = view->ops->execute( view, rec );
+    QueryPerformanceCounter( &end );
+    QueryPerformanceFrequency( &freq );
+
+    if (view->ops->get_dimensions) view->ops->get_dimensions( view, &rows, NULL );
+    TRACE_(msiperf)("%s returned %u, %u rows in %s us\n", debugstr_w(query->text), r, rows,
+                    wine_dbgstr_longlong( (end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart ));
+    return r;
 }
 
 UINT WINAPI MsiViewExecute(MSIHANDLE hView, MSIHANDLE hRec)
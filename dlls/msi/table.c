@@ -38,8 +38,6 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(msidb);
 
-#define MSITABLE_HASH_TABLE_SIZE 37
-
 typedef struct tagMSICOLUMNHASHENTRY
 {
     struct tagMSICOLUMNHASHENTRY *next;
@@ -57,6 +55,8 @@ typedef struct tagMSICOLUMNINFO
     INT     ref_count;
     BOOL    temporary;
     MSICOLUMNHASHENTRY **hash_table;
+    UINT    hash_size;  /* number of buckets, also the number of entries allocated */
+    UINT    hash_count; /* number of entries used */
 } MSICOLUMNINFO;
 
 struct tagMSITABLE
@@ -1011,6 +1011,69 @@ typedef struct tagMSITABLEVIEW
     WCHAR          name[1];
 } MSITABLEVIEW;
 
+static inline MSICOLUMNHASHENTRY *hash_entries( const MSICOLUMNINFO *col )
+{
+    return (MSICOLUMNHASHENTRY *)(col->hash_table + col->hash_size);
+}
+
+/* link an entry into its chain, keeping the chain in ascending row order */
+static void hash_link_entry( MSICOLUMNINFO *col, MSICOLUMNHASHENTRY *entry )
+{
+    MSICOLUMNHASHENTRY **prev = &col->hash_table[entry->value % col->hash_size];
+
+    while (*prev && (*prev)->row < entry->row)
+        prev = &(*prev)->next;
+    entry->next = *prev;
+    *prev = entry;
+}
+
+static MSICOLUMNHASHENTRY *hash_unlink_row( MSICOLUMNINFO *col, UINT value, UINT row )
+{
+    MSICOLUMNHASHENTRY **prev = &col->hash_table[value % col->hash_size], *entry;
+
+    while ((entry = *prev) && (entry->value != value || entry->row != row))
+        prev = &entry->next;
+    if (entry) *prev = entry->next;
+    return entry;
+}
+
+static void hash_shift_rows( MSICOLUMNINFO *col, UINT row, int delta )
+{
+    MSICOLUMNHASHENTRY *entries = hash_entries( col );
+    UINT i;
+
+    for (i = 0; i < col->hash_count; i++)
+        if (entries[i].row >= row) entries[i].row += delta;
+}
+
+/* a zeroed row was inserted at index row */
+static void table_hash_insert_row( MSITABLEVIEW *tv, UINT row )
+{
+    MSICOLUMNHASHENTRY *entry;
+    MSICOLUMNINFO *col;
+    UINT i;
+
+    for (i = 0; i < tv->num_cols; i++)
+    {
+        col = &tv->columns[i];
+        if (!col->hash_table) continue;
+
+        /* rebuild it with more room on the next lookup */
+        if (col->hash_count == col->hash_size)
+        {
+            msi_free( col->hash_table );
+            col->hash_table = NULL;
+            continue;
+        }
+
+        hash_shift_rows( col, row, 1 );
+        entry = &hash_entries( col )[col->hash_count++];
+        entry->value = 0;
+        entry->row = row;
+        hash_link_entry( col, entry );
+    }
+}
+
 static UINT TABLE_fetch_int( struct tagMSIVIEW *view, UINT row, UINT col, UINT *val )
 {
     MSITABLEVIEW *tv = (MSITABLEVIEW*)view;
@@ -1184,9 +1247,6 @@ static UINT table_set_bytes( MSITABLEVIEW *tv, UINT row, UINT col, UINT val )
         return ERROR_FUNCTION_FAILED;
     }
 
-    msi_free( tv->columns[col-1].hash_table );
-    tv->columns[col-1].hash_table = NULL;
-
     n = bytes_per_column( tv->db, &tv->columns[col - 1], LONG_STR_BYTES );
     if ( n != 2 && n != 3 && n != 4 )
     {
@@ -1195,6 +1255,17 @@ static UINT table_set_bytes( MSITABLEVIEW *tv, UINT row, UINT col, UINT val )
     }
 
     offset = tv->columns[col-1].offset;
+    if (tv->columns[col-1].hash_table)
+    {
+        UINT old = read_table_int( tv->table->data, row, offset, n );
+        MSICOLUMNHASHENTRY *entry;
+
+        if (old != val && (entry = hash_unlink_row( &tv->columns[col-1], old, row )))
+        {
+            entry->value = val;
+            hash_link_entry( &tv->columns[col-1], entry );
+        }
+    }
     for ( i = 0; i < n; i++ )
         tv->table->data[row][offset + i] = (val >> i * 8) & 0xff;
 
@@ -1664,7 +1735,9 @@ static UINT table_validate_new( MSITABLEVIEW *tv, MSIRECORD *rec, UINT *column )
     return ERROR_SUCCESS;
 }
 
-static int compare_record( MSITABLEVIEW *tv, UINT row, MSIRECORD *rec )
+/* values holds the key values of the record, valid is the index of the first
+ * key column that couldn't be converted */
+static int compare_record( MSITABLEVIEW *tv, UINT row, const UINT *values, UINT valid )
 {
     UINT r, i, ivalue, x;
 
@@ -1672,9 +1745,9 @@ static int compare_record( MSITABLEVIEW *tv, UINT row, MSIRECORD *rec )
     {
         if (!(tv->columns[i].type & MSITYPE_KEY)) continue;
 
-        r = get_table_value_from_record( tv, rec, i + 1, &ivalue );
-        if (r != ERROR_SUCCESS)
+        if (i >= valid)
             return 1;
+        ivalue = values[i];
 
         r = TABLE_fetch_int( &tv->view, row, i + 1, &x );
         if (r != ERROR_SUCCESS)
@@ -1697,16 +1770,29 @@ static int compare_record( MSITABLEVIEW *tv, UINT row, MSIRECORD *rec )
     return 1;
 }
 
-static int find_insert_index( MSITABLEVIEW *tv, MSIRECORD *rec )
+static UINT find_insert_index( MSITABLEVIEW *tv, MSIRECORD *rec, UINT *row )
 {
     int idx, c, low = 0, high = tv->table->row_count - 1;
+    UINT *values, valid;
 
     TRACE("%p %p\n", tv, rec);
 
+    /* convert the key fields only once, not on every comparison */
+    if (!(values = msi_alloc( tv->num_cols * sizeof(*values) )))
+        return ERROR_OUTOFMEMORY;
+
+    for (valid = 0; valid < tv->num_cols; valid++)
+    {
+        if (!(tv->columns[valid].type & MSITYPE_KEY)) continue;
+        if (get_table_value_from_record( tv, rec, valid + 1, &values[valid] ) != ERROR_SUCCESS)
+            break;
+    }
+
+    *row = -1;
     while (low <= high)
     {
         idx = (low + high) / 2;
-        c = compare_record( tv, idx, rec );
+        c = compare_record( tv, idx, values, valid );
 
         if (c < 0)
             high = idx - 1;
@@ -1715,17 +1801,24 @@ static int find_insert_index( MSITABLEVIEW *tv, MSIRECORD *rec )
         else
         {
             TRACE("found %u\n", idx);
-            return idx;
+            *row = idx;
+            break;
         }
     }
-    TRACE("found %u\n", high + 1);
-    return high + 1;
+    if (*row == -1)
+    {
+        TRACE("found %u\n", high + 1);
+        *row = high + 1;
+    }
+    msi_free( values );
+    return ERROR_SUCCESS;
 }
 
 static UINT TABLE_insert_row( struct tagMSIVIEW *view, MSIRECORD *rec, UINT row, BOOL temporary )
 {
     MSITABLEVIEW *tv = (MSITABLEVIEW*)view;
-    UINT i, r;
+    UINT r, count;
+    BYTE *data;
 
     TRACE("%p %p %s\n", tv, rec, temporary ? "TRUE" : "FALSE" );
 
@@ -1734,8 +1827,8 @@ static UINT TABLE_insert_row( struct tagMSIVIEW *view, MSIRECORD *rec, UINT row,
     if( r != ERROR_SUCCESS )
         return ERROR_FUNCTION_FAILED;
 
-    if (row == -1)
-        row = find_insert_index( tv, rec );
+    if (row == -1 && (r = find_insert_index( tv, rec, &row )))
+        return r;
 
     r = table_create_new_row( view, &row, temporary );
     TRACE("insert_row returned %08x\n", r);
@@ -1743,12 +1836,13 @@ static UINT TABLE_insert_row( struct tagMSIVIEW *view, MSIRECORD *rec, UINT row,
         return r;
 
     /* shift the rows to make room for the new row */
-    for (i = tv->table->row_count - 1; i > row; i--)
-    {
-        memmove(&(tv->table->data[i][0]),
-                &(tv->table->data[i - 1][0]), tv->row_size);
-        tv->table->data_persistent[i] = tv->table->data_persistent[i - 1];
-    }
+    count = tv->table->row_count - 1 - row;
+    data = tv->table->data[tv->table->row_count - 1];
+    memmove( &tv->table->data[row + 1], &tv->table->data[row], count * sizeof(*tv->table->data) );
+    memmove( &tv->table->data_persistent[row + 1], &tv->table->data_persistent[row],
+             count * sizeof(*tv->table->data_persistent) );
+    tv->table->data[row] = data;
+    table_hash_insert_row( tv, row );
 
     /* Re-set the persistence flag */
     tv->table->data_persistent[row] = !temporary;
@@ -1772,23 +1866,25 @@ static UINT TABLE_delete_row( struct tagMSIVIEW *view, UINT row )
     if ( row >= num_rows )
         return ERROR_FUNCTION_FAILED;
 
-    num_rows = tv->table->row_count;
-    tv->table->row_count--;
-
-    /* reset the hash tables */
+    /* drop the row from the hash tables */
     for (i = 0; i < tv->num_cols; i++)
     {
-        msi_free( tv->columns[i].hash_table );
-        tv->columns[i].hash_table = NULL;
-    }
+        UINT value;
 
-    for (i = row + 1; i < num_rows; i++)
-    {
-        memcpy(tv->table->data[i - 1], tv->table->data[i], tv->row_size);
-        tv->table->data_persistent[i - 1] = tv->table->data_persistent[i];
+        if (!tv->columns[i].hash_table) continue;
+        if (!TABLE_fetch_int( view, row, i + 1, &value ))
+            hash_unlink_row( &tv->columns[i], value, row );
+        hash_shift_rows( &tv->columns[i], row + 1, -1 );
     }
 
-    msi_free(tv->table->data[num_rows - 1]);
+    num_rows = tv->table->row_count;
+    tv->table->row_count--;
+
+    msi_free( tv->table->data[row] );
+    memmove( &tv->table->data[row], &tv->table->data[row + 1],
+             (num_rows - row - 1) * sizeof(*tv->table->data) );
+    memmove( &tv->table->data_persistent[row], &tv->table->data_persistent[row + 1],
+             (num_rows - row - 1) * sizeof(*tv->table->data_persistent) );
 
     return ERROR_SUCCESS;
 }
@@ -2123,6 +2219,84 @@ done:
     return r;
 }
 
+static UINT table_build_hash_table( MSITABLEVIEW *tv, UINT col )
+{
+    UINT i, num_rows = tv->table->row_count, size = 16;
+    MSICOLUMNHASHENTRY **hash_table;
+    MSICOLUMNHASHENTRY *new_entry;
+
+    if( tv->columns[col-1].offset >= tv->row_size )
+    {
+        ERR("Stuffed up %d >= %d\n", tv->columns[col-1].offset, tv->row_size );
+        ERR("%p %p\n", tv, tv->columns );
+        return ERROR_FUNCTION_FAILED;
+    }
+
+    while (size <= num_rows) size *= 2;
+
+    /* allocate contiguous memory for the table and its entries so we
+     * don't have to do an expensive cleanup */
+    hash_table = msi_alloc_zero( size * (sizeof(MSICOLUMNHASHENTRY *) + sizeof(MSICOLUMNHASHENTRY)) );
+    if (!hash_table)
+        return ERROR_OUTOFMEMORY;
+
+    /* add the rows backwards so that each chain is in ascending row order */
+    new_entry = (MSICOLUMNHASHENTRY *)(hash_table + size) + num_rows;
+    for (i = num_rows; i > 0; i--)
+    {
+        UINT row_value;
+
+        new_entry--;
+        if (TABLE_fetch_int( &tv->view, i - 1, col, &row_value ))
+            continue;
+
+        new_entry->value = row_value;
+        new_entry->row = i - 1;
+        new_entry->next = hash_table[row_value % size];
+        hash_table[row_value % size] = new_entry;
+    }
+
+    TRACE("%s.%s: hashed %u rows\n", debugstr_w(tv->name), debugstr_w(tv->columns[col-1].colname), num_rows);
+    tv->columns[col-1].hash_table = hash_table;
+    tv->columns[col-1].hash_size = size;
+    tv->columns[col-1].hash_count = num_rows;
+    return ERROR_SUCCESS;
+}
+
+static UINT TABLE_find_matching_rows( struct tagMSIVIEW *view, UINT col,
+    UINT val, UINT *row, MSIITERHANDLE *handle )
+{
+    MSITABLEVIEW *tv = (MSITABLEVIEW*)view;
+    const MSICOLUMNHASHENTRY *entry;
+    UINT r;
+
+    if( !tv->table )
+        return ERROR_INVALID_PARAMETER;
+
+    if( (col==0) || (col > tv->num_cols) )
+        return ERROR_INVALID_PARAMETER;
+
+    if( !*handle )
+    {
+        if (!tv->columns[col-1].hash_table && (r = table_build_hash_table( tv, col )))
+            return r;
+        entry = tv->columns[col-1].hash_table[val % tv->columns[col-1].hash_size];
+    }
+    else
+        entry = (*handle)->next;
+
+    while (entry && entry->value != val)
+        entry = entry->next;
+
+    *handle = entry;
+    if (!entry)
+        return ERROR_NO_MORE_ITEMS;
+
+    *row = entry->row;
+
+    return ERROR_SUCCESS;
+}
+
 static const MSIVIEWOPS table_ops =
 {
     TABLE_fetch_int,
@@ -2144,6 +2318,7 @@ static const MSIVIEWOPS table_ops =
     TABLE_add_column,
     NULL,
     TABLE_drop,
+    TABLE_find_matching_rows,
 };
 
 UINT TABLE_CreateView( MSIDATABASE *db, LPCWSTR name, MSIVIEW **view )
@@ -2483,18 +2658,42 @@ static UINT msi_row_matches( MSITABLEVIEW *tv, UINT row, const UINT *data, UINT
 
 static UINT msi_table_find_row( MSITABLEVIEW *tv, MSIRECORD *rec, UINT *row, UINT *column )
 {
-    UINT i, r = ERROR_FUNCTION_FAILED, *data;
+    UINT i, key, r = ERROR_FUNCTION_FAILED, *data;
+    MSIITERHANDLE handle = NULL;
 
     data = msi_record_to_row( tv, rec );
     if( !data )
         return r;
-    for( i = 0; i < tv->table->row_count; i++ )
+
+    for (key = 0; key < tv->num_cols; key++)
+        if (tv->columns[key].type & MSITYPE_KEY) break;
+
+    if (key < tv->num_cols && !tv->columns[key].hash_table && table_build_hash_table( tv, key + 1 ))
+        key = tv->num_cols;
+
+    if (key < tv->num_cols)
     {
-        r = msi_row_matches( tv, i, data, column );
-        if( r == ERROR_SUCCESS )
+        /* only look at the rows that match the first key column */
+        while (!TABLE_find_matching_rows( &tv->view, key + 1, data[key], &i, &handle ))
         {
-            *row = i;
-            break;
+            r = msi_row_matches( tv, i, data, column );
+            if( r == ERROR_SUCCESS )
+            {
+                *row = i;
+                break;
+            }
+        }
+    }
+    else
+    {
+        for( i = 0; i < tv->table->row_count; i++ )
+        {
+            r = msi_row_matches( tv, i, data, column );
+            if( r == ERROR_SUCCESS )
+            {
+                *row = i;
+                break;
+            }
         }
     }
     msi_free( data );
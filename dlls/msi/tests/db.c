@@ -9196,6 +9196,159 @@ static void test_view_get_error(void)
     DeleteFileA(msifile);
 }
 
+/* runs the query and returns the number of rows, the first fields are stored in values */
+static UINT get_query_values( MSIHANDLE hdb, MSIHANDLE hrec, const char *query, int *values, UINT max )
+{
+    MSIHANDLE view, rec;
+    UINT count = 0;
+
+    if (MsiDatabaseOpenViewA( hdb, query, &view )) return ~0u;
+    if (MsiViewExecute( view, hrec ))
+    {
+        MsiCloseHandle( view );
+        return ~0u;
+    }
+    while (!MsiViewFetch( view, &rec ))
+    {
+        if (count < max) values[count] = MsiRecordGetInteger( rec, 1 );
+        count++;
+        MsiCloseHandle( rec );
+    }
+    MsiViewClose( view );
+    MsiCloseHandle( view );
+    return count;
+}
+
+static void create_lookup_tables( MSIHANDLE hdb, UINT parents, UINT children )
+{
+    char query[256];
+    UINT i, r;
+
+    r = run_query( hdb, 0, "CREATE TABLE `Parent` (`Id` CHAR(32) NOT NULL, `Value` SHORT PRIMARY KEY `Id`)" );
+    ok( r == ERROR_SUCCESS, "got %u\n", r );
+    r = run_query( hdb, 0, "CREATE TABLE `Child` (`Key` LONG NOT NULL, `Parent_` CHAR(32), `Num` LONG PRIMARY KEY `Key`)" );
+    ok( r == ERROR_SUCCESS, "got %u\n", r );
+
+    for (i = 0; i < parents; i++)
+    {
+        sprintf( query, "INSERT INTO `Parent` (`Id`, `Value`) VALUES ('P%u', %u)", i, i % 10000 );
+        r = run_query( hdb, 0, query );
+        ok( r == ERROR_SUCCESS, "got %u\n", r );
+    }
+    for (i = 0; i < children; i++)
+    {
+        sprintf( query, "INSERT INTO `Child` (`Key`, `Parent_`, `Num`) VALUES (%u, 'P%u', %u)", i, i % parents, i * 1000 );
+        r = run_query( hdb, 0, query );
+        ok( r == ERROR_SUCCESS, "got %u\n", r );
+    }
+}
+
+static void test_lookups(void)
+{
+    MSIHANDLE hdb, rec;
+    int values[4];
+    UINT count, r;
+
+    hdb = create_db();
+    ok( hdb, "failed to create db\n" );
+    create_lookup_tables( hdb, 300, 600 );
+
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Id` = 'P42'", values, 4 );
+    ok( count == 1, "got %u rows\n", count );
+    ok( values[0] == 42, "got %d\n", values[0] );
+
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Id` = 'nonexistent'", values, 4 );
+    ok( count == 0, "got %u rows\n", count );
+
+    count = get_query_values( hdb, 0, "SELECT `Child`.`Key` FROM `Parent`, `Child` "
+                              "WHERE `Child`.`Parent_` = `Parent`.`Id` AND `Parent`.`Value` = 7", values, 4 );
+    ok( count == 2, "got %u rows\n", count );
+    ok( (values[0] == 7 && values[1] == 307) || (values[0] == 307 && values[1] == 7),
+        "got %d, %d\n", values[0], values[1] );
+
+    count = get_query_values( hdb, 0, "SELECT `Parent`.`Value` FROM `Child`, `Parent` "
+                              "WHERE `Parent`.`Id` = `Child`.`Parent_` AND `Child`.`Num` > 598000", values, 4 );
+    ok( count == 1, "got %u rows\n", count );
+    ok( values[0] == 299, "got %d\n", values[0] );
+
+    rec = MsiCreateRecord( 1 );
+    MsiRecordSetInteger( rec, 1, 5000 );
+    count = get_query_values( hdb, rec, "SELECT `Key` FROM `Child` WHERE `Num` = ?", values, 4 );
+    ok( count == 1, "got %u rows\n", count );
+    ok( values[0] == 5, "got %d\n", values[0] );
+    MsiRecordSetStringA( rec, 1, "P299" );
+    count = get_query_values( hdb, rec, "SELECT `Key` FROM `Child` WHERE `Parent_` = ? AND `Key` < 1000", values, 4 );
+    ok( count == 2, "got %u rows\n", count );
+    MsiCloseHandle( rec );
+
+    /* the lookups have to follow changes to the table */
+    r = run_query( hdb, 0, "DELETE FROM `Parent` WHERE `Id` = 'P42'" );
+    ok( r == ERROR_SUCCESS, "got %u\n", r );
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Id` = 'P42'", values, 4 );
+    ok( count == 0, "got %u rows\n", count );
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Id` = 'P43'", values, 4 );
+    ok( count == 1, "got %u rows\n", count );
+    ok( values[0] == 43, "got %d\n", values[0] );
+
+    r = run_query( hdb, 0, "INSERT INTO `Parent` (`Id`, `Value`) VALUES ('P42', 4242)" );
+    ok( r == ERROR_SUCCESS, "got %u\n", r );
+    r = run_query( hdb, 0, "INSERT INTO `Parent` (`Id`, `Value`) VALUES ('P42', 4243)" );
+    ok( r == ERROR_FUNCTION_FAILED, "got %u\n", r );
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Id` = 'P42'", values, 4 );
+    ok( count == 1, "got %u rows\n", count );
+    ok( values[0] == 4242, "got %d\n", values[0] );
+
+    r = run_query( hdb, 0, "UPDATE `Parent` SET `Value` = 1 WHERE `Id` = 'P43'" );
+    ok( r == ERROR_SUCCESS, "got %u\n", r );
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Value` = 1", values, 4 );
+    ok( count == 2, "got %u rows\n", count );
+    count = get_query_values( hdb, 0, "SELECT `Value` FROM `Parent` WHERE `Value` = 43", values, 4 );
+    ok( count == 0, "got %u rows\n", count );
+
+    MsiCloseHandle( hdb );
+    DeleteFileA( msifile );
+}
+
+static void test_lookup_performance(void)
+{
+    MSIHANDLE hdb, rec;
+    DWORD start;
+    char id[16];
+    int value;
+    UINT i, count = 0;
+
+    if (!winetest_benchmark)
+        return;
+
+    hdb = create_db();
+    ok( hdb, "failed to create db\n" );
+
+    start = GetTickCount();
+    create_lookup_tables( hdb, 10000, 20000 );
+    trace( "inserting 30000 rows took %u ms\n", GetTickCount() - start );
+
+    start = GetTickCount();
+    count = get_query_values( hdb, 0, "SELECT `Parent`.`Value` FROM `Child`, `Parent` "
+                              "WHERE `Child`.`Parent_` = `Parent`.`Id`", &value, 1 );
+    ok( count == 20000, "got %u rows\n", count );
+    trace( "joining 20000 rows took %u ms\n", GetTickCount() - start );
+
+    rec = MsiCreateRecord( 1 );
+    start = GetTickCount();
+    for (i = 0; i < 10000; i++)
+    {
+        sprintf( id, "P%u", i );
+        MsiRecordSetStringA( rec, 1, id );
+        count = get_query_values( hdb, rec, "SELECT `Value` FROM `Parent` WHERE `Id` = ?", &value, 1 );
+        ok( count == 1, "got %u rows\n", count );
+    }
+    trace( "10000 key lookups took %u ms\n", GetTickCount() - start );
+    MsiCloseHandle( rec );
+
+    MsiCloseHandle( hdb );
+    DeleteFileA( msifile );
+}
+
 START_TEST(db)
 {
     test_msidatabase();
@@ -9255,4 +9408,6 @@ START_TEST(db)
     test_viewmodify_merge();
     test_viewmodify_insert();
     test_view_get_error();
+    test_lookups();
+    test_lookup_performance();
 }
@@ -51,6 +51,9 @@ typedef struct tagJOINTABLE
     UINT col_count;
     UINT row_count;
     UINT table_index;
+    struct expr *lookup_col; /* "lookup_col = lookup_val" selects the rows to visit */
+    struct expr *lookup_val;
+    UINT lookup_rec_index;   /* record field of lookup_val if it's a wildcard */
 } JOINTABLE;
 
 typedef struct tagMSIORDERINFO
@@ -77,6 +80,8 @@ typedef struct tagMSIWHEREVIEW
 
 static UINT WHERE_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
                             struct expr *cond, INT *val, MSIRECORD *record );
+static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
+                             UINT table_rows[] );
 
 #define INITIAL_REORDER_SIZE 16
 
@@ -646,38 +651,124 @@ static UINT WHERE_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
     return ERROR_SUCCESS;
 }
 
+/* Computes the value lookup_col must have, in the form returned by fetch_int.
+ * Returns ERROR_NO_MORE_ITEMS if no row can match, and ERROR_CONTINUE if
+ * all rows have to be checked. */
+static UINT get_lookup_value( MSIWHEREVIEW *wv, const JOINTABLE *table, const UINT rows[],
+                              MSIRECORD *record, UINT *val )
+{
+    const struct expr *expr = table->lookup_val;
+    const WCHAR *str;
+    UINT tval;
+    INT ival;
+
+    if (table->lookup_col->type == EXPR_COL_NUMBER_STRING)
+    {
+        switch (expr->type)
+        {
+        case EXPR_COL_NUMBER_STRING:
+            if (expr_fetch_value( &expr->u.column, rows, &tval ))
+                return ERROR_CONTINUE;
+            str = msi_string_lookup( wv->db->strings, tval, NULL );
+            break;
+        case EXPR_SVAL:
+            str = expr->u.sval;
+            break;
+        default:
+            str = MSI_RecordGetString( record, table->lookup_rec_index );
+            break;
+        }
+
+        /* empty strings compare equal to null ones */
+        if (!str || !*str)
+            return ERROR_CONTINUE;
+        if (msi_string2id( wv->db->strings, str, -1, val ))
+            return ERROR_NO_MORE_ITEMS;
+        return ERROR_SUCCESS;
+    }
+
+    switch (expr->type)
+    {
+    case EXPR_COL_NUMBER:
+    case EXPR_COL_NUMBER32:
+        if (expr_fetch_value( &expr->u.column, rows, &tval ))
+            return ERROR_CONTINUE;
+        ival = tval - (expr->type == EXPR_COL_NUMBER ? 0x8000 : 0x80000000);
+        break;
+    case EXPR_UVAL:
+        ival = expr->u.uval;
+        break;
+    default:
+        ival = MSI_RecordGetInteger( record, table->lookup_rec_index );
+        break;
+    }
+
+    if (table->lookup_col->type == EXPR_COL_NUMBER)
+    {
+        if (ival < -0x8000 || ival > 0x7fff)
+            return ERROR_NO_MORE_ITEMS;
+        *val = ival + 0x8000;
+    }
+    else
+        *val = ival + 0x80000000;
+    return ERROR_SUCCESS;
+}
+
+/* Evaluates the condition for the current row of the first table in the list
+ * and descends into the remaining tables. Returns FALSE to stop iterating. */
+static BOOL check_row( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
+                       UINT table_rows[], UINT *r )
+{
+    INT val = 0;
+
+    wv->rec_index = 0;
+    *r = WHERE_evaluate( wv, table_rows, wv->cond, &val, record );
+    if (*r != ERROR_SUCCESS && *r != ERROR_CONTINUE)
+        return FALSE;
+    if (!val)
+        return TRUE;
+
+    if (*(tables + 1))
+        *r = check_condition( wv, record, tables + 1, table_rows );
+    else if (*r == ERROR_SUCCESS)
+        add_row( wv, table_rows );
+    return *r == ERROR_SUCCESS;
+}
+
 static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
                              UINT table_rows[] )
 {
-    UINT r = ERROR_FUNCTION_FAILED;
-    INT val;
+    JOINTABLE *table = *tables;
+    UINT r = ERROR_CONTINUE, val, *row = &table_rows[table->table_index];
+    MSIITERHANDLE handle = NULL;
 
-    for (table_rows[(*tables)->table_index] = 0;
-         table_rows[(*tables)->table_index] < (*tables)->row_count;
-         table_rows[(*tables)->table_index]++)
+    if (table->lookup_col)
+        r = get_lookup_value( wv, table, table_rows, record, &val );
+
+    if (r == ERROR_SUCCESS)
     {
-        val = 0;
-        wv->rec_index = 0;
-        r = WHERE_evaluate( wv, table_rows, wv->cond, &val, record );
-        if (r != ERROR_SUCCESS && r != ERROR_CONTINUE)
-            break;
-        if (val)
+        /* only visit the rows that can satisfy the equality */
+        while (!(r = table->view->ops->find_matching_rows( table->view,
+                        table->lookup_col->u.column.parsed.column, val, row, &handle )))
         {
-            if (*(tables + 1))
-            {
-                r = check_condition(wv, record, tables + 1, table_rows);
-                if (r != ERROR_SUCCESS)
-                    break;
-            }
-            else
-            {
-                if (r != ERROR_SUCCESS)
-                    break;
-                add_row (wv, table_rows);
-            }
+            if (!check_row( wv, record, tables, table_rows, &r ))
+                break;
         }
+        if (r == ERROR_NO_MORE_ITEMS)
+            r = ERROR_SUCCESS;
     }
-    table_rows[(*tables)->table_index] = INVALID_ROW_INDEX;
+    else if (r == ERROR_NO_MORE_ITEMS)
+        r = ERROR_SUCCESS;
+    else
+    {
+        r = ERROR_FUNCTION_FAILED;
+        for (*row = 0; *row < table->row_count; (*row)++)
+        {
+            if (!check_row( wv, record, tables, table_rows, &r ))
+                break;
+        }
+    }
+    *row = INVALID_ROW_INDEX;
     return r;
 }
 
@@ -785,6 +876,82 @@ static UINT reorder_check( const struct expr *expr, JOINTABLE **ordered_tables,
     }
 }
 
+static BOOL is_lookup_column( const struct expr *expr, const JOINTABLE *table, BOOL string )
+{
+    if (string && expr->type != EXPR_COL_NUMBER_STRING)
+        return FALSE;
+    if (!string && expr->type != EXPR_COL_NUMBER && expr->type != EXPR_COL_NUMBER32)
+        return FALSE;
+    return expr->u.column.parsed.table == table;
+}
+
+/* checks if the value is known once the tables before table are bound */
+static BOOL is_lookup_value( const struct expr *expr, JOINTABLE **tables, const JOINTABLE *table,
+                             BOOL string, const MSIRECORD *record )
+{
+    switch (expr->type)
+    {
+    case EXPR_COL_NUMBER:
+    case EXPR_COL_NUMBER32:
+    case EXPR_COL_NUMBER_STRING:
+        if (string != (expr->type == EXPR_COL_NUMBER_STRING))
+            return FALSE;
+        for (; *tables != table; tables++)
+            if (*tables == expr->u.column.parsed.table) return TRUE;
+        return FALSE;
+    case EXPR_UVAL:
+        return !string;
+    case EXPR_SVAL:
+        return string;
+    case EXPR_WILDCARD:
+        return record != NULL;
+    default:
+        return FALSE;
+    }
+}
+
+/* Looks for an equality in the top level AND chain of the condition that can be
+ * used to look up the rows of table. rec_index counts the wildcards in the same
+ * order as WHERE_evaluate. */
+static void find_lookup( JOINTABLE **tables, JOINTABLE *table, struct expr *expr,
+                         BOOL conjunct, const MSIRECORD *record, UINT *rec_index )
+{
+    struct expr *left, *right;
+    BOOL string;
+
+    if (expr->type == EXPR_WILDCARD)
+        (*rec_index)++;
+    if (expr->type != EXPR_COMPLEX && expr->type != EXPR_STRCMP)
+        return;
+
+    left = expr->u.expr.left;
+    right = expr->u.expr.right;
+    string = expr->type == EXPR_STRCMP;
+
+    if (conjunct && !table->lookup_col && expr->u.expr.op == OP_EQ)
+    {
+        if (is_lookup_column( left, table, string ) &&
+            is_lookup_value( right, tables, table, string, record ))
+        {
+            table->lookup_col = left;
+            table->lookup_val = right;
+        }
+        else if (is_lookup_column( right, table, string ) &&
+                 is_lookup_value( left, tables, table, string, record ))
+        {
+            table->lookup_col = right;
+            table->lookup_val = left;
+        }
+        /* the other side is a column, so a wildcard value is the next field */
+        if (table->lookup_col)
+            table->lookup_rec_index = *rec_index + 1;
+    }
+
+    conjunct = conjunct && expr->type == EXPR_COMPLEX && expr->u.expr.op == OP_AND;
+    find_lookup( tables, table, left, conjunct, record, rec_index );
+    find_lookup( tables, table, right, conjunct, record, rec_index );
+}
+
 /* reorders the tablelist in a way to evaluate the condition as fast as possible */
 static JOINTABLE **ordertables( MSIWHEREVIEW *wv )
 {
@@ -847,6 +1014,19 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
 
     ordered_tables = ordertables( wv );
 
+    for (i = 0; i < wv->table_count; i++)
+    {
+        UINT rec_index = 0;
+
+        table = ordered_tables[i];
+        table->lookup_col = NULL;
+        if (wv->cond && table->view->ops->find_matching_rows)
+            find_lookup( ordered_tables, table, wv->cond, TRUE, record, &rec_index );
+        if (table->lookup_col)
+            TRACE("looking up rows of table %u by column %u\n", table->table_index,
+                  table->lookup_col->u.column.parsed.column);
+    }
+
     rows = msi_alloc( wv->table_count * sizeof(*rows) );
     for (i = 0; i < wv->table_count; i++)
         rows[i] = INVALID_ROW_INDEX;
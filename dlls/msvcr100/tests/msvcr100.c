@@ -170,8 +170,8 @@ struct SchedulerVtbl {
     unsigned int (__thiscall *Release)(Scheduler*);
     void (__thiscall *RegisterShutdownEvent)(Scheduler*,HANDLE);
     void (__thiscall *Attach)(Scheduler*);
-    /* CreateScheduleGroup */
-    /* ScheduleTask */
+    void* (__thiscall *CreateScheduleGroup)(Scheduler*);
+    void (__thiscall *ScheduleTask)(Scheduler*,void (__cdecl*)(void*),void*);
 };
 
 static int* (__cdecl *p_errno)(void);
@@ -989,6 +989,134 @@ static void test_Scheduler(void)
     call_func1(p_SchedulerPolicy_dtor, &policy);
 }
 
+struct scheduled_tasks {
+    Scheduler *scheduler;
+    HANDLE done;
+    LONG count;
+    LONG expected;
+    LONG threads;
+    LONG other_scheduler;
+    DWORD thread_ids[64];
+};
+
+static void __cdecl count_task(void *arg)
+{
+    struct scheduled_tasks *tasks = arg;
+    DWORD tid = GetCurrentThreadId();
+    LONG i, n = min(tasks->threads, ARRAY_SIZE(tasks->thread_ids));
+
+    for(i = 0; i < n; i++)
+        if(tasks->thread_ids[i] == tid) break;
+    if(i == n && n < ARRAY_SIZE(tasks->thread_ids))
+    {
+        i = InterlockedIncrement(&tasks->threads) - 1;
+        if(i < ARRAY_SIZE(tasks->thread_ids)) tasks->thread_ids[i] = tid;
+    }
+
+    if(InterlockedIncrement(&tasks->count) == tasks->expected)
+        SetEvent(tasks->done);
+}
+
+static void __cdecl fork_task(void *arg)
+{
+    struct scheduled_tasks *tasks = arg;
+    Scheduler *scheduler = p_CurrentScheduler_Get();
+    int i;
+
+    /* tasks run with the scheduler they were scheduled on as current scheduler */
+    if(scheduler != tasks->scheduler)
+        InterlockedIncrement(&tasks->other_scheduler);
+    for(i = 0; i < 100; i++)
+        call_func3(scheduler->vtable->ScheduleTask, scheduler, count_task, tasks);
+    count_task(tasks);
+}
+
+static void __cdecl fan_out_task(void *arg)
+{
+    struct scheduled_tasks *tasks = arg;
+
+    if(InterlockedIncrement(&tasks->count) == tasks->expected)
+        SetEvent(tasks->done);
+}
+
+static void test_Scheduler_ScheduleTask(void)
+{
+    struct scheduled_tasks tasks;
+    Scheduler *scheduler;
+    SchedulerPolicy policy;
+    unsigned int i, n, procs;
+    SYSTEM_INFO si;
+    DWORD ret, start;
+
+    GetSystemInfo(&si);
+    procs = si.dwNumberOfProcessors;
+
+    call_func1(p_SchedulerPolicy_ctor, &policy);
+    scheduler = p_Scheduler_Create(&policy);
+    ok(scheduler != NULL, "Scheduler::Create() = NULL\n");
+
+    memset(&tasks, 0, sizeof(tasks));
+    tasks.scheduler = scheduler;
+    tasks.done = CreateEventW(NULL, FALSE, FALSE, NULL);
+    tasks.expected = 1000;
+    for(i = 0; i < 1000; i++)
+        call_func3(scheduler->vtable->ScheduleTask, scheduler, count_task, &tasks);
+    ret = WaitForSingleObject(tasks.done, 5000);
+    ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+    ok(tasks.count == 1000, "count = %d\n", tasks.count);
+    ok(tasks.threads >= 1, "tasks were run on %d threads\n", tasks.threads);
+    n = call_func1(scheduler->vtable->GetNumberOfVirtualProcessors, scheduler);
+    ok(tasks.threads <= n, "tasks were run on %d threads, expected at most %u\n", tasks.threads, n);
+
+    /* tasks scheduled from tasks */
+    tasks.count = 0;
+    tasks.expected = 10 * 101;
+    for(i = 0; i < 10; i++)
+        call_func3(scheduler->vtable->ScheduleTask, scheduler, fork_task, &tasks);
+    ret = WaitForSingleObject(tasks.done, 5000);
+    ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+    ok(tasks.count == 10 * 101, "count = %d\n", tasks.count);
+    ok(!tasks.other_scheduler, "%d tasks were run on another scheduler\n", tasks.other_scheduler);
+    call_func1(scheduler->vtable->Release, scheduler);
+
+    call_func3(p_SchedulerPolicy_SetConcurrencyLimits, &policy, 1, 1);
+    scheduler = p_Scheduler_Create(&policy);
+    ok(scheduler != NULL, "Scheduler::Create() = NULL\n");
+    tasks.count = 0;
+    tasks.threads = 0;
+    tasks.expected = 100;
+    for(i = 0; i < 100; i++)
+        call_func3(scheduler->vtable->ScheduleTask, scheduler, count_task, &tasks);
+    ret = WaitForSingleObject(tasks.done, 5000);
+    ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+    ok(tasks.threads == 1, "tasks were run on %d threads\n", tasks.threads);
+    call_func1(scheduler->vtable->Release, scheduler);
+
+    /* parallel_for-like fan-out of small tasks across concurrency levels */
+    if(winetest_benchmark)
+    {
+        for(n = 1;; n = min(n * 2, procs))
+        {
+            call_func3(p_SchedulerPolicy_SetConcurrencyLimits, &policy, 1, n);
+            scheduler = p_Scheduler_Create(&policy);
+            tasks.count = 0;
+            tasks.expected = 100000;
+
+            start = GetTickCount();
+            for(i = 0; i < 100000; i++)
+                call_func3(scheduler->vtable->ScheduleTask, scheduler, fan_out_task, &tasks);
+            ret = WaitForSingleObject(tasks.done, 60000);
+            ok(ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret);
+            trace("%u virtual processors: 100000 tasks in %u ms\n", n, GetTickCount() - start);
+            call_func1(scheduler->vtable->Release, scheduler);
+            if(n == procs) break;
+        }
+    }
+
+    call_func1(p_SchedulerPolicy_dtor, &policy);
+    CloseHandle(tasks.done);
+}
+
 static void test__memicmp(void)
 {
     static const char *s1 = "abc";
@@ -1113,6 +1241,7 @@ START_TEST(msvcr100)
 
     test_ExternalContextBase();
     test_Scheduler();
+    test_Scheduler_ScheduleTask();
     test_wmemcpy_s();
     test_wmemmove_s();
     test_fread_s();
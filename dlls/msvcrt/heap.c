@@ -25,6 +25,7 @@
 #include "msvcrt.h"
 #include "mtdll.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(msvcrt);
 
@@ -53,6 +54,510 @@ static unsigned int MSVCRT_amblksiz = 16;
 /* FIXME - According to documentation it should be 480 bytes, at runtime default is 0 */
 static MSVCRT_size_t MSVCRT_sbh_threshold = 0;
 
+/* Small allocations are served from 64k spans of equally sized blocks. Each
+ * thread keeps free lists per size class which are refilled from, and
+ * returned to, the spans of the size class in batches, so most malloc/free
+ * calls don't take any lock. Every block starts with a header holding the
+ * requested size, needed for _msize and realloc. A span is released once
+ * none of its blocks are in use, unless it's the last one of its class with
+ * free blocks.
+ *
+ * As with the small block heap, these blocks are not part of the heap
+ * returned by _get_heap_handle(), so HeapSize, HeapFree or HeapValidate
+ * can't be used on them. _msize, _heapchk, _heapmin, _heapset and _heapwalk
+ * handle them, _heapwalk reports them after the heap blocks. */
+#define SMALL_SPAN_SHIFT    16
+#define SMALL_SPAN_SIZE     (1 << SMALL_SPAN_SHIFT)
+#define SMALL_SPAN_HEADER   64
+#define SMALL_HEADER_SIZE   (2 * sizeof(void*))
+#define SMALL_MAX_BLOCK     1024
+#define SMALL_CLASS_COUNT   20
+#define SMALL_USED_MAGIC    0x44455355
+#define SMALL_FREE_MAGIC    0x45455246
+
+#ifdef _WIN64
+#define SMALL_SPAN_MAP_SIZE (1 << 16)
+#else
+#define SMALL_SPAN_MAP_SIZE 1
+#endif
+
+struct small_block
+{
+    union
+    {
+        MSVCRT_size_t       size;
+        struct small_block *next;
+    } u;
+    MSVCRT_size_t magic;
+};
+
+struct small_span
+{
+    struct list         entry;      /* entry in the class list, if the span has free blocks */
+    struct list         all_entry;  /* entry in the list of all spans */
+    struct small_block *free;       /* freed blocks */
+    char               *next;       /* first block never handed out */
+    unsigned int        used;       /* blocks handed out, including the ones in thread caches */
+    unsigned int        class;
+};
+
+C_ASSERT(sizeof(struct small_span) <= SMALL_SPAN_HEADER);
+
+struct small_class
+{
+    SRWLOCK             lock;
+    unsigned int        block_size;
+    unsigned int        batch;
+    struct list         spans;
+};
+
+struct small_cache
+{
+    struct small_block *free[SMALL_CLASS_COUNT];
+    unsigned int        count[SMALL_CLASS_COUNT];
+};
+
+static struct small_class small_classes[SMALL_CLASS_COUNT];
+static BYTE small_class_index[SMALL_MAX_BLOCK / 16 + 1];
+static DWORD *small_span_map[SMALL_SPAN_MAP_SIZE];
+static struct list small_spans = LIST_INIT(small_spans);
+static SRWLOCK small_span_lock = SRWLOCK_INIT;  /* taken before the class locks */
+static DWORD small_cache_tls = TLS_OUT_OF_INDEXES;
+
+static void small_init(void)
+{
+    unsigned int i, c, size = 16, step = 16;
+
+    for (c = 0; c < SMALL_CLASS_COUNT; c++)
+    {
+        InitializeSRWLock(&small_classes[c].lock);
+        small_classes[c].block_size = size;
+        small_classes[c].batch = max(8, min(64, 8192 / size));
+        list_init(&small_classes[c].spans);
+        if (size >= 8 * step) step *= 2;
+        size += step;
+    }
+
+    for (i = 0, c = 0; i < ARRAY_SIZE(small_class_index); i++)
+    {
+        while (small_classes[c].block_size < i * 16) c++;
+        small_class_index[i] = c;
+    }
+
+    small_cache_tls = TlsAlloc();
+}
+
+static struct small_span *small_span_from_ptr(const void *ptr)
+{
+    ULONG_PTR key = (ULONG_PTR)ptr >> SMALL_SPAN_SHIFT;
+    DWORD *leaf;
+
+    if ((key >> 16) >= SMALL_SPAN_MAP_SIZE || !(leaf = small_span_map[key >> 16]))
+        return NULL;
+    if (!(leaf[(key & 0xffff) / 32] & (1u << (key % 32))))
+        return NULL;
+    return (struct small_span *)(key << SMALL_SPAN_SHIFT);
+}
+
+static inline struct small_block *small_span_first(struct small_span *span)
+{
+    return (struct small_block*)((char*)span + SMALL_SPAN_HEADER);
+}
+
+static inline char *small_span_end(struct small_span *span)
+{
+    unsigned int block_size = small_classes[span->class].block_size;
+
+    return (char*)small_span_first(span) + (SMALL_SPAN_SIZE - SMALL_SPAN_HEADER) / block_size * block_size;
+}
+
+static struct small_span *small_new_span(unsigned int idx)
+{
+    struct small_span *span;
+    ULONG_PTR key;
+    DWORD **leaf;
+
+    if (!(span = VirtualAlloc(NULL, SMALL_SPAN_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)))
+        return NULL;
+    key = (ULONG_PTR)span >> SMALL_SPAN_SHIFT;
+    span->free = NULL;
+    span->next = (char*)small_span_first(span);
+    span->used = 0;
+    span->class = idx;
+
+    AcquireSRWLockExclusive(&small_span_lock);
+    leaf = &small_span_map[key >> 16];
+    if ((key >> 16) >= SMALL_SPAN_MAP_SIZE ||
+            (!*leaf && !(*leaf = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 0x10000 / 8))))
+    {
+        ReleaseSRWLockExclusive(&small_span_lock);
+        VirtualFree(span, 0, MEM_RELEASE);
+        return NULL;
+    }
+    (*leaf)[(key & 0xffff) / 32] |= 1u << (key % 32);
+    list_add_head(&small_spans, &span->all_entry);
+    ReleaseSRWLockExclusive(&small_span_lock);
+    return span;
+}
+
+/* frees spans linked through their class entry, which are no longer in a class list */
+static void small_release_spans(struct list *spans)
+{
+    struct small_span *span, *next;
+    ULONG_PTR key;
+
+    if (list_empty(spans)) return;
+
+    AcquireSRWLockExclusive(&small_span_lock);
+    LIST_FOR_EACH_ENTRY(span, spans, struct small_span, entry)
+    {
+        key = (ULONG_PTR)span >> SMALL_SPAN_SHIFT;
+        small_span_map[key >> 16][(key & 0xffff) / 32] &= ~(1u << (key % 32));
+        list_remove(&span->all_entry);
+    }
+    ReleaseSRWLockExclusive(&small_span_lock);
+
+    LIST_FOR_EACH_ENTRY_SAFE(span, next, spans, struct small_span, entry)
+        VirtualFree(span, 0, MEM_RELEASE);
+}
+
+/* returns a block to its span, the class lock must be held; an unused span
+ * is moved to the release list */
+static void small_put_block(struct small_class *class, struct small_block *block, struct list *release)
+{
+    struct small_span *span = (struct small_span*)((ULONG_PTR)block & ~(ULONG_PTR)(SMALL_SPAN_SIZE - 1));
+
+    /* full spans are not in the class list */
+    if (list_empty(&span->entry))
+        list_add_tail(&class->spans, &span->entry);
+    block->u.next = span->free;
+    span->free = block;
+    if (--span->used) return;
+
+    /* keep the last span to avoid mapping a new one for the next allocation */
+    if (list_head(&class->spans) == &span->entry && !list_next(&class->spans, &span->entry))
+        return;
+    list_remove(&span->entry);
+    list_add_tail(release, &span->entry);
+}
+
+/* moves a batch of blocks from the spans of the size class to the thread cache */
+static BOOL small_refill(struct small_cache *cache, unsigned int idx)
+{
+    struct small_class *class = &small_classes[idx];
+    struct small_block *block;
+    struct small_span *span;
+    struct list *ptr;
+    unsigned int i;
+
+    AcquireSRWLockExclusive(&class->lock);
+    for (i = 0; i < class->batch; i++)
+    {
+        if (!(ptr = list_head(&class->spans)))
+        {
+            ReleaseSRWLockExclusive(&class->lock);
+            span = small_new_span(idx);
+            AcquireSRWLockExclusive(&class->lock);
+            if (!span) break;
+            list_add_head(&class->spans, &span->entry);
+        }
+        else span = LIST_ENTRY(ptr, struct small_span, entry);
+
+        if ((block = span->free))
+        {
+            span->free = block->u.next;
+        }
+        else
+        {
+            block = (struct small_block*)span->next;
+            block->magic = SMALL_FREE_MAGIC;
+            span->next += class->block_size;
+        }
+        span->used++;
+        if (!span->free && span->next == small_span_end(span))
+        {
+            list_remove(&span->entry);
+            list_init(&span->entry);
+        }
+
+        block->u.next = cache->free[idx];
+        cache->free[idx] = block;
+    }
+    ReleaseSRWLockExclusive(&class->lock);
+
+    cache->count[idx] += i;
+    return i != 0;
+}
+
+/* returns the count blocks at the head of the thread cache list */
+static void small_flush(struct small_cache *cache, unsigned int idx, unsigned int count)
+{
+    struct small_class *class = &small_classes[idx];
+    struct list release = LIST_INIT(release);
+    struct small_block *block;
+
+    if (!count) return;
+    cache->count[idx] -= count;
+
+    AcquireSRWLockExclusive(&class->lock);
+    while (count--)
+    {
+        block = cache->free[idx];
+        cache->free[idx] = block->u.next;
+        small_put_block(class, block, &release);
+    }
+    ReleaseSRWLockExclusive(&class->lock);
+
+    small_release_spans(&release);
+}
+
+static void* small_alloc(DWORD flags, MSVCRT_size_t size)
+{
+    /* keep at least one byte of data, a block ending at the span end would be
+     * looked up in the next span */
+    unsigned int idx = small_class_index[(max(size, 1) + SMALL_HEADER_SIZE + 15) / 16];
+    struct small_cache *cache;
+    struct small_block *block;
+
+    if (small_cache_tls == TLS_OUT_OF_INDEXES)
+        return NULL;
+
+    if (!(cache = TlsGetValue(small_cache_tls)))
+    {
+        if (!(cache = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache))))
+            return NULL;
+        TlsSetValue(small_cache_tls, cache);
+    }
+
+    if (!cache->free[idx] && !small_refill(cache, idx))
+        return NULL;
+
+    block = cache->free[idx];
+    cache->free[idx] = block->u.next;
+    cache->count[idx]--;
+
+    block->u.size = size;
+    block->magic = SMALL_USED_MAGIC;
+    if (flags & HEAP_ZERO_MEMORY)
+        memset(block + 1, 0, size);
+    return block + 1;
+}
+
+static struct small_block *small_get_block(struct small_span *span, void *ptr)
+{
+    struct small_block *block = (struct small_block*)ptr - 1;
+
+    if ((char*)block < (char*)small_span_first(span) ||
+            ((char*)block - (char*)small_span_first(span)) % small_classes[span->class].block_size ||
+            block->magic != SMALL_USED_MAGIC)
+    {
+        WARN("invalid or already freed block %p\n", ptr);
+        return NULL;
+    }
+    return block;
+}
+
+static BOOL small_free(struct small_span *span, void *ptr)
+{
+    struct small_block *block = small_get_block(span, ptr);
+    struct small_class *class = &small_classes[span->class];
+    struct list release = LIST_INIT(release);
+    struct small_cache *cache;
+
+    if (!block) return FALSE;
+    block->magic = SMALL_FREE_MAGIC;
+
+    /* blocks freed after the thread cache was released go straight back */
+    if (small_cache_tls == TLS_OUT_OF_INDEXES || !(cache = TlsGetValue(small_cache_tls)))
+    {
+        AcquireSRWLockExclusive(&class->lock);
+        small_put_block(class, block, &release);
+        ReleaseSRWLockExclusive(&class->lock);
+        small_release_spans(&release);
+        return TRUE;
+    }
+
+    block->u.next = cache->free[span->class];
+    cache->free[span->class] = block;
+    if (++cache->count[span->class] > 2 * class->batch)
+        small_flush(cache, span->class, class->batch);
+    return TRUE;
+}
+
+static void* small_realloc(struct small_span *span, DWORD flags, void *ptr, MSVCRT_size_t size)
+{
+    struct small_block *block = small_get_block(span, ptr);
+    void *ret;
+
+    if (!block) return NULL;
+
+    if (size + SMALL_HEADER_SIZE <= small_classes[span->class].block_size)
+    {
+        if ((flags & HEAP_ZERO_MEMORY) && size > block->u.size)
+            memset((char*)ptr + block->u.size, 0, size - block->u.size);
+        block->u.size = size;
+        return ptr;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY)
+        return NULL;
+
+    if (size <= SMALL_MAX_BLOCK - SMALL_HEADER_SIZE && (ret = small_alloc(flags, size)))
+        ;
+    else if (!(ret = HeapAlloc(heap, flags, size)))
+        return NULL;
+    memcpy(ret, ptr, block->u.size);
+    small_free(span, ptr);
+    return ret;
+}
+
+void msvcrt_free_heap_cache(void)
+{
+    struct small_cache *cache;
+    unsigned int i;
+
+    if (small_cache_tls == TLS_OUT_OF_INDEXES || !(cache = TlsGetValue(small_cache_tls)))
+        return;
+
+    TlsSetValue(small_cache_tls, NULL);
+    for (i = 0; i < SMALL_CLASS_COUNT; i++)
+        small_flush(cache, i, cache->count[i]);
+    HeapFree(GetProcessHeap(), 0, cache);
+}
+
+/* releases the current thread cache and the unused spans */
+static void small_trim(void)
+{
+    struct list release = LIST_INIT(release);
+    struct small_span *span, *next;
+    unsigned int i;
+
+    msvcrt_free_heap_cache();
+    for (i = 0; i < SMALL_CLASS_COUNT; i++)
+    {
+        AcquireSRWLockExclusive(&small_classes[i].lock);
+        LIST_FOR_EACH_ENTRY_SAFE(span, next, &small_classes[i].spans, struct small_span, entry)
+        {
+            if (span->used) continue;
+            list_remove(&span->entry);
+            list_add_tail(&release, &span->entry);
+        }
+        ReleaseSRWLockExclusive(&small_classes[i].lock);
+    }
+    small_release_spans(&release);
+}
+
+/* checks that all the blocks handed out so far have a valid header */
+static BOOL small_validate(void)
+{
+    struct small_block *block = NULL;
+    struct small_class *class;
+    struct small_span *span;
+    BOOL ret = TRUE;
+
+    AcquireSRWLockExclusive(&small_span_lock);
+    LIST_FOR_EACH_ENTRY(span, &small_spans, struct small_span, all_entry)
+    {
+        class = &small_classes[span->class];
+        AcquireSRWLockShared(&class->lock);
+        for (block = small_span_first(span); (char*)block < span->next;
+                block = (struct small_block*)((char*)block + class->block_size))
+        {
+            if (block->magic != SMALL_USED_MAGIC && block->magic != SMALL_FREE_MAGIC)
+            {
+                ret = FALSE;
+                break;
+            }
+        }
+        ReleaseSRWLockShared(&class->lock);
+        if (!ret) break;
+    }
+    ReleaseSRWLockExclusive(&small_span_lock);
+
+    if (!ret) WARN("invalid block header %p\n", block);
+    return ret;
+}
+
+/* reports the small block after the given entry, starting with the first one
+ * if the entry isn't a small block */
+static int small_heapwalk(struct MSVCRT__heapinfo *next)
+{
+    struct small_block *block = NULL;
+    struct small_class *class;
+    struct small_span *span;
+    struct list *ptr = &small_spans;
+
+    AcquireSRWLockExclusive(&small_span_lock);
+    if ((span = small_span_from_ptr(next->_pentry)))
+    {
+        class = &small_classes[span->class];
+        block = (struct small_block*)next->_pentry - 1;
+        if ((char*)block < (char*)small_span_first(span) ||
+                ((char*)block - (char*)small_span_first(span)) % class->block_size)
+        {
+            ReleaseSRWLockExclusive(&small_span_lock);
+            return MSVCRT__HEAPBADNODE;
+        }
+        block = (struct small_block*)((char*)block + class->block_size);
+        ptr = &span->all_entry;
+    }
+
+    for (;;)
+    {
+        if (span)
+        {
+            class = &small_classes[span->class];
+            AcquireSRWLockShared(&class->lock);
+            if ((char*)block < span->next)
+            {
+                next->_pentry = (int*)(block + 1);
+                if (block->magic == SMALL_USED_MAGIC)
+                {
+                    next->_size = block->u.size;
+                    next->_useflag = MSVCRT__USEDENTRY;
+                }
+                else
+                {
+                    next->_size = class->block_size - SMALL_HEADER_SIZE;
+                    next->_useflag = MSVCRT__FREEENTRY;
+                }
+                ReleaseSRWLockShared(&class->lock);
+                ReleaseSRWLockExclusive(&small_span_lock);
+                return MSVCRT__HEAPOK;
+            }
+            ReleaseSRWLockShared(&class->lock);
+        }
+        if (!(ptr = list_next(&small_spans, ptr))) break;
+        span = LIST_ENTRY(ptr, struct small_span, all_entry);
+        block = small_span_first(span);
+    }
+    ReleaseSRWLockExclusive(&small_span_lock);
+    return MSVCRT__HEAPEND;
+}
+
+static void small_destroy(void)
+{
+    struct small_span *span, *next;
+    unsigned int i;
+
+    msvcrt_free_heap_cache();
+    if (small_cache_tls != TLS_OUT_OF_INDEXES)
+    {
+        TlsFree(small_cache_tls);
+        small_cache_tls = TLS_OUT_OF_INDEXES;
+    }
+
+    for (i = 0; i < SMALL_SPAN_MAP_SIZE; i++)
+    {
+        HeapFree(GetProcessHeap(), 0, small_span_map[i]);
+        small_span_map[i] = NULL;
+    }
+    LIST_FOR_EACH_ENTRY_SAFE(span, next, &small_spans, struct small_span, all_entry)
+        VirtualFree(span, 0, MEM_RELEASE);
+    list_init(&small_spans);
+    for (i = 0; i < SMALL_CLASS_COUNT; i++)
+        list_init(&small_classes[i].spans);
+}
+
 static void* msvcrt_heap_alloc(DWORD flags, MSVCRT_size_t size)
 {
     if(size < MSVCRT_sbh_threshold)
@@ -68,11 +573,22 @@ static void* msvcrt_heap_alloc(DWORD flags, MSVCRT_size_t size)
         return memblock;
     }
 
+    if(size <= SMALL_MAX_BLOCK - SMALL_HEADER_SIZE)
+    {
+        void *ret = small_alloc(flags, size);
+        if(ret) return ret;
+    }
+
     return HeapAlloc(heap, flags, size);
 }
 
 static void* msvcrt_heap_realloc(DWORD flags, void *ptr, MSVCRT_size_t size)
 {
+    struct small_span *span;
+
+    if((span = small_span_from_ptr(ptr)))
+        return small_realloc(span, flags, ptr, size);
+
     if(sb_heap && ptr && !HeapValidate(heap, 0, ptr))
     {
         /* TODO: move data to normal heap if it exceeds sbh_threshold limit */
@@ -105,6 +621,11 @@ static void* msvcrt_heap_realloc(DWORD flags, void *ptr, MSVCRT_size_t size)
 
 static BOOL msvcrt_heap_free(void *ptr)
 {
+    struct small_span *span;
+
+    if((span = small_span_from_ptr(ptr)))
+        return small_free(span, ptr);
+
     if(sb_heap && ptr && !HeapValidate(heap, 0, ptr))
     {
         void **saved = SAVED_PTR(ptr);
@@ -116,6 +637,14 @@ static BOOL msvcrt_heap_free(void *ptr)
 
 static MSVCRT_size_t msvcrt_heap_size(void *ptr)
 {
+    struct small_span *span;
+
+    if((span = small_span_from_ptr(ptr)))
+    {
+        struct small_block *block = small_get_block(span, ptr);
+        return block ? block->u.size : ~(MSVCRT_size_t)0;
+    }
+
     if(sb_heap && ptr && !HeapValidate(heap, 0, ptr))
     {
         void **saved = SAVED_PTR(ptr);
@@ -249,6 +778,8 @@ int CDECL _heapchk(void)
     msvcrt_set_errno(GetLastError());
     return MSVCRT__HEAPBADNODE;
   }
+  if (!small_validate())
+    return MSVCRT__HEAPBADNODE;
   return MSVCRT__HEAPOK;
 }
 
@@ -257,6 +788,7 @@ int CDECL _heapchk(void)
  */
 int CDECL _heapmin(void)
 {
+  small_trim();
   if (!HeapCompact( heap, 0 ) ||
           (sb_heap && !HeapCompact( sb_heap, 0 )))
   {
@@ -277,6 +809,10 @@ int CDECL _heapwalk(struct MSVCRT__heapinfo* next)
   if (sb_heap)
       FIXME("small blocks heap not supported\n");
 
+  /* the small blocks are reported after the heap blocks */
+  if (small_span_from_ptr(next->_pentry))
+    return small_heapwalk(next);
+
   LOCK_HEAP;
   phe.lpData = next->_pentry;
   phe.cbData = next->_size;
@@ -296,7 +832,7 @@ int CDECL _heapwalk(struct MSVCRT__heapinfo* next)
     {
       UNLOCK_HEAP;
       if (GetLastError() == ERROR_NO_MORE_ITEMS)
-         return MSVCRT__HEAPEND;
+         return small_heapwalk(next);
       msvcrt_set_errno(GetLastError());
       if (!phe.lpData)
         return MSVCRT__HEAPBADBEGIN;
@@ -868,11 +1404,13 @@ int CDECL MSVCRT_strncpy_s(char *dest, MSVCRT_size_t numberOfElements,
 BOOL msvcrt_init_heap(void)
 {
     heap = HeapCreate(0, 0, 0);
+    if(heap) small_init();
     return heap != NULL;
 }
 
 void msvcrt_destroy_heap(void)
 {
+    small_destroy();
     HeapDestroy(heap);
     if(sb_heap)
         HeapDestroy(sb_heap);
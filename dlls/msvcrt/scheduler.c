@@ -130,6 +130,7 @@ typedef struct {
     int shutdown_size;
     HANDLE *shutdown_events;
     CRITICAL_SECTION cs;
+    struct task_pool *pool;
 } ThreadScheduler;
 extern const vtable_ptr MSVCRT_ThreadScheduler_vtable;
 
@@ -141,7 +142,9 @@ typedef struct {
     char empty;
 } _CurrentScheduler;
 
+static HMODULE msvcrt_module;
 static int context_tls_index = TLS_OUT_OF_INDEXES;
+static int worker_tls_index = TLS_OUT_OF_INDEXES;
 
 static CRITICAL_SECTION default_scheduler_cs;
 static CRITICAL_SECTION_DEBUG default_scheduler_cs_debug =
@@ -598,12 +601,279 @@ void __thiscall SchedulerPolicy_dtor(SchedulerPolicy *this)
     MSVCRT_operator_delete(this->policy_container);
 }
 
+/* Tasks scheduled on a ThreadScheduler are run by up to virt_proc_no worker
+ * threads, started on demand. Every worker owns a task queue: tasks scheduled
+ * from inside a task go to the worker's own queue and are popped in LIFO order,
+ * an idle worker steals the oldest task from the other queues. Tasks scheduled
+ * from other threads are spread over the queues round-robin. The workers run
+ * with the pool's scheduler as their current scheduler, without referencing it:
+ * the scheduler waits for them in its destructor. */
+struct scheduled_task {
+    void (__cdecl *proc)(void*);
+    void *data;
+};
+
+struct task_queue {
+    SRWLOCK lock;
+    struct scheduled_task *tasks;
+    unsigned int head;
+    unsigned int count;
+    unsigned int size;
+    struct task_pool *pool;
+    HANDLE thread;
+};
+
+struct task_pool {
+    LONG ref;
+    Scheduler *scheduler;
+    CRITICAL_SECTION cs;
+    CONDITION_VARIABLE cv;
+    LONG pending;
+    LONG idle;
+    LONG next_queue;
+    BOOL shutdown;
+    unsigned int thread_count;
+    unsigned int queue_count;
+    struct task_queue queues[1];
+};
+
+static struct task_pool* task_pool_create(Scheduler *scheduler, unsigned int queue_count)
+{
+    struct task_pool *pool;
+    unsigned int i;
+
+    if (worker_tls_index == TLS_OUT_OF_INDEXES) {
+        int tls_index = TlsAlloc();
+        if (tls_index == TLS_OUT_OF_INDEXES) {
+            throw_exception(EXCEPTION_SCHEDULER_RESOURCE_ALLOCATION_ERROR,
+                    HRESULT_FROM_WIN32(GetLastError()), NULL);
+            return NULL;
+        }
+
+        if(InterlockedCompareExchange(&worker_tls_index, tls_index, TLS_OUT_OF_INDEXES) != TLS_OUT_OF_INDEXES)
+            TlsFree(tls_index);
+    }
+
+    if(!queue_count) queue_count = 1;
+    pool = MSVCRT_operator_new(FIELD_OFFSET(struct task_pool, queues[queue_count]));
+    memset(pool, 0, FIELD_OFFSET(struct task_pool, queues[queue_count]));
+    pool->ref = 1;
+    pool->scheduler = scheduler;
+    pool->queue_count = queue_count;
+    for(i=0; i<queue_count; i++) {
+        InitializeSRWLock(&pool->queues[i].lock);
+        pool->queues[i].pool = pool;
+    }
+    InitializeConditionVariable(&pool->cv);
+    InitializeCriticalSection(&pool->cs);
+    pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": task_pool");
+    return pool;
+}
+
+static void task_pool_release(struct task_pool *pool)
+{
+    unsigned int i;
+
+    if(InterlockedDecrement(&pool->ref))
+        return;
+
+    if(pool->pending) WARN("%d tasks were never run\n", pool->pending);
+    for(i=0; i<pool->queue_count; i++)
+        MSVCRT_free(pool->queues[i].tasks);
+    pool->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&pool->cs);
+    MSVCRT_operator_delete(pool);
+}
+
+static BOOL task_queue_push(struct task_queue *queue, void (__cdecl *proc)(void*), void *data)
+{
+    unsigned int pos;
+
+    AcquireSRWLockExclusive(&queue->lock);
+    if(queue->count == queue->size) {
+        unsigned int i, size = queue->size ? queue->size * 2 : 16;
+        struct scheduled_task *tasks = MSVCRT_malloc(size * sizeof(*tasks));
+
+        if(!tasks) {
+            ReleaseSRWLockExclusive(&queue->lock);
+            return FALSE;
+        }
+        for(i=0; i<queue->count; i++)
+            tasks[i] = queue->tasks[(queue->head + i) & (queue->size - 1)];
+        MSVCRT_free(queue->tasks);
+        queue->tasks = tasks;
+        queue->size = size;
+        queue->head = 0;
+    }
+    pos = (queue->head + queue->count++) & (queue->size - 1);
+    queue->tasks[pos].proc = proc;
+    queue->tasks[pos].data = data;
+    ReleaseSRWLockExclusive(&queue->lock);
+    return TRUE;
+}
+
+static BOOL task_queue_pop(struct task_queue *queue, BOOL steal, struct scheduled_task *task)
+{
+    BOOL ret = FALSE;
+
+    /* unlocked check, the pending counter makes sure no task is missed */
+    if(!*(volatile unsigned int*)&queue->count)
+        return FALSE;
+
+    AcquireSRWLockExclusive(&queue->lock);
+    if(queue->count) {
+        if(steal) {
+            *task = queue->tasks[queue->head];
+            queue->head = (queue->head + 1) & (queue->size - 1);
+        } else {
+            *task = queue->tasks[(queue->head + queue->count - 1) & (queue->size - 1)];
+        }
+        queue->count--;
+        ret = TRUE;
+    }
+    ReleaseSRWLockExclusive(&queue->lock);
+    return ret;
+}
+
+static DWORD WINAPI task_pool_worker(void *arg)
+{
+    struct task_queue *queue = arg;
+    struct task_pool *pool = queue->pool;
+    unsigned int i, id = queue - pool->queues;
+    ExternalContextBase *context;
+    struct scheduled_task task;
+    BOOL found;
+
+    TRACE("(%p) started worker %u\n", pool, id);
+
+    /* bind the worker context to the pool's scheduler, so that tasks scheduled
+     * through CurrentScheduler from inside a task stay in this pool */
+    context = (ExternalContextBase*)get_current_context();
+    call_Scheduler_Release(context->scheduler.scheduler);
+    context->scheduler.scheduler = pool->scheduler;
+
+    TlsSetValue(worker_tls_index, queue);
+    for(;;) {
+        found = task_queue_pop(queue, FALSE, &task);
+        for(i=1; !found && i<pool->queue_count; i++)
+            found = task_queue_pop(&pool->queues[(id + i) % pool->queue_count], TRUE, &task);
+
+        if(found) {
+            InterlockedDecrement(&pool->pending);
+            task.proc(task.data);
+            continue;
+        }
+
+        EnterCriticalSection(&pool->cs);
+        InterlockedIncrement(&pool->idle);
+        while(!pool->pending && !pool->shutdown)
+            SleepConditionVariableCS(&pool->cv, &pool->cs, INFINITE);
+        InterlockedDecrement(&pool->idle);
+        found = pool->pending || !pool->shutdown;
+        LeaveCriticalSection(&pool->cs);
+        if(!found) break;
+    }
+    TlsSetValue(worker_tls_index, NULL);
+
+    /* the pool's scheduler is not referenced, drop it before destroying the context */
+    if(context->scheduler.next) {
+        struct scheduler_list *entry = &context->scheduler;
+
+        WARN("(%p) worker %u exiting with attached schedulers\n", pool, id);
+        while(entry->next->next)
+            entry = entry->next;
+        MSVCRT_operator_delete(entry->next);
+        entry->next = NULL;
+    } else {
+        context->scheduler.scheduler = NULL;
+    }
+    TlsSetValue(context_tls_index, NULL);
+    call_Context_dtor(&context->context, 1);
+
+    TRACE("(%p) worker %u finished\n", pool, id);
+    task_pool_release(pool);
+    FreeLibraryAndExitThread(msvcrt_module, 0);
+    return 0;
+}
+
+static BOOL task_pool_start_worker(struct task_pool *pool)
+{
+    struct task_queue *queue;
+    HMODULE module;
+    BOOL ret;
+
+    EnterCriticalSection(&pool->cs);
+    if(pool->thread_count < pool->queue_count && !pool->shutdown) {
+        queue = &pool->queues[pool->thread_count];
+        InterlockedIncrement(&pool->ref);
+        queue->thread = CreateThread(NULL, 0, task_pool_worker, queue, 0, NULL);
+        if(queue->thread) {
+            /* released by the worker when it exits */
+            GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                    (const WCHAR*)msvcrt_module, &module);
+            pool->thread_count++;
+        } else {
+            WARN("failed to start worker thread: %u\n", GetLastError());
+            InterlockedDecrement(&pool->ref);
+        }
+    }
+    ret = pool->thread_count != 0;
+    LeaveCriticalSection(&pool->cs);
+    return ret;
+}
+
+static void task_pool_push(struct task_pool *pool, void (__cdecl *proc)(void*), void *data)
+{
+    struct task_queue *queue = TlsGetValue(worker_tls_index);
+
+    if(!queue || queue->pool != pool)
+        queue = &pool->queues[(unsigned int)InterlockedIncrement(&pool->next_queue) % pool->queue_count];
+
+    if(!task_queue_push(queue, proc, data))
+        throw_exception(EXCEPTION_BAD_ALLOC, 0, "bad allocation");
+
+    /* Pairs with the idle increment in task_pool_worker: either the worker
+     * sees the new task or we see the sleeping worker. */
+    InterlockedIncrement(&pool->pending);
+    if(pool->idle) {
+        EnterCriticalSection(&pool->cs);
+        WakeConditionVariable(&pool->cv);
+        LeaveCriticalSection(&pool->cs);
+    } else if(pool->thread_count < pool->queue_count) {
+        if(!task_pool_start_worker(pool))
+            throw_exception(EXCEPTION_SCHEDULER_RESOURCE_ALLOCATION_ERROR,
+                    HRESULT_FROM_WIN32(GetLastError()), NULL);
+    }
+}
+
+/* Waits for the workers to finish, except the calling one when the scheduler
+ * is released from one of its own tasks. */
+static void task_pool_shutdown(struct task_pool *pool)
+{
+    struct task_queue *current = TlsGetValue(worker_tls_index);
+    unsigned int i;
+
+    EnterCriticalSection(&pool->cs);
+    pool->shutdown = TRUE;
+    WakeAllConditionVariable(&pool->cv);
+    LeaveCriticalSection(&pool->cs);
+
+    for(i=0; i<pool->thread_count; i++) {
+        if(&pool->queues[i] != current)
+            WaitForSingleObject(pool->queues[i].thread, INFINITE);
+        CloseHandle(pool->queues[i].thread);
+    }
+    task_pool_release(pool);
+}
+
 static void ThreadScheduler_dtor(ThreadScheduler *this)
 {
     int i;
 
     if(this->ref != 0) WARN("ref = %d\n", this->ref);
     SchedulerPolicy_dtor(&this->policy);
+    if(this->pool)
+        task_pool_shutdown(this->pool);
 
     for(i=0; i<this->shutdown_count; i++)
         SetEvent(this->shutdown_events[i]);
@@ -717,18 +987,33 @@ DEFINE_THISCALL_WRAPPER(ThreadScheduler_CreateScheduleGroup, 4)
     return NULL;
 }
 
+static struct task_pool* ThreadScheduler_get_pool(ThreadScheduler *this)
+{
+    struct task_pool *pool;
+
+    if(this->pool)
+        return this->pool;
+
+    pool = task_pool_create(&this->scheduler, this->virt_proc_no);
+    if(InterlockedCompareExchangePointer((void**)&this->pool, pool, NULL))
+        task_pool_release(pool);
+    return this->pool;
+}
+
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_ScheduleTask_loc, 16)
 void __thiscall ThreadScheduler_ScheduleTask_loc(ThreadScheduler *this,
         void (__cdecl *proc)(void*), void* data, /*location*/void *placement)
 {
-    FIXME("(%p %p %p %p) stub\n", this, proc, data, placement);
+    TRACE("(%p %p %p %p) placement ignored\n", this, proc, data, placement);
+    task_pool_push(ThreadScheduler_get_pool(this), proc, data);
 }
 
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_ScheduleTask, 12)
 void __thiscall ThreadScheduler_ScheduleTask(ThreadScheduler *this,
         void (__cdecl *proc)(void*), void* data)
 {
-    FIXME("(%p %p %p) stub\n", this, proc, data);
+    TRACE("(%p %p %p)\n", this, proc, data);
+    task_pool_push(ThreadScheduler_get_pool(this), proc, data);
 }
 
 DEFINE_THISCALL_WRAPPER(ThreadScheduler_IsAvailableLocation, 8)
@@ -775,9 +1060,12 @@ static ThreadScheduler* ThreadScheduler_ctor(ThreadScheduler *this,
     this->virt_proc_no = SchedulerPolicy_GetPolicyValue(&this->policy, MaxConcurrency);
     if(this->virt_proc_no > si.dwNumberOfProcessors)
         this->virt_proc_no = si.dwNumberOfProcessors;
+    if(this->virt_proc_no < SchedulerPolicy_GetPolicyValue(&this->policy, MinConcurrency))
+        this->virt_proc_no = SchedulerPolicy_GetPolicyValue(&this->policy, MinConcurrency);
 
     this->shutdown_count = this->shutdown_size = 0;
     this->shutdown_events = NULL;
+    this->pool = NULL;
 
     InitializeCriticalSection(&this->cs);
     this->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": ThreadScheduler");
@@ -1131,6 +1419,7 @@ void __asm_dummy_vtables(void) {
 
 void msvcrt_init_scheduler(void *base)
 {
+    msvcrt_module = base;
 #ifdef __x86_64__
     init_Context_rtti(base);
     init_ContextBase_rtti(base);
@@ -1145,6 +1434,8 @@ void msvcrt_free_scheduler(void)
 {
     if (context_tls_index != TLS_OUT_OF_INDEXES)
         TlsFree(context_tls_index);
+    if (worker_tls_index != TLS_OUT_OF_INDEXES)
+        TlsFree(worker_tls_index);
     if(default_scheduler_policy.policy_container)
         SchedulerPolicy_dtor(&default_scheduler_policy);
     if(default_scheduler) {
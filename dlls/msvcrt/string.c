@@ -661,6 +661,58 @@ static double convert_e10_to_e2(int sign, int e10, ULONGLONG m, int *err)
     return make_double(sign, e2, u128.u[0], ROUND_DOWN, err);
 }
 
+/* Returns TRUE if plain double arithmetic is correctly rounded to nearest,
+ * i.e. the application hasn't changed the rounding mode or the x87 precision. */
+static inline BOOL fpu_round_nearest_double(void)
+{
+#if defined(__GNUC__) && defined(__i386__)
+    unsigned short cw;
+
+    __asm__ __volatile__( "fnstcw %0" : "=m" (cw) );
+    return (cw & 0xf00) == 0x200;
+#elif defined(__GNUC__) && defined(__x86_64__)
+    unsigned int csr;
+
+    __asm__ __volatile__( "stmxcsr %0" : "=m" (csr) );
+    return !(csr & 0x6000);
+#else
+    return FALSE;
+#endif
+}
+
+/* Clinger's fast path: when the mantissa and the power of ten are both
+ * exactly representable, a single multiplication or division gives the
+ * correctly rounded result. Returns FALSE if the number has to go through
+ * convert_e10_to_e2. */
+static BOOL convert_e10_fast(int sign, int e10, ULONGLONG m, double *ret)
+{
+    static const double pow10[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const ULONGLONG max_exact = (ULONGLONG)1 << 53;
+    const int max_e10 = ARRAY_SIZE(pow10) - 1;
+    double d;
+
+    if (m > max_exact || e10 < -max_e10) return FALSE;
+
+    /* 1234e25 can still be handled as 1234000e22 */
+    while (e10 > max_e10)
+    {
+        if (m > max_exact / 10) return FALSE;
+        m *= 10;
+        e10--;
+    }
+    if (!fpu_round_nearest_double()) return FALSE;
+
+    d = m;
+    if (e10 < 0) d /= pow10[-e10];
+    else d *= pow10[e10];
+    *ret = sign == -1 ? -d : d;
+    return TRUE;
+}
+
 double parse_double(MSVCRT_wchar_t (*get)(void *ctx), void (*unget)(void *ctx),
         void *ctx, MSVCRT_pthreadlocinfo locinfo, int *err)
 {
@@ -674,6 +726,7 @@ double parse_double(MSVCRT_wchar_t (*get)(void *ctx), void (*unget)(void *ctx),
     unsigned __int64 d=0, hlp;
     MSVCRT_wchar_t nch;
     int exp=0, sign=1;
+    double ret;
 
     nch = get(ctx);
     if(nch == '-') {
@@ -805,6 +858,8 @@ double parse_double(MSVCRT_wchar_t (*get)(void *ctx), void (*unget)(void *ctx),
     if(exp < MSVCRT_DBL_MIN_10_EXP-MSVCRT_DBL_DIG-18)
         return make_double(sign, INT_MIN, d, ROUND_ZERO, err);
 
+    if(convert_e10_fast(sign, exp, d, &ret))
+        return ret;
     return convert_e10_to_e2(sign, exp, d, err);
 }
 
@@ -2288,9 +2343,10 @@ void* __cdecl MSVCRT_memchr(const void *ptr, int c, MSVCRT_size_t n)
  */
 int __cdecl MSVCRT_strcmp(const char *str1, const char *str2)
 {
-    while (*str1 && *str1 == *str2) { str1++; str2++; }
-    if ((unsigned char)*str1 > (unsigned char)*str2) return 1;
-    if ((unsigned char)*str1 < (unsigned char)*str2) return -1;
+    int ret = strcmp(str1, str2);
+
+    if (ret > 0) return 1;
+    if (ret < 0) return -1;
     return 0;
 }
 
@@ -483,6 +483,193 @@ static void test_calloc(void)
     free(ptr);
 }
 
+static void test_small_blocks(void)
+{
+    /* use function pointer to bypass gcc builtin */
+    void *(__cdecl *p_calloc)(size_t, size_t);
+    unsigned char *mem, *mem2;
+    size_t size, i;
+
+    p_calloc = (void *)GetProcAddress( GetModuleHandleA("msvcrt.dll"), "calloc");
+
+    for (size = 0; size <= 1100; size += 7)
+    {
+        mem = malloc(size);
+        ok(mem != NULL, "malloc(%lu) failed\n", (unsigned long)size);
+        ok(!((UINT_PTR)mem & (sizeof(void*) * 2 - 1)), "incorrect alignment (%p)\n", mem);
+        ok(_msize(mem) == size, "_msize returned %lu, expected %lu\n",
+           (unsigned long)_msize(mem), (unsigned long)size);
+        memset(mem, 0xcc, size);
+        free(mem);
+
+        mem = p_calloc(1, size);
+        ok(mem != NULL, "calloc(%lu) failed\n", (unsigned long)size);
+        for (i = 0; i < size; i++)
+            if (mem[i]) break;
+        ok(i == size, "calloc(%lu) memory not zeroed at %lu\n", (unsigned long)size, (unsigned long)i);
+        free(mem);
+    }
+
+    /* realloc keeps the contents when moving between sizes */
+    mem = malloc(10);
+    for (i = 0; i < 10; i++) mem[i] = i;
+    for (size = 20; size <= 2000; size *= 2)
+    {
+        mem = realloc(mem, size);
+        ok(mem != NULL, "realloc(%lu) failed\n", (unsigned long)size);
+        ok(_msize(mem) == size, "_msize returned %lu, expected %lu\n",
+           (unsigned long)_msize(mem), (unsigned long)size);
+        for (i = 0; i < 10; i++)
+            if (mem[i] != i) break;
+        ok(i == 10, "realloc(%lu) lost data at %lu\n", (unsigned long)size, (unsigned long)i);
+    }
+    mem = realloc(mem, 5);
+    ok(mem != NULL, "realloc failed\n");
+    ok(_msize(mem) == 5, "_msize returned %lu\n", (unsigned long)_msize(mem));
+    ok(!memcmp(mem, "\0\1\2\3\4", 5), "realloc lost data\n");
+
+    mem2 = _expand(mem, 3);
+    ok(mem2 == mem, "_expand returned %p, expected %p\n", mem2, mem);
+    ok(_msize(mem) == 3, "_msize returned %lu\n", (unsigned long)_msize(mem));
+    free(mem);
+}
+
+static void test_small_blocks_heap(void)
+{
+    static char *empty[5000];
+    char *mem, *blocks[2000];
+    _HEAPINFO info;
+    BOOL found = FALSE;
+    unsigned int i;
+    int ret;
+
+    mem = malloc(24);
+    ok(mem != NULL, "malloc failed\n");
+    strcpy(mem, "small block");
+
+    ret = _heapchk();
+    ok(ret == _HEAPOK, "_heapchk returned %d\n", ret);
+
+    memset(&info, 0, sizeof(info));
+    while ((ret = _heapwalk(&info)) == _HEAPOK)
+    {
+        if ((char *)info._pentry != mem) continue;
+        ok(info._useflag == _USEDENTRY, "got flag %d\n", info._useflag);
+        ok(info._size >= 24, "got size %lu\n", (unsigned long)info._size);
+        found = TRUE;
+    }
+    ok(ret == _HEAPEND, "_heapwalk returned %d\n", ret);
+    ok(found || broken(!found) /* low fragmentation heap */, "block %p not found\n", mem);
+
+    /* _heapset only fills free entries */
+    ret = _heapset(0xcc);
+    ok(ret == _HEAPOK, "_heapset returned %d\n", ret);
+    ok(!strcmp(mem, "small block"), "got %s\n", mem);
+    free(mem);
+
+    /* spans of freed blocks can be released and reused */
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+    {
+        blocks[i] = malloc(100);
+        ok(blocks[i] != NULL, "malloc failed\n");
+        memset(blocks[i], i, 100);
+    }
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+        if (i % 2) free(blocks[i]);
+    _heapmin();
+    ret = _heapchk();
+    ok(ret == _HEAPOK, "_heapchk returned %d\n", ret);
+    for (i = 0; i < ARRAY_SIZE(blocks); i += 2)
+    {
+        ok(blocks[i][0] == (char)i && blocks[i][99] == (char)i, "block %u was modified\n", i);
+        free(blocks[i]);
+    }
+    _heapmin();
+    ret = _heapchk();
+    ok(ret == _HEAPOK, "_heapchk returned %d\n", ret);
+
+    mem = malloc(100);
+    ok(mem != NULL, "malloc failed\n");
+    ok(_msize(mem) == 100, "_msize returned %lu\n", (unsigned long)_msize(mem));
+    free(mem);
+
+    /* more empty blocks than fit in a span */
+    for (i = 0; i < ARRAY_SIZE(empty); i++)
+    {
+        empty[i] = malloc(0);
+        ok(empty[i] != NULL, "malloc failed\n");
+        ok(_msize(empty[i]) == 0, "_msize returned %lu\n", (unsigned long)_msize(empty[i]));
+    }
+    ret = _heapchk();
+    ok(ret == _HEAPOK, "_heapchk returned %d\n", ret);
+    for (i = 0; i < ARRAY_SIZE(empty); i += 2)
+    {
+        empty[i] = realloc(empty[i], 8);
+        ok(empty[i] != NULL, "realloc failed\n");
+        ok(_msize(empty[i]) == 8, "_msize returned %lu\n", (unsigned long)_msize(empty[i]));
+    }
+    for (i = 0; i < ARRAY_SIZE(empty); i++)
+        free(empty[i]);
+    _heapmin();
+    ret = _heapchk();
+    ok(ret == _HEAPOK, "_heapchk returned %d\n", ret);
+}
+
+struct malloc_bench
+{
+    HANDLE start;
+    LONG ops;
+};
+
+static DWORD WINAPI malloc_bench_thread(void *arg)
+{
+    struct malloc_bench *bench = arg;
+    void *blocks[64];
+    unsigned int i, j;
+
+    WaitForSingleObject(bench->start, INFINITE);
+    for (i = 0; i < 2000; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(blocks); j++)
+            blocks[j] = malloc(16 + (i * 7 + j * 13) % 240);
+        for (j = 0; j < ARRAY_SIZE(blocks); j++)
+            free(blocks[j]);
+    }
+    InterlockedExchangeAdd(&bench->ops, i * ARRAY_SIZE(blocks));
+    return 0;
+}
+
+static void test_malloc_throughput(void)
+{
+    static const unsigned int counts[] = {1, 4, 16};
+    struct malloc_bench bench;
+    HANDLE threads[16];
+    unsigned int i, j;
+    DWORD start, time;
+
+    if (!winetest_benchmark)
+        return;
+
+    bench.start = CreateEventW(NULL, TRUE, FALSE, NULL);
+    for (i = 0; i < ARRAY_SIZE(counts); i++)
+    {
+        ResetEvent(bench.start);
+        bench.ops = 0;
+        for (j = 0; j < counts[i]; j++)
+            threads[j] = CreateThread(NULL, 0, malloc_bench_thread, &bench, 0, NULL);
+
+        start = GetTickCount();
+        SetEvent(bench.start);
+        WaitForMultipleObjects(counts[i], threads, TRUE, INFINITE);
+        time = GetTickCount() - start;
+
+        trace("%u threads: %d malloc/free pairs in %u ms\n", counts[i], bench.ops, time);
+        for (j = 0; j < counts[i]; j++)
+            CloseHandle(threads[j]);
+    }
+    CloseHandle(bench.start);
+}
+
 START_TEST(heap)
 {
     void *mem;
@@ -508,4 +695,7 @@ START_TEST(heap)
     test_aligned();
     test_sbheap();
     test_calloc();
+    test_small_blocks();
+    test_small_blocks_heap();
+    test_malloc_throughput();
 }
@@ -2043,6 +2043,39 @@ static void test__strtod(void)
 
     d = strtod("1.7976931348623158e+308", NULL);
     ok(d == DBL_MAX, "d = %le\n", d);
+
+    d = strtod("89255e-22", NULL);
+    ok(d == 89255e-22, "d = %.16e\n", d);
+    d = strtod("-4.35", NULL);
+    ok(d == -4.35, "d = %.16e\n", d);
+    d = strtod("1234e25", NULL);
+    ok(d == 1234e25, "d = %.16e\n", d);
+    d = strtod("9007199254740993", NULL);
+    ok(d == 9007199254740992.0, "d = %.16e\n", d);
+    d = strtod("1e22", NULL);
+    ok(d == 1e22, "d = %.16e\n", d);
+    d = strtod("1e23", NULL);
+    ok(d == 1e23, "d = %.16e\n", d);
+}
+
+static void test_strtod_throughput(void)
+{
+    static const char *values[] =
+    {
+        "0.5", "12.75", "-3.14159", "1024", "6.02214076e23", "1.5e-7", "99.99", "0.001"
+    };
+    char *end;
+    double sum = 0;
+    DWORD start;
+    int i;
+
+    if (!winetest_benchmark)
+        return;
+
+    start = GetTickCount();
+    for (i = 0; i < 1000000; i++)
+        sum += strtod(values[i % ARRAY_SIZE(values)], &end);
+    trace("strtod: 1000000 calls in %u ms (sum %g)\n", GetTickCount() - start, sum);
 }
 
 static void test_mbstowcs(void)
@@ -4209,6 +4242,43 @@ static void test_strstr(void)
     }
 }
 
+static void test_wcs_scan(void)
+{
+    wchar_t buf[64], buf2[64];
+    unsigned int off, len;
+    wchar_t *str, *r;
+    int ret;
+
+    for (off = 0; off < 8; off++)
+    {
+        for (len = 0; len < 40; len++)
+        {
+            str = buf + off;
+            for (r = str; r < str + len; r++) *r = 'a' + (r - str) % 8;
+            str[len] = 0;
+
+            ret = wcslen(str);
+            ok(ret == len, "%u/%u: wcslen returned %d\n", off, len, ret);
+
+            r = wcschr(str, 'h');
+            ok(r == (len > 7 ? str + 7 : NULL), "%u/%u: wcschr returned %p, str %p\n", off, len, r, str);
+            r = wcschr(str, 0);
+            ok(r == str + len, "%u/%u: wcschr returned %p, str %p\n", off, len, r, str);
+
+            memcpy(buf2 + 8 - off, str, (len + 1) * sizeof(wchar_t));
+            ret = wcscmp(str, buf2 + 8 - off);
+            ok(!ret, "%u/%u: wcscmp returned %d\n", off, len, ret);
+            if (!len) continue;
+            buf2[8 - off + len - 1] = 0xfffe;
+            ret = wcscmp(str, buf2 + 8 - off);
+            ok(ret < 0, "%u/%u: wcscmp returned %d\n", off, len, ret);
+            buf2[8 - off + len - 1] = 0;
+            ret = wcscmp(str, buf2 + 8 - off);
+            ok(ret > 0, "%u/%u: wcscmp returned %d\n", off, len, ret);
+        }
+    }
+}
+
 static void test_iswdigit(void)
 {
     static const struct {
@@ -4343,6 +4413,7 @@ START_TEST(string)
     test_strnlen();
     test__strtoi64();
     test__strtod();
+    test_strtod_throughput();
     test_mbstowcs();
     test__wcstombs_s_l();
     test_gcvt();
@@ -4380,4 +4451,5 @@ START_TEST(string)
     test_C_locale();
     test_strstr();
     test_iswdigit();
+    test_wcs_scan();
 }
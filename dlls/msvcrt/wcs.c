@@ -31,6 +31,13 @@
 #include "wine/unicode.h"
 #include "wine/debug.h"
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <emmintrin.h>
+#define HAVE_SSE2_STRING_SCAN
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(msvcrt);
 
 static BOOL n_format_enabled = TRUE;
@@ -2523,11 +2530,99 @@ int CDECL MSVCRT_towlower(MSVCRT_wint_t c)
     return MSVCRT__towlower_l(c, NULL);
 }
 
+#ifdef HAVE_SSE2_STRING_SCAN
+
+/* The SSE2 scanners only use aligned loads on the string being scanned, so
+ * they never touch a page the string doesn't extend into. Strings that are
+ * not even WCHAR aligned are left to the plain loops. */
+static inline BOOL use_sse2_scan(const MSVCRT_wchar_t *str)
+{
+#ifdef __x86_64__
+    return !((ULONG_PTR)str & 1);
+#else
+    return sse2_supported && !((ULONG_PTR)str & 1);
+#endif
+}
+
+static SSE2_TARGET MSVCRT_size_t wcslen_sse2(const MSVCRT_wchar_t *str)
+{
+    const MSVCRT_wchar_t *s = str;
+    __m128i zero = _mm_setzero_si128();
+    unsigned int mask;
+
+    for (; (ULONG_PTR)s & 15; s++)
+        if (!*s) return s - str;
+
+    for (;; s += 8)
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_load_si128((const __m128i *)s), zero));
+        if (mask) return s - str + __builtin_ctz(mask) / 2;
+    }
+}
+
+static SSE2_TARGET MSVCRT_wchar_t *wcschr_sse2(const MSVCRT_wchar_t *str, MSVCRT_wchar_t ch)
+{
+    __m128i zero = _mm_setzero_si128(), pattern = _mm_set1_epi16(ch), val;
+    unsigned int mask;
+
+    for (; (ULONG_PTR)str & 15; str++)
+    {
+        if (*str == ch) return (MSVCRT_wchar_t *)str;
+        if (!*str) return NULL;
+    }
+
+    for (;; str += 8)
+    {
+        val = _mm_load_si128((const __m128i *)str);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(val, zero), _mm_cmpeq_epi16(val, pattern)));
+        if (mask)
+        {
+            str += __builtin_ctz(mask) / 2;
+            return *str == ch ? (MSVCRT_wchar_t *)str : NULL;
+        }
+    }
+}
+
+static SSE2_TARGET int wcscmp_sse2(const MSVCRT_wchar_t *str1, const MSVCRT_wchar_t *str2)
+{
+    __m128i zero = _mm_setzero_si128(), val;
+    unsigned int mask;
+    int i;
+
+    for (; (ULONG_PTR)str1 & 15; str1++, str2++)
+        if (!*str1 || *str1 != *str2) return *str1 - *str2;
+
+    for (;; str1 += 8, str2 += 8)
+    {
+        /* str2 is read unaligned, don't let it run into the next page */
+        if (((ULONG_PTR)str2 & 0xfff) > 0x1000 - 16)
+        {
+            for (i = 0; i < 8; i++)
+                if (!str1[i] || str1[i] != str2[i]) return str1[i] - str2[i];
+            continue;
+        }
+
+        val = _mm_load_si128((const __m128i *)str1);
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi16(val, _mm_loadu_si128((const __m128i *)str2))) ^ 0xffff;
+        mask |= _mm_movemask_epi8(_mm_cmpeq_epi16(val, zero));
+        if (mask)
+        {
+            i = __builtin_ctz(mask) / 2;
+            return str1[i] - str2[i];
+        }
+    }
+}
+
+#endif
+
 /*********************************************************************
  *              wcschr (MSVCRT.@)
  */
 MSVCRT_wchar_t* CDECL MSVCRT_wcschr(const MSVCRT_wchar_t *str, MSVCRT_wchar_t ch)
 {
+#ifdef HAVE_SSE2_STRING_SCAN
+    if (use_sse2_scan(str)) return wcschr_sse2(str, ch);
+#endif
     return strchrW(str, ch);
 }
 
@@ -2544,6 +2639,9 @@ MSVCRT_wchar_t* CDECL MSVCRT_wcsrchr(const MSVCRT_wchar_t *str, MSVCRT_wchar_t c
  */
 int CDECL MSVCRT_wcslen(const MSVCRT_wchar_t *str)
 {
+#ifdef HAVE_SSE2_STRING_SCAN
+    if (use_sse2_scan(str)) return wcslen_sse2(str);
+#endif
     return strlenW(str);
 }
 
@@ -2661,5 +2759,8 @@ MSVCRT_size_t CDECL MSVCRT_wcsxfrm(MSVCRT_wchar_t *dest,
  */
 int CDECL MSVCRT_wcscmp(const MSVCRT_wchar_t *str1, const MSVCRT_wchar_t *str2)
 {
+#ifdef HAVE_SSE2_STRING_SCAN
+    if (use_sse2_scan(str1)) return wcscmp_sse2(str1, str2);
+#endif
     return strcmpW(str1, str2);
 }
@@ -195,6 +195,7 @@ struct dir_data_names
 
 struct dir_data
 {
+    unsigned int            refcount; /* references from dir_data_cache and the lookup indexes */
     unsigned int            size;    /* size of the names array */
     unsigned int            count;   /* count of used entries in the names array */
     unsigned int            pos;     /* current reading position in the names array */
@@ -210,6 +211,25 @@ static const unsigned int dir_data_names_initial_size  = 64;
 static struct dir_data **dir_data_cache;
 static unsigned int dir_data_cache_size;
 
+/* case-insensitive name index of a directory, used to avoid scanning it on every lookup */
+struct dir_lookup_index
+{
+    struct list             entry;      /* entry in dir_lookup_list, most recently used first */
+    struct file_identity    id;         /* directory file identity */
+    ULONGLONG               mtime;      /* directory modification time when it was read */
+    BOOL                    stable;     /* whether later changes are guaranteed to change mtime */
+    struct dir_data        *data;       /* directory contents, possibly shared with dir_data_cache */
+    unsigned int            hash_mask;  /* size of the hash tables - 1 */
+    unsigned int           *long_hash;  /* long names hash table, index + 1 in data->names */
+    unsigned int           *short_hash; /* short names hash table, index + 1 in data->names */
+};
+
+static const unsigned int dir_lookup_max_count = 64;
+
+static struct list dir_lookup_list = LIST_INIT( dir_lookup_list );
+static unsigned int dir_lookup_count;
+static unsigned int dir_lookup_hits, dir_lookup_misses, dir_lookup_rescans;
+
 static BOOL show_dot_files;
 static RTL_RUN_ONCE init_once = RTL_RUN_ONCE_INIT;
 
@@ -386,7 +406,7 @@ static void free_dir_data( struct dir_data *data )
 {
     struct dir_data_buffer *buffer, *next;
 
-    if (!data) return;
+    if (!data || --data->refcount) return;
 
     for (buffer = data->buffer; buffer; buffer = next)
     {
@@ -1492,21 +1512,138 @@ static BOOL append_entry( struct dir_data *data, const char *long_name,
 }
 
 
+/* stat information of a directory entry */
+struct dir_stat_info
+{
+    int                     ret;        /* return value of get_file_info */
+    ULONG                   attributes; /* file attributes */
+    struct stat             st;         /* file stat information */
+};
+
+/* stat information prefetched for a range of directory entries */
+struct dir_stat_prefetch
+{
+    LONG                    refcount;   /* references from the caller and the worker threads */
+    const struct dir_data_names *names; /* first entry of the range */
+    unsigned int            start;      /* index of the first entry in the dir_data names */
+    LONG                    count;      /* number of entries in the range */
+    LONG                    next;       /* next entry to stat */
+    LONG                    done;       /* number of entries already stat'ed */
+    struct dir_stat_info    info[1];
+};
+
+static const unsigned int dir_stat_prefetch_max_count = 512;  /* max entries prefetched at once */
+static const unsigned int dir_stat_parallel_min_count = 32;   /* min entries to use worker threads */
+static const unsigned int dir_stat_max_workers        = 4;
+
+static void release_dir_stat_prefetch( struct dir_stat_prefetch *prefetch )
+{
+    if (!InterlockedDecrement( &prefetch->refcount )) RtlFreeHeap( GetProcessHeap(), 0, prefetch );
+}
+
+/* stat the entries of the range that haven't been taken by another thread yet */
+static void stat_dir_entries( struct dir_stat_prefetch *prefetch )
+{
+    struct dir_stat_info *info;
+    LONG i;
+
+    while ((i = InterlockedIncrement( &prefetch->next ) - 1) < prefetch->count)
+    {
+        info = &prefetch->info[i];
+        info->ret = get_file_info( prefetch->names[i].unix_name, &info->st, &info->attributes );
+        if (InterlockedIncrement( &prefetch->done ) == prefetch->count) RtlWakeAddressAll( &prefetch->done );
+    }
+}
+
+static DWORD WINAPI dir_stat_worker( void *arg )
+{
+    struct dir_stat_prefetch *prefetch = arg;
+
+    stat_dir_entries( prefetch );
+    release_dir_stat_prefetch( prefetch );
+    return 0;
+}
+
+
+/***********************************************************************
+ *           prefetch_dir_stats
+ *
+ * Retrieve the stat information of the next entries of the directory data,
+ * spreading the work across the thread pool for large ranges. Must be called
+ * with dir_section held and the current directory set to the directory.
+ */
+static struct dir_stat_prefetch *prefetch_dir_stats( const struct dir_data *data, unsigned int count )
+{
+    struct dir_stat_prefetch *prefetch;
+    unsigned int i, workers;
+    LONG done;
+
+    count = min( count, min( data->count - data->pos, dir_stat_prefetch_max_count ));
+    if (count < 2) return NULL;
+
+    if (!(prefetch = RtlAllocateHeap( GetProcessHeap(), 0,
+                                      offsetof( struct dir_stat_prefetch, info[count] ))))
+        return NULL;
+    prefetch->refcount = 1;
+    prefetch->names    = &data->names[data->pos];
+    prefetch->start    = data->pos;
+    prefetch->count    = count;
+    prefetch->next     = 0;
+    prefetch->done     = 0;
+
+    /* workers that start too late to find any work left simply release their reference */
+    workers = count >= dir_stat_parallel_min_count ? min( dir_stat_max_workers, count / 16 ) : 0;
+    for (i = 0; i < workers; i++)
+    {
+        InterlockedIncrement( &prefetch->refcount );
+        if (RtlQueueWorkItem( dir_stat_worker, prefetch, WT_EXECUTEDEFAULT ))
+        {
+            InterlockedDecrement( &prefetch->refcount );
+            break;
+        }
+    }
+
+    stat_dir_entries( prefetch );
+
+    /* entries taken by the workers must be done before the current directory can change */
+    while ((done = prefetch->done) < prefetch->count)
+        RtlWaitOnAddress( &prefetch->done, &done, sizeof(done), NULL );
+
+    TRACE( "prefetched %u entries from %u with %u workers\n", count, prefetch->start, i );
+    return prefetch;
+}
+
+/* get the stat information of the current entry, using the prefetched data if available */
+static int get_dir_data_file_info( const struct dir_data *data, const struct dir_stat_prefetch *prefetch,
+                                   struct stat *st, ULONG *attributes )
+{
+    const struct dir_stat_info *info;
+
+    if (!prefetch || data->pos < prefetch->start || data->pos - prefetch->start >= prefetch->count)
+        return get_file_info( data->names[data->pos].unix_name, st, attributes );
+
+    info = &prefetch->info[data->pos - prefetch->start];
+    *st = info->st;
+    *attributes = info->attributes;
+    return info->ret;
+}
+
+
 /***********************************************************************
  *           get_dir_data_entry
  *
  * Return a directory entry from the cached data.
  */
-static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, IO_STATUS_BLOCK *io,
-                                    ULONG max_length, FILE_INFORMATION_CLASS class,
-                                    union file_directory_info **last_info )
+static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, const struct dir_stat_prefetch *prefetch,
+                                    void *info_ptr, IO_STATUS_BLOCK *io, ULONG max_length,
+                                    FILE_INFORMATION_CLASS class, union file_directory_info **last_info )
 {
     const struct dir_data_names *names = &dir_data->names[dir_data->pos];
     union file_directory_info *info;
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
 
-    if (get_file_info( names->unix_name, &st, &attributes ) == -1)
+    if (get_dir_data_file_info( dir_data, prefetch, &st, &attributes ) == -1)
     {
         TRACE( "file no longer exists %s\n", names->unix_name );
         return STATUS_SUCCESS;
@@ -1824,6 +1961,177 @@ static int name_compare( const void *a, const void *b )
 }
 
 
+/* return the modification time of a directory in 100ns units */
+static ULONGLONG get_dir_mtime( const struct stat *st )
+{
+    ULONGLONG mtime = (ULONGLONG)st->st_mtime * 10000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime += st->st_mtim.tv_nsec / 100;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    mtime += st->st_mtimespec.tv_nsec / 100;
+#endif
+    return mtime;
+}
+
+/* hash a file name case-insensitively */
+static unsigned int hash_folded_name( const WCHAR *name, unsigned int len )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < len; i++) hash = hash * 65599 + RtlUpcaseUnicodeChar( name[i] );
+    return hash;
+}
+
+static void insert_dir_lookup_name( unsigned int *table, unsigned int mask, const WCHAR *name, unsigned int idx )
+{
+    unsigned int pos = hash_folded_name( name, wcslen(name) ) & mask;
+
+    while (table[pos]) pos = (pos + 1) & mask;
+    table[pos] = idx + 1;
+}
+
+static void free_dir_lookup_index( struct dir_lookup_index *index )
+{
+    list_remove( &index->entry );
+    dir_lookup_count--;
+    free_dir_data( index->data );
+    RtlFreeHeap( GetProcessHeap(), 0, index );
+}
+
+
+/***********************************************************************
+ *           find_dir_lookup_index
+ *
+ * Find the lookup index of a directory and move it to the head of the list.
+ * Must be called with dir_section held.
+ */
+static struct dir_lookup_index *find_dir_lookup_index( const struct stat *st )
+{
+    struct dir_lookup_index *index;
+
+    LIST_FOR_EACH_ENTRY( index, &dir_lookup_list, struct dir_lookup_index, entry )
+    {
+        if (index->id.dev != st->st_dev || index->id.ino != st->st_ino) continue;
+        list_remove( &index->entry );
+        list_add_head( &dir_lookup_list, &index->entry );
+        return index;
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           set_dir_lookup_index
+ *
+ * Build the lookup index of a directory from its contents, replacing the
+ * previous one. st must have been retrieved before reading the contents,
+ * and now before retrieving st. Must be called with dir_section held.
+ */
+static struct dir_lookup_index *set_dir_lookup_index( struct dir_data *data, const struct stat *st,
+                                                       time_t now )
+{
+    struct dir_lookup_index *index;
+    unsigned int i, size = 16;
+
+    while (size < 2 * data->count) size *= 2;
+
+    if (!(index = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                   sizeof(*index) + 2 * size * sizeof(unsigned int) )))
+        return NULL;
+
+    index->id.dev     = st->st_dev;
+    index->id.ino     = st->st_ino;
+    index->mtime      = get_dir_mtime( st );
+    /* file system timestamps may be coarse, don't trust a directory modified while we read it */
+    index->stable     = now - st->st_mtime > 1;
+    index->data       = data;
+    index->hash_mask  = size - 1;
+    index->long_hash  = (unsigned int *)(index + 1);
+    index->short_hash = index->long_hash + size;
+    data->refcount++;
+
+    for (i = 0; i < data->count; i++)
+    {
+        insert_dir_lookup_name( index->long_hash, index->hash_mask, data->names[i].long_name, i );
+        if (data->names[i].short_name[0])
+            insert_dir_lookup_name( index->short_hash, index->hash_mask, data->names[i].short_name, i );
+    }
+
+    /* replace the previous index of the same directory, or the least recently used one */
+    {
+        struct dir_lookup_index *old = find_dir_lookup_index( st );
+
+        if (!old && dir_lookup_count >= dir_lookup_max_count)
+            old = LIST_ENTRY( list_tail( &dir_lookup_list ), struct dir_lookup_index, entry );
+        if (old) free_dir_lookup_index( old );
+    }
+    list_add_head( &dir_lookup_list, &index->entry );
+    dir_lookup_count++;
+    return index;
+}
+
+
+/***********************************************************************
+ *           read_dir_lookup_index
+ *
+ * Read a directory and build its lookup index. Must be called with dir_section held.
+ */
+static struct dir_lookup_index *read_dir_lookup_index( const char *unix_name )
+{
+    struct dir_lookup_index *index = NULL;
+    struct dir_data *data;
+    struct stat st;
+    time_t now = time( NULL );
+    int fd, cwd;
+
+    if ((fd = open( unix_name, O_RDONLY | O_DIRECTORY )) == -1) return NULL;
+
+    if (!fstat( fd, &st ) && (data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*data) )))
+    {
+        data->refcount = 1;
+        cwd = open( ".", O_RDONLY );
+        if (fchdir( fd ) != -1)
+        {
+            if (!read_directory_data( data, fd, NULL )) index = set_dir_lookup_index( data, &st, now );
+            if (cwd == -1 || fchdir( cwd ) == -1) chdir( "/" );
+        }
+        if (cwd != -1) close( cwd );
+        free_dir_data( data );
+    }
+    close( fd );
+    return index;
+}
+
+
+/***********************************************************************
+ *           lookup_dir_index_name
+ *
+ * Find a file name in a directory lookup index and return the corresponding Unix name.
+ */
+static const char *lookup_dir_index_name( const struct dir_lookup_index *index, const WCHAR *name,
+                                          int length, BOOLEAN check_short )
+{
+    const struct dir_data_names *names;
+    unsigned int pos, idx, hash = hash_folded_name( name, length );
+
+    for (pos = hash & index->hash_mask; (idx = index->long_hash[pos]); pos = (pos + 1) & index->hash_mask)
+    {
+        names = &index->data->names[idx - 1];
+        if (!RtlCompareUnicodeStrings( names->long_name, wcslen(names->long_name), name, length, TRUE ))
+            return names->unix_name;
+    }
+    if (!check_short) return NULL;
+
+    for (pos = hash & index->hash_mask; (idx = index->short_hash[pos]); pos = (pos + 1) & index->hash_mask)
+    {
+        names = &index->data->names[idx - 1];
+        if (wcslen(names->short_name) == length && !wcsnicmp( names->short_name, name, length ))
+            return names->unix_name;
+    }
+    return NULL;
+}
+
+
 /***********************************************************************
  *           init_cached_dir_data
  *
@@ -1835,9 +2143,13 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
     struct stat st;
     NTSTATUS status;
     unsigned int i;
+    time_t now = time( NULL );
 
     if (!(data = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*data) )))
         return STATUS_NO_MEMORY;
+    data->refcount = 1;
+
+    if (fstat( fd, &st ) == -1) st.st_ino = st.st_dev = 0;
 
     if ((status = read_directory_data( data, fd, mask )))
     {
@@ -1860,11 +2172,11 @@ static NTSTATUS init_cached_dir_data( struct dir_data **data_ret, int fd, const
         if (data->count < data->size)
             RtlReAllocateHeap( GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY, data->names,
                                data->count * sizeof(*data->names) );
-        if (!fstat( fd, &st ))
-        {
-            data->id.dev = st.st_dev;
-            data->id.ino = st.st_ino;
-        }
+        data->id.dev = st.st_dev;
+        data->id.ino = st.st_ino;
+        /* a complete listing can be reused for case-insensitive lookups in the directory */
+        if (st.st_ino && (!mask || (mask->Length == sizeof(WCHAR) && mask->Buffer[0] == '*')))
+            set_dir_lookup_index( data, &st, now );
     }
 
     TRACE( "mask %s found %u files\n", debugstr_us( mask ), data->count );
@@ -2001,15 +2313,21 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH NtQueryDirectoryFile( HANDLE handle, HANDLE ev
         if (!(status = get_cached_dir_data( handle, &data, fd, mask )))
         {
             union file_directory_info *last_info = NULL;
+            struct dir_stat_prefetch *prefetch = NULL;
 
             if (restart_scan) data->pos = 0;
 
+            /* estimate the number of entries that fit in the buffer, assuming short names */
+            if (!single_entry)
+                prefetch = prefetch_dir_stats( data, length / dir_info_align( dir_info_size( info_class, 12 )));
+
             while (!status && data->pos < data->count)
             {
-                status = get_dir_data_entry( data, buffer, io, length, info_class, &last_info );
+                status = get_dir_data_entry( data, prefetch, buffer, io, length, info_class, &last_info );
                 if (!status || status == STATUS_BUFFER_OVERFLOW) data->pos++;
                 if (single_entry) break;
             }
+            if (prefetch) release_dir_stat_prefetch( prefetch );
 
             if (!last_info) status = STATUS_NO_MORE_FILES;
             else if (status == STATUS_MORE_ENTRIES) status = STATUS_SUCCESS;
@@ -2029,6 +2347,52 @@ NTSTATUS WINAPI DECLSPEC_HOTPATCH NtQueryDirectoryFile( HANDLE handle, HANDLE ev
 }
 
 
+/***********************************************************************
+ *           find_file_in_dir_index
+ *
+ * Find a file in a directory using the directory lookup index, reading the
+ * directory if the index is missing or out of date; helper for find_file_in_dir.
+ * Returns STATUS_NOT_SUPPORTED if the index can't be used.
+ */
+static NTSTATUS find_file_in_dir_index( char *unix_name, int pos, const WCHAR *name, int length,
+                                        BOOLEAN check_short )
+{
+    struct dir_lookup_index *index;
+    const char *found;
+    struct stat st;
+    NTSTATUS status = STATUS_NOT_SUPPORTED;
+
+    if (stat( unix_name, &st ) == -1) return status;
+
+    RtlEnterCriticalSection( &dir_section );
+
+    if ((index = find_dir_lookup_index( &st )) && index->stable && index->mtime == get_dir_mtime( &st ))
+        dir_lookup_hits++;
+    else
+    {
+        if (index) dir_lookup_rescans++;
+        else dir_lookup_misses++;
+        index = read_dir_lookup_index( unix_name );
+        TRACE( "read %s, %u hits %u misses %u rescans\n", debugstr_a(unix_name),
+               dir_lookup_hits, dir_lookup_misses, dir_lookup_rescans );
+    }
+
+    if (index)
+    {
+        if ((found = lookup_dir_index_name( index, name, length, check_short )))
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+            status = STATUS_SUCCESS;
+        }
+        else status = STATUS_OBJECT_PATH_NOT_FOUND;
+    }
+
+    RtlLeaveCriticalSection( &dir_section );
+    return status;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2077,6 +2441,14 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 
     if (!is_name_8_dot_3 && !get_dir_case_sensitivity( unix_name )) goto not_found;
 
+    /* look it up in the directory index */
+
+    switch (find_file_in_dir_index( unix_name, pos, name, length, is_name_8_dot_3 ))
+    {
+    case STATUS_SUCCESS: goto success;
+    case STATUS_OBJECT_PATH_NOT_FOUND: goto not_found;
+    }
+
     /* now look for it through the directory */
 
 #ifdef VFAT_IOCTL_READDIR_BOTH
@@ -269,6 +269,9 @@ static NTSTATUS FILE_CreateFile( PHANDLE handle, ACCESS_MASK access, POBJECT_ATT
             wine_server_add_data( req, unix_name.Buffer, unix_name.Length );
             io->u.Status = wine_server_call( req );
             *handle = wine_server_ptr_handle( reply->handle );
+            /* the server sends the unix fd along with the new handle */
+            if (!io->u.Status && reply->fd_type != FD_TYPE_INVALID)
+                server_cache_handle_fd( *handle, reply->fd_type, reply->fd_access, reply->fd_options );
         }
         SERVER_END_REQ;
         RtlFreeHeap( GetProcessHeap(), 0, objattr );
@@ -0,0 +1,468 @@
+/*
+ * Fast synchronization objects in shared memory
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When the wineserver is started with WINEFSYNC=1, events, semaphores and
+ * mutexes keep their state in a shared memory slot (see server/fsync.c).
+ * Signaling them and waiting on a single one of them is then done here with
+ * atomic operations and futexes.  Every function returns
+ * STATUS_NOT_IMPLEMENTED when the operation has to go through the server:
+ * the feature is disabled, the handle is not a fast object, the access
+ * rights are missing, or some thread is currently waiting on the object in
+ * the server.
+ *
+ * Mutexes are owned by the thread whose id is in the futex word; the
+ * recursion count is only meaningful to the owner.  Events keep a pulse
+ * count next to their state, so that waiters notice a PulseEvent even
+ * though the event is already reset when they wake up.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#include <time.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/library.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(sync);
+
+#ifdef __linux__
+
+/* the shared memory is mapped by several processes, so the futexes cannot be private */
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( int *addr, int val )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, val, NULL, 0, 0 );
+}
+
+/* atomically exchange a 64-bit value */
+static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
+{
+#ifdef _WIN64
+    return (LONG64)interlocked_xchg_ptr( (void **)dest, (void *)val );
+#else
+    LONG64 tmp = *dest;
+    while (interlocked_cmpxchg64( dest, val, tmp ) != tmp) tmp = *dest;
+    return tmp;
+#endif
+}
+
+static struct fsync_slot *fsync_shm;
+static int fsync_disabled;
+
+union fsync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;          /* slot index, 0 if the object has none */
+        unsigned int type : 3;       /* enum fsync_type */
+        unsigned int can_modify : 1; /* handle allows setting the object state */
+        unsigned int can_wait : 1;   /* handle allows waiting on the object */
+        unsigned int valid : 1;      /* entry has been filled */
+    } s;
+};
+
+C_ASSERT( sizeof(union fsync_cache_entry) == sizeof(LONG64) );
+
+#define FSYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(union fsync_cache_entry))
+#define FSYNC_CACHE_ENTRIES     128
+
+static union fsync_cache_entry *fsync_cache[FSYNC_CACHE_ENTRIES];
+
+static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / FSYNC_CACHE_BLOCK_SIZE;
+    return idx % FSYNC_CACHE_BLOCK_SIZE;
+}
+
+/* map the shared memory created by the server */
+static BOOL map_fsync_shm(void)
+{
+    static const char name[] = "/" FSYNC_SHM_NAME;
+    const size_t size = FSYNC_SHM_SLOTS * sizeof(struct fsync_slot);
+    const char *dir = wine_get_server_dir();
+    char *path;
+    void *ptr;
+    int fd;
+
+    if (!(path = RtlAllocateHeap( GetProcessHeap(), 0, strlen(dir) + sizeof(name) ))) return FALSE;
+    strcpy( path, dir );
+    strcat( path, name );
+    fd = open( path, O_RDWR );
+    RtlFreeHeap( GetProcessHeap(), 0, path );
+    if (fd == -1)
+    {
+        ERR( "cannot open shared memory: %s\n", strerror( errno ));
+        return FALSE;
+    }
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return FALSE;
+
+    /* another thread may have mapped it in the meantime */
+    if (interlocked_cmpxchg_ptr( (void **)&fsync_shm, ptr, NULL )) munmap( ptr, size );
+    return TRUE;
+}
+
+static union fsync_cache_entry *get_cache_entry( HANDLE handle )
+{
+    unsigned int entry, idx;
+
+    if (!handle || (LONG_PTR)handle < 0) return NULL;  /* pseudo-handles */
+    idx = handle_to_index( handle, &entry );
+    if (entry >= FSYNC_CACHE_ENTRIES) return NULL;
+
+    if (!fsync_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        void *ptr = wine_anon_mmap( NULL, FSYNC_CACHE_BLOCK_SIZE * sizeof(union fsync_cache_entry),
+                                    PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return NULL;
+        if (interlocked_cmpxchg_ptr( (void **)&fsync_cache[entry], ptr, NULL ))
+            munmap( ptr, FSYNC_CACHE_BLOCK_SIZE * sizeof(union fsync_cache_entry) );
+    }
+    return &fsync_cache[entry][idx];
+}
+
+/* retrieve the slot of a handle, asking the server on the first use */
+static struct fsync_slot *get_fsync_slot( HANDLE handle, union fsync_cache_entry *ret )
+{
+    union fsync_cache_entry *entry;
+    NTSTATUS status;
+
+    if (fsync_disabled || !(entry = get_cache_entry( handle ))) return NULL;
+
+    ret->data = interlocked_cmpxchg64( &entry->data, 0, 0 );
+    if (!ret->s.valid)
+    {
+        ret->data = 0;
+        SERVER_START_REQ( get_fsync_idx )
+        {
+            req->handle = wine_server_obj_handle( handle );
+            if (!(status = wine_server_call( req )))
+            {
+                ret->s.index = reply->index;
+                ret->s.type = reply->type;
+                ret->s.can_wait = !!(reply->access & SYNCHRONIZE);
+                /* releasing a mutex doesn't require any access right */
+                ret->s.can_modify = (reply->type == FSYNC_MUTEX ||
+                                     (reply->access & (EVENT_MODIFY_STATE | SEMAPHORE_MODIFY_STATE)));
+            }
+        }
+        SERVER_END_REQ;
+
+        if (status == STATUS_NOT_IMPLEMENTED)
+        {
+            TRACE( "not supported by the server\n" );
+            fsync_disabled = 1;
+            return NULL;
+        }
+        if (status) return NULL;
+        if (ret->s.index && !fsync_shm && !map_fsync_shm())
+        {
+            fsync_disabled = 1;
+            return NULL;
+        }
+        ret->s.valid = 1;
+        interlocked_xchg64( &entry->data, ret->data );
+    }
+    if (!ret->s.index || ret->s.index >= FSYNC_SHM_SLOTS) return NULL;
+    return &fsync_shm[ret->s.index];
+}
+
+/***********************************************************************
+ *           fsync_close
+ *
+ * Forget the cached slot of a handle that is being closed.
+ */
+void fsync_close( HANDLE handle )
+{
+    unsigned int entry, idx;
+
+    if (!handle || (LONG_PTR)handle < 0) return;
+    idx = handle_to_index( handle, &entry );
+    if (entry < FSYNC_CACHE_ENTRIES && fsync_cache[entry])
+        interlocked_xchg64( &fsync_cache[entry][idx].data, 0 );
+}
+
+static NTSTATUS set_event_state( HANDLE handle, int state, LONG *prev_state )
+{
+    union fsync_cache_entry cache;
+    struct fsync_slot *slot;
+    int old;
+
+    if (!(slot = get_fsync_slot( handle, &cache ))) return STATUS_NOT_IMPLEMENTED;
+    if (cache.s.type != FSYNC_AUTO_EVENT && cache.s.type != FSYNC_MANUAL_EVENT) return STATUS_NOT_IMPLEMENTED;
+    if (!cache.s.can_modify) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = slot->value;
+        if (old & FSYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+    } while ((old & FSYNC_EVENT_SIGNALED) != state &&
+             interlocked_cmpxchg( &slot->value, (old & ~FSYNC_EVENT_SIGNALED) | state, old ) != old);
+
+    old &= FSYNC_EVENT_SIGNALED;
+    if (state && !old) futex_wake( &slot->value, cache.s.type == FSYNC_AUTO_EVENT ? 1 : INT_MAX );
+    if (prev_state) *prev_state = old;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_set_event
+ */
+NTSTATUS fsync_set_event( HANDLE handle, LONG *prev_state )
+{
+    return set_event_state( handle, 1, prev_state );
+}
+
+/***********************************************************************
+ *           fsync_reset_event
+ */
+NTSTATUS fsync_reset_event( HANDLE handle, LONG *prev_state )
+{
+    return set_event_state( handle, 0, prev_state );
+}
+
+/***********************************************************************
+ *           fsync_release_semaphore
+ */
+NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    union fsync_cache_entry cache;
+    struct fsync_slot *slot;
+    int old;
+
+    if (!(slot = get_fsync_slot( handle, &cache ))) return STATUS_NOT_IMPLEMENTED;
+    if (cache.s.type != FSYNC_SEMAPHORE || !cache.s.can_modify) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = slot->value;
+        if (old & FSYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+        if (count > slot->max - old) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (interlocked_cmpxchg( &slot->value, old + count, old ) != old);
+
+    /* there cannot be any thread to wake up if the count was != 0 */
+    if (!old) futex_wake( &slot->value, count );
+    if (previous) *previous = old;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           fsync_release_mutex
+ */
+NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev_count )
+{
+    int tid = GetCurrentThreadId();
+    union fsync_cache_entry cache;
+    struct fsync_slot *slot;
+    int old, count;
+
+    if (!(slot = get_fsync_slot( handle, &cache ))) return STATUS_NOT_IMPLEMENTED;
+    if (cache.s.type != FSYNC_MUTEX) return STATUS_NOT_IMPLEMENTED;
+
+    old = slot->value;
+    if (old & FSYNC_SERVER_WAIT) return STATUS_NOT_IMPLEMENTED;
+    if (old != tid) return STATUS_MUTANT_NOT_OWNED;
+
+    /* only the owner modifies the recursion count */
+    count = slot->count;
+    slot->count = count - 1;
+    if (count == 1 && interlocked_cmpxchg( &slot->value, 0, tid ) != tid)
+    {
+        /* somebody started waiting in the server, let it handle the release */
+        slot->count = count;
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    if (count == 1) futex_wake( &slot->value, 1 );
+    if (prev_count) *prev_count = 1 - count;
+    return STATUS_SUCCESS;
+}
+
+/* try to acquire an object given its current state; return -1 if not signaled, 1 to retry */
+static int try_acquire( struct fsync_slot *slot, enum fsync_type type, int old, NTSTATUS *status )
+{
+    int tid;
+
+    *status = STATUS_WAIT_0;
+    switch (type)
+    {
+    case FSYNC_MANUAL_EVENT:
+        return (old & FSYNC_EVENT_SIGNALED) ? 0 : -1;
+    case FSYNC_AUTO_EVENT:
+        if (!(old & FSYNC_EVENT_SIGNALED)) return -1;
+        return interlocked_cmpxchg( &slot->value, old & ~FSYNC_EVENT_SIGNALED, old ) != old;
+    case FSYNC_SEMAPHORE:
+        if (!old) return -1;
+        return interlocked_cmpxchg( &slot->value, old - 1, old ) != old;
+    case FSYNC_MUTEX:
+        tid = GetCurrentThreadId();
+        if (old == tid)
+        {
+            slot->count++;
+            return 0;
+        }
+        if (old) return -1;
+        if (interlocked_cmpxchg( &slot->value, tid, 0 )) return 1;
+        slot->count = 1;
+        if (slot->abandoned)
+        {
+            slot->abandoned = 0;
+            *status = STATUS_ABANDONED_WAIT_0;
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/***********************************************************************
+ *           fsync_wait
+ *
+ * Non-alertable wait on a single object. When falling back to the server,
+ * the timeout is updated to the remaining time.
+ */
+NTSTATUS fsync_wait( HANDLE handle, const LARGE_INTEGER **timeout, LARGE_INTEGER *remaining )
+{
+    union fsync_cache_entry cache;
+    struct fsync_slot *slot;
+    LARGE_INTEGER now, end;
+    struct timespec ts;
+    NTSTATUS status;
+    timeout_t diff;
+    int old, ret, pulse;
+
+    if (!(slot = get_fsync_slot( handle, &cache ))) return STATUS_NOT_IMPLEMENTED;
+    if (!cache.s.can_wait) return STATUS_NOT_IMPLEMENTED;
+
+    end.QuadPart = 0;
+    if (*timeout && (*timeout)->QuadPart < 0)
+    {
+        RtlQueryPerformanceCounter( &now );
+        end.QuadPart = now.QuadPart - (*timeout)->QuadPart;
+    }
+
+    pulse = slot->value & FSYNC_EVENT_PULSE_MASK;
+    for (;;)
+    {
+        old = slot->value;
+        if ((cache.s.type == FSYNC_MANUAL_EVENT || cache.s.type == FSYNC_AUTO_EVENT) &&
+            (old & FSYNC_EVENT_PULSE_MASK) != pulse)
+        {
+            /* the event has been pulsed since we started waiting; all waiters of a
+             * manual-reset event are released, only the first one of an auto-reset one */
+            if (cache.s.type == FSYNC_MANUAL_EVENT || interlocked_cmpxchg( &slot->count, 0, 1 ) == 1)
+                return STATUS_WAIT_0;
+            pulse = old & FSYNC_EVENT_PULSE_MASK;
+        }
+        if (old & FSYNC_SERVER_WAIT) break;
+        if (!(ret = try_acquire( slot, cache.s.type, old, &status ))) return status;
+        if (ret > 0) continue;
+
+        diff = TIMEOUT_INFINITE;
+        if (*timeout && (*timeout)->QuadPart < 0)
+        {
+            RtlQueryPerformanceCounter( &now );
+            diff = end.QuadPart - now.QuadPart;
+        }
+        else if (*timeout)
+        {
+            NtQuerySystemTime( &now );
+            diff = (*timeout)->QuadPart - now.QuadPart;
+        }
+        if (diff <= 0) return STATUS_TIMEOUT;
+
+        if (diff != TIMEOUT_INFINITE)
+        {
+            ts.tv_sec  = diff / 10000000;
+            ts.tv_nsec = (diff % 10000000) * 100;
+        }
+        futex_wait( &slot->value, old, diff != TIMEOUT_INFINITE ? &ts : NULL );
+    }
+
+    /* the server owns the object now, wait there for the remaining time */
+    if (*timeout && (*timeout)->QuadPart < 0)
+    {
+        RtlQueryPerformanceCounter( &now );
+        remaining->QuadPart = min( now.QuadPart - end.QuadPart, 0 );
+        *timeout = remaining;
+    }
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#else  /* __linux__ */
+
+void fsync_close( HANDLE handle )
+{
+}
+
+NTSTATUS fsync_set_event( HANDLE handle, LONG *prev_state )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+NTSTATUS fsync_reset_event( HANDLE handle, LONG *prev_state )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev_count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+NTSTATUS fsync_wait( HANDLE handle, const LARGE_INTEGER **timeout, LARGE_INTEGER *remaining )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
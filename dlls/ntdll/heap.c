@@ -164,6 +164,9 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_slot *lfh;           /* Low fragmentation front end, NULL if disabled */
+    LONG             lfh_epoch;     /* Sub-heap list epoch, see lfh_free */
+    LONG             lfh_readers[2];/* Front end threads walking the sub-heap list, by epoch */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -178,6 +181,34 @@ typedef struct tagHEAP
 #define HEAP_VALIDATE_ALL     0x20000000
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
+/* Low fragmentation front end, enabled with RtlSetHeapInformation.
+ * Small blocks are cached in per size magazines, grouped in slots that are
+ * assigned to threads by thread id, so that most allocations and frees don't
+ * need the heap critical section. Cached blocks are in-use blocks marked as
+ * pending, and are moved from and to the heap in batches.
+ */
+#define LFH_MAX_BLOCK_SIZE   0x100  /* largest block size handled by the front end */
+#define LFH_NB_CLASSES       (LFH_MAX_BLOCK_SIZE / ALIGNMENT + 1)
+#define LFH_MAGAZINE_SIZE    32     /* max number of cached blocks of a given size */
+#define LFH_BATCH_SIZE       (LFH_MAGAZINE_SIZE / 2)  /* number of blocks moved at once */
+#define LFH_NB_SLOTS         16     /* number of thread slots */
+
+/* heap flags that are incompatible with the front end */
+#define LFH_UNSUPPORTED_FLAGS (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_TAIL_CHECKING_ENABLED | \
+                               HEAP_FREE_CHECKING_ENABLED | HEAP_PAGE_ALLOCS | HEAP_VALIDATE)
+
+struct lfh_magazine
+{
+    unsigned int  count;                      /* number of cached blocks */
+    ARENA_INUSE  *blocks[LFH_MAGAZINE_SIZE];  /* cached blocks, most recently freed last */
+};
+
+struct lfh_slot
+{
+    LONG                lock;                       /* set while a thread is using the slot */
+    struct lfh_magazine magazines[LFH_NB_CLASSES];  /* magazines indexed by block size */
+};
+
 static HEAP *processHeap;  /* main process heap */
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
@@ -625,6 +656,21 @@ static void HEAP_CreateFreeBlock( SUBHEAP *subheap, void *ptr, SIZE_T size )
 }
 
 
+/***********************************************************************
+ *           lfh_wait_readers
+ *
+ * Wait until no front end thread can still see a sub-heap that has just
+ * been removed from the list. Must be called with the heap lock held.
+ */
+static void lfh_wait_readers( HEAP *heap )
+{
+    /* threads that start walking from now on use the other counter */
+    LONG epoch = interlocked_xchg_add( &heap->lfh_epoch, 1 ) & 1;
+
+    while (heap->lfh_readers[epoch]) NtYieldExecution();
+}
+
+
 /***********************************************************************
  *           HEAP_MakeInUseBlockFree
  *
@@ -680,6 +726,8 @@ static void HEAP_MakeInUseBlockFree( SUBHEAP *subheap, ARENA_INUSE *pArena )
         list_remove( &pFree->entry );
         /* Remove the subheap from the list */
         list_remove( &subheap->entry );
+        /* The front end may still be walking the list without the lock */
+        if (heap->lfh) lfh_wait_readers( heap );
         /* Free the memory */
         subheap->magic = 0;
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
@@ -914,7 +962,11 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         subheap->commitSize = commitSize;
         subheap->magic      = SUBHEAP_MAGIC;
         subheap->headerSize = ROUND_SIZE( sizeof(SUBHEAP) );
-        list_add_head( &heap->subheap_list, &subheap->entry );
+        /* the front end walks the list without the lock, so link the entry last */
+        subheap->entry.next = heap->subheap_list.next;
+        subheap->entry.prev = &heap->subheap_list;
+        heap->subheap_list.next->prev = &subheap->entry;
+        interlocked_xchg_ptr( (void **)&heap->subheap_list.next, &subheap->entry );
     }
     else
     {
@@ -924,6 +976,9 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         heap->flags         = flags;
         heap->magic         = HEAP_MAGIC;
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
+        heap->lfh           = NULL;
+        heap->lfh_epoch     = 0;
+        heap->lfh_readers[0] = heap->lfh_readers[1] = 0;
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
 
@@ -1283,7 +1338,7 @@ static BOOL HEAP_ValidateInUseArena( const SUBHEAP *subheap, const ARENA_INUSE *
         return FALSE;
     }
     /* Check unused bytes */
-    if (pArena->magic == ARENA_PENDING_MAGIC)
+    if (pArena->magic == ARENA_PENDING_MAGIC && (flags & HEAP_FREE_CHECKING_ENABLED))
     {
         const DWORD *ptr = (const DWORD *)(pArena + 1);
         const DWORD *end = (const DWORD *)((const char *)ptr + size);
@@ -1520,6 +1575,213 @@ void heap_set_debug_flags( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           allocate_block
+ *
+ * Allocate an in-use block from the free lists. The heap must be locked.
+ */
+static ARENA_INUSE *allocate_block( HEAP *heap, SIZE_T rounded_size )
+{
+    ARENA_FREE *pArena;
+    ARENA_INUSE *pInUse;
+    SUBHEAP *subheap;
+
+    /* Locate a suitable free block */
+
+    if (!(pArena = HEAP_FindFreeBlock( heap, rounded_size, &subheap ))) return NULL;
+
+    /* Remove the arena from the free list */
+
+    list_remove( &pArena->entry );
+
+    /* Build the in-use arena */
+
+    pInUse = (ARENA_INUSE *)pArena;
+
+    /* in-use arena is smaller than free arena,
+     * so we have to add the difference to the size */
+    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
+    pInUse->magic = ARENA_INUSE_MAGIC;
+
+    /* Shrink the block */
+
+    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
+    return pInUse;
+}
+
+
+/***********************************************************************
+ *           lfh_lock_slot
+ *
+ * Grab the front end slot of the current thread, or return NULL if it is busy.
+ */
+static inline struct lfh_slot *lfh_lock_slot( HEAP *heap )
+{
+    ULONG tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct lfh_slot *slot = &heap->lfh[(tid / 4) % LFH_NB_SLOTS];
+
+    if (interlocked_cmpxchg( &slot->lock, 1, 0 )) return NULL;
+    return slot;
+}
+
+static inline void lfh_unlock_slot( struct lfh_slot *slot )
+{
+    interlocked_xchg( &slot->lock, 0 );
+}
+
+
+/***********************************************************************
+ *           lfh_fill_magazine
+ *
+ * Move a batch of new blocks of the given size from the heap to a slot.
+ */
+static void lfh_fill_magazine( HEAP *heap, struct lfh_slot *slot, SIZE_T rounded_size )
+{
+    struct lfh_magazine *magazine;
+    ARENA_INUSE *arena;
+    SIZE_T size;
+    unsigned int i;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    for (i = 0; i < LFH_BATCH_SIZE; i++)
+    {
+        if (!(arena = allocate_block( heap, rounded_size ))) break;
+        arena->magic = ARENA_PENDING_MAGIC;
+
+        /* the block is larger than requested if the rest was too small to be split */
+        size = arena->size & ARENA_SIZE_MASK;
+        magazine = &slot->magazines[size / ALIGNMENT];
+        if (size <= LFH_MAX_BLOCK_SIZE && magazine->count < LFH_MAGAZINE_SIZE)
+            magazine->blocks[magazine->count++] = arena;
+        else
+            HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, arena ), arena );
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+
+/***********************************************************************
+ *           lfh_flush_magazine
+ *
+ * Return the least recently freed half of a full magazine to the heap.
+ */
+static void lfh_flush_magazine( HEAP *heap, struct lfh_magazine *magazine )
+{
+    unsigned int i;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    for (i = 0; i < LFH_BATCH_SIZE; i++)
+        HEAP_MakeInUseBlockFree( HEAP_FindSubHeap( heap, magazine->blocks[i] ), magazine->blocks[i] );
+    RtlLeaveCriticalSection( &heap->critSection );
+
+    magazine->count -= LFH_BATCH_SIZE;
+    memmove( magazine->blocks, magazine->blocks + LFH_BATCH_SIZE,
+             magazine->count * sizeof(magazine->blocks[0]) );
+}
+
+
+/***********************************************************************
+ *           lfh_allocate
+ *
+ * Allocate a small block from the front end; return NULL to use the heap instead.
+ */
+static void *lfh_allocate( HEAP *heap, DWORD flags, SIZE_T size, SIZE_T rounded_size )
+{
+    struct lfh_magazine *magazine;
+    struct lfh_slot *slot;
+    ARENA_INUSE *arena = NULL;
+
+    if (!(slot = lfh_lock_slot( heap ))) return NULL;
+    magazine = &slot->magazines[rounded_size / ALIGNMENT];
+    if (!magazine->count) lfh_fill_magazine( heap, slot, rounded_size );
+    if (magazine->count) arena = magazine->blocks[--magazine->count];
+    lfh_unlock_slot( slot );
+    if (!arena) return NULL;
+
+    arena->magic = ARENA_INUSE_MAGIC;
+    arena->unused_bytes = (arena->size & ARENA_SIZE_MASK) - size;
+    notify_alloc( arena + 1, size, flags & HEAP_ZERO_MEMORY );
+    initialize_block( arena + 1, size, arena->unused_bytes, flags );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Cache a small block in the front end; return FALSE to free it to the heap instead.
+ */
+static BOOL lfh_free( HEAP *heap, ARENA_INUSE *arena )
+{
+    struct lfh_magazine *magazine;
+    struct lfh_slot *slot;
+    SUBHEAP *subheap;
+    SIZE_T size = 0;
+    LONG epoch;
+    BOOL valid;
+
+    /* leave anything unusual to the full validation in RtlFreeHeap */
+    if ((ULONG_PTR)arena % ALIGNMENT != ARENA_OFFSET) return FALSE;
+
+    /* the sub-heaps we may look at are not released until we are done, see lfh_wait_readers */
+    epoch = heap->lfh_epoch & 1;
+    interlocked_xchg_add( &heap->lfh_readers[epoch], 1 );
+    valid = ((subheap = HEAP_FindSubHeap( heap, arena )) &&
+             (char *)arena >= (char *)subheap->base + subheap->headerSize &&
+             arena->magic == ARENA_INUSE_MAGIC && !(arena->size & ARENA_FLAG_FREE) &&
+             (size = arena->size & ARENA_SIZE_MASK) <= LFH_MAX_BLOCK_SIZE);
+    interlocked_xchg_add( &heap->lfh_readers[epoch], -1 );
+    if (!valid) return FALSE;
+
+    if (!(slot = lfh_lock_slot( heap ))) return FALSE;
+    magazine = &slot->magazines[size / ALIGNMENT];
+    if (magazine->count == LFH_MAGAZINE_SIZE) lfh_flush_magazine( heap, magazine );
+    arena->magic = ARENA_PENDING_MAGIC;
+    magazine->blocks[magazine->count++] = arena;
+    lfh_unlock_slot( slot );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           heap_enable_lfh
+ */
+static NTSTATUS heap_enable_lfh( HEAP *heap )
+{
+    struct lfh_slot *slots = NULL;
+    SIZE_T size = LFH_NB_SLOTS * sizeof(*slots);
+    NTSTATUS status;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (!(heap->flags & HEAP_GROWABLE) || (heap->flags & LFH_UNSUPPORTED_FLAGS) ||
+        heap->pending_free || RUNNING_ON_VALGRIND)
+    {
+        WARN( "heap %p flags %08x doesn't support the low fragmentation heap\n", heap, heap->flags );
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), (void **)&slots, 0, &size,
+                                           MEM_COMMIT, PAGE_READWRITE )))
+        return status;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    if (!heap->lfh)
+    {
+        heap->lfh = slots;
+        slots = NULL;
+    }
+    RtlLeaveCriticalSection( &heap->critSection );
+
+    if (slots)
+    {
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), (void **)&slots, &size, MEM_RELEASE );
+    }
+    TRACE( "enabled low fragmentation heap for %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1622,6 +1884,12 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
         NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
     }
     subheap_notify_free_all(&heapPtr->subheap);
+    if (heapPtr->lfh)
+    {
+        size = 0;
+        addr = heapPtr->lfh;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
     if (heapPtr->pending_free)
     {
         size = 0;
@@ -1654,9 +1922,7 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
  */
 void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 {
-    ARENA_FREE *pArena;
     ARENA_INUSE *pInUse;
-    SUBHEAP *subheap;
     HEAP *heapPtr = HEAP_GetPtr( heap );
     SIZE_T rounded_size;
 
@@ -1673,6 +1939,16 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && rounded_size <= LFH_MAX_BLOCK_SIZE)
+    {
+        void *ret = lfh_allocate( heapPtr, flags, size, rounded_size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
@@ -1684,9 +1960,7 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
         return ret;
     }
 
-    /* Locate a suitable free block */
-
-    if (!(pArena = HEAP_FindFreeBlock( heapPtr, rounded_size, &subheap )))
+    if (!(pInUse = allocate_block( heapPtr, rounded_size )))
     {
         TRACE("(%p,%08x,%08lx): returning NULL\n",
                   heap, flags, size  );
@@ -1695,22 +1969,6 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
         return NULL;
     }
 
-    /* Remove the arena from the free list */
-
-    list_remove( &pArena->entry );
-
-    /* Build the in-use arena */
-
-    pInUse = (ARENA_INUSE *)pArena;
-
-    /* in-use arena is smaller than free arena,
-     * so we have to add the difference to the size */
-    pInUse->size  = (pInUse->size & ~ARENA_FLAG_FREE) + sizeof(ARENA_FREE) - sizeof(ARENA_INUSE);
-    pInUse->magic = ARENA_INUSE_MAGIC;
-
-    /* Shrink the block */
-
-    HEAP_ShrinkBlock( subheap, pInUse, rounded_size );
     pInUse->unused_bytes = (pInUse->size & ARENA_SIZE_MASK) - size;
 
     notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
@@ -1754,6 +2012,13 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
         return FALSE;
     }
 
+    if (heapPtr->lfh && lfh_free( heapPtr, (ARENA_INUSE *)ptr - 1 ))
+    {
+        notify_free( ptr );
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
@@ -2244,7 +2509,7 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        *(ULONG *)info = (heap && ((HEAP *)heap)->lfh) ? 2 /* low fragmentation heap */ : 0;
         return STATUS_SUCCESS;
 
     default:
@@ -2258,6 +2523,27 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* the low fragmentation heap cannot be disabled */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:
+            return heap_enable_lfh( heapPtr );
+        default:
+            FIXME("%p: unsupported heap compatibility mode %u\n", heap, *(ULONG *)info);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
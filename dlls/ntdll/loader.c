@@ -53,6 +53,7 @@ WINE_DECLARE_DEBUG_CHANNEL(relay);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
+WINE_DECLARE_DEBUG_CHANNEL(loadtime);
 
 #ifdef _WIN64
 #define DEFAULT_SECURITY_COOKIE_64  (((ULONGLONG)0x00002b99 << 32) | 0x2ddfa232)
@@ -97,6 +98,26 @@ struct dll_dir_entry
 
 static struct list dll_dir_list = LIST_INIT( dll_dir_list );  /* extra dirs from LdrAddDllDirectory */
 
+/* load time statistics of a dll, see load_dll */
+struct load_timing
+{
+    struct load_timing *parent;   /* statistics of the dll that caused this one to be loaded */
+    ULONGLONG           start;    /* time the load started */
+    ULONGLONG           search;   /* time spent looking for the dll file */
+    ULONGLONG           relocs;   /* time spent applying relocations */
+    ULONGLONG           deps;     /* time spent loading the dependencies */
+};
+
+static struct load_timing *current_load_timing;
+
+static inline ULONGLONG get_load_time(void)
+{
+    LARGE_INTEGER counter;
+
+    RtlQueryPerformanceCounter( &counter );
+    return counter.QuadPart;
+}
+
 struct ldr_notification
 {
     struct list                    entry;
@@ -128,6 +149,9 @@ typedef struct _wine_modref
     int                   alloc_deps;
     int                   nDeps;
     struct _wine_modref **deps;
+    unsigned int          export_lookups;   /* number of exports looked up by name */
+    unsigned int          export_hash_mask; /* size of the export hash table - 1 */
+    DWORD                *export_hash;      /* export names hash table, index + 1 in AddressOfNames */
 } WINE_MODREF;
 
 /* info about the current builtin dll load */
@@ -717,6 +741,43 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 }
 
 
+/* hash an export name */
+static inline unsigned int hash_export_name( const char *name )
+{
+    unsigned int hash = 0;
+
+    while (*name) hash = hash * 65599 + (unsigned char)*name++;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		create_export_hash
+ *
+ * Build the hash table of the export names of a module.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL create_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( wm->ldr.BaseAddress, exports->AddressOfNames );
+    unsigned int i, pos, size = 64;
+
+    while (size < 2 * exports->NumberOfNames) size *= 2;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, size * sizeof(DWORD) )))
+        return FALSE;
+    wm->export_hash_mask = size - 1;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( wm->ldr.BaseAddress, names[i] )) & wm->export_hash_mask;
+        while (wm->export_hash[pos]) pos = (pos + 1) & wm->export_hash_mask;
+        wm->export_hash[pos] = i + 1;
+    }
+    TRACE( "%s: %u names\n", debugstr_w(wm->ldr.BaseDllName.Buffer), exports->NumberOfNames );
+    return TRUE;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -729,6 +790,7 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int min = 0, max = exports->NumberOfNames - 1;
+    WINE_MODREF *wm;
 
     /* first check the hint */
     if (hint >= 0 && hint <= max)
@@ -738,7 +800,21 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
+    /* then use the hash table, once the module has been searched often enough to make it worth it */
+    if (exports->NumberOfNames >= 64 && (wm = get_modref( module )) &&
+        (wm->export_hash || (++wm->export_lookups >= 32 && create_export_hash( wm, exports ))))
+    {
+        unsigned int idx, pos = hash_export_name( name ) & wm->export_hash_mask;
+
+        for ( ; (idx = wm->export_hash[pos]); pos = (pos + 1) & wm->export_hash_mask)
+        {
+            if (!strcmp( get_rva( module, names[idx - 1] ), name ))
+                return find_ordinal_export( module, exports, exp_size, ordinals[idx - 1], load_path );
+        }
+        return NULL;
+    }
+
+    /* otherwise do a binary search */
     while (min <= max)
     {
         int res, pos = (min + max) / 2;
@@ -1467,10 +1543,14 @@ static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved )
     if (status == STATUS_SUCCESS)
     {
         WINE_MODREF *prev = current_modref;
+        ULONGLONG start = get_load_time();
+
         current_modref = wm;
 
         call_ldr_notifications( LDR_DLL_NOTIFICATION_REASON_LOADED, &wm->ldr );
         status = MODULE_InitDLL( wm, DLL_PROCESS_ATTACH, lpReserved );
+        TRACE_(loadtime)( "%s: init %s\n", debugstr_w(wm->ldr.FullDllName.Buffer),
+                          wine_dbgstr_longlong( (get_load_time() - start) / 10 ));
         if (status == STATUS_SUCCESS)
         {
             wm->ldr.Flags |= LDR_PROCESS_ATTACHED;
@@ -2530,13 +2610,16 @@ static NTSTATUS load_native_dll( LPCWSTR load_path, const UNICODE_STRING *nt_nam
     IMAGE_NT_HEADERS *nt = RtlImageNtHeader( *module );
     WINE_MODREF *wm;
     NTSTATUS status;
+    ULONGLONG start;
     const char *dll_type = (image_info->image_flags & IMAGE_FLAGS_WineBuiltin) ? "PE builtin" : "native";
 
     TRACE("Trying %s dll %s\n", dll_type, debugstr_us(nt_name) );
 
     /* perform base relocation, if necessary */
 
+    start = get_load_time();
     if ((status = perform_relocations( *module, nt, image_info->map_size ))) return status;
+    if (current_load_timing) current_load_timing->relocs += get_load_time() - start;
 
     /* create the MODREF */
 
@@ -2700,6 +2783,207 @@ static NTSTATUS open_builtin_file( char *name, WINE_MODREF **pwm, void **module,
 }
 
 
+/* persistent cache of the load path directories containing the builtin dlls, see find_builtin_dll */
+struct builtin_path
+{
+    struct list entry;
+    const char *dir;      /* load path directory */
+    char        name[1];  /* lower-case dll name, followed by the directory */
+};
+
+static struct list builtin_paths = LIST_INIT( builtin_paths );
+static char *builtin_paths_file;  /* cache file name, NULL if the cache is disabled */
+static BOOL builtin_paths_loaded;
+
+static const char builtin_paths_header[] = "WINE BUILTIN PATHS 3\n";
+
+/* there is a cache per architecture and per load path */
+#ifdef __i386__
+static const char builtin_paths_arch[] = "x86";
+#elif defined(__x86_64__)
+static const char builtin_paths_arch[] = "x86_64";
+#elif defined(__powerpc__)
+static const char builtin_paths_arch[] = "powerpc";
+#elif defined(__arm__)
+static const char builtin_paths_arch[] = "arm";
+#elif defined(__aarch64__)
+static const char builtin_paths_arch[] = "arm64";
+#else
+#error Unsupported CPU
+#endif
+
+/* add an entry, replacing an older one for the same dll */
+static void add_builtin_path( const char *name, unsigned int len, const char *dir )
+{
+    struct builtin_path *path;
+    unsigned int dir_len = strlen( dir ) + 1;
+
+    LIST_FOR_EACH_ENTRY( path, &builtin_paths, struct builtin_path, entry )
+    {
+        if (strncmp( path->name, name, len ) || path->name[len]) continue;
+        list_remove( &path->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, path );
+        break;
+    }
+
+    if (!(path = RtlAllocateHeap( GetProcessHeap(), 0, offsetof( struct builtin_path, name[len + 1 + dir_len] ))))
+        return;
+    memcpy( path->name, name, len );
+    path->name[len] = 0;
+    path->dir = memcpy( path->name + len + 1, dir, dir_len );
+    list_add_tail( &builtin_paths, &path->entry );
+}
+
+/* format the cache header, listing the load path directories with their modification times */
+static char *get_builtin_paths_header(void)
+{
+    const char *dir;
+    char *header, *p;
+    struct stat st;
+    unsigned int i, len = sizeof(builtin_paths_header);
+
+    for (i = 0; (dir = wine_dll_enum_load_path( i )); i++) len += strlen( dir ) + 48;
+    if (!(header = RtlAllocateHeap( GetProcessHeap(), 0, len ))) return NULL;
+
+    p = header + sprintf( header, "%s", builtin_paths_header );
+    for (i = 0; (dir = wine_dll_enum_load_path( i )); i++)
+    {
+        if (stat( dir, &st ) == -1) st.st_mtime = 0;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+        p += sprintf( p, "D %lu.%09lu %s\n", (unsigned long)st.st_mtime, (unsigned long)st.st_mtim.tv_nsec, dir );
+#else
+        p += sprintf( p, "D %lu %s\n", (unsigned long)st.st_mtime, dir );
+#endif
+    }
+    return header;
+}
+
+/* build the cache file name from the architecture and a hash of the load path directories */
+static char *get_builtin_paths_file( const char *config_dir )
+{
+    unsigned int i, hash = 2166136261u;
+    const char *dir, *p;
+    char *file;
+
+    for (i = 0; (dir = wine_dll_enum_load_path( i )); i++)
+    {
+        for (p = dir; *p; p++) hash = (hash ^ (unsigned char)*p) * 16777619;
+        hash = (hash ^ '\n') * 16777619;
+    }
+
+    if (!(file = RtlAllocateHeap( GetProcessHeap(), 0, strlen( config_dir ) + sizeof("/.builtin-paths--")
+                                  + strlen( builtin_paths_arch ) + 8 )))
+        return NULL;
+    sprintf( file, "%s/.builtin-paths-%s-%08x", config_dir, builtin_paths_arch, hash );
+    return file;
+}
+
+/* read the cache file, or reset it if the load path changed since it was written */
+static void load_builtin_paths(void)
+{
+    const char *config_dir = wine_get_config_dir();
+    char *header, *data = NULL, *p, *sep, *next;
+    struct stat st;
+    size_t header_len;
+    int fd;
+
+    builtin_paths_loaded = TRUE;
+
+    /* don't bother when running from the build tree, or when there's no other directory to skip */
+    if (wine_get_build_dir() || !config_dir || !wine_dll_enum_load_path( 1 )) return;
+    if (!(header = get_builtin_paths_header())) return;
+    if (!(builtin_paths_file = get_builtin_paths_file( config_dir ))) goto done;
+    header_len = strlen( header );
+
+    if ((fd = open( builtin_paths_file, O_RDONLY )) != -1)
+    {
+        if (!fstat( fd, &st ) && st.st_size > header_len && st.st_size < 0x100000 &&
+            (data = RtlAllocateHeap( GetProcessHeap(), 0, st.st_size + 1 )) &&
+            read( fd, data, st.st_size ) == st.st_size)
+            data[st.st_size] = 0;
+        else
+        {
+            RtlFreeHeap( GetProcessHeap(), 0, data );
+            data = NULL;
+        }
+        close( fd );
+    }
+
+    if (data && !memcmp( data, header, header_len ))
+    {
+        /* each line is the directory, a tab and the dll name */
+        for (p = data + header_len; (next = strchr( p, '\n' )); p = next + 1)
+        {
+            *next = 0;
+            if (!(sep = strchr( p, '\t' ))) break;
+            *sep = 0;
+            add_builtin_path( sep + 1, next - sep - 1, p );
+        }
+        TRACE( "loaded %u entries from %s\n", list_count( &builtin_paths ), debugstr_a(builtin_paths_file) );
+    }
+    else
+    {
+        /* a load path directory changed, start a new cache */
+        char *tmp = RtlAllocateHeap( GetProcessHeap(), 0, strlen(builtin_paths_file) + sizeof(".XXXXXX") );
+
+        TRACE( "resetting %s\n", debugstr_a(builtin_paths_file) );
+        if (tmp)
+        {
+            strcpy( tmp, builtin_paths_file );
+            strcat( tmp, ".XXXXXX" );
+            if ((fd = mkstemps( tmp, 0 )) != -1)
+            {
+                if (write( fd, header, header_len ) == header_len && !fchmod( fd, 0644 ))
+                    rename( tmp, builtin_paths_file );
+                else
+                    unlink( tmp );
+                close( fd );
+            }
+            RtlFreeHeap( GetProcessHeap(), 0, tmp );
+        }
+    }
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, data );
+    RtlFreeHeap( GetProcessHeap(), 0, header );
+}
+
+/* find the cached load path directory of a builtin dll */
+static struct builtin_path *find_builtin_path( const char *name, unsigned int len )
+{
+    struct builtin_path *path;
+
+    if (!builtin_paths_loaded) load_builtin_paths();
+    if (!builtin_paths_file) return NULL;
+
+    LIST_FOR_EACH_ENTRY( path, &builtin_paths, struct builtin_path, entry )
+        if (!strncmp( path->name, name, len ) && !path->name[len]) return path;
+    return NULL;
+}
+
+/* remember the load path directory of a builtin dll, for this and later processes */
+static void store_builtin_path( const char *name, unsigned int len, const char *dir )
+{
+    char *line;
+    int fd, size;
+
+    if (!builtin_paths_file) return;
+    if (strpbrk( dir, "\t\n" )) return;
+
+    add_builtin_path( name, len, dir );
+
+    if (!(line = RtlAllocateHeap( GetProcessHeap(), 0, strlen( dir ) + len + 3 ))) return;
+    size = sprintf( line, "%s\t%.*s\n", dir, (int)len, name );
+    /* a single write so that concurrent processes don't mix up their entries */
+    if ((fd = open( builtin_paths_file, O_WRONLY | O_APPEND )) != -1)
+    {
+        write( fd, line, size );
+        close( fd );
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, line );
+}
+
+
 /***********************************************************************
  *           find_builtin_dll
  */
@@ -2712,6 +2996,7 @@ static NTSTATUS find_builtin_dll( const WCHAR *name, WINE_MODREF **pwm,
     char *ptr, *file;
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
     BOOL found_image = FALSE;
+    struct builtin_path *cached;
 
     len = wcslen( name );
     if (build_dir) maxlen = strlen(build_dir) + sizeof("/programs/") + len;
@@ -2755,16 +3040,38 @@ static NTSTATUS find_builtin_dll( const WCHAR *name, WINE_MODREF **pwm,
         if (status != STATUS_DLL_NOT_FOUND) goto done;
     }
 
+    /* a cached directory is only a hint, a dll that isn't found there is
+     * searched in the whole load path */
+    if ((cached = find_builtin_path( file + pos + 1, len )))
+    {
+        for (i = 0; (path = wine_dll_enum_load_path( i )); i++)
+            if (!strcmp( path, cached->dir )) break;
+        if (path)
+        {
+            file[pos + len + 1] = 0;
+            ptr = prepend( file + pos, path, strlen(path) );
+            status = open_builtin_file( ptr, pwm, module, image_info, st, so_name );
+            if (status == STATUS_IMAGE_MACHINE_TYPE_MISMATCH) found_image = TRUE;
+            else if (status != STATUS_DLL_NOT_FOUND) goto done;
+        }
+    }
+
     for (i = 0; (path = wine_dll_enum_load_path( i )); i++)
     {
+        if (cached && !strcmp( path, cached->dir )) continue;  /* already tried */
         file[pos + len + 1] = 0;
         ptr = prepend( file + pos, path, strlen(path) );
         status = open_builtin_file( ptr, pwm, module, image_info, st, so_name );
         if (status == STATUS_IMAGE_MACHINE_TYPE_MISMATCH) found_image = TRUE;
-        else if (status != STATUS_DLL_NOT_FOUND) goto done;
+        else if (status != STATUS_DLL_NOT_FOUND)
+        {
+            if (!status) store_builtin_path( file + pos + 1, len, path );
+            goto done;
+        }
     }
 
     if (found_image) status = STATUS_IMAGE_MACHINE_TYPE_MISMATCH;
+
     WARN( "cannot find builtin library for %s\n", debugstr_w(name) );
 
 done:
@@ -2894,6 +3201,7 @@ static NTSTATUS load_builtin_dll( LPCWSTR load_path, const UNICODE_STRING *nt_na
     pe_image_info_t image_info;
     struct stat st;
     char *so_name;
+    ULONGLONG start;
 
     /* Fix the name in case we have a full path and extension */
     name = nt_name->Buffer;
@@ -2904,7 +3212,9 @@ static NTSTATUS load_builtin_dll( LPCWSTR load_path, const UNICODE_STRING *nt_na
 
     if (!module_ptr) module_ptr = &module;
 
+    start = get_load_time();
     status = find_builtin_dll( name, pwm, module_ptr, &image_info, &st, &so_name );
+    if (current_load_timing) current_load_timing->search += get_load_time() - start;
     if (status) return status;
 
     if (*pwm)
@@ -3172,10 +3482,17 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
     void *module;
     pe_image_info_t image_info;
     NTSTATUS nts;
+    struct load_timing timing;
+    ULONGLONG total;
 
     TRACE( "looking for %s in %s\n", debugstr_w(libname), debugstr_w(load_path) );
 
+    memset( &timing, 0, sizeof(timing) );
+    timing.start = get_load_time();
+    timing.parent = current_load_timing;
+
     nts = find_dll_file( load_path, libname, default_ext, &nt_name, pwm, &module, &image_info, &st );
+    timing.search = get_load_time() - timing.start;
 
     if (*pwm)  /* found already loaded module */
     {
@@ -3188,6 +3505,8 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
         return STATUS_SUCCESS;
     }
 
+    current_load_timing = &timing;
+
     if (nts && nts != STATUS_DLL_NOT_FOUND && nts != STATUS_INVALID_IMAGE_NOT_MZ) goto done;
 
     main_exe = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress );
@@ -3286,8 +3605,20 @@ static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, const WC
     }
 
 done:
+    current_load_timing = timing.parent;
+    total = get_load_time() - timing.start;
+    if (timing.parent) timing.parent->deps += total;
+
     if (nts == STATUS_SUCCESS)
+    {
         TRACE("Loaded module %s at %p\n", debugstr_us(&nt_name), (*pwm)->ldr.BaseAddress);
+        /* times in microseconds, the load time doesn't include the dependencies */
+        TRACE_(loadtime)( "%s: search %s load %s relocs %s deps %s\n", debugstr_us(&nt_name),
+                          wine_dbgstr_longlong( timing.search / 10 ),
+                          wine_dbgstr_longlong( (total - timing.search - timing.deps) / 10 ),
+                          wine_dbgstr_longlong( timing.relocs / 10 ),
+                          wine_dbgstr_longlong( timing.deps / 10 ));
+    }
     else
         WARN("Failed to load module %s; status=%x\n", debugstr_w(libname), nts);
 
@@ -3806,6 +4137,7 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -767,6 +767,25 @@ NTSTATUS WINAPI NtNotifyChangeKey(
                                       ChangeBuffer, Length, Asynchronous);
 }
 
+/* fill the get_key_value requests for a list of values */
+static void init_multiple_value_requests( HANDLE handle, const KEY_MULTIPLE_VALUE_INFORMATION *values,
+                                          struct __server_request_info *reqs, ULONG count )
+{
+    ULONG i;
+
+    for (i = 0; i < count; i++)
+    {
+        struct get_key_value_request *req = &reqs[i].u.req.get_key_value_request;
+
+        memset( &reqs[i].u.req, 0, sizeof(reqs[i].u.req) );
+        reqs[i].u.req.request_header.req = REQ_get_key_value;
+        reqs[i].data_count = 0;
+        reqs[i].reply_data = NULL;
+        req->hkey = wine_server_obj_handle( handle );
+        wine_server_add_data( req, values[i].ValueName->Buffer, values[i].ValueName->Length );
+    }
+}
+
 /******************************************************************************
  * NtQueryMultipleValueKey [NTDLL]
  * ZwQueryMultipleValueKey
@@ -780,10 +799,64 @@ NTSTATUS WINAPI NtQueryMultipleValueKey(
 	ULONG Length,
 	PULONG  ReturnLength)
 {
-	FIXME("(%p,%p,0x%08x,%p,0x%08x,%p) stub!\n",
-	KeyHandle, ListOfValuesToQuery, NumberOfItems, MultipleValueInformation,
-	Length,ReturnLength);
-	return STATUS_SUCCESS;
+    struct __server_request_info *reqs;
+    NTSTATUS ret = STATUS_SUCCESS;
+    ULONG i, total;
+    BOOL retry;
+
+    TRACE( "(%p,%p,%u,%p,%u,%p)\n", KeyHandle, ListOfValuesToQuery, NumberOfItems,
+           MultipleValueInformation, Length, ReturnLength );
+
+    if (NumberOfItems && ~(SIZE_T)0 / NumberOfItems < sizeof(*reqs)) return STATUS_INVALID_PARAMETER;
+
+    for (i = 0; i < NumberOfItems; i++)
+        if (ListOfValuesToQuery[i].ValueName->Length > MAX_VALUE_LENGTH) return STATUS_OBJECT_NAME_NOT_FOUND;
+
+    if (!(reqs = RtlAllocateHeap( GetProcessHeap(), 0, NumberOfItems * sizeof(*reqs) )))
+        return STATUS_NO_MEMORY;
+
+    do
+    {
+        /* retrieve the type and size of all the values first */
+        init_multiple_value_requests( KeyHandle, ListOfValuesToQuery, reqs, NumberOfItems );
+        server_call_batch( reqs, NumberOfItems );
+        for (i = total = 0; i < NumberOfItems; i++)
+        {
+            const struct get_key_value_reply *reply = &reqs[i].u.reply.get_key_value_reply;
+
+            if ((ret = reqs[i].u.reply.reply_header.error)) goto done;
+            ListOfValuesToQuery[i].Type = reply->type;
+            ListOfValuesToQuery[i].DataLength = reply->total;
+            ListOfValuesToQuery[i].DataOffset = (total + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1);
+            total = ListOfValuesToQuery[i].DataOffset + reply->total;
+        }
+        if (ReturnLength) *ReturnLength = total;
+        if (Length < total)
+        {
+            ret = STATUS_BUFFER_OVERFLOW;
+            goto done;
+        }
+
+        /* then fetch the data straight into the output buffer */
+        init_multiple_value_requests( KeyHandle, ListOfValuesToQuery, reqs, NumberOfItems );
+        for (i = 0; i < NumberOfItems; i++)
+            wine_server_set_reply( &reqs[i], (char *)MultipleValueInformation + ListOfValuesToQuery[i].DataOffset,
+                                   ListOfValuesToQuery[i].DataLength );
+        server_call_batch( reqs, NumberOfItems );
+        for (i = 0, retry = FALSE; i < NumberOfItems; i++)
+        {
+            const struct get_key_value_reply *reply = &reqs[i].u.reply.get_key_value_reply;
+
+            if ((ret = reqs[i].u.reply.reply_header.error)) goto done;
+            /* start over if a value has been modified in the meantime */
+            if (reply->type != ListOfValuesToQuery[i].Type ||
+                reply->total != ListOfValuesToQuery[i].DataLength) retry = TRUE;
+        }
+    } while (retry);
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, reqs );
+    return ret;
 }
 
 /******************************************************************************
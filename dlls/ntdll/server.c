@@ -79,6 +79,7 @@
 #include "winnt.h"
 #include "wine/library.h"
 #include "wine/server.h"
+#include "wine/list.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -92,6 +93,9 @@ WINE_DEFAULT_DEBUG_CHANNEL(server);
 #ifndef MSG_CMSG_CLOEXEC
 #define MSG_CMSG_CLOEXEC 0
 #endif
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
 
 #define SOCKETNAME "socket"        /* name of the socket file */
 #define LOCKNAME   "lock"          /* name of the lock file */
@@ -128,6 +132,15 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
 };
 static RTL_CRITICAL_SECTION fd_cache_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 
+/* fds received for another thread's new handle, protected by fd_cache_section */
+struct pending_fd
+{
+    struct list  entry;
+    obj_handle_t handle;
+    int          fd;
+};
+static struct list pending_fds = LIST_INIT( pending_fds );
+
 /* atomically exchange a 64-bit value */
 static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
 {
@@ -324,6 +337,69 @@ unsigned int CDECL wine_server_call( void *req_ptr )
 }
 
 
+/***********************************************************************
+ *           server_call_batch
+ *
+ * Perform several independent server calls, in a single round-trip when
+ * possible. Each request is filled as for wine_server_call() and receives
+ * its own reply and status.
+ */
+void server_call_batch( struct __server_request_info *reqs, unsigned int count )
+{
+    data_size_t size = 0, reply_size = 0, pos;
+    unsigned int i, done = 0;
+    char *buffer = NULL;
+
+    for (i = 0; i < count; i++)
+    {
+        size += (sizeof(reqs[i].u.req) + reqs[i].u.req.request_header.request_size + 7) & ~7;
+        reply_size += (sizeof(reqs[i].u.reply) + reqs[i].u.req.request_header.reply_size + 7) & ~7;
+    }
+
+    if (count > 1 && (buffer = RtlAllocateHeap( GetProcessHeap(), 0, max( size, reply_size ) )))
+    {
+        for (i = pos = 0; i < count; i++)
+        {
+            const struct __server_request_info *req = &reqs[i];
+            data_size_t len = sizeof(req->u.req);
+            unsigned int j;
+
+            memcpy( buffer + pos, &req->u.req, sizeof(req->u.req) );
+            for (j = 0; j < req->data_count; j++)
+            {
+                memcpy( buffer + pos + len, req->data[j].ptr, req->data[j].size );
+                len += req->data[j].size;
+            }
+            memset( buffer + pos + len, 0, ((len + 7) & ~7) - len );
+            pos += (len + 7) & ~7;
+        }
+
+        SERVER_START_REQ( batch )
+        {
+            wine_server_add_data( req, buffer, size );
+            wine_server_set_reply( req, buffer, reply_size );
+            if (!wine_server_call( req )) done = reply->count;
+        }
+        SERVER_END_REQ;
+
+        for (i = pos = 0; i < done; i++)
+        {
+            struct __server_request_info *req = &reqs[i];
+
+            memcpy( &req->u.reply, buffer + pos, sizeof(req->u.reply) );
+            if (req->u.reply.reply_header.reply_size)
+                memcpy( req->reply_data, buffer + pos + sizeof(req->u.reply),
+                        req->u.reply.reply_header.reply_size );
+            pos += (sizeof(req->u.reply) + req->u.reply.reply_header.reply_size + 7) & ~7;
+        }
+        RtlFreeHeap( GetProcessHeap(), 0, buffer );
+    }
+
+    /* requests that can't be batched are performed one at a time */
+    for (i = done; i < count; i++) wine_server_call( &reqs[i] );
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -825,7 +901,7 @@ void CDECL wine_server_send_fd( int fd )
  *
  * Receive a file descriptor passed from the server.
  */
-static int receive_fd( obj_handle_t *handle )
+static int receive_fd( obj_handle_t *handle, int flags )
 {
     struct iovec vec;
     struct msghdr msghdr;
@@ -850,7 +926,7 @@ static int receive_fd( obj_handle_t *handle )
 
     for (;;)
     {
-        if ((ret = recvmsg( fd_socket, &msghdr, MSG_CMSG_CLOEXEC )) > 0)
+        if ((ret = recvmsg( fd_socket, &msghdr, MSG_CMSG_CLOEXEC | flags )) > 0)
         {
 #ifndef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
             struct cmsghdr *cmsg;
@@ -873,6 +949,11 @@ static int receive_fd( obj_handle_t *handle )
         if (!ret) break;
         if (errno == EINTR) continue;
         if (errno == EPIPE) break;
+        if (errno == EAGAIN && (flags & MSG_DONTWAIT))
+        {
+            *handle = 0;
+            return -1;
+        }
         server_protocol_perror("recvmsg");
     }
     /* the server closed the connection; time to die... */
@@ -914,7 +995,7 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 /***********************************************************************
  *           add_fd_to_cache
  *
- * Caller must hold fd_cache_section.
+ * Doesn't need any locking; fails if the handle is already cached.
  */
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
                             unsigned int access, unsigned int options )
@@ -930,13 +1011,15 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 
     if (!fd_cache[entry])  /* do we need to allocate a new block of entries? */
     {
-        if (!entry) fd_cache[0] = fd_cache_initial_block;
+        if (!entry) interlocked_cmpxchg_ptr( (void **)&fd_cache[0], fd_cache_initial_block, NULL );
         else
         {
             void *ptr = wine_anon_mmap( NULL, FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
                                         PROT_READ | PROT_WRITE, 0 );
             if (ptr == MAP_FAILED) return FALSE;
-            fd_cache[entry] = ptr;
+            /* another thread may have allocated the block in the meantime */
+            if (interlocked_cmpxchg_ptr( (void **)&fd_cache[entry], ptr, NULL ))
+                munmap( ptr, FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry) );
         }
     }
 
@@ -945,9 +1028,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
-    cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
-    assert( !cache.s.fd );
-    return TRUE;
+    return !interlocked_cmpxchg64( &fd_cache[entry][idx].data, cache.data, 0 );
 }
 
 
@@ -976,6 +1057,72 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 }
 
 
+/***********************************************************************
+ *           receive_handle_fd
+ *
+ * Receive the unix fd that the server sent for a given handle. All fds
+ * arrive on the same process-wide socket, so the fd of another new handle
+ * may come first; it is set aside until the thread that created that
+ * handle picks it up. Must be called inside fd_cache_section.
+ */
+static int receive_handle_fd( HANDLE handle, int flags )
+{
+    struct pending_fd *pending;
+    obj_handle_t fd_handle;
+    int fd;
+
+    LIST_FOR_EACH_ENTRY( pending, &pending_fds, struct pending_fd, entry )
+    {
+        if (pending->handle != wine_server_obj_handle( handle )) continue;
+        fd = pending->fd;
+        list_remove( &pending->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, pending );
+        return fd;
+    }
+
+    for (;;)
+    {
+        fd = receive_fd( &fd_handle, flags );
+        if (wine_server_ptr_handle( fd_handle ) == handle || !fd_handle) return fd;
+        if (!(pending = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pending) )))
+        {
+            ERR( "no memory to keep fd for handle %04x\n", fd_handle );
+            if (fd != -1) close( fd );
+            continue;
+        }
+        pending->handle = fd_handle;
+        pending->fd = fd;
+        list_add_tail( &pending_fds, &pending->entry );
+    }
+}
+
+
+/***********************************************************************
+ *           discard_pending_fd
+ *
+ * Drop an fd that was sent for a handle but never picked up, for instance
+ * because the thread that created the handle was terminated.
+ */
+static void discard_pending_fd( HANDLE handle )
+{
+    struct pending_fd *pending;
+    sigset_t sigset;
+
+    if (list_empty( &pending_fds )) return;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    LIST_FOR_EACH_ENTRY( pending, &pending_fds, struct pending_fd, entry )
+    {
+        if (pending->handle != wine_server_obj_handle( handle )) continue;
+        if (pending->fd != -1) close( pending->fd );
+        list_remove( &pending->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, pending );
+        break;
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
 /***********************************************************************
  *           server_remove_fd_from_cache
  */
@@ -991,10 +1138,41 @@ int server_remove_fd_from_cache( HANDLE handle )
         if (cache.s.type != FD_TYPE_INVALID) fd = cache.s.fd - 1;
     }
 
+    discard_pending_fd( handle );
     return fd;
 }
 
 
+/***********************************************************************
+ *           server_cache_handle_fd
+ *
+ * Store in the cache the unix fd that the server sent along with a new
+ * handle. The fd is already waiting on the socket once the request that
+ * created the handle has returned, so it is never waited for.
+ */
+void server_cache_handle_fd( HANDLE handle, enum server_fd_type type,
+                             unsigned int access, unsigned int options )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    sigset_t sigset;
+    int fd;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    if ((fd = receive_handle_fd( handle, MSG_DONTWAIT )) != -1)
+    {
+        /* drop whatever a racing close of the previous owner of the handle value left behind */
+        if (entry < FD_CACHE_ENTRIES && fd_cache[entry])
+        {
+            union fd_cache_entry cache;
+            cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, 0 );
+            if (cache.data && cache.s.type != FD_TYPE_INVALID) close( cache.s.fd - 1 );
+        }
+        if (!add_fd_to_cache( handle, fd, type, access, options )) close( fd );
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1004,7 +1182,6 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                         int *needs_close, enum server_fd_type *type, unsigned int *options )
 {
     sigset_t sigset;
-    obj_handle_t fd_handle;
     int ret, fd = -1;
     unsigned int access = 0;
 
@@ -1027,9 +1204,8 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                 if (type) *type = reply->type;
                 if (options) *options = reply->options;
                 access = reply->access;
-                if ((fd = receive_fd( &fd_handle )) != -1)
+                if ((fd = receive_handle_fd( handle, 0 )) != -1)
                 {
-                    assert( wine_server_ptr_handle(fd_handle) == handle );
                     *needs_close = (!reply->cacheable ||
                                     !add_fd_to_cache( handle, fd, reply->type,
                                                       reply->access, reply->options ));
@@ -1477,7 +1653,7 @@ void server_init_process(void)
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
 
     /* receive the first thread request fd on the main socket */
-    ntdll_get_thread_data()->request_fd = receive_fd( &version );
+    ntdll_get_thread_data()->request_fd = receive_fd( &version, 0 );
 
 #ifdef SO_PASSCRED
     /* now that we hopefully received the server_pid, disable SO_PASSCRED */
@@ -829,6 +829,160 @@ done:
     pRtlFreeUnicodeString(&ntdirname);
 }
 
+static BOOL file_exists_in_dir(const char *dir, const char *name)
+{
+    char buf[MAX_PATH];
+
+    sprintf(buf, "%s\\%s", dir, name);
+    return GetFileAttributesA(buf) != INVALID_FILE_ATTRIBUTES;
+}
+
+static void create_file_in_dir(const char *dir, const char *name)
+{
+    char buf[MAX_PATH];
+    HANDLE h;
+
+    sprintf(buf, "%s\\%s", dir, name);
+    h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+    ok(h != INVALID_HANDLE_VALUE, "failed to create '%s', error %u\n", buf, GetLastError());
+    CloseHandle(h);
+}
+
+static void test_case_insensitive_lookup(void)
+{
+    char testdir[MAX_PATH], buf[MAX_PATH], buf2[MAX_PATH];
+    WIN32_FIND_DATAA data;
+    HANDLE handle;
+    BOOL ret;
+    int i;
+
+    GetTempPathA(MAX_PATH, testdir);
+    strcat(testdir, "lookup.tmp");
+    ret = CreateDirectoryA(testdir, NULL);
+    ok(ret, "couldn't create dir '%s', error %u\n", testdir, GetLastError());
+
+    for (i = 0; i < 100; i++)
+    {
+        sprintf(buf, "File%03d.Txt", i);
+        create_file_in_dir(testdir, buf);
+    }
+
+    /* repeated lookups in the same directory */
+    for (i = 0; i < 100; i++)
+    {
+        sprintf(buf, "fILE%03d.tXT", i);
+        ok(file_exists_in_dir(testdir, buf), "%s not found\n", buf);
+    }
+    ok(!file_exists_in_dir(testdir, "file100.txt"), "file100.txt found\n");
+    ok(GetLastError() == ERROR_FILE_NOT_FOUND, "got error %u\n", GetLastError());
+
+    /* enumerate the directory, then look up files that changed since */
+    sprintf(buf, "%s\\*", testdir);
+    handle = FindFirstFileA(buf, &data);
+    ok(handle != INVALID_HANDLE_VALUE, "FindFirstFile failed, error %u\n", GetLastError());
+    while (FindNextFileA(handle, &data));
+    FindClose(handle);
+
+    create_file_in_dir(testdir, "NewFile.Txt");
+    ok(file_exists_in_dir(testdir, "NEWFILE.TXT"), "NEWFILE.TXT not found\n");
+
+    sprintf(buf, "%s\\%s", testdir, "File000.Txt");
+    sprintf(buf2, "%s\\%s", testdir, "Renamed.Txt");
+    ret = MoveFileA(buf, buf2);
+    ok(ret, "MoveFile failed, error %u\n", GetLastError());
+    ok(!file_exists_in_dir(testdir, "file000.txt"), "file000.txt found\n");
+    ok(file_exists_in_dir(testdir, "renamed.TXT"), "renamed.TXT not found\n");
+
+    sprintf(buf, "%s\\%s", testdir, "NEWFILE.txt");
+    ret = DeleteFileA(buf);
+    ok(ret, "DeleteFile failed, error %u\n", GetLastError());
+    ok(!file_exists_in_dir(testdir, "newfile.txt"), "newfile.txt found\n");
+
+    DeleteFileA(buf2);
+    for (i = 1; i < 100; i++)
+    {
+        sprintf(buf, "%s\\File%03d.Txt", testdir, i);
+        DeleteFileA(buf);
+    }
+    ret = RemoveDirectoryA(testdir);
+    ok(ret, "RemoveDirectory failed, error %u\n", GetLastError());
+}
+
+static void test_large_directory(void)
+{
+    char testdir[MAX_PATH], buf[MAX_PATH];
+    WCHAR testdir_w[MAX_PATH];
+    UNICODE_STRING ntdirname;
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    FILE_ID_BOTH_DIRECTORY_INFORMATION *info;
+    BYTE *data;
+    DWORD status, written, found = 0, calls = 0, size = 0x2000;
+    HANDLE h, dirh;
+    BOOL ret;
+    int i, idx;
+
+    GetTempPathA(MAX_PATH, testdir);
+    strcat(testdir, "large.tmp");
+    ret = CreateDirectoryA(testdir, NULL);
+    ok(ret, "couldn't create dir '%s', error %u\n", testdir, GetLastError());
+
+    /* give each file a different size to check that the stat data matches the name */
+    for (i = 0; i < 300; i++)
+    {
+        sprintf(buf, "%s\\f%03d", testdir, i);
+        h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+        ok(h != INVALID_HANDLE_VALUE, "failed to create '%s', error %u\n", buf, GetLastError());
+        WriteFile(h, buf, i % 50, &written, NULL);
+        CloseHandle(h);
+    }
+
+    pRtlMultiByteToUnicodeN(testdir_w, sizeof(testdir_w), NULL, testdir, strlen(testdir) + 1);
+    ret = pRtlDosPathNameToNtPathName_U(testdir_w, &ntdirname, NULL, NULL);
+    ok(ret, "RtlDosPathNameToNtPathName_U failed\n");
+    InitializeObjectAttributes(&attr, &ntdirname, OBJ_CASE_INSENSITIVE, 0, NULL);
+    status = pNtOpenFile(&dirh, SYNCHRONIZE | FILE_LIST_DIRECTORY, &attr, &io, FILE_SHARE_READ,
+                         FILE_SYNCHRONOUS_IO_NONALERT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_DIRECTORY_FILE);
+    ok(status == STATUS_SUCCESS, "failed to open dir, status %x\n", status);
+
+    data = HeapAlloc(GetProcessHeap(), 0, size);
+    while (!(status = pNtQueryDirectoryFile(dirh, NULL, NULL, NULL, &io, data, size,
+                                            FileIdBothDirectoryInformation, FALSE, NULL, FALSE)))
+    {
+        calls++;
+        for (info = (FILE_ID_BOTH_DIRECTORY_INFORMATION *)data; ;
+             info = (FILE_ID_BOTH_DIRECTORY_INFORMATION *)((BYTE *)info + info->NextEntryOffset))
+        {
+            if (info->FileName[0] != '.')
+            {
+                ok(info->FileNameLength == 4 * sizeof(WCHAR), "got name %s\n",
+                   wine_dbgstr_wn(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+                idx = (info->FileName[1] - '0') * 100 + (info->FileName[2] - '0') * 10 + info->FileName[3] - '0';
+                ok(info->EndOfFile.QuadPart == idx % 50, "%s: got size %s\n",
+                   wine_dbgstr_wn(info->FileName, 4), wine_dbgstr_longlong(info->EndOfFile.QuadPart));
+                found++;
+            }
+            if (!info->NextEntryOffset) break;
+        }
+        /* also use a small buffer for a few calls */
+        size = 0x200;
+    }
+    ok(status == STATUS_NO_MORE_FILES, "got status %x\n", status);
+    ok(found == 300, "found %u files\n", found);
+    ok(calls > 1, "got %u calls\n", calls);
+    HeapFree(GetProcessHeap(), 0, data);
+    pNtClose(dirh);
+    pRtlFreeUnicodeString(&ntdirname);
+
+    for (i = 0; i < 300; i++)
+    {
+        sprintf(buf, "%s\\f%03d", testdir, i);
+        DeleteFileA(buf);
+    }
+    ret = RemoveDirectoryA(testdir);
+    ok(ret, "RemoveDirectory failed, error %u\n", GetLastError());
+}
+
 static void test_redirection(void)
 {
     ULONG old, cur;
@@ -907,5 +1061,7 @@ START_TEST(directory)
     test_directory_sort( sysdir );
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
+    test_case_insensitive_lookup();
+    test_large_directory();
     test_redirection();
 }
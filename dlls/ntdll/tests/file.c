@@ -4951,6 +4951,84 @@ static void test_file_readonly_access(void)
     DeleteFileW(path);
 }
 
+static DWORD WINAPI fd_cache_thread( void *arg )
+{
+    const WCHAR *path = arg;
+    char buffer[MAX_PATH];
+    IO_STATUS_BLOCK io;
+    NTSTATUS status;
+    HANDLE handle;
+    int i;
+
+    for (i = 0; i < 200; i++)
+    {
+        handle = CreateFileW( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+        ok( handle != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+        memset( buffer, 0, sizeof(buffer) );
+        status = pNtReadFile( handle, NULL, NULL, NULL, &io, buffer, sizeof(buffer), NULL, NULL );
+        ok( status == STATUS_SUCCESS, "NtReadFile failed %#x\n", status );
+        ok( !lstrcmpA( buffer, wine_dbgstr_w(path) ), "got %s\n", buffer );
+        CloseHandle( handle );
+    }
+    return 0;
+}
+
+static void test_file_fd_cache(void)
+{
+    static const WCHAR fooW[] = {'f', 'o', 'o', 0};
+    WCHAR temp[MAX_PATH], path[4][MAX_PATH];
+    HANDLE handle, handle2, threads[4];
+    const char *data;
+    char buffer[MAX_PATH];
+    IO_STATUS_BLOCK io;
+    NTSTATUS status;
+    DWORD size;
+    int i;
+
+    GetTempPathW( MAX_PATH, temp );
+    for (i = 0; i < ARRAY_SIZE(path); i++)
+    {
+        GetTempFileNameW( temp, fooW, 0, path[i] );
+        handle = CreateFileW( path[i], GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0 );
+        ok( handle != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+        data = wine_dbgstr_w( path[i] );
+        WriteFile( handle, data, strlen(data), &size, NULL );
+        CloseHandle( handle );
+    }
+
+    /* the handle value is reused, the cached fd must not be */
+    handle = CreateFileW( path[0], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+    ok( handle != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+    memset( buffer, 0, sizeof(buffer) );
+    status = pNtReadFile( handle, NULL, NULL, NULL, &io, buffer, sizeof(buffer), NULL, NULL );
+    ok( status == STATUS_SUCCESS, "NtReadFile failed %#x\n", status );
+    ok( !lstrcmpA( buffer, wine_dbgstr_w(path[0]) ), "got %s\n", buffer );
+    CloseHandle( handle );
+
+    handle2 = CreateFileW( path[1], GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0 );
+    ok( handle2 != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError() );
+    memset( buffer, 0, sizeof(buffer) );
+    status = pNtReadFile( handle2, NULL, NULL, NULL, &io, buffer, sizeof(buffer), NULL, NULL );
+    ok( status == STATUS_SUCCESS, "NtReadFile failed %#x\n", status );
+    ok( !lstrcmpA( buffer, wine_dbgstr_w(path[1]) ), "got %s\n", buffer );
+
+    /* the cached access rights still apply */
+    status = pNtWriteFile( handle2, NULL, NULL, NULL, &io, "x", 1, NULL, NULL );
+    ok( status == STATUS_ACCESS_DENIED, "NtWriteFile returned %#x\n", status );
+    CloseHandle( handle2 );
+
+    /* concurrent opens receive their fds on the same socket */
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread( NULL, 0, fd_cache_thread, path[i], 0, NULL );
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        ok( !WaitForSingleObject( threads[i], 30000 ), "thread %d didn't finish\n", i );
+        CloseHandle( threads[i] );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(path); i++) DeleteFileW( path[i] );
+}
+
 START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
@@ -5021,4 +5099,5 @@ START_TEST(file)
     test_query_attribute_information_file();
     test_ioctl();
     test_flush_buffers_file();
+    test_file_fd_cache();
 }
@@ -0,0 +1,279 @@
+/*
+ * Unit test suite for ntdll heap functions
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+#define NB_THREADS  4
+#define NB_BLOCKS   256
+#define NB_LOOPS    2000
+
+struct heap_thread_params
+{
+    HANDLE heap;
+    void * volatile *shared;  /* blocks exchanged between the threads */
+    DWORD  id;
+    LONG   errors;
+};
+
+static ULONG get_heap_compat( HANDLE heap )
+{
+    ULONG info = 0xdeadbeef;
+    SIZE_T size = 0;
+    NTSTATUS status;
+
+    status = RtlQueryHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), &size );
+    ok( !status, "RtlQueryHeapInformation failed %x\n", status );
+    ok( size == sizeof(ULONG), "wrong size %lu\n", size );
+    return info;
+}
+
+static void test_lfh(void)
+{
+    static const SIZE_T sizes[] = { 1, 7, 8, 15, 16, 24, 31, 33, 64, 100, 127, 200, 230, 240, 250, 300, 1000 };
+    void *blocks[ARRAY_SIZE(sizes) * 20];
+    HANDLE heap;
+    NTSTATUS status;
+    ULONG info;
+    BOOLEAN ret;
+    SIZE_T size;
+    unsigned int i, j;
+    BYTE *ptr;
+
+    heap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL );
+    ok( heap != NULL, "RtlCreateHeap failed\n" );
+
+    info = 2;
+    status = RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) - 1 );
+    ok( status == STATUS_BUFFER_TOO_SMALL, "got %x\n", status );
+    status = RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !status, "RtlSetHeapInformation failed %x\n", status );
+    info = get_heap_compat( heap );
+    ok( info == 2, "got heap compatibility %u\n", info );
+
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+    {
+        size = sizes[i % ARRAY_SIZE(sizes)];
+        blocks[i] = RtlAllocateHeap( heap, (i & 1) ? HEAP_ZERO_MEMORY : 0, size );
+        ok( blocks[i] != NULL, "%u: allocation of %lu bytes failed\n", i, size );
+        ok( RtlSizeHeap( heap, 0, blocks[i] ) == size, "%u: got size %lu, expected %lu\n",
+            i, RtlSizeHeap( heap, 0, blocks[i] ), size );
+        ptr = blocks[i];
+        if (i & 1)
+        {
+            for (j = 0; j < size; j++) if (ptr[j]) break;
+            ok( j == size, "%u: block not zeroed at %u\n", i, j );
+        }
+        memset( ptr, i, size );
+    }
+
+    /* free every other block and reuse them */
+    for (i = 0; i < ARRAY_SIZE(blocks); i += 2)
+    {
+        ret = RtlFreeHeap( heap, 0, blocks[i] );
+        ok( ret, "%u: RtlFreeHeap failed\n", i );
+    }
+    ret = RtlValidateHeap( heap, 0, NULL );
+    ok( ret, "RtlValidateHeap failed\n" );
+
+    for (i = 0; i < ARRAY_SIZE(blocks); i += 2)
+    {
+        size = sizes[i % ARRAY_SIZE(sizes)];
+        blocks[i] = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, size );
+        ok( blocks[i] != NULL, "%u: allocation of %lu bytes failed\n", i, size );
+        ptr = blocks[i];
+        for (j = 0; j < size; j++) if (ptr[j]) break;
+        ok( j == size, "%u: block not zeroed at %u\n", i, j );
+        memset( ptr, i, size );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+    {
+        size = sizes[i % ARRAY_SIZE(sizes)];
+        ptr = blocks[i];
+        for (j = 0; j < size; j++) if (ptr[j] != (BYTE)i) break;
+        ok( j == size, "%u: block overwritten at %u\n", i, j );
+
+        ptr = RtlReAllocateHeap( heap, 0, blocks[i], size + 40 );
+        ok( ptr != NULL, "%u: RtlReAllocateHeap failed\n", i );
+        for (j = 0; j < size; j++) if (ptr[j] != (BYTE)i) break;
+        ok( j == size, "%u: reallocated block differs at %u\n", i, j );
+        blocks[i] = ptr;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(blocks); i++)
+    {
+        ret = RtlFreeHeap( heap, 0, blocks[i] );
+        ok( ret, "%u: RtlFreeHeap failed\n", i );
+    }
+    ret = RtlValidateHeap( heap, 0, NULL );
+    ok( ret, "RtlValidateHeap failed\n" );
+
+    /* the low fragmentation heap can't be turned off */
+    info = 0;
+    status = RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( status == STATUS_UNSUCCESSFUL, "got %x\n", status );
+    RtlDestroyHeap( heap );
+
+    heap = RtlCreateHeap( HEAP_GROWABLE | HEAP_NO_SERIALIZE, NULL, 0, 0, NULL, NULL );
+    ok( heap != NULL, "RtlCreateHeap failed\n" );
+    info = 2;
+    status = RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( status == STATUS_UNSUCCESSFUL, "got %x\n", status );
+    info = get_heap_compat( heap );
+    ok( info == 0, "got heap compatibility %u\n", info );
+    RtlDestroyHeap( heap );
+}
+
+static DWORD WINAPI heap_thread( void *arg )
+{
+    struct heap_thread_params *params = arg;
+    void *blocks[NB_BLOCKS];
+    unsigned int seed = params->id, i, j, size;
+    BYTE *ptr;
+
+    memset( blocks, 0, sizeof(blocks) );
+    for (i = 0; i < NB_LOOPS; i++)
+    {
+        for (j = 0; j < NB_BLOCKS; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            if ((ptr = blocks[j]))
+            {
+                if (ptr[0] != (BYTE)j || ptr[RtlSizeHeap( params->heap, 0, ptr ) - 1] != (BYTE)j)
+                    InterlockedIncrement( &params->errors );
+                /* hand some of the blocks over to another thread */
+                if (!(seed & 0x700)) ptr = InterlockedExchangePointer( &params->shared[j], ptr );
+                RtlFreeHeap( params->heap, 0, ptr );
+            }
+            size = 1 + (seed >> 16) % 240;
+            if (!(ptr = blocks[j] = RtlAllocateHeap( params->heap, 0, size )))
+            {
+                InterlockedIncrement( &params->errors );
+                continue;
+            }
+            memset( ptr, j, size );
+        }
+    }
+    for (j = 0; j < NB_BLOCKS; j++) RtlFreeHeap( params->heap, 0, blocks[j] );
+    return 0;
+}
+
+static void test_heap_threads( BOOL lfh )
+{
+    struct heap_thread_params params[NB_THREADS];
+    void * volatile shared[NB_BLOCKS];
+    HANDLE threads[NB_THREADS];
+    ULONG info = 2;
+    HANDLE heap;
+    BOOLEAN ret;
+    DWORD i;
+
+    heap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL );
+    ok( heap != NULL, "RtlCreateHeap failed\n" );
+    if (lfh) RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+
+    for (i = 0; i < NB_BLOCKS; i++)
+    {
+        /* the shared blocks only need to be valid heap blocks, any contents will do */
+        shared[i] = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, 16 );
+    }
+
+    for (i = 0; i < NB_THREADS; i++)
+    {
+        params[i].heap = heap;
+        params[i].shared = shared;
+        params[i].id = i;
+        params[i].errors = 0;
+        threads[i] = CreateThread( NULL, 0, heap_thread, &params[i], 0, NULL );
+        ok( threads[i] != NULL, "CreateThread failed %u\n", GetLastError() );
+    }
+    WaitForMultipleObjects( NB_THREADS, threads, TRUE, INFINITE );
+
+    for (i = 0; i < NB_THREADS; i++)
+    {
+        ok( !params[i].errors, "thread %u: %u errors\n", i, params[i].errors );
+        CloseHandle( threads[i] );
+    }
+
+    for (i = 0; i < NB_BLOCKS; i++) RtlFreeHeap( heap, 0, shared[i] );
+    ret = RtlValidateHeap( heap, 0, NULL );
+    ok( ret, "RtlValidateHeap failed\n" );
+    RtlDestroyHeap( heap );
+}
+
+static void test_lfh_release(void)
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    void *base, *last_base, *middle = NULL;
+    void **blocks;
+    ULONG info = 2;
+    HANDLE heap;
+    NTSTATUS status;
+    BOOLEAN ret;
+    SIZE_T size;
+    unsigned int count = 0, max_count = 100000;
+
+    heap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL );
+    ok( heap != NULL, "RtlCreateHeap failed\n" );
+    status = RtlSetHeapInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !status, "RtlSetHeapInformation failed %x\n", status );
+    blocks = HeapAlloc( GetProcessHeap(), 0, max_count * sizeof(*blocks) );
+
+    /* grow the heap until it has a sub-heap between the first and the last one */
+    last_base = heap;
+    while (count < max_count)
+    {
+        if (!(blocks[count] = RtlAllocateHeap( heap, 0, 200 ))) break;
+        status = NtQueryVirtualMemory( GetCurrentProcess(), blocks[count++], MemoryBasicInformation,
+                                       &mbi, sizeof(mbi), &size );
+        ok( !status, "NtQueryVirtualMemory failed %x\n", status );
+        base = mbi.AllocationBase;
+        if (base == last_base) continue;
+        if (middle) break;
+        if (last_base != heap) middle = blocks[count - 1];
+        last_base = base;
+    }
+    ok( middle != NULL, "heap didn't grow, %u blocks\n", count );
+
+    /* free the blocks in reverse order, the front end keeps the most recent ones */
+    while (count) RtlFreeHeap( heap, 0, blocks[--count] );
+    ret = RtlValidateHeap( heap, 0, NULL );
+    ok( ret, "RtlValidateHeap failed\n" );
+
+    if (middle)
+    {
+        status = NtQueryVirtualMemory( GetCurrentProcess(), middle, MemoryBasicInformation,
+                                       &mbi, sizeof(mbi), &size );
+        ok( !status, "NtQueryVirtualMemory failed %x\n", status );
+        ok( mbi.State == MEM_FREE || broken(mbi.State == MEM_RESERVE),
+            "empty sub-heap not released, state %x\n", mbi.State );
+    }
+
+    HeapFree( GetProcessHeap(), 0, blocks );
+    RtlDestroyHeap( heap );
+}
+
+START_TEST(heap)
+{
+    test_lfh();
+    test_lfh_release();
+    test_heap_threads( FALSE );
+    test_heap_threads( TRUE );
+}
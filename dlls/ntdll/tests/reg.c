@@ -131,8 +131,11 @@ static NTSTATUS (WINAPI * pNtCreateKey)( PHANDLE retkey, ACCESS_MASK access, con
                              ULONG TitleIndex, const UNICODE_STRING *class, ULONG options,
                              PULONG dispos );
 static NTSTATUS (WINAPI * pNtQueryKey)(HANDLE,KEY_INFORMATION_CLASS,PVOID,ULONG,PULONG);
+static NTSTATUS (WINAPI * pNtEnumerateKey)(HANDLE,ULONG,KEY_INFORMATION_CLASS,PVOID,ULONG,PULONG);
+static NTSTATUS (WINAPI * pNtEnumerateValueKey)(HANDLE,ULONG,KEY_VALUE_INFORMATION_CLASS,PVOID,ULONG,PULONG);
 static NTSTATUS (WINAPI * pNtQueryLicenseValue)(const UNICODE_STRING *,ULONG *,PVOID,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtQueryValueKey)(HANDLE,const UNICODE_STRING *,KEY_VALUE_INFORMATION_CLASS,void *,DWORD,DWORD *);
+static NTSTATUS (WINAPI * pNtQueryMultipleValueKey)(HANDLE,KEY_MULTIPLE_VALUE_INFORMATION *,ULONG,void *,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtSetValueKey)(HANDLE, const PUNICODE_STRING, ULONG,
                                ULONG, const void*, ULONG  );
 static NTSTATUS (WINAPI * pNtQueryInformationProcess)(HANDLE,PROCESSINFOCLASS,PVOID,ULONG,PULONG);
@@ -184,7 +187,10 @@ static BOOL InitFunctionPtrs(void)
     NTDLL_GET_PROC(NtFlushKey)
     NTDLL_GET_PROC(NtDeleteKey)
     NTDLL_GET_PROC(NtQueryKey)
+    NTDLL_GET_PROC(NtEnumerateKey)
+    NTDLL_GET_PROC(NtEnumerateValueKey)
     NTDLL_GET_PROC(NtQueryValueKey)
+    NTDLL_GET_PROC(NtQueryMultipleValueKey)
     NTDLL_GET_PROC(NtQueryInformationProcess)
     NTDLL_GET_PROC(NtSetValueKey)
     NTDLL_GET_PROC(NtOpenKey)
@@ -1703,6 +1709,218 @@ static void test_redirection(void)
     pNtClose( key64 );
 }
 
+static void test_NtQueryMultipleValueKey(void)
+{
+    static const DWORD dword = 0x12345678;
+    static const char *names[] = { "multi1", "multi2", "multi3", "multi4" };
+    KEY_MULTIPLE_VALUE_INFORMATION values[ARRAY_SIZE(names)];
+    UNICODE_STRING str[ARRAY_SIZE(names)];
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    LARGE_INTEGER start, end, freq;
+    OBJECT_ATTRIBUTES attr;
+    BYTE buffer[256];
+    ULONG i, j, len;
+    NTSTATUS status;
+    HANDLE key;
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ|KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08x\n", status);
+
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        pRtlCreateUnicodeStringFromAsciiz(&str[i], names[i]);
+        if (i & 1) status = pNtSetValueKey(key, &str[i], 0, REG_DWORD, &dword, sizeof(dword));
+        else status = pNtSetValueKey(key, &str[i], 0, REG_SZ, stringW, (i + 1) * sizeof(WCHAR));
+        ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08x\n", status);
+        values[i].ValueName = &str[i];
+    }
+
+    len = 0xdeadbeef;
+    status = pNtQueryMultipleValueKey(key, values, ARRAY_SIZE(values), buffer, 1, &len);
+    ok(status == STATUS_BUFFER_OVERFLOW, "got 0x%08x\n", status);
+    ok(len >= 2 * (sizeof(dword) + 2 * sizeof(WCHAR)) && len <= sizeof(buffer), "wrong len %u\n", len);
+
+    memset(buffer, 0xcc, sizeof(buffer));
+    status = pNtQueryMultipleValueKey(key, values, ARRAY_SIZE(values), buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryMultipleValueKey failed: 0x%08x\n", status);
+    for (i = 0; i < ARRAY_SIZE(values); i++)
+    {
+        if (i & 1)
+        {
+            ok(values[i].Type == REG_DWORD, "%u: wrong type %u\n", i, values[i].Type);
+            ok(values[i].DataLength == sizeof(dword), "%u: wrong length %u\n", i, values[i].DataLength);
+            ok(!memcmp(buffer + values[i].DataOffset, &dword, sizeof(dword)), "%u: wrong data\n", i);
+        }
+        else
+        {
+            ok(values[i].Type == REG_SZ, "%u: wrong type %u\n", i, values[i].Type);
+            ok(values[i].DataLength == (i + 1) * sizeof(WCHAR), "%u: wrong length %u\n", i, values[i].DataLength);
+            ok(!memcmp(buffer + values[i].DataOffset, stringW, (i + 1) * sizeof(WCHAR)), "%u: wrong data\n", i);
+        }
+        ok(values[i].DataOffset + values[i].DataLength <= len, "%u: wrong offset %u\n", i, values[i].DataOffset);
+    }
+
+    pNtDeleteValueKey(key, &str[2]);
+    status = pNtQueryMultipleValueKey(key, values, ARRAY_SIZE(values), buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08x\n", status);
+
+    if (winetest_benchmark)
+    {
+        len = FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(dword)]);
+        info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+        NtQueryPerformanceCounter(&start, &freq);
+        for (i = 0; i < 1000; i++)
+            pNtQueryValueKey(key, &str[1], KeyValuePartialInformation, info, len, &len);
+        NtQueryPerformanceCounter(&end, NULL);
+        trace("NtQueryValueKey: %u calls/s\n",
+              (DWORD)(1000 * freq.QuadPart / max(end.QuadPart - start.QuadPart, 1)));
+
+        for (j = 0; j < ARRAY_SIZE(values); j++) values[j].ValueName = &str[1];
+        NtQueryPerformanceCounter(&start, NULL);
+        for (i = 0; i < 1000 / ARRAY_SIZE(values); i++)
+            pNtQueryMultipleValueKey(key, values, ARRAY_SIZE(values), buffer, sizeof(buffer), &len);
+        NtQueryPerformanceCounter(&end, NULL);
+        trace("NtQueryMultipleValueKey: %u values/s\n",
+              (DWORD)(i * ARRAY_SIZE(values) * freq.QuadPart / max(end.QuadPart - start.QuadPart, 1)));
+    }
+
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        pNtDeleteValueKey(key, &str[i]);
+        pRtlFreeUnicodeString(&str[i]);
+    }
+    pNtClose(key);
+}
+
+static void set_large_key_name(UNICODE_STRING *name, DWORD index, BOOL upper)
+{
+    char buffer[16];
+    int i;
+
+    /* spread the names so that they are not created in sorted order */
+    sprintf(buffer, upper ? "K%08X" : "k%08x", index * 2654435761u);
+    for (i = 0; buffer[i]; i++) name->Buffer[i] = buffer[i];
+    name->Length = i * sizeof(WCHAR);
+}
+
+static void test_large_key(void)
+{
+    BYTE buffer[256];
+    KEY_VALUE_PARTIAL_INFORMATION *partial_info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    KEY_FULL_INFORMATION *full_info = (KEY_FULL_INFORMATION *)buffer;
+    KEY_BASIC_INFORMATION *basic_info = (KEY_BASIC_INFORMATION *)buffer;
+    LARGE_INTEGER start, end, freq;
+    UNICODE_STRING str, name, prev, cur;
+    OBJECT_ATTRIBUTES attr;
+    WCHAR nameW[16], prevW[16];
+    HANDLE root, key, subkey;
+    DWORD i, count, len;
+    NTSTATUS status;
+
+    count = winetest_benchmark ? 1000000 : 2000;
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&root, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08x\n", status);
+    pRtlCreateUnicodeStringFromAsciiz(&str, "LargeKey");
+    InitializeObjectAttributes(&attr, &str, 0, root, 0);
+    status = pNtCreateKey(&key, KEY_ALL_ACCESS, &attr, 0, 0, REG_OPTION_VOLATILE, 0);
+    ok(status == STATUS_SUCCESS, "NtCreateKey failed: 0x%08x\n", status);
+    pRtlFreeUnicodeString(&str);
+    pNtClose(root);
+
+    name.Buffer = nameW;
+    name.MaximumLength = sizeof(nameW);
+    InitializeObjectAttributes(&attr, &name, 0, key, 0);
+
+    if (winetest_benchmark) NtQueryPerformanceCounter(&start, &freq);
+    for (i = 0; i < count; i++)
+    {
+        set_large_key_name(&name, i, i & 1);
+        if ((status = pNtCreateKey(&subkey, KEY_ALL_ACCESS, &attr, 0, 0, REG_OPTION_VOLATILE, 0))) break;
+        pNtClose(subkey);
+        if ((status = pNtSetValueKey(key, &name, 0, REG_DWORD, &i, sizeof(i)))) break;
+    }
+    ok(status == STATUS_SUCCESS, "%u: failed to create key: 0x%08x\n", i, status);
+    if (winetest_benchmark)
+    {
+        NtQueryPerformanceCounter(&end, NULL);
+        trace("created %u keys and values in %u ms\n", count,
+              (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+    }
+
+    for (i = 0; i < count; i += count / 100)
+    {
+        set_large_key_name(&name, i, !(i & 1));
+        status = pNtOpenKey(&subkey, KEY_READ, &attr);
+        ok(status == STATUS_SUCCESS, "%u: NtOpenKey failed: 0x%08x\n", i, status);
+        pNtClose(subkey);
+        status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "%u: NtQueryValueKey failed: 0x%08x\n", i, status);
+        ok(*(DWORD *)partial_info->Data == i, "%u: wrong data %u\n", i, *(DWORD *)partial_info->Data);
+    }
+
+    /* subkeys are always enumerated in sorted order */
+    prev.Buffer = prevW;
+    if (winetest_benchmark) NtQueryPerformanceCounter(&start, NULL);
+    for (i = 0; i <= count; i++)
+    {
+        status = pNtEnumerateKey(key, i, KeyBasicInformation, buffer, sizeof(buffer), &len);
+        if (status) break;
+        cur.Buffer = basic_info->Name;
+        cur.Length = cur.MaximumLength = basic_info->NameLength;
+        if (i && pRtlCompareUnicodeString(&prev, &cur, TRUE) >= 0) break;
+        memcpy(prevW, cur.Buffer, cur.Length);
+        prev.Length = prev.MaximumLength = cur.Length;
+    }
+    ok(status == STATUS_NO_MORE_ENTRIES, "%u: got 0x%08x\n", i, status);
+    ok(i == count, "enumerated %u keys, expected %u\n", i, count);
+    for (i = 0; i <= count; i++)
+    {
+        status = pNtEnumerateValueKey(key, i, KeyValueBasicInformation, buffer, sizeof(buffer), &len);
+        if (status) break;
+    }
+    ok(status == STATUS_NO_MORE_ENTRIES, "%u: got 0x%08x\n", i, status);
+    ok(i == count, "enumerated %u values, expected %u\n", i, count);
+    if (winetest_benchmark)
+    {
+        NtQueryPerformanceCounter(&end, NULL);
+        trace("enumerated %u keys and values in %u ms\n", count,
+              (DWORD)((end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart));
+    }
+
+    for (i = 0; i < count; i += 2)
+    {
+        set_large_key_name(&name, i, FALSE);
+        if ((status = pNtOpenKey(&subkey, DELETE, &attr))) break;
+        status = pNtDeleteKey(subkey);
+        pNtClose(subkey);
+        if (status || (status = pNtDeleteValueKey(key, &name))) break;
+    }
+    ok(status == STATUS_SUCCESS, "%u: failed to delete key: 0x%08x\n", i, status);
+
+    status = pNtQueryKey(key, KeyFullInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "NtQueryKey failed: 0x%08x\n", status);
+    ok(full_info->SubKeys == count / 2, "got %u subkeys\n", full_info->SubKeys);
+    ok(full_info->Values == count / 2, "got %u values\n", full_info->Values);
+
+    for (i = 0; i < count; i++)
+    {
+        set_large_key_name(&name, i, TRUE);
+        status = pNtOpenKey(&subkey, DELETE, &attr);
+        if ((i & 1) != (status == STATUS_SUCCESS)) break;
+        if (status) continue;
+        pNtDeleteKey(subkey);
+        pNtClose(subkey);
+    }
+    ok(i == count, "%u: got 0x%08x\n", i, status);
+
+    status = pNtDeleteKey(key);
+    ok(status == STATUS_SUCCESS, "NtDeleteKey failed: 0x%08x\n", status);
+    pNtClose(key);
+}
+
 static void test_long_value_name(void)
 {
     HANDLE key;
@@ -2040,6 +2258,8 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_NtQueryMultipleValueKey();
+    test_large_key();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
@@ -732,6 +732,68 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+static TP_WORK *nested_child_work;
+
+static void CALLBACK nested_parent_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        pTpPostWork(nested_child_work);
+}
+
+static void CALLBACK nested_child_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void test_tp_work_nested(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    LONG child_count = 0;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    int i;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, 4);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    nested_child_work = NULL;
+    status = pTpAllocWork(&nested_child_work, nested_child_cb, &child_count, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    work = NULL;
+    status = pTpAllocWork(&work, nested_parent_cb, NULL, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+
+    /* work posted from within callbacks is executed as well */
+    for (i = 0; i < 10000; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    pTpWaitForWork(nested_child_work, FALSE);
+    ok(child_count == 40000, "expected child_count = 40000, got %u\n", child_count);
+
+    /* cancelling pending callbacks doesn't affect callbacks posted afterwards */
+    child_count = 0;
+    for (i = 0; i < 100; i++)
+        pTpPostWork(nested_child_work);
+    pTpWaitForWork(nested_child_work, TRUE);
+    ok(child_count <= 100, "expected child_count <= 100, got %u\n", child_count);
+    child_count = 0;
+    pTpPostWork(nested_child_work);
+    pTpWaitForWork(nested_child_work, FALSE);
+    ok(child_count == 1, "expected child_count = 1, got %u\n", child_count);
+
+    pTpReleaseWork(work);
+    pTpReleaseWork(nested_child_work);
+    pTpReleasePool(pool);
+}
+
 static void CALLBACK simple_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
 {
     HANDLE *semaphores = userdata;
@@ -2244,6 +2306,7 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_nested();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
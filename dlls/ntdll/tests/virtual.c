@@ -530,6 +530,77 @@ static void test_user_shared_data(void)
 #endif
 }
 
+static void test_allocation_stress(void)
+{
+    static const unsigned int count = 4000;
+    LARGE_INTEGER start, end, freq;
+    void **blocks, **big_blocks;
+    unsigned int i, pass;
+    NTSTATUS status;
+    SIZE_T size;
+
+    blocks = HeapAlloc(GetProcessHeap(), 0, count * sizeof(*blocks));
+    big_blocks = HeapAlloc(GetProcessHeap(), 0, count / 2 * sizeof(*big_blocks));
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        ULONG type = MEM_RESERVE | (pass ? MEM_TOP_DOWN : 0);
+
+        if (winetest_benchmark) NtQueryPerformanceCounter(&start, &freq);
+        for (i = 0; i < count; i++)
+        {
+            blocks[i] = NULL;
+            size = 0x10000;
+            status = NtAllocateVirtualMemory(NtCurrentProcess(), &blocks[i], 0, &size, type, PAGE_READWRITE);
+            ok(!status, "%u: failed to allocate, status %08x\n", i, status);
+        }
+        /* leave 64K holes that are too small for the big blocks */
+        for (i = 0; i < count; i += 2)
+        {
+            size = 0;
+            status = NtFreeVirtualMemory(NtCurrentProcess(), &blocks[i], &size, MEM_RELEASE);
+            ok(!status, "%u: failed to free, status %08x\n", i, status);
+        }
+        for (i = 0; i < count / 2; i++)
+        {
+            big_blocks[i] = NULL;
+            size = 0x20000;
+            status = NtAllocateVirtualMemory(NtCurrentProcess(), &big_blocks[i], 0, &size, type, PAGE_READWRITE);
+            ok(!status, "%u: failed to allocate, status %08x\n", i, status);
+        }
+        /* the holes are still available for small blocks */
+        for (i = 0; i < count; i += 2)
+        {
+            blocks[i] = NULL;
+            size = 0x10000;
+            status = NtAllocateVirtualMemory(NtCurrentProcess(), &blocks[i], 0, &size, type, PAGE_READWRITE);
+            ok(!status, "%u: failed to allocate, status %08x\n", i, status);
+        }
+        if (winetest_benchmark)
+        {
+            NtQueryPerformanceCounter(&end, NULL);
+            trace("%s: %u allocations in %.3f ms\n", pass ? "top down" : "bottom up", 2 * count,
+                  (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart);
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            size = 0;
+            status = NtFreeVirtualMemory(NtCurrentProcess(), &blocks[i], &size, MEM_RELEASE);
+            ok(!status, "%u: failed to free, status %08x\n", i, status);
+        }
+        for (i = 0; i < count / 2; i++)
+        {
+            size = 0;
+            status = NtFreeVirtualMemory(NtCurrentProcess(), &big_blocks[i], &size, MEM_RELEASE);
+            ok(!status, "%u: failed to free, status %08x\n", i, status);
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, big_blocks);
+    HeapFree(GetProcessHeap(), 0, blocks);
+}
+
 START_TEST(virtual)
 {
     HMODULE mod;
@@ -563,4 +634,5 @@ START_TEST(virtual)
     test_RtlCreateUserStack();
     test_NtMapViewOfSection();
     test_user_shared_data();
+    test_allocation_stress();
 }
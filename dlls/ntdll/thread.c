@@ -313,6 +313,7 @@ TEB *thread_init(void)
 
     virtual_get_system_info( &sbi );
     user_shared_data->NumberOfPhysicalPages = sbi.MmNumberOfPhysicalPages;
+    user_shared_data->LargePageMinimum = virtual_get_large_page_minimum();
 
     return teb;
 }
@@ -114,8 +114,33 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_FAIRNESS_INTERVAL 61
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* queue of threadpool objects with pending callbacks */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    /* Queued objects, locked via .lock, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
+    struct list             objects[3];
+    LONG                    depth;
+    LONG                    max_depth;
+};
+
+/* internal worker thread representation */
+struct threadpool_worker
+{
+    struct threadpool_worker *next;     /* entries are only freed with the pool */
+    struct threadpool       *pool;
+    BOOL                    active;     /* locked via .pool->cs */
+    /* work submitted from callbacks running on this worker */
+    struct threadpool_queue queue;
+    /* only accessed by the worker thread */
+    unsigned int            tick;
+    LONG                    num_steals;
+    LONG                    num_local_submits;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -123,14 +148,19 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
+    /* Pools of wait and I/O objects, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
     struct list             pools[3];
-    RTL_CONDITION_VARIABLE  update_event;
-    /* information about worker threads, locked via .cs */
+    LONG                    num_queued;
+    /* work submitted from outside of the worker threads */
+    struct threadpool_queue queue;
+    struct threadpool_worker *workers;
+    LONG                    wake_count;
+    LONG                    num_idle_workers;
+    /* information about worker threads, modified via .cs */
     int                     max_workers;
     int                     min_workers;
-    int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_workers;
+    LONG                    num_busy_workers;
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
@@ -169,8 +199,9 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the pool, locked via .queue->lock, or .pool->cs for wait and I/O objects */
     struct list             pool_entry;
+    struct threadpool_queue *queue;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
     LONG                    num_pending_callbacks;
@@ -374,6 +405,7 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static void tp_threadpool_wake( struct threadpool *pool );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_prepare_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
@@ -1370,6 +1402,140 @@ static void CALLBACK timerqueue_thread_proc( void *param )
     RtlExitUserThread( 0 );
 }
 
+/***********************************************************************
+ *           tp_queue_init    (internal)
+ */
+static void tp_queue_init( struct threadpool_queue *queue )
+{
+    unsigned int i;
+
+    RtlInitializeSRWLock( &queue->lock );
+    for (i = 0; i < ARRAY_SIZE(queue->objects); ++i)
+        list_init( &queue->objects[i] );
+    queue->depth = 0;
+    queue->max_depth = 0;
+}
+
+/***********************************************************************
+ *           tp_queue_push    (internal)
+ *
+ * Adds a pending callback to an object, and queues the object if it
+ * didn't have any. The queue pointer of an object is only set while it
+ * is linked into that queue, and only changes with the queue lock held.
+ */
+static void tp_queue_push( struct threadpool_queue *queue, struct threadpool_object *object )
+{
+    LONG pending;
+
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    for (;;)
+    {
+        if ((pending = object->num_pending_callbacks))
+        {
+            /* already queued somewhere else, only add the callback */
+            if (interlocked_cmpxchg( (int *)&object->num_pending_callbacks, pending + 1, pending ) == pending)
+                break;
+        }
+        else if (!interlocked_cmpxchg( (int *)&object->num_pending_callbacks, 1, 0 ))
+        {
+            interlocked_xchg_ptr( (void **)&object->queue, queue );
+            list_add_tail( &queue->objects[object->priority], &object->pool_entry );
+            if (interlocked_inc( &queue->depth ) > queue->max_depth)
+                queue->max_depth = queue->depth;
+            break;
+        }
+    }
+    RtlReleaseSRWLockExclusive( &queue->lock );
+}
+
+/***********************************************************************
+ *           tp_queue_pop    (internal)
+ *
+ * Takes the next pending callback from a queue. The callback is accounted
+ * as running before it stops being pending, so that waiters never see the
+ * object as finished in between.
+ */
+static struct threadpool_object *tp_queue_pop( struct threadpool_queue *queue )
+{
+    struct threadpool_object *object = NULL;
+    struct list *ptr = NULL;
+    unsigned int i;
+    LONG pending;
+
+    if (!queue->depth) return NULL;
+
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    for (i = 0; i < ARRAY_SIZE(queue->objects); ++i)
+        if ((ptr = list_head( &queue->objects[i] ))) break;
+
+    if (ptr)
+    {
+        object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+        list_remove( &object->pool_entry );
+        interlocked_inc( &object->num_associated_callbacks );
+        interlocked_inc( &object->num_running_callbacks );
+
+        for (;;)
+        {
+            pending = object->num_pending_callbacks;
+            assert( pending > 0 );
+            if (pending == 1)
+            {
+                /* clear the queue first, submitters may queue the object elsewhere once it reaches 0 */
+                interlocked_xchg_ptr( (void **)&object->queue, NULL );
+                if (interlocked_cmpxchg( (int *)&object->num_pending_callbacks, 0, 1 ) == 1)
+                {
+                    interlocked_dec( &queue->depth );
+                    break;
+                }
+                interlocked_xchg_ptr( (void **)&object->queue, queue );
+            }
+            else if (interlocked_cmpxchg( (int *)&object->num_pending_callbacks, pending - 1, pending ) == pending)
+            {
+                /* further callbacks are pending, move the object to the end of the queue */
+                list_add_tail( &queue->objects[object->priority], &object->pool_entry );
+                break;
+            }
+        }
+    }
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    return object;
+}
+
+/***********************************************************************
+ *           tp_queue_cancel    (internal)
+ *
+ * Removes an object from its queue and returns the number of pending
+ * callbacks that were cancelled.
+ */
+static LONG tp_queue_cancel( struct threadpool_object *object )
+{
+    struct threadpool_queue *queue;
+    LONG pending = 0;
+
+    while (object->num_pending_callbacks)
+    {
+        /* the object is in the middle of being queued or dequeued */
+        if (!(queue = object->queue))
+        {
+            NtYieldExecution();
+            continue;
+        }
+
+        RtlAcquireSRWLockExclusive( &queue->lock );
+        if (object->queue == queue)
+        {
+            list_remove( &object->pool_entry );
+            interlocked_xchg_ptr( (void **)&object->queue, NULL );
+            interlocked_dec( &queue->depth );
+            pending = interlocked_xchg( (int *)&object->num_pending_callbacks, 0 );
+        }
+        RtlReleaseSRWLockExclusive( &queue->lock );
+        if (pending) break;
+    }
+    return pending;
+}
+
 /***********************************************************************
  *           tp_new_worker_thread    (internal)
  *
@@ -1377,18 +1543,35 @@ static void CALLBACK timerqueue_thread_proc( void *param )
  */
 static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
 {
+    struct threadpool_worker *worker;
     HANDLE thread;
     NTSTATUS status;
 
+    /* Reuse the entry of a terminated worker thread if possible. */
+    for (worker = pool->workers; worker; worker = worker->next)
+        if (!worker->active) break;
+
+    if (!worker)
+    {
+        if (!(worker = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*worker) )))
+            return STATUS_NO_MEMORY;
+        worker->pool = pool;
+        tp_queue_init( &worker->queue );
+        worker->next = pool->workers;
+        interlocked_xchg_ptr( (void **)&pool->workers, worker );
+    }
+
+    worker->active = TRUE;
     status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                  threadpool_worker_proc, pool, &thread, NULL );
+                                  threadpool_worker_proc, worker, &thread, NULL );
     if (status == STATUS_SUCCESS)
     {
         interlocked_inc( &pool->refcount );
-        pool->num_workers++;
-        pool->num_busy_workers++;
+        interlocked_inc( &pool->num_workers );
+        interlocked_inc( &pool->num_busy_workers );
         NtClose( thread );
     }
+    else worker->active = FALSE;
     return status;
 }
 
@@ -1860,7 +2043,11 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         list_init( &pool->pools[i] );
-    RtlInitializeConditionVariable( &pool->update_event );
+    pool->num_queued              = 0;
+    tp_queue_init( &pool->queue );
+    pool->workers                 = NULL;
+    pool->wake_count              = 0;
+    pool->num_idle_workers        = 0;
 
     pool->max_workers             = 500;
     pool->min_workers             = 0;
@@ -1887,7 +2074,56 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
     assert( pool != default_threadpool );
 
     pool->shutdown = TRUE;
-    RtlWakeAllConditionVariable( &pool->update_event );
+    interlocked_inc( &pool->wake_count );
+    RtlWakeAddressAll( &pool->wake_count );
+}
+
+/***********************************************************************
+ *           tp_threadpool_wake    (internal)
+ *
+ * Wakes up an idle worker thread, if there is any. Submitters update the
+ * queues before checking for idle threads, and idle threads check the
+ * queues after announcing themselves, so no wakeup can be lost.
+ */
+static void tp_threadpool_wake( struct threadpool *pool )
+{
+    if (!pool->num_idle_workers) return;
+    interlocked_inc( &pool->wake_count );
+    RtlWakeAddressSingle( &pool->wake_count );
+}
+
+/***********************************************************************
+ *           tp_threadpool_has_work    (internal)
+ */
+static BOOL tp_threadpool_has_work( struct threadpool *pool )
+{
+    struct threadpool_worker *worker;
+
+    if (pool->num_queued || pool->queue.depth) return TRUE;
+    for (worker = pool->workers; worker; worker = worker->next)
+        if (worker->queue.depth) return TRUE;
+    return FALSE;
+}
+
+/***********************************************************************
+ *           tp_threadpool_trace_stats    (internal)
+ */
+static void tp_threadpool_trace_stats( struct threadpool *pool )
+{
+    struct threadpool_worker *worker;
+    LONG max_depth = 0, steals = 0, local_submits = 0;
+
+    if (!TRACE_ON(threadpool)) return;
+
+    for (worker = pool->workers; worker; worker = worker->next)
+    {
+        max_depth = max( max_depth, worker->queue.max_depth );
+        steals += worker->num_steals;
+        local_submits += worker->num_local_submits;
+    }
+    TRACE( "pool %p: %d workers, queue depth %d (max %d), max local depth %d, %d local submissions, %d steals\n",
+           pool, pool->num_workers, pool->queue.depth, pool->queue.max_depth, max_depth,
+           local_submits, steals );
 }
 
 /***********************************************************************
@@ -1897,17 +2133,28 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
  */
 static BOOL tp_threadpool_release( struct threadpool *pool )
 {
+    struct threadpool_worker *worker, *next;
     unsigned int i;
 
     if (interlocked_dec( &pool->refcount ))
         return FALSE;
 
     TRACE( "destroying threadpool %p\n", pool );
+    tp_threadpool_trace_stats( pool );
 
     assert( pool->shutdown );
     assert( !pool->objcount );
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         assert( list_empty( &pool->pools[i] ) );
+    assert( !pool->queue.depth );
+
+    for (worker = pool->workers; worker; worker = next)
+    {
+        next = worker->next;
+        assert( !worker->active );
+        assert( !worker->queue.depth );
+        RtlFreeHeap( GetProcessHeap(), 0, worker );
+    }
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -2151,6 +2398,31 @@ static void tp_object_prio_queue( struct threadpool_object *object )
     list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
 }
 
+/* Wait and I/O objects have additional state locked via pool->cs, so they
+ * are queued into the pool lists, all other objects use the work queues. */
+static inline BOOL object_uses_work_queue( const struct threadpool_object *object )
+{
+    return object->type != TP_OBJECT_TYPE_WAIT && object->type != TP_OBJECT_TYPE_IO;
+}
+
+/***********************************************************************
+ *           tp_object_add_pending    (internal)
+ *
+ * Adds a pending callback to an object which is already queued, without
+ * taking any lock.
+ */
+static BOOL tp_object_add_pending( struct threadpool_object *object )
+{
+    LONG pending;
+
+    while ((pending = object->num_pending_callbacks))
+    {
+        if (interlocked_cmpxchg( (int *)&object->num_pending_callbacks, pending + 1, pending ) == pending)
+            return TRUE;
+    }
+    return FALSE;
+}
+
 /***********************************************************************
  *           tp_object_submit    (internal)
  *
@@ -2160,11 +2432,45 @@ static void tp_object_prio_queue( struct threadpool_object *object )
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
     struct threadpool *pool = object->pool;
+    struct threadpool_worker *worker;
     NTSTATUS status = STATUS_UNSUCCESSFUL;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
+    if (object_uses_work_queue( object ))
+    {
+        /* Queue work item and increment refcount. Work submitted from a
+         * callback goes to the local queue of the worker thread. */
+        interlocked_inc( &object->refcount );
+        if (!tp_object_add_pending( object ))
+        {
+            worker = ntdll_get_thread_data()->threadpool_worker;
+            if (worker && worker->pool == pool)
+            {
+                tp_queue_push( &worker->queue, object );
+                worker->num_local_submits++;
+            }
+            else tp_queue_push( &pool->queue, object );
+        }
+
+        /* Start new worker threads if required. This is checked after
+         * queuing, a terminating worker checks the queues after leaving. */
+        if (pool->num_busy_workers >= pool->num_workers)
+        {
+            RtlEnterCriticalSection( &pool->cs );
+            if (pool->num_busy_workers >= pool->num_workers &&
+                pool->num_workers < pool->max_workers)
+                status = tp_new_worker_thread( pool );
+            RtlLeaveCriticalSection( &pool->cs );
+        }
+
+        /* No new thread started - wake up one existing thread. */
+        if (status != STATUS_SUCCESS)
+            tp_threadpool_wake( pool );
+        return;
+    }
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
@@ -2175,7 +2481,10 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     /* Queue work item and increment refcount. */
     interlocked_inc( &object->refcount );
     if (!object->num_pending_callbacks++)
+    {
         tp_object_prio_queue( object );
+        interlocked_inc( &pool->num_queued );
+    }
 
     /* Count how often the object was signaled. */
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
@@ -2185,7 +2494,7 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     if (status != STATUS_SUCCESS)
     {
         assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        tp_threadpool_wake( pool );
     }
 
     RtlLeaveCriticalSection( &pool->cs );
@@ -2201,19 +2510,27 @@ static void tp_object_cancel( struct threadpool_object *object )
     struct threadpool *pool = object->pool;
     LONG pending_callbacks = 0;
 
-    RtlEnterCriticalSection( &pool->cs );
-    if (object->num_pending_callbacks)
+    if (object_uses_work_queue( object ))
     {
-        pending_callbacks = object->num_pending_callbacks;
-        object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
+        pending_callbacks = tp_queue_cancel( object );
+    }
+    else
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        if (object->num_pending_callbacks)
+        {
+            pending_callbacks = object->num_pending_callbacks;
+            object->num_pending_callbacks = 0;
+            list_remove( &object->pool_entry );
+            interlocked_dec( &pool->num_queued );
 
-        if (object->type == TP_OBJECT_TYPE_WAIT)
-            object->u.wait.signaled = 0;
+            if (object->type == TP_OBJECT_TYPE_WAIT)
+                object->u.wait.signaled = 0;
+        }
+        if (object->type == TP_OBJECT_TYPE_IO)
+            object->u.io.pending_count = 0;
+        RtlLeaveCriticalSection( &pool->cs );
     }
-    if (object->type == TP_OBJECT_TYPE_IO)
-        object->u.io.pending_count = 0;
-    RtlLeaveCriticalSection( &pool->cs );
 
     while (pending_callbacks--)
         tp_object_release( object );
@@ -2324,6 +2641,161 @@ static struct list *threadpool_get_next_item( const struct threadpool *pool )
     return ptr;
 }
 
+/***********************************************************************
+ *           tp_threadpool_pop    (internal)
+ *
+ * Takes the next pending callback of a wait or I/O object from the pool
+ * lists. The caller must hold pool->cs.
+ */
+static struct threadpool_object *tp_threadpool_pop( struct threadpool *pool, TP_WAIT_RESULT *wait_result,
+                                                    struct io_completion *completion )
+{
+    struct threadpool_object *object;
+    struct list *ptr;
+
+    if (!(ptr = threadpool_get_next_item( pool )))
+        return NULL;
+
+    object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+    assert( object->num_pending_callbacks > 0 );
+
+    /* If further pending callbacks are queued, move the work item to
+     * the end of the pool list. Otherwise remove it from the pool. */
+    list_remove( &object->pool_entry );
+    if (--object->num_pending_callbacks)
+        tp_object_prio_queue( object );
+    else
+        interlocked_dec( &pool->num_queued );
+
+    /* For wait objects check if they were signaled or have timed out. */
+    if (object->type == TP_OBJECT_TYPE_WAIT)
+    {
+        *wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+        if (*wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
+    }
+    else if (object->type == TP_OBJECT_TYPE_IO)
+    {
+        assert( object->u.io.completion_count );
+        *completion = object->u.io.completions[--object->u.io.completion_count];
+        object->u.io.pending_count--;
+    }
+
+    interlocked_inc( &object->num_associated_callbacks );
+    interlocked_inc( &object->num_running_callbacks );
+    return object;
+}
+
+/***********************************************************************
+ *           tp_worker_pop_shared    (internal)
+ */
+static struct threadpool_object *tp_worker_pop_shared( struct threadpool *pool, TP_WAIT_RESULT *wait_result,
+                                                       struct io_completion *completion )
+{
+    struct threadpool_object *object;
+
+    if ((object = tp_queue_pop( &pool->queue )))
+        return object;
+    if (!pool->num_queued)
+        return NULL;
+
+    RtlEnterCriticalSection( &pool->cs );
+    object = tp_threadpool_pop( pool, wait_result, completion );
+    RtlLeaveCriticalSection( &pool->cs );
+    return object;
+}
+
+/***********************************************************************
+ *           tp_worker_next_object    (internal)
+ *
+ * Returns the next object to run a callback for. Workers run the work
+ * submitted from their own callbacks first, then the shared work, and
+ * steal work from the other workers when there is nothing else to do.
+ */
+static struct threadpool_object *tp_worker_next_object( struct threadpool_worker *worker, TP_WAIT_RESULT *wait_result,
+                                                        struct io_completion *completion )
+{
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object;
+    struct threadpool_worker *other;
+
+    /* Look at the shared work from time to time, so that it isn't
+     * starved by callbacks which keep submitting local work. */
+    if (!(++worker->tick % THREADPOOL_FAIRNESS_INTERVAL) &&
+        (object = tp_worker_pop_shared( pool, wait_result, completion )))
+        return object;
+
+    if ((object = tp_queue_pop( &worker->queue )))
+        return object;
+    if ((object = tp_worker_pop_shared( pool, wait_result, completion )))
+        return object;
+
+    for (other = pool->workers; other; other = other->next)
+    {
+        if (other == worker) continue;
+        if ((object = tp_queue_pop( &other->queue )))
+        {
+            worker->num_steals++;
+            return object;
+        }
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           tp_worker_may_terminate    (internal)
+ *
+ * Checks whether an idle worker thread can terminate. A thread only
+ * terminates when no new tasks are available, and the number of threads
+ * can be decreased without violating the min_workers limit. An exception
+ * is when min_workers == 0, then objcount is used to detect if the last
+ * thread can be terminated.
+ */
+static BOOL tp_worker_may_terminate( struct threadpool_worker *worker )
+{
+    struct threadpool *pool = worker->pool;
+    BOOL ret = FALSE;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (pool->num_workers > max( pool->min_workers, 1 ) ||
+        (!pool->min_workers && !pool->objcount))
+    {
+        /* Submitters check the number of workers after queuing, so the
+         * queues have to be checked after the thread is removed. */
+        interlocked_dec( &pool->num_workers );
+        if (!(ret = !tp_threadpool_has_work( pool )))
+            interlocked_inc( &pool->num_workers );
+        else
+            worker->active = FALSE;
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+    return ret;
+}
+
+/***********************************************************************
+ *           tp_object_callback_done    (internal)
+ *
+ * Accounts for a finished callback and wakes up threads waiting for the
+ * object when needed.
+ */
+static void tp_object_callback_done( struct threadpool_object *object, BOOL associated )
+{
+    struct threadpool *pool = object->pool;
+    BOOL finished;
+
+    finished = !interlocked_dec( &object->num_running_callbacks );
+    if (associated && !interlocked_dec( &object->num_associated_callbacks ))
+        finished = TRUE;
+    if (!finished || object->num_pending_callbacks)
+        return;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (object_is_finished( object, TRUE ))
+        RtlWakeAllConditionVariable( &object->group_finished_event );
+    if (associated && object_is_finished( object, FALSE ))
+        RtlWakeAllConditionVariable( &object->finished_event );
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
@@ -2332,193 +2804,168 @@ static void CALLBACK threadpool_worker_proc( void *param )
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
     struct io_completion completion;
-    struct threadpool *pool = param;
+    struct threadpool_worker *worker = param;
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object;
     TP_WAIT_RESULT wait_result = 0;
     LARGE_INTEGER timeout;
-    struct list *ptr;
+    LONG wake_count;
     NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
-    RtlEnterCriticalSection( &pool->cs );
-    pool->num_busy_workers--;
+    ntdll_get_thread_data()->threadpool_worker = worker;
+    interlocked_dec( &pool->num_busy_workers );
     for (;;)
     {
-        while ((ptr = threadpool_get_next_item( pool )))
+        if (!(object = tp_worker_next_object( worker, &wait_result, &completion )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
-
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (--object->num_pending_callbacks)
-                tp_object_prio_queue( object );
-
-            /* For wait objects check if they were signaled or have timed out. */
-            if (object->type == TP_OBJECT_TYPE_WAIT)
-            {
-                wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
-                if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
-            }
-            else if (object->type == TP_OBJECT_TYPE_IO)
+            /* Announce that this thread is idle and check the queues again,
+             * submitters check for idle threads after queuing. */
+            wake_count = pool->wake_count;
+            interlocked_inc( &pool->num_idle_workers );
+            if (!(object = tp_worker_next_object( worker, &wait_result, &completion )))
             {
-                assert( object->u.io.completion_count );
-                completion = object->u.io.completions[--object->u.io.completion_count];
-                object->u.io.pending_count--;
-            }
-
-            /* Leave critical section and do the actual callback. */
-            object->num_associated_callbacks++;
-            object->num_running_callbacks++;
-            pool->num_busy_workers++;
-            RtlLeaveCriticalSection( &pool->cs );
-
-            /* Initialize threadpool instance struct. */
-            callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
-            instance.object                     = object;
-            instance.threadid                   = GetCurrentThreadId();
-            instance.associated                 = TRUE;
-            instance.may_run_long               = object->may_run_long;
-            instance.cleanup.critical_section   = NULL;
-            instance.cleanup.mutex              = NULL;
-            instance.cleanup.semaphore          = NULL;
-            instance.cleanup.semaphore_count    = 0;
-            instance.cleanup.event              = NULL;
-            instance.cleanup.library            = NULL;
-
-            switch (object->type)
-            {
-                case TP_OBJECT_TYPE_SIMPLE:
+                /* Shutdown worker thread if requested. */
+                if (pool->shutdown)
                 {
-                    TRACE( "executing simple callback %p(%p, %p)\n",
-                           object->u.simple.callback, callback_instance, object->userdata );
-                    object->u.simple.callback( callback_instance, object->userdata );
-                    TRACE( "callback %p returned\n", object->u.simple.callback );
+                    interlocked_dec( &pool->num_idle_workers );
+                    RtlEnterCriticalSection( &pool->cs );
+                    interlocked_dec( &pool->num_workers );
+                    worker->active = FALSE;
+                    RtlLeaveCriticalSection( &pool->cs );
                     break;
                 }
 
-                case TP_OBJECT_TYPE_WORK:
-                {
-                    TRACE( "executing work callback %p(%p, %p, %p)\n",
-                           object->u.work.callback, callback_instance, object->userdata, object );
-                    object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
-                    TRACE( "callback %p returned\n", object->u.work.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_TIMER:
-                {
-                    TRACE( "executing timer callback %p(%p, %p, %p)\n",
-                           object->u.timer.callback, callback_instance, object->userdata, object );
-                    object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
-                    TRACE( "callback %p returned\n", object->u.timer.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_WAIT:
-                {
-                    TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
-                           object->u.wait.callback, callback_instance, object->userdata, object, wait_result );
-                    object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, wait_result );
-                    TRACE( "callback %p returned\n", object->u.wait.callback );
-                    break;
-                }
-
-                case TP_OBJECT_TYPE_IO:
-                {
-                    TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
-                            object->u.io.callback, callback_instance, object->userdata,
-                            completion.cvalue, &completion.iosb, (TP_IO *)object );
-                    object->u.io.callback( callback_instance, object->userdata,
-                            (void *)completion.cvalue, &completion.iosb, (TP_IO *)object );
-                    TRACE( "callback %p returned\n", object->u.io.callback );
-                    break;
-                }
-
-                default:
-                    assert(0);
+                /* Wait for new tasks or until the timeout expires. */
+                timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+                status = RtlWaitOnAddress( &pool->wake_count, &wake_count, sizeof(wake_count), &timeout );
+                interlocked_dec( &pool->num_idle_workers );
+                if (status == STATUS_TIMEOUT && tp_worker_may_terminate( worker ))
                     break;
+                continue;
             }
+            interlocked_dec( &pool->num_idle_workers );
+        }
 
-            /* Execute finalization callback. */
-            if (object->finalization_callback)
+        /* Do the actual callback. */
+        interlocked_inc( &pool->num_busy_workers );
+
+        /* Initialize threadpool instance struct. */
+        callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
+        instance.object                     = object;
+        instance.threadid                   = GetCurrentThreadId();
+        instance.associated                 = TRUE;
+        instance.may_run_long               = object->may_run_long;
+        instance.cleanup.critical_section   = NULL;
+        instance.cleanup.mutex              = NULL;
+        instance.cleanup.semaphore          = NULL;
+        instance.cleanup.semaphore_count    = 0;
+        instance.cleanup.event              = NULL;
+        instance.cleanup.library            = NULL;
+
+        switch (object->type)
+        {
+            case TP_OBJECT_TYPE_SIMPLE:
             {
-                TRACE( "executing finalization callback %p(%p, %p)\n",
-                       object->finalization_callback, callback_instance, object->userdata );
-                object->finalization_callback( callback_instance, object->userdata );
-                TRACE( "callback %p returned\n", object->finalization_callback );
+                TRACE( "executing simple callback %p(%p, %p)\n",
+                       object->u.simple.callback, callback_instance, object->userdata );
+                object->u.simple.callback( callback_instance, object->userdata );
+                TRACE( "callback %p returned\n", object->u.simple.callback );
+                break;
             }
 
-            /* Execute cleanup tasks. */
-            if (instance.cleanup.critical_section)
-            {
-                RtlLeaveCriticalSection( instance.cleanup.critical_section );
-            }
-            if (instance.cleanup.mutex)
-            {
-                status = NtReleaseMutant( instance.cleanup.mutex, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
-            }
-            if (instance.cleanup.semaphore)
+            case TP_OBJECT_TYPE_WORK:
             {
-                status = NtReleaseSemaphore( instance.cleanup.semaphore, instance.cleanup.semaphore_count, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
+                TRACE( "executing work callback %p(%p, %p, %p)\n",
+                       object->u.work.callback, callback_instance, object->userdata, object );
+                object->u.work.callback( callback_instance, object->userdata, (TP_WORK *)object );
+                TRACE( "callback %p returned\n", object->u.work.callback );
+                break;
             }
-            if (instance.cleanup.event)
+
+            case TP_OBJECT_TYPE_TIMER:
             {
-                status = NtSetEvent( instance.cleanup.event, NULL );
-                if (status != STATUS_SUCCESS) goto skip_cleanup;
+                TRACE( "executing timer callback %p(%p, %p, %p)\n",
+                       object->u.timer.callback, callback_instance, object->userdata, object );
+                object->u.timer.callback( callback_instance, object->userdata, (TP_TIMER *)object );
+                TRACE( "callback %p returned\n", object->u.timer.callback );
+                break;
             }
-            if (instance.cleanup.library)
+
+            case TP_OBJECT_TYPE_WAIT:
             {
-                LdrUnloadDll( instance.cleanup.library );
+                TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
+                       object->u.wait.callback, callback_instance, object->userdata, object, wait_result );
+                object->u.wait.callback( callback_instance, object->userdata, (TP_WAIT *)object, wait_result );
+                TRACE( "callback %p returned\n", object->u.wait.callback );
+                break;
             }
 
-        skip_cleanup:
-            RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
-
-            /* Simple callbacks are automatically shutdown after execution. */
-            if (object->type == TP_OBJECT_TYPE_SIMPLE)
+            case TP_OBJECT_TYPE_IO:
             {
-                tp_object_prepare_shutdown( object );
-                object->shutdown = TRUE;
+                TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
+                        object->u.io.callback, callback_instance, object->userdata,
+                        completion.cvalue, &completion.iosb, (TP_IO *)object );
+                object->u.io.callback( callback_instance, object->userdata,
+                        (void *)completion.cvalue, &completion.iosb, (TP_IO *)object );
+                TRACE( "callback %p returned\n", object->u.io.callback );
+                break;
             }
 
-            object->num_running_callbacks--;
-            if (object_is_finished( object, TRUE ))
-                RtlWakeAllConditionVariable( &object->group_finished_event );
+            default:
+                assert(0);
+                break;
+        }
 
-            if (instance.associated)
-            {
-                object->num_associated_callbacks--;
-                if (object_is_finished( object, FALSE ))
-                    RtlWakeAllConditionVariable( &object->finished_event );
-            }
+        /* Execute finalization callback. */
+        if (object->finalization_callback)
+        {
+            TRACE( "executing finalization callback %p(%p, %p)\n",
+                   object->finalization_callback, callback_instance, object->userdata );
+            object->finalization_callback( callback_instance, object->userdata );
+            TRACE( "callback %p returned\n", object->finalization_callback );
+        }
 
-            tp_object_release( object );
+        /* Execute cleanup tasks. */
+        if (instance.cleanup.critical_section)
+        {
+            RtlLeaveCriticalSection( instance.cleanup.critical_section );
+        }
+        if (instance.cleanup.mutex)
+        {
+            status = NtReleaseMutant( instance.cleanup.mutex, NULL );
+            if (status != STATUS_SUCCESS) goto skip_cleanup;
+        }
+        if (instance.cleanup.semaphore)
+        {
+            status = NtReleaseSemaphore( instance.cleanup.semaphore, instance.cleanup.semaphore_count, NULL );
+            if (status != STATUS_SUCCESS) goto skip_cleanup;
+        }
+        if (instance.cleanup.event)
+        {
+            status = NtSetEvent( instance.cleanup.event, NULL );
+            if (status != STATUS_SUCCESS) goto skip_cleanup;
+        }
+        if (instance.cleanup.library)
+        {
+            LdrUnloadDll( instance.cleanup.library );
         }
 
-        /* Shutdown worker thread if requested. */
-        if (pool->shutdown)
-            break;
+    skip_cleanup:
+        interlocked_dec( &pool->num_busy_workers );
 
-        /* Wait for new tasks or until the timeout expires. A thread only terminates
-         * when no new tasks are available, and the number of threads can be
-         * decreased without violating the min_workers limit. An exception is when
-         * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
-            (!pool->min_workers && !pool->objcount)))
+        /* Simple callbacks are automatically shutdown after execution. */
+        if (object->type == TP_OBJECT_TYPE_SIMPLE)
         {
-            break;
+            tp_object_prepare_shutdown( object );
+            object->shutdown = TRUE;
         }
+
+        tp_object_callback_done( object, instance.associated );
+        tp_object_release( object );
     }
-    pool->num_workers--;
-    RtlLeaveCriticalSection( &pool->cs );
+    ntdll_get_thread_data()->threadpool_worker = NULL;
 
     TRACE( "terminating worker thread for pool %p\n", pool );
     tp_threadpool_release( pool );
@@ -2856,7 +3303,7 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     pool = object->pool;
     RtlEnterCriticalSection( &pool->cs );
 
-    object->num_associated_callbacks--;
+    interlocked_dec( &object->num_associated_callbacks );
     if (object_is_finished( object, FALSE ))
         RtlWakeAllConditionVariable( &object->finished_event );
 
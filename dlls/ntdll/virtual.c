@@ -86,6 +86,9 @@ struct file_view
 #define VPROT_WRITEWATCH 0x40
 /* per-mapping protection flags */
 #define VPROT_SYSTEM     0x0200  /* system view (underlying mmap not under our control) */
+#define VPROT_HUGETLB    0x0400  /* view mapped with explicit huge pages */
+#define VPROT_HUGEPAGE   0x0800  /* view advised to use transparent huge pages */
+#define VPROT_LARGEPAGES 0x1000  /* view allocated with MEM_LARGE_PAGES */
 
 /* Conversion from VPROT_* to Win32 flags */
 static const BYTE VIRTUAL_Win32Flags[16] =
@@ -108,7 +111,18 @@ static const BYTE VIRTUAL_Win32Flags[16] =
     PAGE_EXECUTE_WRITECOPY      /* READ | WRITE | EXEC | WRITECOPY */
 };
 
+/* range of free address space, rounded to the allocation granularity */
+struct range_entry
+{
+    void *base;
+    void *end;
+};
+
 static struct wine_rb_tree views_tree;
+static struct range_entry *free_ranges;      /* sorted array of the free ranges between views, NULL if invalid */
+static struct range_entry *free_ranges_end;  /* end of the used part of the array */
+static size_t free_ranges_size;              /* allocated size of the array */
+static const UINT_PTR granularity_mask = 0xffff;  /* reserved areas have 64K granularity */
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -184,6 +198,12 @@ static void *preload_reserve_end;
 static BOOL use_locks;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
 
+static size_t large_page_size;   /* size of the host huge pages, 0 if not supported */
+static ULONG large_page_shift;
+static size_t huge_page_min_size;  /* minimum size of committed areas that get transparent huge pages */
+static size_t hugetlb_bytes;     /* memory currently mapped with explicit huge pages */
+static size_t hugepage_bytes;    /* memory currently advised to use transparent huge pages */
+
 static inline int is_view_valloc( const struct file_view *view )
 {
     return !(view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT));
@@ -497,6 +517,184 @@ static struct file_view *find_view_range( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           free_ranges_lower_bound
+ *
+ * Return the first free range whose end is not below addr, or free_ranges_end if there is none.
+ * The csVirtual section must be held by caller.
+ */
+static struct range_entry *free_ranges_lower_bound( const void *addr )
+{
+    struct range_entry *begin = free_ranges, *end = free_ranges_end, *mid;
+
+    while (begin < end)
+    {
+        mid = begin + (end - begin) / 2;
+        if (mid->end < addr) begin = mid + 1;
+        else end = mid;
+    }
+    return begin;
+}
+
+
+/***********************************************************************
+ *           free_ranges_free
+ *
+ * Release the free ranges array, unless it is the initial one from the views block.
+ * The csVirtual section must be held by caller.
+ */
+static void free_ranges_free(void)
+{
+    if (free_ranges_size != view_block_size / sizeof(*free_ranges))
+        munmap( free_ranges, free_ranges_size * sizeof(*free_ranges) );
+}
+
+
+/***********************************************************************
+ *           free_ranges_insert
+ *
+ * Make room for count new entries before the given one. The csVirtual section must be held by caller.
+ * On failure the free ranges are invalidated and the views tree is used from then on.
+ */
+static struct range_entry *free_ranges_insert( struct range_entry *range, unsigned int count )
+{
+    size_t pos = range - free_ranges;
+
+    if (free_ranges_end + count > free_ranges + free_ranges_size)
+    {
+        size_t size = free_ranges_size * 2;
+        struct range_entry *ptr = wine_anon_mmap( NULL, size * sizeof(*ptr), PROT_READ | PROT_WRITE, 0 );
+
+        if (ptr == (void *)-1)
+        {
+            ERR( "out of memory for %lu free ranges, falling back to the views tree\n", (unsigned long)size );
+            free_ranges_free();
+            free_ranges = free_ranges_end = NULL;
+            free_ranges_size = 0;
+            return NULL;
+        }
+        memcpy( ptr, free_ranges, (free_ranges_end - free_ranges) * sizeof(*ptr) );
+        free_ranges_free();
+        free_ranges_end = ptr + (free_ranges_end - free_ranges);
+        free_ranges = ptr;
+        free_ranges_size = size;
+        range = free_ranges + pos;
+    }
+    memmove( range + count, range, (free_ranges_end - range) * sizeof(*range) );
+    free_ranges_end += count;
+    return range;
+}
+
+
+/***********************************************************************
+ *           free_ranges_remove
+ *
+ * Remove an area from the free ranges. The csVirtual section must be held by caller.
+ */
+static void free_ranges_remove( void *base, void *end )
+{
+    struct range_entry *range = free_ranges_lower_bound( base ), *last;
+
+    if (range != free_ranges_end && range->end == base) range++;
+    if (range == free_ranges_end || range->base >= end) return;
+
+    if (range->base < base && range->end > end)  /* split the range in two */
+    {
+        if (!(range = free_ranges_insert( range, 1 ))) return;
+        range[0].end = base;
+        range[1].base = end;
+        return;
+    }
+    if (range->base < base)
+    {
+        range->end = base;
+        range++;
+    }
+    for (last = range; last != free_ranges_end && last->end <= end; last++) ;
+    if (last != free_ranges_end && last->base < end) last->base = end;
+    memmove( range, last, (free_ranges_end - last) * sizeof(*range) );
+    free_ranges_end -= last - range;
+}
+
+
+/***********************************************************************
+ *           free_ranges_add
+ *
+ * Add an area to the free ranges, merging it with the adjacent ones.
+ * The csVirtual section must be held by caller.
+ */
+static void free_ranges_add( void *base, void *end )
+{
+    struct range_entry *range = free_ranges_lower_bound( base ), *last;
+
+    for (last = range; last != free_ranges_end && last->base <= end; last++) ;
+
+    if (last == range)
+    {
+        if (!(range = free_ranges_insert( range, 1 ))) return;
+        range->base = base;
+        range->end = end;
+        return;
+    }
+    range->base = min( range->base, base );
+    range->end = max( last[-1].end, end );
+    memmove( range + 1, last, (free_ranges_end - last) * sizeof(*range) );
+    free_ranges_end -= last - range - 1;
+}
+
+
+/* return the area covered by a view, rounded to the allocation granularity */
+static void get_view_granularity_range( const struct file_view *view, void **base, void **end )
+{
+    *base = ROUND_ADDR( view->base, granularity_mask );
+    *end = ROUND_ADDR( (char *)view->base + view->size + granularity_mask, granularity_mask );
+    if (!*end) *end = (void *)~(UINT_PTR)0;  /* wrapped around the end of the address space */
+}
+
+
+/***********************************************************************
+ *           free_ranges_insert_view
+ *
+ * Update the free ranges after a view has been created. The csVirtual section must be held by caller.
+ */
+static void free_ranges_insert_view( struct file_view *view )
+{
+    void *base, *end;
+
+    if (!free_ranges) return;
+    get_view_granularity_range( view, &base, &end );
+    free_ranges_remove( base, end );
+}
+
+
+/***********************************************************************
+ *           free_ranges_remove_view
+ *
+ * Update the free ranges before a view is removed from the tree, keeping
+ * the granularity blocks that are still partly used by the adjacent views.
+ * The csVirtual section must be held by caller.
+ */
+static void free_ranges_remove_view( struct file_view *view )
+{
+    struct wine_rb_entry *prev = wine_rb_prev( &view->entry ), *next = wine_rb_next( &view->entry );
+    void *base, *end, *other_base, *other_end;
+
+    if (!free_ranges) return;
+    get_view_granularity_range( view, &base, &end );
+    if (prev)
+    {
+        get_view_granularity_range( WINE_RB_ENTRY_VALUE( prev, struct file_view, entry ), &other_base, &other_end );
+        if (other_end > base) base = other_end;
+    }
+    if (next)
+    {
+        get_view_granularity_range( WINE_RB_ENTRY_VALUE( next, struct file_view, entry ), &other_base, &other_end );
+        if (other_base < end) end = other_base;
+    }
+    if (base < end) free_ranges_add( base, end );
+}
+
+
 /***********************************************************************
  *           find_view_inside_range
  *
@@ -575,9 +773,45 @@ static void* try_map_free_area( void *base, void *end, ptrdiff_t step,
 static void *map_free_area( void *base, void *end, size_t size, size_t mask, int top_down,
                              int unix_prot )
 {
-    struct wine_rb_entry *first = find_view_inside_range( &base, &end, top_down );
+    struct wine_rb_entry *first;
+    struct range_entry *range;
     ptrdiff_t step = top_down ? -(mask + 1) : (mask + 1);
-    void *start;
+    void *start, *range_base, *range_end;
+
+    if (!free_ranges) goto search_views;
+
+    if (top_down)
+    {
+        range = free_ranges_lower_bound( end );
+        if (range == free_ranges_end) range--;
+
+        for ( ; range >= free_ranges && range->end > base; range--)
+        {
+            range_base = max( range->base, base );
+            range_end = min( range->end, end );
+            if (range_base >= range_end || (char *)range_end - (char *)range_base < size) continue;
+            start = ROUND_ADDR( (char *)range_end - size, mask );
+            if (start < range_base) continue;
+            if ((start = try_map_free_area( range_base, range_end, step, start, size, unix_prot )))
+                return start;
+        }
+    }
+    else
+    {
+        for (range = free_ranges_lower_bound( base ); range != free_ranges_end && range->base < end; range++)
+        {
+            range_base = max( range->base, base );
+            range_end = min( range->end, end );
+            start = ROUND_ADDR( (char *)range_base + mask, mask );
+            if (!start || start >= range_end || (char *)range_end - (char *)start < size) continue;
+            if ((start = try_map_free_area( range_base, range_end, step, start, size, unix_prot )))
+                return start;
+        }
+    }
+    return NULL;
+
+search_views:
+    first = find_view_inside_range( &base, &end, top_down );
 
     if (top_down)
     {
@@ -628,8 +862,40 @@ static void *map_free_area( void *base, void *end, size_t size, size_t mask, int
  */
 static void *find_reserved_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
-    struct wine_rb_entry *first = find_view_inside_range( &base, &end, top_down );
-    void *start;
+    struct wine_rb_entry *first;
+    struct range_entry *range;
+    void *start, *range_base, *range_end;
+
+    if (!free_ranges) goto search_views;
+
+    if (top_down)
+    {
+        range = free_ranges_lower_bound( end );
+        if (range == free_ranges_end) range--;
+
+        for ( ; range >= free_ranges && range->end > base; range--)
+        {
+            range_base = max( range->base, base );
+            range_end = min( range->end, end );
+            if (range_base >= range_end || (char *)range_end - (char *)range_base < size) continue;
+            start = ROUND_ADDR( (char *)range_end - size, mask );
+            if (start >= range_base) return start;
+        }
+    }
+    else
+    {
+        for (range = free_ranges_lower_bound( base ); range != free_ranges_end && range->base < end; range++)
+        {
+            range_base = max( range->base, base );
+            range_end = min( range->end, end );
+            start = ROUND_ADDR( (char *)range_base + mask, mask );
+            if (start && start < range_end && (char *)range_end - (char *)start >= size) return start;
+        }
+    }
+    return NULL;
+
+search_views:
+    first = find_view_inside_range( &base, &end, top_down );
 
     if (top_down)
     {
@@ -833,8 +1099,11 @@ static struct file_view *alloc_view(void)
  */
 static void delete_view( struct file_view *view ) /* [in] View */
 {
+    if (view->protect & VPROT_HUGETLB) hugetlb_bytes -= view->size;
+    if (view->protect & VPROT_HUGEPAGE) hugepage_bytes -= view->size;
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
     set_page_vprot( view->base, view->size, 0 );
+    free_ranges_remove_view( view );
     wine_rb_remove( &views_tree, &view->entry );
     *(struct file_view **)view = next_free_view;
     next_free_view = view;
@@ -882,6 +1151,7 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     set_page_vprot( base, size, vprot );
 
     wine_rb_put( &views_tree, view->base, &view->entry );
+    free_ranges_insert_view( view );
 
     *view_ret = view;
 
@@ -1049,6 +1319,20 @@ static BOOL VIRTUAL_SetProt( struct file_view *view, /* [in] Pointer to view */
 }
 
 
+/***********************************************************************
+ *           is_large_page_range
+ *
+ * Check that a range can be changed independently from the rest of the view;
+ * large pages can only be reprotected or decommitted as a whole, as huge page
+ * mappings can't be split.
+ */
+static BOOL is_large_page_range( struct file_view *view, const void *base, size_t size )
+{
+    if (!(view->protect & VPROT_LARGEPAGES)) return TRUE;
+    return !((UINT_PTR)base & (large_page_size - 1)) && !(size & (large_page_size - 1));
+}
+
+
 /***********************************************************************
  *           set_protection
  *
@@ -1070,6 +1354,7 @@ static NTSTATUS set_protection( struct file_view *view, void *base, SIZE_T size,
         if ((view->protect & access) != access) return STATUS_INVALID_PAGE_PROTECTION;
     }
 
+    if (!is_large_page_range( view, base, size )) return STATUS_INVALID_PARAMETER;
     if (!VIRTUAL_SetProt( view, base, size, vprot | VPROT_COMMITTED )) return STATUS_ACCESS_DENIED;
     return STATUS_SUCCESS;
 }
@@ -1294,6 +1579,49 @@ done:
 }
 
 
+/***********************************************************************
+ *           map_large_pages
+ *
+ * Back a newly committed view with huge pages, falling back to transparent
+ * huge pages if the host has no explicit huge pages available.
+ * The csVirtual section must be held by caller.
+ */
+static void map_large_pages( struct file_view *view, unsigned int vprot, BOOL explicit )
+{
+    int prot = VIRTUAL_GetUnixProt( vprot );
+
+    if (explicit) view->protect |= VPROT_LARGEPAGES;
+#ifdef MAP_HUGETLB
+    if (explicit && !((UINT_PTR)view->base & (large_page_size - 1)) && !(view->size & (large_page_size - 1)))
+    {
+        if (mmap( view->base, view->size, prot, MAP_FIXED | MAP_PRIVATE | MAP_ANON | MAP_HUGETLB,
+                  -1, 0 ) == view->base)
+        {
+            view->protect |= VPROT_HUGETLB;
+            hugetlb_bytes += view->size;
+            TRACE( "%p-%p: mapped with huge pages, %lu bytes total\n", view->base,
+                   (char *)view->base + view->size, (unsigned long)hugetlb_bytes );
+            return;
+        }
+        /* the previous mapping may be gone if the huge page mmap failed, restore it */
+        WARN( "%p-%p: no huge pages available (%s)\n", view->base,
+              (char *)view->base + view->size, strerror(errno) );
+        if (wine_anon_mmap( view->base, view->size, prot, MAP_FIXED ) != view->base)
+            ERR( "failed to restore mapping %p-%p\n", view->base, (char *)view->base + view->size );
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (!madvise( view->base, view->size, MADV_HUGEPAGE ))
+    {
+        view->protect |= VPROT_HUGEPAGE;
+        hugepage_bytes += view->size;
+        TRACE( "%p-%p: using transparent huge pages, %lu bytes total\n", view->base,
+               (char *)view->base + view->size, (unsigned long)hugepage_bytes );
+    }
+#endif
+}
+
+
 /***********************************************************************
  *           map_file_into_view
  *
@@ -1409,6 +1737,7 @@ static SIZE_T get_committed_size( struct file_view *view, void *base, BYTE *vpro
  */
 static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t size )
 {
+    if (!is_large_page_range( view, (char *)view->base + start, size )) return STATUS_INVALID_PARAMETER;
     if (wine_anon_mmap( (char *)view->base + start, size, PROT_NONE, MAP_FIXED ) != (void *)-1)
     {
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
@@ -1938,12 +2267,32 @@ static int alloc_virtual_heap( void *base, size_t size, void *arg )
     return (alloc->base != (void *)-1);
 }
 
+/***********************************************************************
+ *           get_large_page_size
+ */
+static size_t get_large_page_size(void)
+{
+#ifdef __linux__
+    unsigned long size = 0;
+    char buffer[128];
+    FILE *f;
+
+    if (!(f = fopen( "/proc/meminfo", "r" ))) return 0;
+    while (fgets( buffer, sizeof(buffer), f ))
+        if (sscanf( buffer, "Hugepagesize: %lu kB", &size ) == 1) break;
+    fclose( f );
+    return size * 1024;
+#else
+    return 0;
+#endif
+}
+
 /***********************************************************************
  *           virtual_init
  */
 void virtual_init(void)
 {
-    const char *preload;
+    const char *preload, *env;
     struct alloc_virtual_heap alloc_views;
     size_t size;
 
@@ -1961,6 +2310,12 @@ void virtual_init(void)
 #endif
     user_space_limit = working_set_limit = address_space_limit;
 #endif
+    if ((large_page_size = get_large_page_size()))
+    {
+        while (((size_t)1 << large_page_shift) < large_page_size) large_page_shift++;
+        /* opt-in transparent huge pages for large committed areas, size in megabytes */
+        if ((env = getenv( "WINEHUGEPAGES" ))) huge_page_min_size = (size_t)strtoul( env, NULL, 10 ) << 20;
+    }
     if ((preload = getenv("WINEPRELOADRESERVE")))
     {
         unsigned long start, end;
@@ -1977,9 +2332,9 @@ void virtual_init(void)
     /* try to find space in a reserved area for the views and pages protection table */
 #ifdef _WIN64
     pages_vprot_size = ((size_t)address_space_limit >> page_shift >> pages_vprot_shift) + 1;
-    alloc_views.size = view_block_size + pages_vprot_size * sizeof(*pages_vprot);
+    alloc_views.size = 2 * view_block_size + pages_vprot_size * sizeof(*pages_vprot);
 #else
-    alloc_views.size = view_block_size + (1U << (32 - page_shift));
+    alloc_views.size = 2 * view_block_size + (1U << (32 - page_shift));
 #endif
     if (wine_mmap_enum_reserved_areas( alloc_virtual_heap, &alloc_views, 1 ))
         wine_mmap_remove_reserved_area( alloc_views.base, alloc_views.size, 0 );
@@ -1989,9 +2344,16 @@ void virtual_init(void)
     assert( alloc_views.base != (void *)-1 );
     view_block_start = alloc_views.base;
     view_block_end = view_block_start + view_block_size / sizeof(*view_block_start);
-    pages_vprot = (void *)((char *)alloc_views.base + view_block_size);
+    free_ranges = (void *)((char *)alloc_views.base + view_block_size);
+    free_ranges_size = view_block_size / sizeof(*free_ranges);
+    pages_vprot = (void *)((char *)alloc_views.base + 2 * view_block_size);
     wine_rb_init( &views_tree, compare_view );
 
+    /* initially the whole address space is free */
+    free_ranges[0].base = (void *)0;
+    free_ranges[0].end = (void *)~(UINT_PTR)0;
+    free_ranges_end = free_ranges + 1;
+
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
     size = (char *)address_space_start - (char *)0x10000;
     if (size && wine_mmap_is_in_reserved_area( (void*)0x10000, size ) == 1)
@@ -2008,6 +2370,15 @@ void virtual_init_threading(void)
 }
 
 
+/***********************************************************************
+ *           virtual_get_large_page_minimum
+ */
+SIZE_T virtual_get_large_page_minimum(void)
+{
+    return large_page_size;
+}
+
+
 /***********************************************************************
  *           virtual_get_system_info
  */
@@ -2720,7 +3091,7 @@ NTSTATUS virtual_alloc_aligned( PVOID *ret, unsigned short zero_bits_64, SIZE_T
     unsigned int vprot;
     SIZE_T size = *size_ptr;
     NTSTATUS status = STATUS_SUCCESS;
-    BOOL is_dos_memory = FALSE;
+    BOOL is_dos_memory = FALSE, huge_pages = FALSE;
     struct file_view *view;
     sigset_t sigset;
 
@@ -2755,12 +3126,31 @@ NTSTATUS virtual_alloc_aligned( PVOID *ret, unsigned short zero_bits_64, SIZE_T
     /* Compute the alloc type flags */
 
     if (!(type & (MEM_COMMIT | MEM_RESERVE | MEM_RESET)) ||
-        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET)))
+        (type & ~(MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET | MEM_LARGE_PAGES)))
     {
         WARN("called with wrong alloc type flags (%08x) !\n", type);
         return STATUS_INVALID_PARAMETER;
     }
 
+    if (type & MEM_LARGE_PAGES)
+    {
+        /* large pages must be reserved and committed at once, in multiples of the large page size */
+        if (!large_page_size || (type & (MEM_COMMIT | MEM_RESERVE)) != (MEM_COMMIT | MEM_RESERVE) ||
+            (type & MEM_WRITE_WATCH) || ((UINT_PTR)base & (large_page_size - 1)) ||
+            (size & (large_page_size - 1)))
+        {
+            WARN("invalid large page allocation %p %08lx %08x\n", base, size, type);
+            return STATUS_INVALID_PARAMETER;
+        }
+        huge_pages = TRUE;
+    }
+    else if (huge_page_min_size && size >= huge_page_min_size &&
+             (type & (MEM_COMMIT | MEM_RESERVE)) == (MEM_COMMIT | MEM_RESERVE))
+        huge_pages = TRUE;
+
+    /* align huge page areas so that they can be entirely backed by huge pages */
+    if (huge_pages && !base && !alignment) alignment = min( large_page_shift, 21 );
+
     /* Reserve the memory */
 
     if (use_locks) server_enter_uninterrupted_section( &csVirtual, &sigset );
@@ -2777,7 +3167,11 @@ NTSTATUS virtual_alloc_aligned( PVOID *ret, unsigned short zero_bits_64, SIZE_T
             else if (is_dos_memory) status = allocate_dos_memory( &view, vprot );
             else status = map_view( &view, base, size, alignment, type & MEM_TOP_DOWN, vprot, zero_bits_64 );
 
-            if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS)
+            {
+                if (huge_pages) map_large_pages( view, vprot, type & MEM_LARGE_PAGES );
+                base = view->base;
+            }
         }
     }
     else if (type & MEM_RESET)
@@ -3181,6 +3575,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.ShareCount = 1; /* FIXME */
             if (p->VirtualAttributes.Valid)
                 p->VirtualAttributes.Win32Protection = VIRTUAL_GetWin32Prot( vprot, view->protect );
+            p->VirtualAttributes.LargePage = !!(view->protect & VPROT_HUGETLB);
         }
     }
     server_leave_uninterrupted_section( &csVirtual, &sigset );
@@ -179,6 +179,19 @@ static HRESULT push_instr_int(compile_ctx_t *ctx, vbsop_t op, LONG arg)
     return S_OK;
 }
 
+static HRESULT push_instr_int_uint(compile_ctx_t *ctx, vbsop_t op, LONG arg1, unsigned arg2)
+{
+    unsigned ret;
+
+    ret = push_instr(ctx, op);
+    if(!ret)
+        return E_OUTOFMEMORY;
+
+    instr_ptr(ctx, ret)->arg1.lng = arg1;
+    instr_ptr(ctx, ret)->arg2.uint = arg2;
+    return S_OK;
+}
+
 static HRESULT push_instr_uint(compile_ctx_t *ctx, vbsop_t op, unsigned arg)
 {
     unsigned ret;
@@ -427,9 +440,44 @@ static HRESULT compile_args(compile_ctx_t *ctx, expression_t *args, unsigned *re
     return S_OK;
 }
 
+/*
+ * Binds an identifier to a local variable (index >= 0) or an argument (index < 0) of the
+ * function being compiled. Those are looked up before anything else, so the binding can't
+ * change at run time. Variables declared after the reference are left to run time lookup.
+ */
+static BOOL bind_local(compile_ctx_t *ctx, const WCHAR *name, int *ret)
+{
+    dim_decl_t *dim_decl;
+    unsigned i;
+
+    if(ctx->func->type == FUNC_GLOBAL)
+        return FALSE;
+
+    if((ctx->func->type == FUNC_FUNCTION || ctx->func->type == FUNC_PROPGET || ctx->func->type == FUNC_DEFGET)
+       && !wcsicmp(name, ctx->func->name))
+        return FALSE;
+
+    for(dim_decl = ctx->dim_decls, i = 0; dim_decl; dim_decl = dim_decl->next, i++) {
+        if(!wcsicmp(dim_decl->name, name)) {
+            *ret = i;
+            return TRUE;
+        }
+    }
+
+    for(i = 0; i < ctx->func->arg_cnt; i++) {
+        if(!wcsicmp(ctx->func->args[i].name, name)) {
+            *ret = -(int)i - 1;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 static HRESULT compile_member_expression(compile_ctx_t *ctx, member_expression_t *expr, unsigned arg_cnt, BOOL ret_val)
 {
     HRESULT hres;
+    int local;
 
     if(ret_val && !arg_cnt) {
         expression_t *const_expr;
@@ -437,6 +485,9 @@ static HRESULT compile_member_expression(compile_ctx_t *ctx, member_expression_t
         const_expr = lookup_const_decls(ctx, expr->identifier, TRUE);
         if(const_expr)
             return compile_expression(ctx, const_expr);
+
+        if(!expr->obj_expr && bind_local(ctx, expr->identifier, &local))
+            return push_instr_int(ctx, OP_local, local);
     }
 
     if(expr->obj_expr) {
@@ -998,6 +1049,8 @@ static HRESULT compile_assignment(compile_ctx_t *ctx, expression_t *left, expres
     call_expression_t *call_expr = NULL;
     member_expression_t *member_expr;
     unsigned args_cnt = 0;
+    BOOL is_local = FALSE;
+    int local;
     vbsop_t op;
     HRESULT hres;
 
@@ -1021,6 +1074,9 @@ static HRESULT compile_assignment(compile_ctx_t *ctx, expression_t *left, expres
             return hres;
 
         op = is_set ? OP_set_member : OP_assign_member;
+    }else if(bind_local(ctx, member_expr->identifier, &local)) {
+        op = is_set ? OP_set_local : OP_assign_local;
+        is_local = TRUE;
     }else {
         op = is_set ? OP_set_ident : OP_assign_ident;
     }
@@ -1035,7 +1091,10 @@ static HRESULT compile_assignment(compile_ctx_t *ctx, expression_t *left, expres
             return hres;
     }
 
-    hres = push_instr_bstr_uint(ctx, op, member_expr->identifier, args_cnt);
+    if(is_local)
+        hres = push_instr_int_uint(ctx, op, local, args_cnt);
+    else
+        hres = push_instr_bstr_uint(ctx, op, member_expr->identifier, args_cnt);
     if(FAILED(hres))
         return hres;
 
@@ -1791,15 +1850,8 @@ static BOOL lookup_script_identifier(compile_ctx_t *ctx, script_ctx_t *script, c
     for(c = 0; c < ARRAY_SIZE(contexts); c++) {
         if(!contexts[c]) continue;
 
-        for(i = 0; i < contexts[c]->global_vars_cnt; i++) {
-            if(!wcsicmp(contexts[c]->global_vars[i]->name, identifier))
-                return TRUE;
-        }
-
-        for(i = 0; i < contexts[c]->global_funcs_cnt; i++) {
-            if(!wcsicmp(contexts[c]->global_funcs[i]->name, identifier))
-                return TRUE;
-        }
+        if(find_global_var(contexts[c], identifier, &i) || find_global_func(contexts[c], identifier, &i))
+            return TRUE;
 
         for(class = contexts[c]->classes; class; class = class->next) {
             if(!wcsicmp(class->name, identifier))
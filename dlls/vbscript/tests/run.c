@@ -3219,6 +3219,70 @@ static void run_tests(void)
     test_multiple_parse();
 }
 
+static void run_benchmark(const char *name, const char *src)
+{
+    DWORD start, end;
+
+    start = GetTickCount();
+    parse_script_a(src);
+    end = GetTickCount();
+
+    trace("%s ran in %u ms\n", name, end - start);
+}
+
+static void run_benchmarks(void)
+{
+    char *src, *ptr;
+    unsigned i;
+
+    static const char globals_loop[] =
+        "g5000 = 1\n"
+        "For i = 1 To 100000\n"
+        "    g0 = g0 + 1\n"
+        "    g9999 = g9999 + g5000\n"
+        "Next\n"
+        "Call ok(g0 = 100000, \"g0 = \" & g0)\n"
+        "Call ok(g9999 = 100000, \"g9999 = \" & g9999)\n"
+        "Function bumpGlobals(n)\n"
+        "    Dim j\n"
+        "    For j = 1 To n\n"
+        "        g1 = g1 + g5000\n"
+        "        Call g2func()\n"
+        "    Next\n"
+        "End Function\n"
+        "Sub g2func()\n"
+        "    g2 = g2 + 1\n"
+        "End Sub\n"
+        "Call bumpGlobals(100000)\n"
+        "Call ok(g1 = 100000, \"g1 = \" & g1)\n"
+        "Call ok(g2 = 100000, \"g2 = \" & g2)\n";
+
+    static const char locals_loop[] =
+        "Function sumTo(n)\n"
+        "    Dim i, x\n"
+        "    x = 0\n"
+        "    For i = 1 To n\n"
+        "        x = x + i\n"
+        "    Next\n"
+        "    sumTo = x\n"
+        "End Function\n"
+        "Dim s\n"
+        "s = sumTo(300000)\n"
+        "Call ok(s = 45000150000, \"s = \" & s)\n";
+
+    trace("Running benchmarks...\n");
+
+    /* A large classic ASP style script with 10000 global variables. */
+    src = ptr = HeapAlloc(GetProcessHeap(), 0, 10000 * 16 + sizeof(globals_loop));
+    for(i = 0; i < 10000; i++)
+        ptr += sprintf(ptr, "Dim g%u\n", i);
+    strcpy(ptr, globals_loop);
+    run_benchmark("globals", src);
+    HeapFree(GetProcessHeap(), 0, src);
+
+    run_benchmark("locals", locals_loop);
+}
+
 static BOOL check_vbscript(void)
 {
     IRegExp2 *regexp;
@@ -3261,6 +3325,8 @@ START_TEST(run)
         run_from_file(argv[2]);
     }else {
         run_tests();
+        if(winetest_interactive || winetest_benchmark)
+            run_benchmarks();
     }
 
     CoUninitialize();
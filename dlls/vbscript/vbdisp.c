@@ -1256,6 +1256,8 @@ static ULONG WINAPI ScriptDisp_Release(IDispatchEx *iface)
         heap_pool_free(&This->heap);
         heap_free(This->global_vars);
         heap_free(This->global_funcs);
+        heap_free(This->global_vars_hash.buckets);
+        heap_free(This->global_funcs_hash.buckets);
         heap_free(This);
     }
 
@@ -1362,18 +1364,14 @@ static HRESULT WINAPI ScriptDisp_GetDispID(IDispatchEx *iface, BSTR bstrName, DW
     if(!This->ctx)
         return E_UNEXPECTED;
 
-    for(i = 0; i < This->global_vars_cnt; i++) {
-        if(!wcsicmp(This->global_vars[i]->name, bstrName)) {
-            *pid = i + 1;
-            return S_OK;
-        }
+    if(find_global_var(This, bstrName, &i)) {
+        *pid = i + 1;
+        return S_OK;
     }
 
-    for(i = 0; i < This->global_funcs_cnt; i++) {
-        if(!wcsicmp(This->global_funcs[i]->name, bstrName)) {
-            *pid = i + 1 + DISPID_FUNCTION_MASK;
-            return S_OK;
-        }
+    if(find_global_func(This, bstrName, &i)) {
+        *pid = i + 1 + DISPID_FUNCTION_MASK;
+        return S_OK;
     }
 
     *pid = -1;
@@ -1483,6 +1481,137 @@ static IDispatchExVtbl ScriptDispVtbl = {
     ScriptDisp_GetNameSpaceParent
 };
 
+static unsigned hash_global_name(const WCHAR *name)
+{
+    unsigned h = 0;
+
+    for(; *name; name++)
+        h = (h>>(sizeof(unsigned)*8-4)) ^ (h<<4) ^ towlower(*name);
+    return h;
+}
+
+static inline const WCHAR *global_name(ScriptDisp *obj, BOOL is_func, unsigned idx)
+{
+    return is_func ? obj->global_funcs[idx]->name : obj->global_vars[idx]->name;
+}
+
+static BOOL find_global(ScriptDisp *obj, BOOL is_func, const WCHAR *name, unsigned *ret)
+{
+    global_hash_t *hash = is_func ? &obj->global_funcs_hash : &obj->global_vars_hash;
+    unsigned i, idx;
+
+    if(!hash->size)
+        return FALSE;
+
+    for(i = hash_global_name(name) & (hash->size-1); (idx = hash->buckets[i]); i = (i+1) & (hash->size-1)) {
+        if(!wcsicmp(global_name(obj, is_func, idx-1), name)) {
+            *ret = idx-1;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void insert_global_hash(global_hash_t *hash, const WCHAR *name, unsigned idx)
+{
+    unsigned i;
+
+    for(i = hash_global_name(name) & (hash->size-1); hash->buckets[i]; i = (i+1) & (hash->size-1));
+    hash->buckets[i] = idx+1;
+}
+
+/* Adds the last entry of global_vars or global_funcs to its hash table, growing it if needed. */
+static BOOL add_global_hash(ScriptDisp *obj, BOOL is_func)
+{
+    global_hash_t *hash = is_func ? &obj->global_funcs_hash : &obj->global_vars_hash;
+    size_t cnt = is_func ? obj->global_funcs_cnt : obj->global_vars_cnt;
+    unsigned *buckets, size, i;
+
+    if(cnt * 2 <= hash->size) {
+        insert_global_hash(hash, global_name(obj, is_func, cnt-1), cnt-1);
+        return TRUE;
+    }
+
+    size = hash->size ? hash->size * 2 : 32;
+    buckets = heap_alloc_zero(size * sizeof(*buckets));
+    if(!buckets)
+        return FALSE;
+
+    heap_free(hash->buckets);
+    hash->buckets = buckets;
+    hash->size = size;
+    for(i = 0; i < cnt; i++)
+        insert_global_hash(hash, global_name(obj, is_func, i), i);
+    return TRUE;
+}
+
+BOOL find_global_var(ScriptDisp *obj, const WCHAR *name, unsigned *ret)
+{
+    return find_global(obj, FALSE, name, ret);
+}
+
+BOOL find_global_func(ScriptDisp *obj, const WCHAR *name, unsigned *ret)
+{
+    return find_global(obj, TRUE, name, ret);
+}
+
+HRESULT add_global_var(ScriptDisp *obj, dynamic_var_t *var)
+{
+    if(obj->global_vars_cnt == obj->global_vars_size) {
+        dynamic_var_t **new_vars;
+        size_t size = obj->global_vars_size ? obj->global_vars_size * 2 : 16;
+
+        if(obj->global_vars)
+            new_vars = heap_realloc(obj->global_vars, size * sizeof(*new_vars));
+        else
+            new_vars = heap_alloc(size * sizeof(*new_vars));
+        if(!new_vars)
+            return E_OUTOFMEMORY;
+        obj->global_vars = new_vars;
+        obj->global_vars_size = size;
+    }
+
+    obj->global_vars[obj->global_vars_cnt++] = var;
+    if(!add_global_hash(obj, FALSE)) {
+        obj->global_vars_cnt--;
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+/* Adds a global function, replacing an existing function of the same name. */
+HRESULT add_global_func(ScriptDisp *obj, function_t *func)
+{
+    unsigned i;
+
+    if(find_global(obj, TRUE, func->name, &i)) {
+        obj->global_funcs[i] = func;
+        return S_OK;
+    }
+
+    if(obj->global_funcs_cnt == obj->global_funcs_size) {
+        function_t **new_funcs;
+        size_t size = obj->global_funcs_size ? obj->global_funcs_size * 2 : 16;
+
+        if(obj->global_funcs)
+            new_funcs = heap_realloc(obj->global_funcs, size * sizeof(*new_funcs));
+        else
+            new_funcs = heap_alloc(size * sizeof(*new_funcs));
+        if(!new_funcs)
+            return E_OUTOFMEMORY;
+        obj->global_funcs = new_funcs;
+        obj->global_funcs_size = size;
+    }
+
+    obj->global_funcs[obj->global_funcs_cnt++] = func;
+    if(!add_global_hash(obj, TRUE)) {
+        obj->global_funcs_cnt--;
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
 HRESULT create_script_disp(script_ctx_t *ctx, ScriptDisp **ret)
 {
     ScriptDisp *script_disp;
@@ -42,6 +42,7 @@ static HMODULE vcomp_module;
 static int     vcomp_max_threads;
 static int     vcomp_num_threads;
 static BOOL    vcomp_nested_fork = FALSE;
+static int     vcomp_spin_count;
 
 static RTL_CRITICAL_SECTION vcomp_section;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -57,6 +58,12 @@ static RTL_CRITICAL_SECTION vcomp_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 #define VCOMP_DYNAMIC_FLAGS_GUIDED      0x03
 #define VCOMP_DYNAMIC_FLAGS_INCREMENT   0x40
 
+/* number of small_pause() iterations before waiting threads go to sleep */
+#define VCOMP_SPIN_COUNT                4000
+
+/* counter value of a work sharing state which is being initialized */
+#define VCOMP_STATE_INIT                0xffffffff
+
 struct vcomp_thread_data
 {
     struct vcomp_team_data  *team;
@@ -94,22 +101,26 @@ struct vcomp_team_data
     __ms_va_list            valist;
 
     /* barrier */
-    unsigned int            barrier;
-    int                     barrier_count;
+    LONG                    barrier;
+    LONG                    barrier_count;
+    LONG                    barrier_waiters;
 };
 
+/* The section and dynamic states hold the generation of the construct in the
+ * high and the number of dispensed sections or iterations in the low 32 bits,
+ * so that threads still busy with an older construct can't take work from a
+ * newer one. */
 struct vcomp_task_data
 {
     /* single */
-    unsigned int            single;
+    LONG                    single;
 
     /* section */
-    unsigned int            section;
+    LONG64                  section;
     int                     num_sections;
-    int                     section_index;
 
     /* dynamic */
-    unsigned int            dynamic;
+    LONG64                  dynamic;
     unsigned int            dynamic_first;
     unsigned int            dynamic_last;
     unsigned int            dynamic_iterations;
@@ -420,6 +431,88 @@ static void vcomp_free_thread_data(void)
     vcomp_set_thread_data(NULL);
 }
 
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+static inline LONG64 vcomp_state_read(LONG64 *state)
+{
+#ifdef __x86_64__
+    return *(volatile LONG64 *)state;
+#else
+    return InterlockedCompareExchange64(state, 0, 0);
+#endif
+}
+
+static inline unsigned int vcomp_state_gen(LONG64 state)
+{
+    return (ULONG64)state >> 32;
+}
+
+static inline unsigned int vcomp_state_count(LONG64 state)
+{
+    return (unsigned int)state;
+}
+
+static inline LONG64 vcomp_make_state(unsigned int gen, unsigned int count)
+{
+    return ((ULONG64)gen << 32) | count;
+}
+
+/* Returns TRUE if the caller is the first thread to reach construct gen. It
+ * then has to initialize the construct and call vcomp_state_publish. */
+static BOOL vcomp_state_claim(LONG64 *state, unsigned int gen)
+{
+    LONG64 prev, old = vcomp_state_read(state);
+
+    while ((int)(gen - vcomp_state_gen(old)) > 0)
+    {
+        prev = InterlockedCompareExchange64(state, vcomp_make_state(gen, VCOMP_STATE_INIT), old);
+        if (prev == old) return TRUE;
+        old = prev;
+    }
+    return FALSE;
+}
+
+static inline void vcomp_state_publish(LONG64 *state, unsigned int gen)
+{
+    InterlockedCompareExchange64(state, vcomp_make_state(gen, 0), vcomp_make_state(gen, VCOMP_STATE_INIT));
+}
+
+/* Waits for construct gen to be initialized, returns FALSE if the state
+ * already belongs to another construct. */
+static BOOL vcomp_state_get(LONG64 *state, unsigned int gen, LONG64 *ret)
+{
+    int i = 0;
+
+    for (;;)
+    {
+        *ret = vcomp_state_read(state);
+        if (vcomp_state_gen(*ret) != gen) return FALSE;
+        if (vcomp_state_count(*ret) != VCOMP_STATE_INIT) return TRUE;
+        if (i++ < vcomp_spin_count) small_pause();
+        else SwitchToThread();
+    }
+}
+
+/* Spins for a short while as long as *ptr == val, returns TRUE if it changed. */
+static BOOL vcomp_spin_wait(LONG *ptr, LONG val)
+{
+    int i;
+
+    for (i = 0; i < vcomp_spin_count; i++)
+    {
+        if (*(volatile LONG *)ptr != val) return TRUE;
+        small_pause();
+    }
+    return *(volatile LONG *)ptr != val;
+}
+
 void CDECL _vcomp_atomic_add_i1(char *dest, char val)
 {
     interlocked_xchg_add8(dest, val);
@@ -1041,25 +1134,37 @@ void CDECL _vcomp_flush(void)
 void CDECL _vcomp_barrier(void)
 {
     struct vcomp_team_data *team_data = vcomp_init_thread_data()->team;
+    LONG barrier;
 
     TRACE("()\n");
 
     if (!team_data)
         return;
 
-    EnterCriticalSection(&vcomp_section);
-    if (++team_data->barrier_count >= team_data->num_threads)
+    /* The last thread to arrive resets the counter and starts a new barrier
+     * generation. Waiting threads spin on the generation before sleeping. */
+    barrier = *(volatile LONG *)&team_data->barrier;
+    if (InterlockedIncrement(&team_data->barrier_count) >= team_data->num_threads)
     {
-        team_data->barrier++;
         team_data->barrier_count = 0;
-        WakeAllConditionVariable(&team_data->cond);
-    }
-    else
-    {
-        unsigned int barrier = team_data->barrier;
-        while (team_data->barrier == barrier)
-            SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
+        InterlockedIncrement(&team_data->barrier);
+        if (*(volatile LONG *)&team_data->barrier_waiters)
+        {
+            EnterCriticalSection(&vcomp_section);
+            WakeAllConditionVariable(&team_data->cond);
+            LeaveCriticalSection(&vcomp_section);
+        }
+        return;
     }
+
+    if (vcomp_spin_wait(&team_data->barrier, barrier))
+        return;
+
+    EnterCriticalSection(&vcomp_section);
+    InterlockedIncrement(&team_data->barrier_waiters);
+    while (team_data->barrier == barrier)
+        SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
+    InterlockedDecrement(&team_data->barrier_waiters);
     LeaveCriticalSection(&vcomp_section);
 }
 
@@ -1086,20 +1191,20 @@ int CDECL _vcomp_single_begin(int flags)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int ret = FALSE;
+    LONG prev, single;
 
     TRACE("(%x): semi-stub\n", flags);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->single++;
-    if ((int)(thread_data->single - task_data->single) > 0)
+    single = *(volatile LONG *)&task_data->single;
+    while ((int)(thread_data->single - single) > 0)
     {
-        task_data->single = thread_data->single;
-        ret = TRUE;
+        prev = InterlockedCompareExchange(&task_data->single, thread_data->single, single);
+        if (prev == single) return TRUE;
+        single = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
 
-    return ret;
+    return FALSE;
 }
 
 void CDECL _vcomp_single_end(void)
@@ -1115,33 +1220,39 @@ void CDECL _vcomp_sections_init(int n)
 
     TRACE("(%d)\n", n);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->section++;
-    if ((int)(thread_data->section - task_data->section) > 0)
+    if (vcomp_state_claim(&task_data->section, thread_data->section))
     {
-        task_data->section       = thread_data->section;
-        task_data->num_sections  = n;
-        task_data->section_index = 0;
+        task_data->num_sections = n;
+        vcomp_state_publish(&task_data->section, thread_data->section);
     }
-    LeaveCriticalSection(&vcomp_section);
 }
 
 int CDECL _vcomp_sections_next(void)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int i = -1;
+    LONG64 prev, state;
+    int num_sections;
 
     TRACE("()\n");
 
-    EnterCriticalSection(&vcomp_section);
-    if (thread_data->section == task_data->section &&
-        task_data->section_index != task_data->num_sections)
+    if (!vcomp_state_get(&task_data->section, thread_data->section, &state))
+        return -1;
+
+    for (;;)
     {
-        i = task_data->section_index++;
+        num_sections = task_data->num_sections;
+        if ((int)vcomp_state_count(state) >= num_sections)
+            return -1;
+
+        prev = InterlockedCompareExchange64(&task_data->section, state + 1, state);
+        if (prev == state)
+            return vcomp_state_count(state);
+        if (vcomp_state_gen(prev) != thread_data->section)
+            return -1;
+        state = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-    return i;
 }
 
 void CDECL _vcomp_for_static_simple_init(unsigned int first, unsigned int last, int step,
@@ -1326,19 +1437,17 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
             type = VCOMP_DYNAMIC_FLAGS_GUIDED;
         }
 
-        EnterCriticalSection(&vcomp_section);
         thread_data->dynamic++;
         thread_data->dynamic_type = type;
-        if ((int)(thread_data->dynamic - task_data->dynamic) > 0)
+        if (vcomp_state_claim(&task_data->dynamic, thread_data->dynamic))
         {
-            task_data->dynamic              = thread_data->dynamic;
             task_data->dynamic_first        = first;
             task_data->dynamic_last         = last;
             task_data->dynamic_iterations   = iterations;
             task_data->dynamic_step         = step;
             task_data->dynamic_chunksize    = chunksize;
+            vcomp_state_publish(&task_data->dynamic, thread_data->dynamic);
         }
-        LeaveCriticalSection(&vcomp_section);
     }
 }
 
@@ -1361,26 +1470,49 @@ int CDECL _vcomp_for_dynamic_next(unsigned int *begin, unsigned int *end)
     else if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_CHUNKED ||
              thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED)
     {
-        unsigned int iterations = 0;
-        EnterCriticalSection(&vcomp_section);
-        if (thread_data->dynamic == task_data->dynamic &&
-            task_data->dynamic_iterations != 0)
+        unsigned int first, last, total, chunksize, done, remaining, iterations;
+        LONG64 prev, state;
+        int step;
+
+        if (!vcomp_state_get(&task_data->dynamic, thread_data->dynamic, &state))
+            return 0;
+
+        for (;;)
         {
-            iterations = min(task_data->dynamic_iterations, task_data->dynamic_chunksize);
+            /* the parameters are only valid if the state is unchanged */
+            first       = task_data->dynamic_first;
+            last        = task_data->dynamic_last;
+            total       = task_data->dynamic_iterations;
+            step        = task_data->dynamic_step;
+            chunksize   = task_data->dynamic_chunksize;
+
+            done = vcomp_state_count(state);
+            if (done >= total)
+                return 0;
+
+            remaining  = total - done;
+            iterations = min(remaining, chunksize);
             if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED &&
-                task_data->dynamic_iterations > num_threads * task_data->dynamic_chunksize)
+                remaining > num_threads * chunksize)
             {
-                iterations = (task_data->dynamic_iterations + num_threads - 1) / num_threads;
+                iterations = (remaining + num_threads - 1) / num_threads;
             }
-            *begin = task_data->dynamic_first;
-            *end   = task_data->dynamic_first + (iterations - 1) * task_data->dynamic_step;
-            task_data->dynamic_iterations -= iterations;
-            task_data->dynamic_first      += iterations * task_data->dynamic_step;
-            if (!task_data->dynamic_iterations)
-                *end = task_data->dynamic_last;
+            if (!iterations)
+                return 0;
+
+            prev = InterlockedCompareExchange64(&task_data->dynamic, state + iterations, state);
+            if (prev == state)
+                break;
+            if (vcomp_state_gen(prev) != thread_data->dynamic)
+                return 0;
+            state = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
-        return iterations != 0;
+
+        *begin = first + done * step;
+        *end   = *begin + (iterations - 1) * step;
+        if (done + iterations == total)
+            *end = last;
+        return 1;
     }
 
     return 0;
@@ -1395,6 +1527,8 @@ int CDECL omp_in_parallel(void)
 static DWORD WINAPI _vcomp_fork_worker(void *param)
 {
     struct vcomp_thread_data *thread_data = param;
+    int i;
+
     vcomp_set_thread_data(thread_data);
 
     TRACE("starting worker thread for %p\n", thread_data);
@@ -1414,6 +1548,17 @@ static DWORD WINAPI _vcomp_fork_worker(void *param)
             list_add_tail(&vcomp_idle_threads, &thread_data->entry);
             if (++team->finished_threads >= team->num_threads)
                 WakeAllConditionVariable(&team->cond);
+
+            /* parallel regions often follow each other closely, spin for
+             * a while before going to sleep */
+            LeaveCriticalSection(&vcomp_section);
+            for (i = 0; i < vcomp_spin_count; i++)
+            {
+                if (*(struct vcomp_team_data * volatile *)&thread_data->team) break;
+                small_pause();
+            }
+            EnterCriticalSection(&vcomp_section);
+            if (thread_data->team) continue;
         }
 
         if (!SleepConditionVariableCS(&thread_data->cond, &vcomp_section, 5000) &&
@@ -1461,6 +1606,7 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     __ms_va_start(team_data.valist, wrapper);
     team_data.barrier           = 0;
     team_data.barrier_count     = 0;
+    team_data.barrier_waiters   = 0;
 
     task_data.single            = 0;
     task_data.section           = 0;
@@ -1546,6 +1692,14 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
 
     if (team_data.num_threads > 1)
     {
+        int i;
+
+        for (i = 0; i < vcomp_spin_count; i++)
+        {
+            if (*(volatile int *)&team_data.finished_threads >= team_data.num_threads - 1) break;
+            small_pause();
+        }
+
         EnterCriticalSection(&vcomp_section);
 
         team_data.finished_threads++;
@@ -1680,6 +1834,7 @@ BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved)
             vcomp_module      = instance;
             vcomp_max_threads = sysinfo.dwNumberOfProcessors;
             vcomp_num_threads = sysinfo.dwNumberOfProcessors;
+            vcomp_spin_count  = sysinfo.dwNumberOfProcessors > 1 ? VCOMP_SPIN_COUNT : 0;
             break;
         }
 
@@ -1315,6 +1315,45 @@ static void test_vcomp_for_dynamic_init(void)
     pomp_set_num_threads(max_threads);
 }
 
+static void CDECL for_dynamic_nowait_cb(LONG *counts)
+{
+    unsigned int begin, end, i;
+    int loop;
+
+    /* consecutive loops without a barrier in between */
+    for (loop = 0; loop < 100; loop++)
+    {
+        p_vcomp_for_dynamic_init((loop & 1 ? VCOMP_DYNAMIC_FLAGS_GUIDED : VCOMP_DYNAMIC_FLAGS_CHUNKED) |
+                                 VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, 99, 1, 1 + loop % 3);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+        {
+            for (i = begin; i <= end; i++)
+                InterlockedIncrement(&counts[loop * 100 + i]);
+        }
+    }
+}
+
+static void test_vcomp_for_dynamic_nowait(void)
+{
+    int max_threads = pomp_get_max_threads();
+    static LONG counts[100 * 100];
+    int i, j;
+
+    for (i = 1; i <= 4; i++)
+    {
+        pomp_set_num_threads(i);
+
+        memset(counts, 0, sizeof(counts));
+        p_vcomp_fork(TRUE, 1, for_dynamic_nowait_cb, counts);
+        for (j = 0; j < ARRAY_SIZE(counts); j++)
+            if (counts[j] != 1) break;
+        ok(j == ARRAY_SIZE(counts), "%d threads: iteration %d of loop %d run %d times\n",
+           i, j % 100, j / 100, j < ARRAY_SIZE(counts) ? counts[j] : 0);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 static void CDECL master_cb(HANDLE semaphore)
 {
     int num_threads = pomp_get_num_threads();
@@ -2209,6 +2248,105 @@ static void test_reduction_float_double(void)
     }
 }
 
+/* EPCC-style synchronization and scheduling microbenchmarks */
+
+#define BENCH_REPS 10000
+
+static void CDECL empty_cb(void)
+{
+}
+
+static void CDECL barrier_bench_cb(void)
+{
+    int i;
+
+    for (i = 0; i < BENCH_REPS; i++)
+        p_vcomp_barrier();
+}
+
+static void CDECL single_bench_cb(LONG *count)
+{
+    int i;
+
+    for (i = 0; i < BENCH_REPS; i++)
+    {
+        if (p_vcomp_single_begin(0))
+            InterlockedIncrement(count);
+        p_vcomp_single_end();
+        p_vcomp_barrier();
+    }
+}
+
+static void CDECL sched_bench_cb(unsigned int flags, LONG *count)
+{
+    unsigned int begin, end;
+    int i;
+
+    for (i = 0; i < 10; i++)
+    {
+        p_vcomp_for_dynamic_init(flags | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, BENCH_REPS - 1, 1, 1);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+            InterlockedExchangeAdd(count, end - begin + 1);
+        p_vcomp_barrier();
+    }
+}
+
+static double bench_elapsed_us(LARGE_INTEGER *start)
+{
+    LARGE_INTEGER end, freq;
+
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&freq);
+    return (end.QuadPart - start->QuadPart) * 1000000.0 / freq.QuadPart;
+}
+
+static void test_benchmarks(void)
+{
+    int max_threads = pomp_get_max_threads();
+    LARGE_INTEGER start;
+    LONG count;
+    int i, n;
+
+    if (!winetest_benchmark)
+        return;
+
+    for (n = 1;; n = min(n * 2, max_threads))
+    {
+        pomp_set_num_threads(n);
+
+        QueryPerformanceCounter(&start);
+        for (i = 0; i < BENCH_REPS / 10; i++)
+            p_vcomp_fork(TRUE, 0, empty_cb);
+        trace("%d threads: parallel %.3f us\n", n, bench_elapsed_us(&start) / (BENCH_REPS / 10));
+
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 0, barrier_bench_cb);
+        trace("%d threads: barrier %.3f us\n", n, bench_elapsed_us(&start) / BENCH_REPS);
+
+        count = 0;
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 1, single_bench_cb, &count);
+        trace("%d threads: single %.3f us\n", n, bench_elapsed_us(&start) / BENCH_REPS);
+        ok(count == BENCH_REPS, "expected count == %d, got %d\n", BENCH_REPS, count);
+
+        count = 0;
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 2, sched_bench_cb, VCOMP_DYNAMIC_FLAGS_CHUNKED, &count);
+        trace("%d threads: dynamic,1 %.3f us per iteration\n", n, bench_elapsed_us(&start) / (BENCH_REPS * 10));
+        ok(count == BENCH_REPS * 10, "expected count == %d, got %d\n", BENCH_REPS * 10, count);
+
+        count = 0;
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 2, sched_bench_cb, VCOMP_DYNAMIC_FLAGS_GUIDED, &count);
+        trace("%d threads: guided,1 %.3f us per iteration\n", n, bench_elapsed_us(&start) / (BENCH_REPS * 10));
+        ok(count == BENCH_REPS * 10, "expected count == %d, got %d\n", BENCH_REPS * 10, count);
+
+        if (n == max_threads) break;
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 START_TEST(vcomp)
 {
     if (!init_vcomp())
@@ -2221,6 +2359,7 @@ START_TEST(vcomp)
     test_vcomp_for_static_simple_init();
     test_vcomp_for_static_init();
     test_vcomp_for_dynamic_init();
+    test_vcomp_for_dynamic_nowait();
     test_vcomp_master_begin();
     test_vcomp_single_begin();
     test_vcomp_enter_critsect();
@@ -2238,6 +2377,7 @@ START_TEST(vcomp)
     test_reduction_integer32();
     test_reduction_integer64();
     test_reduction_float_double();
+    test_benchmarks();
 
     release_vcomp();
 }
@@ -21,6 +21,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_cs);
 
 #define WINED3D_INITIAL_CS_SIZE 4096
 
@@ -514,6 +515,50 @@ static const char *debug_cs_op(enum wined3d_cs_op op)
     }
 }
 
+static inline LONGLONG wined3d_cs_get_time(void)
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static void wined3d_cs_report_stats(struct wined3d_cs *cs)
+{
+    struct wined3d_cs_stats *stats = &cs->stats, *prev = &cs->prev_stats;
+    double scale = 1000.0 / cs->frequency;
+    DWORD time = GetTickCount();
+    unsigned int frames, samples;
+
+    ++cs->frames;
+
+    /* every 1.5 seconds */
+    if (time - cs->stats_time <= 1500)
+        return;
+
+    frames = cs->frames;
+    samples = stats->queue_samples - prev->queue_samples;
+    TRACE_(d3d_cs)("%p: %u frames, per frame: spin %.3f ms, sleep %.3f ms (%.1f waits), "
+            "queue depth avg %u max %u bytes, finish %.1f stalls %.3f ms, map %.1f stalls %.3f ms, "
+            "spin limit %.3f ms.\n", cs, frames,
+            (stats->spin_time - prev->spin_time) * scale / frames,
+            (stats->wait_time - prev->wait_time) * scale / frames,
+            (double)(stats->wait_count - prev->wait_count) / frames,
+            samples ? (unsigned int)((stats->queue_depth - prev->queue_depth) / samples) : 0,
+            stats->max_queue_depth,
+            (double)(stats->finish_count - prev->finish_count) / frames,
+            (stats->finish_time - prev->finish_time) * scale / frames,
+            (double)(stats->map_count - prev->map_count) / frames,
+            (stats->map_time - prev->map_time) * scale / frames,
+            cs->spin_limit * scale);
+
+    /* The thread counters are updated concurrently, so they are never reset. */
+    *prev = *stats;
+    stats->max_queue_depth = 0;
+    cs->stats_time = time;
+    cs->frames = 0;
+}
+
 static void wined3d_cs_exec_nop(struct wined3d_cs *cs, const void *data)
 {
 }
@@ -572,6 +617,9 @@ void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *sw
         wined3d_pause();
         pending = InterlockedCompareExchange(&cs->pending_presents, 0, 0);
     }
+
+    if (cs->thread && TRACE_ON(d3d_cs))
+        wined3d_cs_report_stats(cs);
 }
 
 static void wined3d_cs_exec_clear(struct wined3d_cs *cs, const void *data)
@@ -2496,6 +2544,11 @@ void wined3d_cs_emit_generate_mipmaps(struct wined3d_cs *cs, struct wined3d_shad
     wined3d_cs_submit(cs, WINED3D_CS_QUEUE_DEFAULT);
 }
 
+static BOOL wined3d_cs_queue_is_idle(const struct wined3d_cs_queue *queue)
+{
+    return queue->head == *(volatile LONG *)&queue->tail;
+}
+
 static void wined3d_cs_emit_stop(struct wined3d_cs *cs)
 {
     struct wined3d_cs_stop *op;
@@ -2504,7 +2557,11 @@ static void wined3d_cs_emit_stop(struct wined3d_cs *cs)
     op->opcode = WINED3D_CS_OP_STOP;
 
     wined3d_cs_submit(cs, WINED3D_CS_QUEUE_DEFAULT);
-    wined3d_cs_finish(cs, WINED3D_CS_QUEUE_DEFAULT);
+
+    /* The CS thread doesn't signal "finish_event" when it stops, since "cs"
+     * may be freed as soon as the queue is idle. */
+    while (!wined3d_cs_queue_is_idle(&cs->queue[WINED3D_CS_QUEUE_DEFAULT]))
+        wined3d_pause();
 }
 
 static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void *data) =
@@ -2626,11 +2683,20 @@ static BOOL wined3d_cs_queue_is_empty(const struct wined3d_cs *cs, const struct
 static void wined3d_cs_queue_submit(struct wined3d_cs_queue *queue, struct wined3d_cs *cs)
 {
     struct wined3d_cs_packet *packet;
+    unsigned int depth;
     size_t packet_size;
+    LONG head;
 
     packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
     packet_size = FIELD_OFFSET(struct wined3d_cs_packet, data[packet->size]);
-    InterlockedExchange(&queue->head, (queue->head + packet_size) & (WINED3D_CS_QUEUE_SIZE - 1));
+    head = (queue->head + packet_size) & (WINED3D_CS_QUEUE_SIZE - 1);
+    InterlockedExchange(&queue->head, head);
+
+    depth = (head - *(volatile LONG *)&queue->tail) & (WINED3D_CS_QUEUE_SIZE - 1);
+    cs->stats.queue_depth += depth;
+    ++cs->stats.queue_samples;
+    if (depth > cs->stats.max_queue_depth)
+        cs->stats.max_queue_depth = depth;
 
     if (InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
         SetEvent(cs->event);
@@ -2714,13 +2780,54 @@ static void *wined3d_cs_mt_require_space(struct wined3d_cs *cs, size_t size, enu
     return wined3d_cs_queue_require_space(&cs->queue[queue_id], size, cs);
 }
 
+static void wined3d_cs_wait_finish(struct wined3d_cs *cs, const struct wined3d_cs_queue *queue)
+{
+    InterlockedExchange(&cs->waiting_for_finish, TRUE);
+
+    /* Same as in wined3d_cs_wait_event(), the CS thread may have emptied the
+     * queue before "waiting_for_finish" was set, or may already have reset it
+     * and be about to signal the event. */
+    if (wined3d_cs_queue_is_idle(queue) && InterlockedCompareExchange(&cs->waiting_for_finish, FALSE, TRUE))
+        return;
+
+    WaitForSingleObject(cs->finish_event, INFINITE);
+}
+
 static void wined3d_cs_mt_finish(struct wined3d_cs *cs, enum wined3d_cs_queue_id queue_id)
 {
+    struct wined3d_cs_queue *queue = &cs->queue[queue_id];
+    unsigned int spin_count = 0;
+    LONGLONG start, time;
+
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_finish(cs, queue_id);
 
-    while (cs->queue[queue_id].head != *(volatile LONG *)&cs->queue[queue_id].tail)
-        wined3d_pause();
+    if (wined3d_cs_queue_is_idle(queue))
+        return;
+
+    /* Spin for a short while, the CS thread is usually about to catch up, but
+     * don't burn a CPU core while it is busy with a long operation. */
+    start = wined3d_cs_get_time();
+    while (!wined3d_cs_queue_is_idle(queue))
+    {
+        if (!(++spin_count % WINED3D_CS_SPIN_CHECK_INTERVAL)
+                && wined3d_cs_get_time() - start >= cs->finish_spin)
+            wined3d_cs_wait_finish(cs, queue);
+        else
+            wined3d_pause();
+    }
+    time = wined3d_cs_get_time() - start;
+
+    if (queue_id == WINED3D_CS_QUEUE_MAP)
+    {
+        ++cs->stats.map_count;
+        cs->stats.map_time += time;
+    }
+    else
+    {
+        ++cs->stats.finish_count;
+        cs->stats.finish_time += time;
+    }
 }
 
 static const struct wined3d_cs_ops wined3d_cs_mt_ops =
@@ -2746,7 +2853,7 @@ static void poll_queries(struct wined3d_cs *cs)
     }
 }
 
-static void wined3d_cs_wait_event(struct wined3d_cs *cs)
+static void wined3d_cs_wait_event(struct wined3d_cs *cs, DWORD timeout)
 {
     InterlockedExchange(&cs->waiting_for_event, TRUE);
 
@@ -2762,14 +2869,37 @@ static void wined3d_cs_wait_event(struct wined3d_cs *cs)
             && InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
         return;
 
-    WaitForSingleObject(cs->event, INFINITE);
+    /* If we time out, the main thread may have reset "waiting_for_event"
+     * already, in which case the event is about to be signalled. */
+    if (WaitForSingleObject(cs->event, timeout) == WAIT_TIMEOUT
+            && !InterlockedCompareExchange(&cs->waiting_for_event, FALSE, TRUE))
+        WaitForSingleObject(cs->event, INFINITE);
+}
+
+/* Spin for about twice the average time between commands, so that a thread
+ * submitting commands in quick succession doesn't have to wake us up every
+ * time, but sleep right away when the queue usually stays empty for longer.
+ * Long idle periods, e.g. while the application waits for vsync, are capped
+ * to keep them from dominating the average. */
+static void wined3d_cs_update_spin_limit(struct wined3d_cs *cs, LONGLONG idle_time)
+{
+    if (idle_time > 4 * cs->spin_max)
+        idle_time = 4 * cs->spin_max;
+    cs->idle_average += (idle_time - cs->idle_average) / 8;
+
+    if (cs->idle_average > cs->spin_max)
+        cs->spin_limit = cs->spin_min;
+    else
+        cs->spin_limit = max(cs->spin_min, min(2 * cs->idle_average, cs->spin_max));
 }
 
 static DWORD WINAPI wined3d_cs_run(void *ctx)
 {
     struct wined3d_cs_packet *packet;
     struct wined3d_cs_queue *queue;
+    LONGLONG idle_start = 0, spin_start = 0, time;
     unsigned int spin_count = 0;
+    BOOL waited = FALSE;
     struct wined3d_cs *cs = ctx;
     enum wined3d_cs_op opcode;
     HMODULE wined3d_module;
@@ -2798,12 +2928,40 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
             queue = &cs->queue[WINED3D_CS_QUEUE_DEFAULT];
             if (wined3d_cs_queue_is_empty(cs, queue))
             {
-                if (++spin_count >= WINED3D_CS_SPIN_COUNT && list_empty(&cs->query_poll_list))
-                    wined3d_cs_wait_event(cs);
+                if (!spin_count++)
+                {
+                    idle_start = spin_start = wined3d_cs_get_time();
+                    waited = FALSE;
+                }
+                else if (!(spin_count % WINED3D_CS_SPIN_CHECK_INTERVAL)
+                        && ((time = wined3d_cs_get_time()) - spin_start >= cs->spin_limit || waited))
+                {
+                    cs->stats.spin_time += time - spin_start;
+
+                    /* Pending queries still need to be polled now and then. */
+                    if (list_empty(&cs->query_poll_list))
+                        wined3d_cs_wait_event(cs, INFINITE);
+                    else
+                        wined3d_cs_wait_event(cs, WINED3D_CS_QUERY_WAIT_TIME);
+
+                    spin_start = wined3d_cs_get_time();
+                    cs->stats.wait_time += spin_start - time;
+                    ++cs->stats.wait_count;
+                    /* Go back to sleep right away if nothing was submitted. */
+                    waited = TRUE;
+                    poll = WINED3D_CS_QUERY_POLL_INTERVAL - 1;
+                }
                 continue;
             }
         }
-        spin_count = 0;
+
+        if (spin_count)
+        {
+            time = wined3d_cs_get_time();
+            cs->stats.spin_time += time - spin_start;
+            wined3d_cs_update_spin_limit(cs, time - idle_start);
+            spin_count = 0;
+        }
 
         tail = queue->tail;
         packet = (struct wined3d_cs_packet *)&queue->data[tail];
@@ -2826,6 +2984,10 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
         tail += FIELD_OFFSET(struct wined3d_cs_packet, data[packet->size]);
         tail &= (WINED3D_CS_QUEUE_SIZE - 1);
         InterlockedExchange(&queue->tail, tail);
+
+        if (*(volatile BOOL *)&cs->waiting_for_finish && tail == *(volatile LONG *)&queue->head
+                && InterlockedCompareExchange(&cs->waiting_for_finish, FALSE, TRUE))
+            SetEvent(cs->finish_event);
     }
 
     cs->queue[WINED3D_CS_QUEUE_MAP].tail = cs->queue[WINED3D_CS_QUEUE_MAP].head;
@@ -2837,6 +2999,7 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
 {
     const struct wined3d_d3d_info *d3d_info = &device->adapter->d3d_info;
+    LARGE_INTEGER frequency;
     struct wined3d_cs *cs;
 
     if (!(cs = heap_alloc_zero(sizeof(*cs))))
@@ -2845,6 +3008,14 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
     cs->ops = &wined3d_cs_st_ops;
     cs->device = device;
 
+    QueryPerformanceFrequency(&frequency);
+    cs->frequency = frequency.QuadPart;
+    cs->spin_min = WINED3D_CS_SPIN_MIN_TIME * cs->frequency / 1000000;
+    cs->spin_max = WINED3D_CS_SPIN_MAX_TIME * cs->frequency / 1000000;
+    cs->finish_spin = WINED3D_CS_FINISH_SPIN_TIME * cs->frequency / 1000000;
+    cs->spin_limit = cs->spin_max;
+    cs->stats_time = GetTickCount();
+
     state_init(&cs->state, d3d_info, WINED3D_STATE_NO_REF | WINED3D_STATE_INIT_DEFAULT);
 
     cs->data_size = WINED3D_INITIAL_CS_SIZE;
@@ -2863,10 +3034,19 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
             goto fail;
         }
 
+        if (!(cs->finish_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        {
+            ERR("Failed to create command stream finish event.\n");
+            CloseHandle(cs->event);
+            heap_free(cs->data);
+            goto fail;
+        }
+
         if (!(GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
                 (const WCHAR *)wined3d_cs_run, &cs->wined3d_module)))
         {
             ERR("Failed to get wined3d module handle.\n");
+            CloseHandle(cs->finish_event);
             CloseHandle(cs->event);
             heap_free(cs->data);
             goto fail;
@@ -2876,6 +3056,7 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
         {
             ERR("Failed to create wined3d command stream thread.\n");
             FreeLibrary(cs->wined3d_module);
+            CloseHandle(cs->finish_event);
             CloseHandle(cs->event);
             heap_free(cs->data);
             goto fail;
@@ -2898,6 +3079,7 @@ void wined3d_cs_destroy(struct wined3d_cs *cs)
         CloseHandle(cs->thread);
         if (!CloseHandle(cs->event))
             ERR("Closing event failed.\n");
+        CloseHandle(cs->finish_event);
     }
 
     state_cleanup(&cs->state);
@@ -4014,7 +4014,11 @@ enum wined3d_push_constants
 
 #define WINED3D_CS_QUERY_POLL_INTERVAL  10u
 #define WINED3D_CS_QUEUE_SIZE           0x100000u
-#define WINED3D_CS_SPIN_COUNT           10000000u
+#define WINED3D_CS_SPIN_CHECK_INTERVAL  64u
+#define WINED3D_CS_SPIN_MIN_TIME        20u     /* microseconds */
+#define WINED3D_CS_SPIN_MAX_TIME        1000u   /* microseconds */
+#define WINED3D_CS_FINISH_SPIN_TIME     200u    /* microseconds */
+#define WINED3D_CS_QUERY_WAIT_TIME      1u      /* milliseconds */
 
 struct wined3d_cs_queue
 {
@@ -4031,6 +4035,23 @@ struct wined3d_cs_ops
             unsigned int start_idx, unsigned int count, const void *constants);
 };
 
+/* Times are in performance counter ticks. The thread fields are only updated
+ * by the command stream thread, the others by the application thread. */
+struct wined3d_cs_stats
+{
+    LONGLONG spin_time;
+    LONGLONG wait_time;
+    unsigned int wait_count;
+
+    LONGLONG queue_depth;
+    unsigned int queue_samples;
+    unsigned int max_queue_depth;
+    unsigned int finish_count;
+    LONGLONG finish_time;
+    unsigned int map_count;
+    LONGLONG map_time;
+};
+
 struct wined3d_cs
 {
     const struct wined3d_cs_ops *ops;
@@ -4049,6 +4070,19 @@ struct wined3d_cs
     HANDLE event;
     BOOL waiting_for_event;
     LONG pending_presents;
+
+    HANDLE finish_event;
+    BOOL waiting_for_finish;
+
+    /* Adaptive spinning, in performance counter ticks. */
+    LONGLONG spin_min, spin_max, spin_limit;
+    LONGLONG finish_spin;
+    LONGLONG idle_average;
+
+    struct wined3d_cs_stats stats, prev_stats;
+    LONGLONG frequency;
+    DWORD stats_time;
+    unsigned int frames;
 };
 
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device) DECLSPEC_HIDDEN;
@@ -195,6 +195,21 @@ struct wake_up_reply
 };
 
 
+struct fsync_slot
+{
+    int           value;
+    int           count;
+    int           abandoned;
+    unsigned int  max;
+};
+#define FSYNC_SERVER_WAIT  0x80000000
+#define FSYNC_EVENT_SIGNALED    0x00000001
+#define FSYNC_EVENT_PULSE       0x00000002
+#define FSYNC_EVENT_PULSE_MASK  0x7ffffffe
+#define FSYNC_SHM_NAME     "fsync"
+#define FSYNC_SHM_SLOTS    65536
+
+
 typedef __int64 timeout_t;
 #define TIMEOUT_INFINITE (((timeout_t)0x7fffffff) << 32 | 0xffffffff)
 
@@ -1493,6 +1508,23 @@ struct open_semaphore_reply
 
 
 
+struct get_fsync_idx_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fsync_idx_reply
+{
+    struct reply_header __header;
+    unsigned int index;
+    int          type;
+    unsigned int access;
+    char __pad_20[4];
+};
+enum fsync_type { FSYNC_NONE, FSYNC_AUTO_EVENT, FSYNC_MANUAL_EVENT, FSYNC_SEMAPHORE, FSYNC_MUTEX };
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -1508,7 +1540,9 @@ struct create_file_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          fd_type;
+    unsigned int fd_access;
+    unsigned int fd_options;
 };
 
 
@@ -5781,6 +5815,22 @@ struct resume_process_reply
 };
 
 
+
+struct batch_request
+{
+    struct request_header __header;
+    /* VARARG(requests,bytes); */
+    char __pad_12[4];
+};
+struct batch_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(replies,bytes); */
+    char __pad_12[4];
+};
+
+
 enum request
 {
     REQ_new_process,
@@ -5825,6 +5875,7 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_fsync_idx,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -6078,6 +6129,7 @@ enum request
     REQ_terminate_job,
     REQ_suspend_process,
     REQ_resume_process,
+    REQ_batch,
     REQ_NB_REQUESTS
 };
 
@@ -6127,6 +6179,7 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_fsync_idx_request get_fsync_idx_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -6380,6 +6433,7 @@ union generic_request
     struct terminate_job_request terminate_job_request;
     struct suspend_process_request suspend_process_request;
     struct resume_process_request resume_process_request;
+    struct batch_request batch_request;
 };
 union generic_reply
 {
@@ -6427,6 +6481,7 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_fsync_idx_reply get_fsync_idx_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6680,11 +6735,12 @@ union generic_reply
     struct terminate_job_reply terminate_job_reply;
     struct suspend_process_reply suspend_process_reply;
     struct resume_process_reply resume_process_reply;
+    struct batch_reply batch_reply;
 };
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 601
+#define SERVER_PROTOCOL_VERSION 605
 
 /* ### protocol_version end ### */
 
@@ -59,6 +59,9 @@ extern int winetest_debug;
 /* running in interactive mode? */
 extern int winetest_interactive;
 
+/* run the benchmarks? */
+extern int winetest_benchmark;
+
 /* report successful tests (BOOL) */
 extern int winetest_report_success;
 
@@ -211,6 +214,9 @@ int winetest_debug = 1;
 /* interactive mode? */
 int winetest_interactive = 0;
 
+/* run the benchmarks? */
+int winetest_benchmark = 0;
+
 /* current platform */
 const char *winetest_platform = "windows";
 
@@ -629,6 +635,7 @@ int main( int argc, char **argv )
 
     if (GetEnvironmentVariableA( "WINETEST_DEBUG", p, sizeof(p) )) winetest_debug = atoi(p);
     if (GetEnvironmentVariableA( "WINETEST_INTERACTIVE", p, sizeof(p) )) winetest_interactive = atoi(p);
+    if (GetEnvironmentVariableA( "WINETEST_BENCHMARK", p, sizeof(p) )) winetest_benchmark = atoi(p);
     if (GetEnvironmentVariableA( "WINETEST_REPORT_SUCCESS", p, sizeof(p) )) winetest_report_success = atoi(p);
 
     if (!strcmp( winetest_platform, "windows" )) SetUnhandledExceptionFilter( exc_filter );
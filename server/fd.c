@@ -554,7 +554,9 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (epoll_fd == -1) break;  /* an error occurred with epoll */
 
+        unlock_server();
         ret = epoll_wait( epoll_fd, events, ARRAY_SIZE( events ), timeout );
+        lock_server();
         set_current_time();
 
         /* put the events into the pollfd array first, like poll does */
@@ -659,6 +661,7 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (kqueue_fd == -1) break;  /* an error occurred with kqueue */
 
+        unlock_server();
         if (timeout != -1)
         {
             struct timespec ts;
@@ -668,6 +671,7 @@ static inline void main_loop_epoll(void)
             ret = kevent( kqueue_fd, NULL, 0, events, ARRAY_SIZE( events ), &ts );
         }
         else ret = kevent( kqueue_fd, NULL, 0, events, ARRAY_SIZE( events ), NULL );
+        lock_server();
 
         set_current_time();
 
@@ -763,6 +767,7 @@ static inline void main_loop_epoll(void)
         if (!active_users) break;  /* last user removed by a timeout */
         if (port_fd == -1) break;  /* an error occurred with event completion */
 
+        unlock_server();
         if (timeout != -1)
         {
             struct timespec ts;
@@ -772,6 +777,7 @@ static inline void main_loop_epoll(void)
             ret = port_getn( port_fd, events, ARRAY_SIZE( events ), &nget, &ts );
         }
         else ret = port_getn( port_fd, events, ARRAY_SIZE( events ), &nget, NULL );
+        lock_server();
 
 	if (ret == -1) break;  /* an error occurred with event completion */
 
@@ -943,7 +949,9 @@ void main_loop(void)
 
         if (!active_users) break;  /* last user removed by a timeout */
 
+        unlock_server();
         ret = poll( pollfd, nb_users, timeout );
+        lock_server();
         set_current_time();
 
         if (ret > 0)
@@ -2584,6 +2592,28 @@ DECL_HANDLER(get_handle_unix_name)
     }
 }
 
+/* send the unix fd of a new handle to the client if it can be cached there */
+/* return the fd type, or FD_TYPE_INVALID if no fd was sent */
+int send_handle_fd( struct object *obj, obj_handle_t handle, unsigned int *options )
+{
+    int type = FD_TYPE_INVALID;
+    struct fd *fd;
+
+    if (!(fd = get_obj_fd( obj )))
+    {
+        clear_error();
+        return type;
+    }
+    if (fd->cacheable && fd->unix_fd != -1 &&
+        !send_client_fd( current->process, fd->unix_fd, handle ))
+    {
+        type = fd->fd_ops->get_fd_type( fd );
+        *options = fd->options;
+    }
+    release_object( fd );
+    return type;
+}
+
 /* get a Unix fd to access a file */
 DECL_HANDLER(get_handle_fd)
 {
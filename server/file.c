@@ -741,6 +741,12 @@ DECL_HANDLER(create_file)
                              req->create, req->options, req->attrs, sd )))
     {
         reply->handle = alloc_handle( current->process, file, req->access, objattr->attributes );
+        if (reply->handle)
+        {
+            /* save the client a get_handle_fd request for the first I/O on the handle */
+            reply->fd_type = send_handle_fd( file, reply->handle, &reply->fd_options );
+            reply->fd_access = get_handle_access( current->process, reply->handle );
+        }
         release_object( file );
     }
     if (root_fd) release_object( root_fd );
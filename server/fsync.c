@@ -0,0 +1,269 @@
+/*
+ * Shared memory state for fast synchronization objects
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When WINEFSYNC is set in the server environment, events, semaphores and
+ * mutexes keep their state in a slot of a shared memory file that every
+ * client maps.  Clients then signal and acquire uncontended objects with
+ * atomic operations on the slot and sleep on it with futexes, without a
+ * server round-trip.
+ *
+ * As soon as a thread waits on the object through the server, the
+ * FSYNC_SERVER_WAIT bit is set in the futex word.  Clients never modify a
+ * slot that has this bit set and go through the server instead, so that the
+ * usual signaled/satisfied logic of the wait queues stays valid.  The bit is
+ * cleared again when the last server waiter is removed.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "handle.h"
+#include "thread.h"
+#include "request.h"
+
+static struct fsync_slot *fsync_shm;  /* shared memory mapping, NULL if disabled */
+static unsigned int next_slot = 1;    /* first never used slot, 0 means no slot */
+static unsigned int *free_slots;      /* stack of released slots */
+static unsigned int nb_free_slots;
+static unsigned int max_free_slots;
+
+/* create the shared memory if requested by the environment */
+void init_fsync(void)
+{
+#ifdef __linux__
+    const size_t size = FSYNC_SHM_SLOTS * sizeof(struct fsync_slot);
+    const char *env = getenv( "WINEFSYNC" );
+    void *ptr;
+    int fd;
+
+    /* we are in the server directory, remove a file left by a previous server */
+    unlink( FSYNC_SHM_NAME );
+    if (!env || !atoi( env )) return;
+
+    if ((fd = open( FSYNC_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0600 )) == -1)
+    {
+        fprintf( stderr, "wineserver: cannot create %s: %s\n", FSYNC_SHM_NAME, strerror( errno ));
+        return;
+    }
+    if (ftruncate( fd, size ) == -1 ||
+        (ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        fprintf( stderr, "wineserver: cannot map %s: %s\n", FSYNC_SHM_NAME, strerror( errno ));
+        close( fd );
+        unlink( FSYNC_SHM_NAME );
+        return;
+    }
+    close( fd );
+    fsync_shm = ptr;
+    if (debug_level) fprintf( stderr, "wineserver: using shared memory synchronization\n" );
+#endif
+}
+
+/* allocate a slot for a new object; return 0 if none is available */
+unsigned int alloc_fsync_slot( int value, unsigned int max )
+{
+    unsigned int index;
+
+    if (!fsync_shm) return 0;
+    if (nb_free_slots) index = free_slots[--nb_free_slots];
+    else if (next_slot < FSYNC_SHM_SLOTS) index = next_slot++;
+    else return 0;
+
+    fsync_shm[index].count = 0;
+    fsync_shm[index].abandoned = 0;
+    fsync_shm[index].max = max;
+    fsync_shm[index].value = value;
+    return index;
+}
+
+/* release the slot of a destroyed object */
+void free_fsync_slot( unsigned int index )
+{
+    if (!index) return;
+    if (nb_free_slots == max_free_slots)
+    {
+        unsigned int new_max = max(64, max_free_slots * 2);
+        unsigned int *new_slots = realloc( free_slots, new_max * sizeof(*free_slots) );
+
+        if (!new_slots) return;  /* simply leak the slot */
+        free_slots = new_slots;
+        max_free_slots = new_max;
+    }
+    memset( &fsync_shm[index], 0, sizeof(fsync_shm[index]) );
+    free_slots[nb_free_slots++] = index;
+}
+
+struct fsync_slot *get_fsync_slot( unsigned int index )
+{
+    assert( index && index < next_slot );
+    return &fsync_shm[index];
+}
+
+/* return the object state, without the server wait flag */
+int get_fsync_value( unsigned int index )
+{
+    return get_fsync_slot( index )->value & ~FSYNC_SERVER_WAIT;
+}
+
+/* wake up the clients sleeping on a slot */
+static void wake_fsync_slot( struct fsync_slot *slot )
+{
+#ifdef __linux__
+    syscall( __NR_futex, &slot->value, 1 /* FUTEX_WAKE */, INT_MAX, NULL, 0, 0 );
+#endif
+}
+
+/* atomically set the object state and wake up the clients; return the previous state */
+int set_fsync_value( unsigned int index, int value )
+{
+    struct fsync_slot *slot = get_fsync_slot( index );
+    int old;
+
+    do old = slot->value;
+    while (interlocked_cmpxchg( &slot->value, (old & FSYNC_SERVER_WAIT) | value, old ) != old);
+    if ((old & ~FSYNC_SERVER_WAIT) != value) wake_fsync_slot( slot );
+    return old & ~FSYNC_SERVER_WAIT;
+}
+
+/* atomically change the object state if it is still equal to compare */
+int cmpxchg_fsync_value( unsigned int index, int value, int compare )
+{
+    struct fsync_slot *slot = get_fsync_slot( index );
+    int old = slot->value;
+
+    if ((old & ~FSYNC_SERVER_WAIT) != compare) return 0;
+    if (interlocked_cmpxchg( &slot->value, (old & FSYNC_SERVER_WAIT) | value, old ) != old) return 0;
+    wake_fsync_slot( slot );
+    return 1;
+}
+
+/* set or reset an event, keeping its pulse count; return the previous state */
+int set_fsync_event( unsigned int index, int signaled )
+{
+    struct fsync_slot *slot = get_fsync_slot( index );
+    int old;
+
+    do old = slot->value;
+    while ((old & FSYNC_EVENT_SIGNALED) != signaled &&
+           interlocked_cmpxchg( &slot->value, (old & ~FSYNC_EVENT_SIGNALED) | signaled, old ) != old);
+    if ((old & FSYNC_EVENT_SIGNALED) != signaled) wake_fsync_slot( slot );
+    return old & FSYNC_EVENT_SIGNALED;
+}
+
+/* reset a pulsed event and release the clients that were waiting on it
+ *
+ * The pulse count changes the futex word, so that waiting clients notice
+ * the pulse even though the event is not signaled anymore when they wake up.
+ * The signaled state of an auto-reset event is taken first, and only then is
+ * the pulse left in the count field, where the first client to notice the
+ * pulse takes it; nothing is left there if a server waiter or a client has
+ * already consumed the signaled state. */
+void pulse_fsync_event( unsigned int index, int manual_reset )
+{
+    struct fsync_slot *slot = get_fsync_slot( index );
+    int old;
+
+    if (!manual_reset)
+    {
+        do
+        {
+            old = slot->value;
+            if (!(old & FSYNC_EVENT_SIGNALED)) return;
+        } while (interlocked_cmpxchg( &slot->value, old & ~FSYNC_EVENT_SIGNALED, old ) != old);
+        interlocked_xchg( &slot->count, 1 );
+    }
+    do old = slot->value;
+    while (interlocked_cmpxchg( &slot->value, (old & FSYNC_SERVER_WAIT) |
+                                ((old + FSYNC_EVENT_PULSE) & FSYNC_EVENT_PULSE_MASK), old ) != old);
+    wake_fsync_slot( slot );
+}
+
+/* add_queue implementation for objects that may have a slot */
+int fsync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index )
+{
+    if (index)
+    {
+        struct fsync_slot *slot = get_fsync_slot( index );
+        int old;
+
+        do old = slot->value;
+        while (!(old & FSYNC_SERVER_WAIT) &&
+               interlocked_cmpxchg( &slot->value, old | FSYNC_SERVER_WAIT, old ) != old);
+    }
+    return add_queue( obj, entry );
+}
+
+/* remove_queue implementation for objects that may have a slot */
+void fsync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index )
+{
+    /* give the object back to the clients when the last server waiter goes away */
+    if (index && list_head( &obj->wait_queue ) == &entry->entry &&
+        list_tail( &obj->wait_queue ) == &entry->entry)
+    {
+        struct fsync_slot *slot = get_fsync_slot( index );
+        int old;
+
+        do old = slot->value;
+        while (interlocked_cmpxchg( &slot->value, old & ~FSYNC_SERVER_WAIT, old ) != old);
+    }
+    remove_queue( obj, entry );
+}
+
+/* retrieve the shared memory slot of a synchronization object */
+DECL_HANDLER(get_fsync_idx)
+{
+    struct object *obj;
+
+    if (!fsync_shm)
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    reply->type   = FSYNC_NONE;
+    reply->access = get_handle_access( current->process, req->handle );
+    if (!(reply->index = get_event_fsync_idx( obj, &reply->type )) &&
+        !(reply->index = get_semaphore_fsync_idx( obj, &reply->type )))
+        reply->index = get_mutex_fsync_idx( obj, &reply->type );
+    release_object( obj );
+}
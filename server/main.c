@@ -144,6 +144,9 @@ int main( int argc, char *argv[] )
     set_current_time();
     init_signals();
     init_directories();
+    init_fsync();
+    init_request_stats();
+    init_request_dispatch();
     init_registry();
     main_loop();
     return 0;
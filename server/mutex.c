@@ -42,11 +42,17 @@ struct mutex
     struct thread *owner;           /* mutex owner */
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
-    struct list    entry;           /* entry in owner thread mutex list */
+    struct list    entry;           /* entry in owner thread mutex list, or in fsync_mutexes */
+    unsigned int   fsync_idx;       /* shared memory slot holding the owner, if any */
 };
 
+/* mutexes with a shared memory slot, their owner is only known by thread id */
+static struct list fsync_mutexes = LIST_INIT( fsync_mutexes );
+
 static void mutex_dump( struct object *obj, int verbose );
 static struct object_type *mutex_get_type( struct object *obj );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int mutex_map_access( struct object *obj, unsigned int access );
@@ -58,8 +64,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     mutex_dump,                /* dump */
     mutex_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -80,6 +86,25 @@ static const struct object_ops mutex_ops =
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
+    if (mutex->fsync_idx)
+    {
+        struct fsync_slot *slot = get_fsync_slot( mutex->fsync_idx );
+        int owner = get_fsync_value( mutex->fsync_idx );
+
+        /* the owner tid is the ownership state, the count is only valid while it is set */
+        assert( !owner || owner == thread->id );
+        if (owner) slot->count++;
+        else
+        {
+            /* clients don't acquire a mutex that has server waiters, so this can't fail */
+            int grabbed = cmpxchg_fsync_value( mutex->fsync_idx, thread->id, 0 );
+
+            assert( grabbed );
+            slot->count = 1;
+        }
+        return;
+    }
+
     assert( !mutex->count || (mutex->owner == thread) );
 
     if (!mutex->count++)  /* FIXME: avoid wrap-around */
@@ -93,6 +118,14 @@ static void do_grab( struct mutex *mutex, struct thread *thread )
 /* release a mutex once the recursion count is 0 */
 static void do_release( struct mutex *mutex )
 {
+    if (mutex->fsync_idx)
+    {
+        assert( !get_fsync_slot( mutex->fsync_idx )->count );
+        set_fsync_value( mutex->fsync_idx, 0 );
+        wake_up( &mutex->obj, 0 );
+        return;
+    }
+
     assert( !mutex->count );
     /* remove the mutex from the thread list of owned mutexes */
     list_remove( &mutex->entry );
@@ -100,6 +133,42 @@ static void do_release( struct mutex *mutex )
     wake_up( &mutex->obj, 0 );
 }
 
+/* get the recursion count of a mutex and check whether a thread owns it */
+static unsigned int get_mutex_count( struct mutex *mutex, struct thread *thread, int *owned )
+{
+    if (mutex->fsync_idx)
+    {
+        int owner = get_fsync_value( mutex->fsync_idx );
+
+        /* clients set the owner before the count and clear the count before the
+         * owner, so only the owner tid tells whether the mutex is free */
+        *owned = (owner == thread->id);
+        if (!owner) return 0;
+        return max( get_fsync_slot( mutex->fsync_idx )->count, 1 );
+    }
+    *owned = (mutex->owner == thread);
+    return mutex->count;
+}
+
+/* release a mutex owned by the current thread; return the previous count, 0 on error */
+static unsigned int release_mutex( struct mutex *mutex )
+{
+    unsigned int count;
+    int owned;
+
+    if (!(count = get_mutex_count( mutex, current, &owned )) || !owned)
+    {
+        set_error( STATUS_MUTANT_NOT_OWNED );
+        return 0;
+    }
+    if (mutex->fsync_idx)
+    {
+        if (!--get_fsync_slot( mutex->fsync_idx )->count) do_release( mutex );
+    }
+    else if (!--mutex->count) do_release( mutex );
+    return count;
+}
+
 static struct mutex *create_mutex( struct object *root, const struct unicode_str *name,
                                    unsigned int attr, int owned, const struct security_descriptor *sd )
 {
@@ -113,6 +182,8 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
+            if ((mutex->fsync_idx = alloc_fsync_slot( 0, 0 )))
+                list_add_tail( &fsync_mutexes, &mutex->entry );
             if (owned) do_grab( mutex, current );
         }
     }
@@ -131,13 +202,40 @@ void abandon_mutexes( struct thread *thread )
         mutex->abandoned = 1;
         do_release( mutex );
     }
+
+restart:
+    LIST_FOR_EACH( ptr, &fsync_mutexes )
+    {
+        struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
+        struct fsync_slot *slot = get_fsync_slot( mutex->fsync_idx );
+
+        if (get_fsync_value( mutex->fsync_idx ) != thread->id) continue;
+        slot->count = 0;
+        slot->abandoned = 1;
+        do_release( mutex );
+        /* waking up other threads may have destroyed mutexes */
+        goto restart;
+    }
+}
+
+unsigned int get_mutex_fsync_idx( struct object *obj, int *type )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+
+    if (obj->ops != &mutex_ops) return 0;
+    *type = FSYNC_MUTEX;
+    return mutex->fsync_idx;
 }
 
 static void mutex_dump( struct object *obj, int verbose )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
+    if (mutex->fsync_idx)
+        fprintf( stderr, "Mutex count=%u owner=%04x\n", get_fsync_slot( mutex->fsync_idx )->count,
+                 get_fsync_value( mutex->fsync_idx ));
+    else
+        fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
 }
 
 static struct object_type *mutex_get_type( struct object *obj )
@@ -147,21 +245,39 @@ static struct object_type *mutex_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return fsync_add_queue( obj, entry, mutex->fsync_idx );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    fsync_remove_queue( obj, entry, mutex->fsync_idx );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    int owned;
+
     assert( obj->ops == &mutex_ops );
-    return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
+    return (!get_mutex_count( mutex, get_wait_queue_thread( entry ), &owned ) || owned);
 }
 
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    int *abandoned = mutex->fsync_idx ? &get_fsync_slot( mutex->fsync_idx )->abandoned : &mutex->abandoned;
+
     assert( obj->ops == &mutex_ops );
 
     do_grab( mutex, get_wait_queue_thread( entry ));
-    if (mutex->abandoned) make_wait_abandoned( entry );
-    mutex->abandoned = 0;
+    if (*abandoned) make_wait_abandoned( entry );
+    *abandoned = 0;
 }
 
 static unsigned int mutex_map_access( struct object *obj, unsigned int access )
@@ -183,13 +299,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (!mutex->count || (mutex->owner != current))
-    {
-        set_error( STATUS_MUTANT_NOT_OWNED );
-        return 0;
-    }
-    if (!--mutex->count) do_release( mutex );
-    return 1;
+    return release_mutex( mutex ) != 0;
 }
 
 static void mutex_destroy( struct object *obj )
@@ -197,6 +307,12 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->fsync_idx)
+    {
+        list_remove( &mutex->entry );
+        free_fsync_slot( mutex->fsync_idx );
+        return;
+    }
     if (!mutex->count) return;
     mutex->count = 0;
     do_release( mutex );
@@ -243,12 +359,7 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
-        else
-        {
-            reply->prev_count = mutex->count;
-            if (!--mutex->count) do_release( mutex );
-        }
+        reply->prev_count = release_mutex( mutex );
         release_object( mutex );
     }
 }
@@ -261,9 +372,9 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
-        reply->count = mutex->count;
-        reply->owned = (mutex->owner == current);
-        reply->abandoned = mutex->abandoned;
+        reply->count = get_mutex_count( mutex, current, &reply->owned );
+        reply->abandoned = mutex->fsync_idx ? get_fsync_slot( mutex->fsync_idx )->abandoned
+                                            : mutex->abandoned;
 
         release_object( mutex );
     }
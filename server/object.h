@@ -31,6 +31,14 @@
 
 #define DEBUG_OBJECTS
 
+/* some read-only requests can be handled on worker threads (see WINESERVER_THREADS) */
+#if defined(__GNUC__) && defined(HAVE_PTHREAD_H)
+#define SERVER_THREADS
+#define server_thread_local __thread
+#else
+#define server_thread_local
+#endif
+
 /* kernel objects */
 
 struct namespace;
@@ -190,10 +198,30 @@ extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_han
 extern void pulse_event( struct event *event );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern unsigned int get_event_fsync_idx( struct object *obj, int *type );
 
 /* mutex functions */
 
 extern void abandon_mutexes( struct thread *thread );
+extern unsigned int get_mutex_fsync_idx( struct object *obj, int *type );
+
+/* semaphore functions */
+
+extern unsigned int get_semaphore_fsync_idx( struct object *obj, int *type );
+
+/* shared memory synchronization functions */
+
+extern void init_fsync(void);
+extern unsigned int alloc_fsync_slot( int value, unsigned int max );
+extern void free_fsync_slot( unsigned int index );
+extern struct fsync_slot *get_fsync_slot( unsigned int index );
+extern int get_fsync_value( unsigned int index );
+extern int set_fsync_value( unsigned int index, int value );
+extern int cmpxchg_fsync_value( unsigned int index, int value, int compare );
+extern int set_fsync_event( unsigned int index, int signaled );
+extern void pulse_fsync_event( unsigned int index, int manual_reset );
+extern int fsync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index );
+extern void fsync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index );
 
 /* serial functions */
 
@@ -34,6 +34,9 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -59,6 +62,20 @@ struct notify
     struct process   *process;  /* process in which the hkey is valid */
 };
 
+/* hash index of the unsorted subkeys or values of a large key
+ *
+ * New entries of a large key are appended at the end of the array instead of
+ * being inserted at their sorted position, and are found through a hash table
+ * until the array gets sorted again, when an operation needs the entries in
+ * order such as enumerating or deleting them.
+ */
+struct key_index
+{
+    unsigned int     size;     /* size of the hash table (power of 2) */
+    unsigned int    *table;    /* array index + 1 of the unsorted entries, 0 for free slots */
+    int              unsorted; /* number of entries at the end of the array that are not sorted */
+};
+
 /* a registry key */
 struct key
 {
@@ -74,9 +91,12 @@ struct key
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    struct key_index  subkey_index; /* index of the unsorted subkeys */
+    struct key_index  value_index; /* index of the unsorted values */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    const struct hive_key *hive;   /* hive record if the subkeys and values are not loaded yet */
 };
 
 /* key flags */
@@ -99,10 +119,70 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_INDEXED  256 /* min. number of subkeys or values before new ones are left unsorted */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
+/* binary hive file format
+ *
+ * A hive starts with a header followed by the key records. The records of the
+ * subkeys of a key are always stored before it, and the root key of the branch
+ * comes last. The hive is mapped in memory and the records are only turned into
+ * key objects when a key is accessed. Changes are then appended to a journal,
+ * which contains the same key records with the full path of the key relative to
+ * the branch as name, and without any subkeys.
+ */
+
+#define HIVE_VERSION 1
+
+static const char hive_magic[8] = { 'W','I','N','E','H','I','V','E' };
+static const char journal_magic[8] = { 'W','I','N','E','J','R','N','L' };
+
+struct hive_header
+{
+    char           magic[8];    /* hive_magic or journal_magic */
+    unsigned int   version;     /* HIVE_VERSION, also detects a byte order mismatch */
+    unsigned int   arch;        /* prefix architecture */
+    timeout_t      generation;  /* time the hive was written, to match it with its journal */
+    unsigned int   root;        /* offset of the root key record (hive only) */
+    unsigned int   size;        /* total size of the file (hive only) */
+};
+
+struct hive_key
+{
+    unsigned int   size;        /* size of the record, aligned to 8 bytes */
+    unsigned int   flags;       /* saved key flags */
+    timeout_t      modif;       /* last modification time */
+    unsigned int   namelen;     /* length of key name */
+    unsigned int   classlen;    /* length of class name */
+    unsigned int   nb_subkeys;  /* number of subkeys */
+    unsigned int   nb_values;   /* number of values */
+    /* followed by the subkey record offsets, the values, the key name and class, */
+    /* and the value names and data */
+};
+
+struct hive_value
+{
+    unsigned int   type;        /* value type */
+    data_size_t    len;         /* value data length in bytes */
+    unsigned int   namelen;     /* length of value name */
+    unsigned int   offset;      /* offset of value name from the start of the key record, followed by the data */
+};
+
+#define HIVE_KEY_FLAGS    (KEY_SYMLINK | KEY_WOW64)  /* key flags stored in the hive */
+#define HIVE_KEY_DELETED  0x80000000                 /* journal record of a deleted key */
+
+#define MIN_JOURNAL_SIZE  (1024 * 1024)  /* journal size below which the hive is never rewritten */
+
+/* buffer to build hive records */
+struct hive_buffer
+{
+    char          *data;
+    size_t         size;
+    size_t         alloc;
+};
+
 /* the root of the registry tree */
 static struct key *root_key;
 
@@ -117,18 +197,30 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index );
+static int load_hive_key( struct key *key );
+static void sort_subkeys( struct key *key );
+static void sort_values( struct key *key );
+static void journal_deleted_key( const struct key *key );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    char        *hive_path;     /* binary hive file */
+    char        *journal_path;  /* journal of the changes since the hive was written */
+    char        *hive;          /* mapped hive, NULL if none */
+    size_t       hive_size;     /* size of the hive file */
+    timeout_t    generation;    /* generation of the hive file, 0 if there isn't one */
+    size_t       journal_size;  /* size of the valid part of the journal, 0 if it must be created */
+    struct hive_buffer deleted; /* journal records of the keys deleted since the last save */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
+static int use_registry_hive;  /* save the registry in the binary hive format */
 
 
 /* information about a file being loaded */
@@ -255,11 +347,14 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static int save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
-    if (key->flags & KEY_VOLATILE) return;
+    if (key->flags & KEY_VOLATILE) return 1;
+    if (key->hive && !load_hive_key( key )) return 0;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -277,7 +372,9 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
         if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
         for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
     }
-    for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!save_subkeys( key->subkeys[i], base, f )) return 0;
+    return 1;
 }
 
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
@@ -417,12 +514,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_index.table );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_index.table );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -489,7 +588,10 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->last_value  = -1;
         key->values      = NULL;
         key->modif       = modif;
+        memset( &key->subkey_index, 0, sizeof(key->subkey_index) );
+        memset( &key->value_index, 0, sizeof(key->value_index) );
         key->parent      = NULL;
+        key->hive        = NULL;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -549,6 +651,156 @@ static void touch_key( struct key *key, unsigned int change )
         check_notify( k, change, 0 );
 }
 
+/* compare two key or value names */
+static int compare_names( const WCHAR *name1, data_size_t len1, const WCHAR *name2, data_size_t len2 )
+{
+    int res = memicmp_strW( name1, name2, min( len1, len2 ) );
+    if (!res) res = len1 - len2;
+    return res;
+}
+
+static int compare_subkeys( const void *ptr1, const void *ptr2 )
+{
+    const struct key *key1 = *(struct key * const *)ptr1;
+    const struct key *key2 = *(struct key * const *)ptr2;
+    return compare_names( key1->name, key1->namelen, key2->name, key2->namelen );
+}
+
+static int compare_values( const void *ptr1, const void *ptr2 )
+{
+    const struct key_value *value1 = ptr1;
+    const struct key_value *value2 = ptr2;
+    return compare_names( value1->name, value1->namelen, value2->name, value2->namelen );
+}
+
+static const WCHAR *get_subkey_name( const struct key *key, int index, data_size_t *len )
+{
+    *len = key->subkeys[index]->namelen;
+    return key->subkeys[index]->name;
+}
+
+static const WCHAR *get_value_name( const struct key *key, int index, data_size_t *len )
+{
+    *len = key->values[index].namelen;
+    return key->values[index].name;
+}
+
+/* check if a new entry should be appended to the unsorted ones instead of being inserted at index */
+static inline int is_unsorted_insert( const struct key_index *index, int pos, int count )
+{
+    return index->unsorted || (pos < count && count >= MIN_INDEXED);
+}
+
+/* get the hash table slot of a name */
+static inline unsigned int get_index_slot( const struct key_index *index, const WCHAR *name, data_size_t len )
+{
+    return hash_strW( name, len, ~0u ) & (index->size - 1);
+}
+
+/* add an unsorted array entry to the hash table */
+static void add_index_entry( struct key_index *index, const struct key *key, int pos,
+                             const WCHAR *(*get_name)( const struct key *, int, data_size_t * ) )
+{
+    unsigned int slot;
+    const WCHAR *name;
+    data_size_t len;
+
+    name = get_name( key, pos, &len );
+    for (slot = get_index_slot( index, name, len ); index->table[slot]; slot = (slot + 1) & (index->size - 1))
+        ;
+    index->table[slot] = pos + 1;
+}
+
+/* make room in the hash table for one more unsorted entry after the count existing entries */
+static int grow_index( struct key_index *index, const struct key *key, int count,
+                       const WCHAR *(*get_name)( const struct key *, int, data_size_t * ) )
+{
+    unsigned int *table, size;
+    int i;
+
+    if (index->unsorted < index->size / 2) return 1;
+    size = max( index->size * 2, MIN_INDEXED );
+    if (!(table = mem_alloc( size * sizeof(*table) ))) return 0;
+    memset( table, 0, size * sizeof(*table) );
+    free( index->table );
+    index->table = table;
+    index->size  = size;
+    for (i = count - index->unsorted; i < count; i++) add_index_entry( index, key, i, get_name );
+    return 1;
+}
+
+/* find a name among the unsorted entries; return its position in the array or -1 */
+static int find_index_entry( const struct key_index *index, const struct key *key, const struct unicode_str *name,
+                             const WCHAR *(*get_name)( const struct key *, int, data_size_t * ) )
+{
+    unsigned int slot;
+    const WCHAR *entry;
+    data_size_t len;
+
+    if (!index->unsorted) return -1;
+    for (slot = get_index_slot( index, name->str, name->len ); index->table[slot];
+         slot = (slot + 1) & (index->size - 1))
+    {
+        entry = get_name( key, index->table[slot] - 1, &len );
+        if (!compare_names( entry, len, name->str, name->len )) return index->table[slot] - 1;
+    }
+    return -1;
+}
+
+static void free_index( struct key_index *index )
+{
+    free( index->table );
+    index->table    = NULL;
+    index->size     = 0;
+    index->unsorted = 0;
+}
+
+/* merge the unsorted entries at the end of an array with the sorted ones */
+static void merge_entries( void *array, size_t size, int count, int sorted,
+                           int (*compare)( const void *, const void * ) )
+{
+    char *base = array, *tail;
+    int i = sorted - 1, j = count - sorted - 1, k = count - 1;
+
+    if (!(tail = malloc( (count - sorted) * size )))
+    {
+        qsort( base, count, size, compare );
+        return;
+    }
+    qsort( base + sorted * size, count - sorted, size, compare );
+    memcpy( tail, base + sorted * size, (count - sorted) * size );
+    while (j >= 0)
+    {
+        if (i >= 0 && compare( base + i * size, tail + j * size ) > 0)
+            memcpy( base + k-- * size, base + i-- * size, size );
+        else
+            memcpy( base + k-- * size, tail + j-- * size, size );
+    }
+    free( tail );
+}
+
+/* sort the subkeys that were appended to a large key */
+static void sort_subkeys( struct key *key )
+{
+    struct key_index *index = &key->subkey_index;
+    int count = key->last_subkey + 1;
+
+    if (!index->unsorted) return;
+    merge_entries( key->subkeys, sizeof(*key->subkeys), count, count - index->unsorted, compare_subkeys );
+    free_index( index );
+}
+
+/* sort the values that were appended to a large key */
+static void sort_values( struct key *key )
+{
+    struct key_index *index = &key->value_index;
+    int count = key->last_value + 1;
+
+    if (!index->unsorted) return;
+    merge_entries( key->values, sizeof(*key->values), count, count - index->unsorted, compare_values );
+    free_index( index );
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -579,7 +831,7 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
                                  int index, timeout_t modif )
 {
     struct key *key;
-    int i;
+    int i, unsorted;
 
     if (name->len > MAX_NAME_LEN * sizeof(WCHAR))
     {
@@ -591,12 +843,23 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         /* need to grow the array */
         if (!grow_subkeys( parent )) return NULL;
     }
+    if ((unsorted = is_unsorted_insert( &parent->subkey_index, index, parent->last_subkey + 1 )))
+    {
+        if (!grow_index( &parent->subkey_index, parent, parent->last_subkey + 1, get_subkey_name ))
+            return NULL;
+        index = parent->last_subkey + 1;
+    }
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
+        if (unsorted)
+        {
+            add_index_entry( &parent->subkey_index, parent, index, get_subkey_name );
+            parent->subkey_index.unsorted++;
+        }
         if (is_wow6432node( key->name, key->namelen ) && !is_wow6432node( parent->name, parent->namelen ))
             parent->flags |= KEY_WOW64;
     }
@@ -611,6 +874,7 @@ static void free_subkey( struct key *parent, int index )
 
     assert( index >= 0 );
     assert( index <= parent->last_subkey );
+    assert( !parent->subkey_index.unsorted );
 
     key = parent->subkeys[index];
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
@@ -634,13 +898,23 @@ static void free_subkey( struct key *parent, int index )
 }
 
 /* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+static struct key *find_subkey( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->hive && !load_hive_key( key ))
+    {
+        *index = -1;  /* nowhere to insert it either */
+        return NULL;
+    }
+    if ((i = find_index_entry( &key->subkey_index, key, name, get_subkey_name )) != -1)
+    {
+        *index = i;
+        return key->subkeys[i];
+    }
     min = 0;
-    max = key->last_subkey;
+    max = key->last_subkey - key->subkey_index.unsorted;
     while (min <= max)
     {
         i = (min + max) / 2;
@@ -659,7 +933,7 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     return NULL;
 }
 
-/* return the wow64 variant of the key, or the key itself if none */
+/* return the wow64 variant of the key, or the key itself if none; NULL if the key can't be loaded */
 static struct key *find_wow64_subkey( struct key *key, const struct unicode_str *name )
 {
     static const struct unicode_str wow6432node_str = { wow6432node, sizeof(wow6432node) };
@@ -669,7 +943,7 @@ static struct key *find_wow64_subkey( struct key *key, const struct unicode_str
     if (!is_wow6432node( name->str, name->len ))
     {
         key = find_subkey( key, &wow6432node_str, &index );
-        assert( key );  /* if KEY_WOW64 is set we must find it */
+        assert( key || index == -1 );  /* if KEY_WOW64 is set we must find it */
     }
     return key;
 }
@@ -712,24 +986,25 @@ static struct key *open_key_prefix( struct key *key, const struct unicode_str *n
 {
     token->str = NULL;
     if (!get_path_token( name, token )) return NULL;
-    if (access & KEY_WOW64_32KEY) key = find_wow64_subkey( key, token );
+    if ((access & KEY_WOW64_32KEY) && !(key = find_wow64_subkey( key, token ))) return NULL;
     while (token->len)
     {
         struct key *subkey;
         if (!(subkey = find_subkey( key, token, index )))
         {
+            if (*index == -1) return NULL;
             if ((key->flags & KEY_WOWSHARE) && !(access & KEY_WOW64_64KEY))
             {
                 /* try in the 64-bit parent */
                 key = key->parent;
-                subkey = find_subkey( key, token, index );
+                if (!(subkey = find_subkey( key, token, index )) && *index == -1) return NULL;
             }
         }
         if (!subkey) break;
         key = subkey;
         get_path_token( name, token );
         if (!token->len) break;
-        if (!(access & KEY_WOW64_64KEY)) key = find_wow64_subkey( key, token );
+        if (!(access & KEY_WOW64_64KEY) && !(key = find_wow64_subkey( key, token ))) return NULL;
         if (!(key = follow_symlink( key, 0 )))
         {
             set_error( STATUS_OBJECT_NAME_NOT_FOUND );
@@ -753,7 +1028,7 @@ static struct key *open_key( struct key *key, const struct unicode_str *name, un
         set_error( STATUS_OBJECT_NAME_NOT_FOUND );
         return NULL;
     }
-    if (!(access & KEY_WOW64_64KEY)) key = find_wow64_subkey( key, &token );
+    if (!(access & KEY_WOW64_64KEY) && !(key = find_wow64_subkey( key, &token ))) return NULL;
     if (!(attributes & OBJ_OPENLINK) && !(key = follow_symlink( key, 0 )))
     {
         set_error( STATUS_OBJECT_NAME_NOT_FOUND );
@@ -778,7 +1053,7 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
 
     if (!token.len)  /* the key already exists */
     {
-        if (!(access & KEY_WOW64_64KEY)) key = find_wow64_subkey( key, &token );
+        if (!(access & KEY_WOW64_64KEY) && !(key = find_wow64_subkey( key, &token ))) return NULL;
         if (options & REG_OPTION_CREATE_LINK)
         {
             set_error( STATUS_OBJECT_NAME_COLLISION );
@@ -843,7 +1118,11 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
     while (token.len)
     {
         struct key *subkey;
-        if (!(subkey = find_subkey( key, &token, &index ))) break;
+        if (!(subkey = find_subkey( key, &token, &index )))
+        {
+            if (index == -1) return NULL;
+            break;
+        }
         key = subkey;
         if (!(key = follow_symlink( key, 0 )))
         {
@@ -875,7 +1154,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
+static void enum_key( struct key *key, int index, int info_class,
                       struct enum_key_reply *reply )
 {
     static const WCHAR backslash[] = { '\\' };
@@ -886,6 +1165,7 @@ static void enum_key( const struct key *key, int index, int info_class,
     const struct key *k;
     char *data;
 
+    if (key->hive && !load_hive_key( key )) return;
     if (index != -1)  /* -1 means use the specified key directly */
     {
         if ((index < 0) || (index > key->last_subkey))
@@ -893,8 +1173,10 @@ static void enum_key( const struct key *key, int index, int info_class,
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
+    if (key->hive && !load_hive_key( key )) return;
 
     namelen = key->namelen;
     classlen = key->classlen;
@@ -994,10 +1276,12 @@ static int delete_key( struct key *key, int recurse )
     }
     assert( parent );
 
+    if (key->hive && !load_hive_key( key )) return -1;
     while (recurse && (key->last_subkey>=0))
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
             return -1;
 
+    sort_subkeys( parent );  /* the following subkeys are moved down */
     for (index = 0; index <= parent->last_subkey; index++)
         if (parent->subkeys[index] == key) break;
     assert( index <= parent->last_subkey );
@@ -1010,6 +1294,7 @@ static int delete_key( struct key *key, int recurse )
     }
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
+    if (use_registry_hive) journal_deleted_key( key );
     free_subkey( parent, index );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 0;
@@ -1041,13 +1326,23 @@ static int grow_values( struct key *key )
 }
 
 /* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->hive && !load_hive_key( key ))
+    {
+        *index = -1;  /* nowhere to insert it either */
+        return NULL;
+    }
+    if ((i = find_index_entry( &key->value_index, key, name, get_value_name )) != -1)
+    {
+        *index = i;
+        return &key->values[i];
+    }
     min = 0;
-    max = key->last_value;
+    max = key->last_value - key->value_index.unsorted;
     while (min <= max)
     {
         i = (min + max) / 2;
@@ -1071,7 +1366,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
+    int i, unsorted;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1082,6 +1377,11 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     {
         if (!grow_values( key )) return NULL;
     }
+    if ((unsorted = is_unsorted_insert( &key->value_index, index, key->last_value + 1 )))
+    {
+        if (!grow_index( &key->value_index, key, key->last_value + 1, get_value_name )) return NULL;
+        index = key->last_value + 1;
+    }
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
     value = &key->values[index];
@@ -1089,6 +1389,11 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    if (unsorted)
+    {
+        add_index_entry( &key->value_index, key, index, get_value_name );
+        key->value_index.unsorted++;
+    }
     return value;
 }
 
@@ -1110,6 +1415,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
             return;
         }
     }
+    else if (index == -1) return;
 
     if (key->flags & KEY_SYMLINK)
     {
@@ -1156,7 +1462,7 @@ static void get_value( struct key *key, const struct unicode_str *name, int *typ
     else
     {
         *type = -1;
-        set_error( STATUS_OBJECT_NAME_NOT_FOUND );
+        if (index != -1) set_error( STATUS_OBJECT_NAME_NOT_FOUND );
     }
 }
 
@@ -1165,6 +1471,8 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 {
     struct key_value *value;
 
+    if (key->hive && !load_hive_key( key )) return;
+    sort_values( key );
     if (i < 0 || i > key->last_value) set_error( STATUS_NO_MORE_ENTRIES );
     else
     {
@@ -1217,6 +1525,8 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     struct key_value *value;
     int i, index, nb_values;
 
+    if (key->hive && !load_hive_key( key )) return;
+    sort_values( key );  /* the following values are moved down */
     if (!(value = find_value( key, name, &index )))
     {
         set_error( STATUS_OBJECT_NAME_NOT_FOUND );
@@ -1516,7 +1826,7 @@ static struct key_value *parse_value_name( struct key *key, const char *buffer,
     if (buffer[*len] != '=') goto error;
     (*len)++;
     while (isspace(buffer[*len])) (*len)++;
-    if (!(value = find_value( key, &name, &index ))) value = insert_value( key, &name, index );
+    if (!(value = find_value( key, &name, &index )) && index != -1) value = insert_value( key, &name, index );
     return value;
 
  error:
@@ -1691,6 +2001,16 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
     free( info.tmp );
 }
 
+/* mark a branch loaded at run time as modified, so that it gets added to the journal */
+static void make_tree_dirty( struct key *key )
+{
+    int i;
+
+    if (key->hive || (key->flags & KEY_VOLATILE)) return;
+    make_dirty( key );
+    for (i = 0; i <= key->last_subkey; i++) make_tree_dirty( key->subkeys[i] );
+}
+
 /* load a part of the registry from a file */
 static void load_registry( struct key *key, obj_handle_t handle )
 {
@@ -1707,33 +2027,559 @@ static void load_registry( struct key *key, obj_handle_t handle )
         {
             load_keys( key, NULL, f, -1 );
             fclose( f );
+            if (use_registry_hive) make_tree_dirty( key );
         }
         else file_set_error();
     }
 }
 
+/* build the name of a hive file from the name of the text file */
+static char *get_hive_file_name( const char *path, const char *ext )
+{
+    const char *p = strrchr( path, '.' );
+    size_t len = p ? p - path : strlen( path );
+    char *ret;
+
+    if (!(ret = malloc( len + strlen( ext ) + 1 ))) fatal_error( "out of memory\n" );
+    memcpy( ret, path, len );
+    strcpy( ret + len, ext );
+    return ret;
+}
+
+static inline const unsigned int *get_hive_subkeys( const struct hive_key *rec )
+{
+    return (const unsigned int *)(rec + 1);
+}
+
+static inline const struct hive_value *get_hive_values( const struct hive_key *rec )
+{
+    return (const struct hive_value *)(get_hive_subkeys( rec ) + rec->nb_subkeys);
+}
+
+static inline const WCHAR *get_hive_key_name( const struct hive_key *rec )
+{
+    return (const WCHAR *)(get_hive_values( rec ) + rec->nb_values);
+}
+
+/* check that a key record is consistent and fits in the available size */
+static int check_hive_key( const struct hive_key *rec, size_t avail )
+{
+    const struct hive_value *values;
+    unsigned int i, pos;
+
+    if (avail < sizeof(*rec) || rec->size < sizeof(*rec) || rec->size > avail || (rec->size & 7)) return 0;
+    pos = sizeof(*rec);
+    if (rec->nb_subkeys > (rec->size - pos) / sizeof(unsigned int)) return 0;
+    pos += rec->nb_subkeys * sizeof(unsigned int);
+    if (rec->nb_values > (rec->size - pos) / sizeof(*values)) return 0;
+    pos += rec->nb_values * sizeof(*values);
+    if (rec->namelen > rec->size - pos) return 0;
+    pos += rec->namelen;
+    if (rec->classlen > rec->size - pos) return 0;
+
+    values = get_hive_values( rec );
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        if (values[i].offset > rec->size) return 0;
+        if (values[i].namelen > rec->size - values[i].offset) return 0;
+        if (values[i].len > rec->size - values[i].offset - values[i].namelen) return 0;
+    }
+    return 1;
+}
+
+/* find the branch whose mapped hive contains a key record */
+static struct save_branch_info *get_hive_branch( const struct hive_key *rec )
+{
+    int i;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        const char *hive = save_branch_info[i].hive;
+        if (hive && (const char *)rec >= hive && (const char *)rec < hive + save_branch_info[i].hive_size)
+            return &save_branch_info[i];
+    }
+    assert( 0 );
+    return NULL;
+}
+
+/* find the branch containing a key */
+static struct save_branch_info *get_key_branch( const struct key *key )
+{
+    int i;
+
+    for ( ; key; key = key->parent)
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch_info[i].key == key) return &save_branch_info[i];
+    return NULL;
+}
+
+/* initialize a key from its hive record; the subkeys and values are loaded on first access */
+static void init_key_from_hive( struct key *key, const struct hive_key *rec )
+{
+    key->hive   = rec;
+    key->modif  = rec->modif;
+    key->flags |= rec->flags & HIVE_KEY_FLAGS;
+    if (rec->classlen)
+    {
+        free( key->class );
+        key->classlen = rec->classlen;
+        if (!(key->class = memdup( (const char *)get_hive_key_name( rec ) + rec->namelen, rec->classlen )))
+            key->classlen = 0;
+    }
+}
+
+/* create the subkeys and values of a key from its hive record */
+/* the key is only updated once everything is loaded, a failed load leaves it untouched */
+static int load_hive_key( struct key *key )
+{
+    const struct hive_key *rec = key->hive;
+    const unsigned int *subkeys = get_hive_subkeys( rec );
+    const struct hive_value *values = get_hive_values( rec );
+    struct save_branch_info *branch = get_hive_branch( rec );
+    struct key **new_subkeys = NULL;
+    struct key_value *new_values = NULL;
+    unsigned int status = STATUS_NO_MEMORY;
+    int i, last_subkey = -1, last_value = -1;
+
+    if (rec->nb_subkeys &&
+        !(new_subkeys = malloc( max( rec->nb_subkeys, MIN_SUBKEYS ) * sizeof(*new_subkeys) )))
+        goto failed;
+    if (rec->nb_values &&
+        !(new_values = malloc( max( rec->nb_values, MIN_VALUES ) * sizeof(*new_values) )))
+        goto failed;
+
+    for (i = 0; i < rec->nb_subkeys; i++)
+    {
+        const struct hive_key *sub = (const struct hive_key *)(branch->hive + subkeys[i]);
+        struct unicode_str name;
+        struct key *subkey;
+
+        /* subkeys are always stored before their parent, this also prevents loops */
+        if ((subkeys[i] & 7) || subkeys[i] < sizeof(struct hive_header) ||
+            (const char *)sub >= (const char *)rec ||
+            !check_hive_key( sub, branch->hive_size - subkeys[i] ))
+        {
+            fprintf( stderr, "wineserver: corrupted key record in %s\n", branch->hive_path );
+            status = STATUS_REGISTRY_CORRUPT;
+            goto failed;
+        }
+        name.str = get_hive_key_name( sub );
+        name.len = sub->namelen;
+        if (!(subkey = alloc_key( &name, sub->modif ))) goto failed;
+        init_key_from_hive( subkey, sub );
+        subkey->parent = key;
+        new_subkeys[++last_subkey] = subkey;
+    }
+
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        struct key_value *value = &new_values[i];
+        const char *ptr = (const char *)rec + values[i].offset;
+
+        value->namelen = values[i].namelen;
+        value->type    = values[i].type;
+        value->len     = values[i].len;
+        value->name    = NULL;
+        value->data    = NULL;
+        if (value->namelen && !(value->name = memdup( ptr, value->namelen ))) goto failed;
+        if (value->len && !(value->data = memdup( ptr + value->namelen, value->len )))
+        {
+            free( value->name );
+            goto failed;
+        }
+        last_value = i;
+    }
+
+    key->hive = NULL;
+    if (new_subkeys)
+    {
+        key->subkeys     = new_subkeys;
+        key->nb_subkeys  = max( rec->nb_subkeys, MIN_SUBKEYS );
+        key->last_subkey = last_subkey;
+    }
+    if (new_values)
+    {
+        key->values     = new_values;
+        key->nb_values  = max( rec->nb_values, MIN_VALUES );
+        key->last_value = last_value;
+    }
+    return 1;
+
+failed:
+    for (i = 0; i <= last_subkey; i++)
+    {
+        new_subkeys[i]->parent = NULL;
+        release_object( new_subkeys[i] );
+    }
+    for (i = 0; i <= last_value; i++)
+    {
+        free( new_values[i].name );
+        free( new_values[i].data );
+    }
+    free( new_subkeys );
+    free( new_values );
+    set_error( status );
+    return 0;
+}
+
+/* reserve space at the end of a hive buffer */
+static void *reserve_hive_buffer( struct hive_buffer *buffer, size_t size )
+{
+    char *ptr;
+
+    if (buffer->size + size > buffer->alloc)
+    {
+        size_t new_alloc = max( max( buffer->alloc * 2, buffer->size + size ), 65536 );
+
+        if (!(ptr = realloc( buffer->data, new_alloc )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        buffer->data  = ptr;
+        buffer->alloc = new_alloc;
+    }
+    ptr = buffer->data + buffer->size;
+    memset( ptr, 0, size );
+    buffer->size += size;
+    return ptr;
+}
+
+/* append a key record to a hive buffer; key is NULL for a deleted key */
+static int write_key_record( struct hive_buffer *buffer, const struct key *key, const WCHAR *name,
+                             data_size_t namelen, unsigned int flags,
+                             const unsigned int *subkeys, unsigned int nb_subkeys )
+{
+    unsigned int i, nb_values = key ? key->last_value + 1 : 0;
+    data_size_t classlen = key ? key->classlen : 0;
+    struct hive_value *values;
+    struct hive_key *rec;
+    size_t size, pos;
+    char *ptr;
+
+    size = sizeof(*rec) + nb_subkeys * sizeof(*subkeys) + nb_values * sizeof(*values) + namelen + classlen;
+    /* value names are aligned to a WCHAR */
+    for (i = 0; i < nb_values; i++) size += (key->values[i].namelen + key->values[i].len + 1) & ~1;
+    size = (size + 7) & ~7;
+    if (size > UINT_MAX)
+    {
+        set_error( STATUS_NO_MEMORY );
+        return 0;
+    }
+    if (!(ptr = reserve_hive_buffer( buffer, size ))) return 0;
+
+    rec = (struct hive_key *)ptr;
+    rec->size       = size;
+    rec->flags      = flags;
+    rec->modif      = key ? key->modif : 0;
+    rec->namelen    = namelen;
+    rec->classlen   = classlen;
+    rec->nb_subkeys = nb_subkeys;
+    rec->nb_values  = nb_values;
+    if (nb_subkeys) memcpy( rec + 1, subkeys, nb_subkeys * sizeof(*subkeys) );
+    values = (struct hive_value *)((unsigned int *)(rec + 1) + nb_subkeys);
+    pos = (char *)(values + nb_values) - ptr;
+    if (namelen) memcpy( ptr + pos, name, namelen );
+    pos += namelen;
+    if (classlen) memcpy( ptr + pos, key->class, classlen );
+    pos += classlen;
+    for (i = 0; i < nb_values; i++)
+    {
+        const struct key_value *value = &key->values[i];
+
+        pos = (pos + 1) & ~1;
+        values[i].type    = value->type;
+        values[i].len     = value->len;
+        values[i].namelen = value->namelen;
+        values[i].offset  = pos;
+        if (value->namelen) memcpy( ptr + pos, value->name, value->namelen );
+        pos += value->namelen;
+        if (value->len) memcpy( ptr + pos, value->data, value->len );
+        pos += value->len;
+    }
+    return 1;
+}
+
+/* build the path of a key relative to the base key of its branch */
+static WCHAR *get_branch_path( const struct key *key, const struct key *base, data_size_t *len )
+{
+    const struct key *k;
+    data_size_t pos = 0;
+    WCHAR *path;
+
+    for (k = key; k != base; k = k->parent) pos += k->namelen + sizeof(WCHAR);
+    if (!(path = mem_alloc( pos + sizeof(WCHAR) ))) return NULL;
+    *len = pos ? pos - sizeof(WCHAR) : 0;
+    for (k = key, pos = *len; k != base; k = k->parent)
+    {
+        pos -= k->namelen;
+        memcpy( (char *)path + pos, k->name, k->namelen );
+        if (!pos) break;
+        pos -= sizeof(WCHAR);
+        path[pos / sizeof(WCHAR)] = '\\';
+    }
+    return path;
+}
+
+/* write a key and its subkeys to a hive file; return the offset of the key record, or 0 on error */
+static unsigned int save_hive_keys( struct key *key, const struct key *base, FILE *f,
+                                    struct hive_buffer *buffer, size_t *written )
+{
+    unsigned int *subkeys = NULL, nb_subkeys = 0, offset = 0;
+    size_t pos;
+    int i;
+
+    if (key->hive && !load_hive_key( key )) return 0;
+    sort_subkeys( key );
+    sort_values( key );
+    if (key->last_subkey >= 0 && !(subkeys = mem_alloc( (key->last_subkey + 1) * sizeof(*subkeys) )))
+        return 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        if (key->subkeys[i]->flags & KEY_VOLATILE) continue;
+        if (!(subkeys[nb_subkeys++] = save_hive_keys( key->subkeys[i], base, f, buffer, written ))) goto done;
+    }
+
+    pos = *written + buffer->size;
+    if (pos > UINT_MAX) goto done;
+    if (!write_key_record( buffer, key, key == base ? NULL : key->name, key == base ? 0 : key->namelen,
+                           key->flags & HIVE_KEY_FLAGS, subkeys, nb_subkeys ))
+        goto done;
+    offset = pos;
+
+    if (buffer->size >= 65536)
+    {
+        if (fwrite( buffer->data, buffer->size, 1, f ) != 1) offset = 0;
+        *written += buffer->size;
+        buffer->size = 0;
+    }
+done:
+    free( subkeys );
+    return offset;
+}
+
+/* append journal records for the modified keys of a branch */
+static int save_journal_keys( struct key *key, const struct key *base, struct hive_buffer *buffer )
+{
+    data_size_t len;
+    WCHAR *path;
+    int i, ret;
+
+    if ((key->flags & (KEY_DIRTY | KEY_VOLATILE)) != KEY_DIRTY) return 1;
+    if (key->hive && !load_hive_key( key )) return 0;
+    sort_values( key );
+    if (!(path = get_branch_path( key, base, &len ))) return 0;
+    ret = write_key_record( buffer, key, path, len, key->flags & HIVE_KEY_FLAGS, NULL, 0 );
+    free( path );
+    for (i = 0; ret && i <= key->last_subkey; i++) ret = save_journal_keys( key->subkeys[i], base, buffer );
+    return ret;
+}
+
+/* record the deletion of a key for the next journal update */
+static void journal_deleted_key( const struct key *key )
+{
+    struct save_branch_info *branch = get_key_branch( key );
+    data_size_t len;
+    WCHAR *path;
+
+    /* without a hive, the whole branch is written on the next save anyway */
+    if (!branch || !branch->generation || (key->flags & KEY_VOLATILE)) return;
+    if (!(path = get_branch_path( key, branch->key, &len ))) return;
+    write_key_record( &branch->deleted, NULL, path, len, HIVE_KEY_DELETED, NULL, 0 );
+    free( path );
+}
+
+/* apply a journal record to a registry branch */
+static void load_journal_key( struct key *base, const struct hive_key *rec )
+{
+    const struct hive_value *values = get_hive_values( rec );
+    struct unicode_str path, token;
+    struct key_value *value;
+    struct key *key = base;
+    int i, index;
+
+    path.str = get_hive_key_name( rec );
+    path.len = rec->namelen;
+    token.str = NULL;
+    if (!get_path_token( &path, &token )) return;
+    while (token.len)
+    {
+        struct key *subkey;
+
+        /* don't follow symlinks, the path is the physical location of the key */
+        if (!(subkey = find_subkey( key, &token, &index )))
+        {
+            if (index == -1 || (rec->flags & HIVE_KEY_DELETED)) return;
+            if (!(subkey = alloc_subkey( key, &token, index, rec->modif ))) return;
+        }
+        key = subkey;
+        get_path_token( &path, &token );
+    }
+
+    if (rec->flags & HIVE_KEY_DELETED)
+    {
+        if (key != base) delete_key( key, 1 );
+        return;
+    }
+
+    if (key->hive && !load_hive_key( key )) return;
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+    free_index( &key->value_index );
+    for (i = 0; i < (int)rec->nb_values; i++)
+    {
+        const char *ptr = (const char *)rec + values[i].offset;
+        struct unicode_str name;
+
+        name.str = (const WCHAR *)ptr;
+        name.len = values[i].namelen;
+        if (!(value = insert_value( key, &name, key->last_value + 1 ))) break;
+        value->type = values[i].type;
+        if (values[i].len && !(value->data = memdup( ptr + name.len, values[i].len ))) break;
+        value->len = values[i].len;
+    }
+
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    if (rec->classlen && (key->class = memdup( (const char *)path.str + path.len, rec->classlen )))
+        key->classlen = rec->classlen;
+    key->flags = (key->flags & ~KEY_SYMLINK) | (rec->flags & KEY_SYMLINK);
+    key->modif = rec->modif;
+}
+
+/* replay the journal of a branch on top of its hive */
+static void load_journal( struct save_branch_info *info )
+{
+    const struct hive_header *header;
+    struct stat st;
+    size_t pos = 0;
+    char *data;
+    int fd;
+
+    info->journal_size = 0;
+    if ((fd = open( info->journal_path, O_RDONLY )) == -1) return;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || !(data = mem_alloc( st.st_size )))
+    {
+        close( fd );
+        return;
+    }
+    while (pos < st.st_size)
+    {
+        ssize_t ret = read( fd, data + pos, st.st_size - pos );
+        if (ret <= 0) break;
+        pos += ret;
+    }
+    close( fd );
+
+    header = (const struct hive_header *)data;
+    if (pos == st.st_size && !memcmp( header->magic, journal_magic, sizeof(header->magic) ) &&
+        header->version == HIVE_VERSION && header->generation == info->generation)
+    {
+        for (pos = sizeof(*header); pos < st.st_size; pos += ((const struct hive_key *)(data + pos))->size)
+        {
+            /* stop at a record that was only partially written */
+            if (!check_hive_key( (const struct hive_key *)(data + pos), st.st_size - pos )) break;
+            load_journal_key( info->key, (const struct hive_key *)(data + pos) );
+        }
+        info->journal_size = pos;
+        info->deleted.size = 0;
+        make_clean( info->key );
+    }
+    free( data );
+}
+
+/* map the binary hive of a branch; return 1 if loaded, 0 if not usable, -1 on error */
+static int load_hive( struct save_branch_info *info )
+{
+    const struct hive_header *header;
+    struct key *key = info->key;
+    struct stat st;
+    void *ptr;
+    int fd;
+
+    if ((fd = open( info->hive_path, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > UINT_MAX ||
+        (ptr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    header = ptr;
+    if (memcmp( header->magic, hive_magic, sizeof(header->magic) ) || header->version != HIVE_VERSION ||
+        header->size != st.st_size || header->arch > PREFIX_64BIT || (header->root & 7) ||
+        header->root < sizeof(*header) || header->root >= header->size ||
+        !check_hive_key( (const struct hive_key *)((char *)ptr + header->root), header->size - header->root ) ||
+        key->last_subkey != -1 || key->last_value != -1)
+    {
+        fprintf( stderr, "wineserver: %s is not a valid registry hive\n", info->hive_path );
+        munmap( ptr, st.st_size );
+        return 0;
+    }
+    if (header->arch != PREFIX_UNKNOWN)
+    {
+        if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->arch;
+        else if (header->arch != prefix_type)
+        {
+            munmap( ptr, st.st_size );
+            return -1;
+        }
+    }
+
+    info->hive = ptr;
+    info->hive_size = st.st_size;
+    info->generation = header->generation;
+    init_key_from_hive( key, (const struct hive_key *)(info->hive + header->root) );
+    load_journal( info );
+    return 1;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
-    FILE *f;
+    struct save_branch_info *info;
+    FILE *f = NULL;
+    int ret;
+
+    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+
+    info = &save_branch_info[save_branch_count++];
+    info->path = filename;
+    info->key = key;
+    info->hive_path = get_hive_file_name( filename, ".hive" );
+    info->journal_path = get_hive_file_name( filename, ".journal" );
 
-    if ((f = fopen( filename, "r" )))
+    /* a hive takes precedence, it is removed when the branch is converted back to text */
+    if ((ret = load_hive( info )) == -1)
+    {
+        fprintf( stderr, "%s is not a valid registry file\n", info->hive_path );
+        save_branch_count--;
+        return 1;
+    }
+    if (!ret && (f = fopen( filename, "r" )))
     {
         load_keys( key, filename, f, 0 );
         fclose( f );
         if (get_error() == STATUS_NOT_REGISTRY_FILE)
         {
             fprintf( stderr, "%s is not a valid registry file\n", filename );
+            save_branch_count--;
             return 1;
         }
     }
 
-    assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
+    /* make sure the branch gets converted if it's not in the requested format */
+    if ((ret || f) && !info->generation != !use_registry_hive) make_dirty( key );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    grab_object( key );
     make_object_static( &key->obj );
-    return (f != NULL);
+    return (ret || f);
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1796,6 +2642,8 @@ void init_registry(void)
     struct key *key, *hklm, *hkcu;
     char *p;
 
+    use_registry_hive = (p = getenv( "WINEREGHIVE" )) && atoi( p );
+
     /* switch to the config dir */
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
@@ -1868,7 +2716,7 @@ void init_registry(void)
 }
 
 /* save a registry branch to a file */
-static void save_all_subkeys( struct key *key, FILE *f )
+static int save_all_subkeys( struct key *key, FILE *f )
 {
     fprintf( f, "WINE REGISTRY Version 2\n" );
     fprintf( f, ";; All keys relative to " );
@@ -1885,7 +2733,7 @@ static void save_all_subkeys( struct key *key, FILE *f )
     default:
         break;
     }
-    save_subkeys( key, key, f );
+    return save_subkeys( key, key, f );
 }
 
 /* save a registry branch to a file handle */
@@ -1902,8 +2750,8 @@ static void save_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "w" );
         if (f)
         {
-            save_all_subkeys( key, f );
-            if (fclose( f )) file_set_error();
+            if (!save_all_subkeys( key, f )) fclose( f );
+            else if (fclose( f )) file_set_error();
         }
         else
         {
@@ -1971,8 +2819,8 @@ static int save_branch( struct key *key, const char *path )
         dump_operation( key, NULL, "saving" );
     }
 
-    save_all_subkeys( key, f );
-    ret = !fclose(f);
+    ret = save_all_subkeys( key, f );
+    if (fclose( f )) ret = 0;
 
     if (tmp)
     {
@@ -1987,6 +2835,145 @@ done:
     return ret;
 }
 
+/* write a complete hive for a branch; the journal starts over */
+static int save_hive( struct save_branch_info *info )
+{
+    struct hive_header header;
+    struct hive_buffer buffer = { NULL, 0, 0 };
+    size_t written = sizeof(header);
+    char *tmp;
+    FILE *f;
+    int ret = 0;
+
+    if (!(tmp = malloc( strlen( info->hive_path ) + 5 ))) return 0;
+    sprintf( tmp, "%s.tmp", info->hive_path );
+    if (!(f = fopen( tmp, "w" )))
+    {
+        free( tmp );
+        return 0;
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->hive_path );
+        dump_operation( info->key, NULL, "saving" );
+    }
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, hive_magic, sizeof(header.magic) );
+    header.version    = HIVE_VERSION;
+    header.arch       = prefix_type;
+    header.generation = max( current_time, info->generation + 1 );
+    if (fwrite( &header, sizeof(header), 1, f ) == 1 &&
+        (header.root = save_hive_keys( info->key, info->key, f, &buffer, &written )) &&
+        (!buffer.size || fwrite( buffer.data, buffer.size, 1, f ) == 1) &&
+        written + buffer.size <= UINT_MAX)
+    {
+        header.size = written + buffer.size;
+        ret = !fseek( f, 0, SEEK_SET ) && fwrite( &header, sizeof(header), 1, f ) == 1;
+    }
+    /* make sure the data is on disk before the rename replaces the old hive */
+    if (ret && (fflush( f ) || fsync( fileno( f ) ))) ret = 0;
+    if (fclose( f )) ret = 0;
+    if (ret) ret = !rename( tmp, info->hive_path );
+    if (!ret) unlink( tmp );
+    free( tmp );
+    free( buffer.data );
+    if (!ret) return 0;
+
+    /* all the keys have been loaded, the previous hive is no longer needed */
+    if (info->hive) munmap( info->hive, info->hive_size );
+    unlink( info->journal_path );
+    info->hive = NULL;
+    info->hive_size = header.size;
+    info->generation = header.generation;
+    info->journal_size = 0;
+    info->deleted.size = 0;
+    make_clean( info->key );
+    return 1;
+}
+
+/* append the modified keys of a branch to its journal */
+static int save_journal( struct save_branch_info *info )
+{
+    struct hive_buffer *buffer = &info->deleted;
+    size_t start = buffer->size, pos = 0;
+    struct hive_header header;
+    int fd, ret;
+
+    /* the records of the deleted keys are already in the buffer */
+    if (!save_journal_keys( info->key, info->key, buffer )) goto failed;
+    if ((fd = open( info->journal_path, O_WRONLY | O_CREAT, 0666 )) == -1) goto failed;
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->journal_path );
+        dump_operation( info->key, NULL, "saving" );
+    }
+
+    if (!info->journal_size)
+    {
+        memset( &header, 0, sizeof(header) );
+        memcpy( header.magic, journal_magic, sizeof(header.magic) );
+        header.version    = HIVE_VERSION;
+        header.arch       = prefix_type;
+        header.generation = info->generation;
+        ret = !ftruncate( fd, 0 ) && write( fd, &header, sizeof(header) ) == sizeof(header);
+        if (ret) info->journal_size = sizeof(header);
+    }
+    /* get rid of a partially written record */
+    else ret = !ftruncate( fd, info->journal_size ) && lseek( fd, info->journal_size, SEEK_SET ) != -1;
+
+    while (ret && pos < buffer->size)
+    {
+        ssize_t size = write( fd, buffer->data + pos, buffer->size - pos );
+        if (size <= 0) ret = 0;
+        else pos += size;
+    }
+    if (ret && fsync( fd )) ret = 0;
+    if (close( fd )) ret = 0;
+    if (!ret) goto failed;
+
+    info->journal_size += buffer->size;
+    buffer->size = 0;
+    make_clean( info->key );
+    return 1;
+
+failed:
+    buffer->size = start;
+    return 0;
+}
+
+/* save a registry branch in the binary hive format */
+static int save_hive_branch( struct save_branch_info *info )
+{
+    if (!(info->key->flags & KEY_DIRTY))
+    {
+        if (debug_level > 1) dump_operation( info->key, NULL, "Not saving clean" );
+        return 1;
+    }
+    /* only rewrite the hive once the journal gets too large */
+    if (info->generation && info->journal_size < max( info->hive_size / 2, MIN_JOURNAL_SIZE ) &&
+        save_journal( info ))
+        return 1;
+    return save_hive( info );
+}
+
+/* save a registry branch in the requested format */
+static int save_registry_branch( struct save_branch_info *info )
+{
+    if (use_registry_hive) return save_hive_branch( info );
+    if (!save_branch( info->key, info->path )) return 0;
+    if (info->generation)
+    {
+        /* the branch has been converted back to text, the hive is obsolete */
+        unlink( info->hive_path );
+        unlink( info->journal_path );
+        info->generation = 0;
+    }
+    return 1;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -1994,8 +2981,7 @@ static void periodic_save( void *arg )
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    for (i = 0; i < save_branch_count; i++) save_registry_branch( &save_branch_info[i] );
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2015,10 +3001,10 @@ void flush_registry(void)
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_registry_branch( &save_branch_info[i] ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
-                     save_branch_info[i].path );
+                     use_registry_hive ? save_branch_info[i].hive_path : save_branch_info[i].path );
             perror( " " );
         }
     }
@@ -2107,9 +3093,16 @@ DECL_HANDLER(delete_key)
 DECL_HANDLER(flush_key)
 {
     struct key *key = get_hkey_obj( req->hkey, 0 );
+    struct save_branch_info *branch;
+
     if (key)
     {
-        /* we don't need to do anything here with the current implementation */
+        /* appending to the journal is cheap enough to write the changes right away */
+        if (use_registry_hive && (branch = get_key_branch( key )) && fchdir( config_dir_fd ) != -1)
+        {
+            if (!save_hive_branch( branch )) file_set_error();
+            if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+        }
         release_object( key );
     }
 }
@@ -51,6 +51,9 @@
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #ifdef __APPLE__
 # include <mach/mach_time.h>
 #endif
@@ -123,8 +126,8 @@ static const struct fd_ops master_socket_fd_ops =
 };
 
 
-struct thread *current = NULL;  /* thread handling the current request */
-unsigned int global_error = 0;  /* global error code for when no thread is current */
+server_thread_local struct thread *current = NULL;  /* thread handling the current request */
+server_thread_local unsigned int global_error = 0;  /* global error code for when no thread is current */
 timeout_t server_start_time = 0;  /* server startup time */
 char *server_dir = NULL;   /* server directory */
 int server_dir_fd = -1;    /* file descriptor for the server dir */
@@ -293,12 +296,563 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/* per-request dispatch statistics */
+struct request_stats
+{
+    unsigned int count;  /* number of calls */
+    timeout_t    total;  /* total time spent in the handler */
+    timeout_t    max;    /* longest single call */
+};
+
+static struct request_stats *req_stats;  /* NULL if statistics are disabled */
+static timeout_t stats_start_time;
+
+#ifdef SERVER_THREADS
+
+/* contention statistics of the server lock */
+struct lock_stats
+{
+    unsigned int count;      /* number of acquisitions */
+    unsigned int contended;  /* acquisitions that had to wait */
+    timeout_t    wait;       /* total time spent waiting */
+};
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct lock_stats exclusive_stats;  /* main thread */
+static struct lock_stats shared_stats;     /* worker threads */
+static unsigned int nb_workers;            /* number of worker threads, 0 if disabled */
+static unsigned int worker_requests;       /* number of requests handled by workers */
+
+static void dump_lock_stats( const char *name, const struct lock_stats *stats )
+{
+    fprintf( stderr, "wineserver: server lock %s: %u acquisitions, %u contended, %u.%03u ms waiting\n",
+             name, stats->count, stats->contended,
+             (unsigned int)(stats->wait / 10000), (unsigned int)(stats->wait / 10 % 1000) );
+}
+
+#endif  /* SERVER_THREADS */
+
+static int compare_request_stats( const void *a, const void *b )
+{
+    const struct request_stats *s1 = &req_stats[*(const enum request *)a];
+    const struct request_stats *s2 = &req_stats[*(const enum request *)b];
+
+    if (s1->total != s2->total) return s1->total < s2->total ? 1 : -1;
+    if (s1->count != s2->count) return s1->count < s2->count ? 1 : -1;
+    return 0;
+}
+
+/* dump the request statistics, most expensive requests first */
+void dump_request_stats(void)
+{
+    enum request order[REQ_NB_REQUESTS];
+    unsigned int i, nb = 0, count = 0;
+    timeout_t total = 0, elapsed;
+
+    if (!req_stats) return;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++)
+    {
+        if (!req_stats[i].count) continue;
+        order[nb++] = i;
+        count += req_stats[i].count;
+        /* the time of batched requests is already accounted for individually */
+        if (i != REQ_batch) total += req_stats[i].total;
+    }
+    qsort( order, nb, sizeof(order[0]), compare_request_stats );
+
+    elapsed = monotonic_counter() - stats_start_time;
+    fprintf( stderr, "wineserver: %u requests in %u.%03u s, request handlers busy %u.%03u s (%u%%)\n",
+             count, (unsigned int)(elapsed / TICKS_PER_SEC), (unsigned int)(elapsed / 10000 % 1000),
+             (unsigned int)(total / TICKS_PER_SEC), (unsigned int)(total / 10000 % 1000),
+             elapsed ? (unsigned int)(total * 100 / elapsed) : 0 );
+#ifdef SERVER_THREADS
+    if (nb_workers)
+    {
+        fprintf( stderr, "wineserver: %u requests handled by %u worker threads\n", worker_requests, nb_workers );
+        dump_lock_stats( "exclusive", &exclusive_stats );
+        dump_lock_stats( "shared", &shared_stats );
+    }
+#endif
+    fprintf( stderr, "%-32s %10s %14s %10s %10s\n", "request", "count", "total (ms)", "avg (us)", "max (us)" );
+    for (i = 0; i < nb; i++)
+    {
+        const struct request_stats *stats = &req_stats[order[i]];
+        fprintf( stderr, "%-32s %10u %10u.%03u %10u %10u\n", get_req_name( order[i] ), stats->count,
+                 (unsigned int)(stats->total / 10000), (unsigned int)(stats->total / 10 % 1000),
+                 (unsigned int)(stats->total / 10 / stats->count), (unsigned int)(stats->max / 10) );
+    }
+}
+
+/* enable the request statistics if requested by the environment */
+void init_request_stats(void)
+{
+    const char *env = getenv( "WINESERVER_STATS" );
+
+    if (!env || !atoi( env )) return;
+    if (!(req_stats = calloc( REQ_NB_REQUESTS, sizeof(*req_stats) ))) return;
+    stats_start_time = monotonic_counter();
+    atexit( dump_request_stats );
+}
+
+/* call a request handler, updating the statistics if enabled */
+static inline void dispatch_request( enum request req, union generic_reply *reply )
+{
+    struct request_stats *stats;
+    timeout_t start, time;
+
+    if (!req_stats)
+    {
+        req_handlers[req]( &current->req, reply );
+        return;
+    }
+
+    start = monotonic_counter();
+    req_handlers[req]( &current->req, reply );
+    time = monotonic_counter() - start;
+
+#ifdef SERVER_THREADS
+    if (nb_workers) pthread_mutex_lock( &stats_mutex );
+#endif
+    stats = &req_stats[req];
+    stats->count++;
+    stats->total += time;
+    if (time > stats->max) stats->max = time;
+#ifdef SERVER_THREADS
+    if (nb_workers) pthread_mutex_unlock( &stats_mutex );
+#endif
+}
+
+#ifdef SERVER_THREADS
+
+/*
+ * Parallel dispatch of read-only requests (WINESERVER_THREADS)
+ *
+ * All server state is protected by a single read-write lock. The main
+ * thread holds it exclusively, except while it waits for events in the
+ * main loop. Requests that only read server state are handed to worker
+ * threads, which run them while holding the lock shared. They only run
+ * while the main thread is idle, but several of them run at the same time.
+ *
+ * Worker threads don't touch object reference counts or the poll state.
+ * The main thread releases the threads that the workers served, and it
+ * finishes the replies that could not be written at once.
+ */
+
+struct dispatch_wakeup
+{
+    struct object        obj;         /* object header */
+    struct fd           *fd;          /* file descriptor for the pipe side */
+    int                  pipe_write;  /* unix fd for the pipe write side */
+};
+
+static void dispatch_wakeup_dump( struct object *obj, int verbose );
+static void dispatch_wakeup_destroy( struct object *obj );
+static void dispatch_wakeup_poll_event( struct fd *fd, int event );
+
+static const struct object_ops dispatch_wakeup_ops =
+{
+    sizeof(struct dispatch_wakeup),  /* size */
+    dispatch_wakeup_dump,            /* dump */
+    no_get_type,                     /* get_type */
+    no_add_queue,                    /* add_queue */
+    NULL,                            /* remove_queue */
+    NULL,                            /* signaled */
+    NULL,                            /* satisfied */
+    no_signal,                       /* signal */
+    no_get_fd,                       /* get_fd */
+    no_map_access,                   /* map_access */
+    default_get_sd,                  /* get_sd */
+    default_set_sd,                  /* set_sd */
+    no_lookup_name,                  /* lookup_name */
+    no_link_name,                    /* link_name */
+    NULL,                            /* unlink_name */
+    no_open_file,                    /* open_file */
+    no_kernel_obj_list,              /* get_kernel_obj_list */
+    no_close_handle,                 /* close_handle */
+    dispatch_wakeup_destroy          /* destroy */
+};
+
+static const struct fd_ops dispatch_wakeup_fd_ops =
+{
+    NULL,                            /* get_poll_events */
+    dispatch_wakeup_poll_event,      /* poll_event */
+    NULL,                            /* flush */
+    NULL,                            /* get_fd_type */
+    NULL,                            /* ioctl */
+    NULL,                            /* queue_async */
+    NULL                             /* reselect_async */
+};
+
+static pthread_rwlock_t server_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t dispatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dispatch_cond = PTHREAD_COND_INITIALIZER;
+static struct list dispatch_queue = LIST_INIT( dispatch_queue );  /* threads waiting for a worker */
+static struct list dispatch_done = LIST_INIT( dispatch_done );    /* threads served by a worker */
+static struct dispatch_wakeup *dispatch_wakeup;
+
+static void dispatch_wakeup_dump( struct object *obj, int verbose )
+{
+    struct dispatch_wakeup *wakeup = (struct dispatch_wakeup *)obj;
+    fprintf( stderr, "Dispatch wakeup fd=%p\n", wakeup->fd );
+}
+
+static void dispatch_wakeup_destroy( struct object *obj )
+{
+    struct dispatch_wakeup *wakeup = (struct dispatch_wakeup *)obj;
+    if (wakeup->fd) release_object( wakeup->fd );
+    close( wakeup->pipe_write );
+}
+
+static void dispatch_wakeup_poll_event( struct fd *fd, int event )
+{
+    char buffer[64];
+
+    /* the threads have already been processed by lock_server() */
+    if (event & POLLIN) read( get_unix_fd( fd ), buffer, sizeof(buffer) );
+}
+
+/* check if a request only reads server state and can be handled by a worker thread */
+static int is_parallel_request( const struct thread *thread )
+{
+    if (thread->req.request_header.request_size) return 0;
+
+    switch (thread->req.request_header.req)
+    {
+    case REQ_get_window_info:
+    case REQ_get_window_parents:
+    case REQ_get_window_rectangles:
+    case REQ_get_window_text:
+    case REQ_get_window_tree:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* acquire the server lock, updating the contention statistics */
+static void acquire_server_lock( int exclusive )
+{
+    struct lock_stats *stats = exclusive ? &exclusive_stats : &shared_stats;
+    timeout_t start = 0;
+    int contended;
+
+    if (exclusive) contended = pthread_rwlock_trywrlock( &server_lock );
+    else contended = pthread_rwlock_tryrdlock( &server_lock );
+
+    if (contended)
+    {
+        if (req_stats) start = monotonic_counter();
+        if (exclusive) pthread_rwlock_wrlock( &server_lock );
+        else pthread_rwlock_rdlock( &server_lock );
+    }
+    if (!req_stats) return;
+
+    pthread_mutex_lock( &stats_mutex );
+    stats->count++;
+    if (contended)
+    {
+        stats->contended++;
+        stats->wait += monotonic_counter() - start;
+    }
+    pthread_mutex_unlock( &stats_mutex );
+}
+
+/* write the reply of a request handled by a worker thread; return the errno to report, -1 for a partial write */
+static int write_worker_reply( union generic_reply *reply )
+{
+    struct iovec vec[2];
+    int ret;
+
+    vec[0].iov_base = (void *)reply;
+    vec[0].iov_len  = sizeof(*reply);
+    vec[1].iov_base = current->reply_data;
+    vec[1].iov_len  = current->reply_size;
+
+    if ((ret = writev( get_unix_fd( current->reply_fd ), vec, current->reply_size ? 2 : 1 )) < 0) return errno;
+    if (ret < sizeof(*reply)) return -1;
+
+    /* the main thread waits for POLLOUT if we couldn't write it all */
+    if ((current->reply_towrite = current->reply_size - (ret - sizeof(*reply)))) return 0;
+    free( current->reply_data );
+    current->reply_data = NULL;
+    return 0;
+}
+
+/* handle a request on a worker thread, with the server lock held shared */
+static void call_worker_handler( struct thread *thread )
+{
+    union generic_reply reply;
+    enum request req = thread->req.request_header.req;
+
+    thread->dispatch_status = 0;
+    /* the thread may have been killed in the meantime */
+    if (thread->state == TERMINATED || !thread->reply_fd || !is_parallel_request( thread )) return;
+
+    current = thread;
+    current->reply_size = 0;
+    clear_error();
+    memset( &reply, 0, sizeof(reply) );
+
+    dispatch_request( req, &reply );
+
+    reply.reply_header.error = current->error;
+    reply.reply_header.reply_size = current->reply_size;
+    thread->dispatch_status = write_worker_reply( &reply );
+    current = NULL;
+}
+
+static void *dispatch_worker( void *arg )
+{
+    struct thread *thread;
+    struct list *ptr;
+    int wakeup;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &dispatch_mutex );
+        while (!(ptr = list_head( &dispatch_queue ))) pthread_cond_wait( &dispatch_cond, &dispatch_mutex );
+        list_remove( ptr );
+        pthread_mutex_unlock( &dispatch_mutex );
+        thread = LIST_ENTRY( ptr, struct thread, dispatch_entry );
+
+        acquire_server_lock( 0 );
+        call_worker_handler( thread );
+        wakeup = thread->dispatch_status || thread->reply_towrite;
+
+        /* queue the thread before releasing the lock, so that the main thread
+         * never sees a new request from it before it has processed this one */
+        pthread_mutex_lock( &dispatch_mutex );
+        list_add_tail( &dispatch_done, &thread->dispatch_entry );
+        if (req_stats) worker_requests++;
+        pthread_mutex_unlock( &dispatch_mutex );
+        pthread_rwlock_unlock( &server_lock );
+
+        if (wakeup)
+        {
+            char dummy = 0;
+            write( dispatch_wakeup->pipe_write, &dummy, 1 );
+        }
+    }
+    return NULL;
+}
+
+/* hand a request to the worker threads */
+static void queue_worker_request( struct thread *thread )
+{
+    thread->dispatched = 1;
+    grab_object( thread );
+    pthread_mutex_lock( &dispatch_mutex );
+    list_add_tail( &dispatch_queue, &thread->dispatch_entry );
+    pthread_cond_signal( &dispatch_cond );
+    pthread_mutex_unlock( &dispatch_mutex );
+}
+
+/* finish the requests handled by worker threads, on the main thread */
+static void finish_worker_requests(void)
+{
+    struct list done, *ptr;
+
+    pthread_mutex_lock( &dispatch_mutex );
+    list_init( &done );
+    list_move_tail( &done, &dispatch_done );
+    pthread_mutex_unlock( &dispatch_mutex );
+
+    while ((ptr = list_head( &done )))
+    {
+        struct thread *thread = LIST_ENTRY( ptr, struct thread, dispatch_entry );
+
+        list_remove( ptr );
+        thread->dispatched = 0;
+        if (thread->state != TERMINATED && thread->reply_fd)
+        {
+            if (thread->dispatch_status == EPIPE)
+                kill_thread( thread, 0 );  /* normal death */
+            else if (thread->dispatch_status == -1)
+                fatal_protocol_error( thread, "partial write\n" );
+            else if (thread->dispatch_status)
+                fatal_protocol_error( thread, "reply write: %s\n", strerror( thread->dispatch_status ));
+            else if (thread->reply_towrite)
+            {
+                /* couldn't write it all, wait for POLLOUT */
+                set_fd_events( thread->reply_fd, POLLOUT );
+                set_fd_events( thread->request_fd, 0 );
+            }
+        }
+        release_object( thread );
+    }
+}
+
+/* release the server lock while the main loop waits for events */
+void unlock_server(void)
+{
+    if (nb_workers) pthread_rwlock_unlock( &server_lock );
+}
+
+/* take the server lock back once the main loop has events to process */
+void lock_server(void)
+{
+    if (!nb_workers) return;
+    acquire_server_lock( 1 );
+    finish_worker_requests();
+}
+
+/* start the worker threads if requested by the environment */
+void init_request_dispatch(void)
+{
+    const char *env = getenv( "WINESERVER_THREADS" );
+    unsigned int i, count;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int fd[2];
+
+    if (!env || !(count = atoi( env ))) return;
+    if (debug_level)
+    {
+        fprintf( stderr, "wineserver: request tracing is enabled, not using worker threads\n" );
+        return;
+    }
+
+    if (pipe( fd ) == -1) return;
+    fcntl( fd[0], F_SETFL, O_NONBLOCK );
+    if (!(dispatch_wakeup = alloc_object( &dispatch_wakeup_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        return;
+    }
+    dispatch_wakeup->pipe_write = fd[1];
+    if (!(dispatch_wakeup->fd = create_anonymous_fd( &dispatch_wakeup_fd_ops, fd[0], &dispatch_wakeup->obj, 0 )))
+    {
+        release_object( dispatch_wakeup );
+        dispatch_wakeup = NULL;
+        return;
+    }
+    set_fd_events( dispatch_wakeup->fd, POLLIN );
+    make_object_static( &dispatch_wakeup->obj );
+
+    pthread_rwlock_wrlock( &server_lock );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    for (i = 0; i < count; i++)
+    {
+        if (pthread_create( &thread, &attr, dispatch_worker, NULL )) break;
+        nb_workers++;
+    }
+    pthread_attr_destroy( &attr );
+    if (!nb_workers) pthread_rwlock_unlock( &server_lock );
+}
+
+#else  /* SERVER_THREADS */
+
+void unlock_server(void)
+{
+}
+
+void lock_server(void)
+{
+}
+
+void init_request_dispatch(void)
+{
+}
+
+#endif  /* SERVER_THREADS */
+
+/* check if a request can be part of a batch; it must not block or kill the thread */
+static int is_batch_request( enum request req )
+{
+    switch (req)
+    {
+    case REQ_close_handle:
+    case REQ_enum_key:
+    case REQ_enum_key_value:
+    case REQ_get_key_value:
+    case REQ_get_window_property:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* perform several independent requests in a single round-trip */
+DECL_HANDLER(batch)
+{
+    union generic_request saved_req = current->req;
+    void *saved_data = current->req_data;
+    const char *data = get_req_data();
+    data_size_t size = get_req_data_size(), max_size = get_reply_max_size();
+    data_size_t pos = 0, reply_pos = 0;
+    unsigned int count = 0;
+    char *replies = NULL;
+
+    if (max_size && !(replies = mem_alloc( max_size ))) return;
+
+    while (size - pos >= sizeof(union generic_request))
+    {
+        const union generic_request *sub_req = (const union generic_request *)(data + pos);
+        enum request sub = sub_req->request_header.req;
+        data_size_t req_size = sub_req->request_header.request_size;
+        data_size_t reply_size = sub_req->request_header.reply_size;
+        union generic_reply sub_reply;
+
+        if (!is_batch_request( sub )) break;
+        if (req_size > size - pos - sizeof(*sub_req)) break;
+        if (max_size - reply_pos < sizeof(sub_reply) ||
+            reply_size > max_size - reply_pos - sizeof(sub_reply)) break;
+
+        current->req = *sub_req;
+        current->req_data = (void *)(sub_req + 1);
+        current->reply_size = 0;
+        clear_error();
+        memset( &sub_reply, 0, sizeof(sub_reply) );
+
+        if (debug_level) trace_request();
+        dispatch_request( sub, &sub_reply );
+
+        sub_reply.reply_header.error = current->error;
+        sub_reply.reply_header.reply_size = current->reply_size;
+        if (debug_level) trace_reply( sub, &sub_reply );
+
+        memcpy( replies + reply_pos, &sub_reply, sizeof(sub_reply) );
+        if (current->reply_size)
+            memcpy( replies + reply_pos + sizeof(sub_reply), current->reply_data, current->reply_size );
+        free( current->reply_data );
+        current->reply_data = NULL;
+
+        reply_pos += min( (sizeof(sub_reply) + current->reply_size + 7) & ~7, max_size - reply_pos );
+        pos += min( (sizeof(*sub_req) + req_size + 7) & ~7, size - pos );
+        count++;
+    }
+
+    current->req = saved_req;
+    current->req_data = saved_data;
+    current->reply_size = 0;
+    clear_error();
+
+    reply->count = count;
+    if (replies) set_reply_data_ptr( replies, reply_pos );
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
 
+#ifdef SERVER_THREADS
+    if (thread->dispatched)
+    {
+        fatal_protocol_error( thread, "request %d received while another one is pending\n", req );
+        return;
+    }
+    if (nb_workers && is_parallel_request( thread ))
+    {
+        queue_worker_request( thread );
+        return;
+    }
+#endif
+
     current = thread;
     current->reply_size = 0;
     clear_error();
@@ -307,7 +861,7 @@ static void call_req_handler( struct thread *thread )
     if (debug_level) trace_request();
 
     if (req < REQ_NB_REQUESTS)
-        req_handlers[req]( &current->req, &reply );
+        dispatch_request( req, &reply );
     else
         set_error( STATUS_NOT_IMPLEMENTED );
 
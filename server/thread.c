@@ -202,6 +202,9 @@ static inline void init_thread_structure( struct thread *thread )
     thread->token           = NULL;
     thread->desc            = NULL;
     thread->desc_len        = 0;
+#ifdef SERVER_THREADS
+    thread->dispatched      = 0;
+#endif
 
     thread->creation_time = current_time;
     thread->exit_time     = 0;
@@ -90,6 +90,11 @@ struct thread
     struct list            kernel_object; /* list of kernel object pointers */
     data_size_t            desc_len;      /* thread description length in bytes */
     WCHAR                 *desc;          /* thread description string */
+#ifdef SERVER_THREADS
+    struct list            dispatch_entry;/* entry in the worker thread queues */
+    int                    dispatched;    /* request has been handed to a worker thread */
+    int                    dispatch_status;/* errno of the reply write by the worker, -1 if partial */
+#endif
 };
 
 struct thread_snapshot
@@ -99,7 +104,7 @@ struct thread_snapshot
     int             priority;  /* priority class */
 };
 
-extern struct thread *current;
+extern server_thread_local struct thread *current;
 
 /* thread functions */
 
@@ -142,7 +147,7 @@ extern int send_thread_signal( struct thread *thread, int sig );
 extern void get_selector_entry( struct thread *thread, int entry, unsigned int *base,
                                 unsigned int *limit, unsigned char *flags );
 
-extern unsigned int global_error;  /* global error code for when no thread is current */
+extern server_thread_local unsigned int global_error;  /* global error code for when no thread is current */
 
 static inline unsigned int get_error(void)       { return current ? current->error : global_error; }
 static inline void set_error( unsigned int err ) { global_error = err; if (current) current->error = err; }